@@ -2,7 +2,13 @@
 
 #include <algorithm>
 #include <cerrno>
+#include <charconv>
+#include <climits>
+#include <cmath>
 #include <cstdio>
+#include <cstring>
+#include <limits>
+#include <unordered_set>
 
 namespace lua_core {
 
@@ -110,6 +116,1457 @@ int ProtectedTableICollect(lua_State* L) {  // [t] -> [dense array of values]
   return 1;
 }
 
+// Converts a pairs() key at `idx` to a LuaValue: strings and numbers (integer
+// vs float preserved) only. Returns null for any other key type, which the
+// traversals skip. Never converts in place, so lua_next can keep using the key.
+LuaPtr PairsKeyToLuaValue(lua_State* L, const int idx) {
+  if (const int key_type = lua_type(L, idx); key_type == LUA_TSTRING) {
+    size_t len;
+    const char* str = lua_tolstring(L, idx, &len);
+    return std::make_shared<LuaValue>(LuaValue::from(std::string(str, len)));
+  } else if (key_type == LUA_TNUMBER) {
+    if (lua_isinteger(L, idx)) {
+      return std::make_shared<LuaValue>(LuaValue::from(static_cast<int64_t>(lua_tointeger(L, idx))));
+    }
+    return std::make_shared<LuaValue>(LuaValue::from(static_cast<double>(lua_tonumber(L, idx))));
+  }
+  return nullptr;
+}
+
+// The userdata block behind a numeric array view: the binding's ref_id (for
+// the ref count and the round trip back to the same TypedArray), the view, and
+// the LuaRuntime::NumericViewEpoch at which the view was last resolved.
+struct NumericArrayBlock {
+  int ref_id;
+  NumericArrayView view;
+  uint64_t epoch;
+};
+
+// Marks every numeric array view stale when it goes out of scope, however the
+// host call it brackets ends: the JS that call ran may have detached a buffer.
+struct NumericViewsCallout {
+  LuaRuntime* runtime;
+  ~NumericViewsCallout() { if (runtime) runtime->InvalidateNumericViews(); }
+};
+
+const char* NumericArrayTypeName(const NumericArrayType type) {
+  switch (type) {
+    case NumericArrayType::Int8: return "Int8Array";
+    case NumericArrayType::Int16: return "Int16Array";
+    case NumericArrayType::Uint16: return "Uint16Array";
+    case NumericArrayType::Int32: return "Int32Array";
+    case NumericArrayType::Uint32: return "Uint32Array";
+    case NumericArrayType::Float32: return "Float32Array";
+    case NumericArrayType::Float64: return "Float64Array";
+  }
+  return "numeric array";
+}
+
+// Pushes element `i` (0-based): a Lua integer for the integer element types,
+// a float for Float32/Float64.
+void PushNumericElement(lua_State* L, const NumericArrayView& v, const size_t i) {
+  switch (v.type) {
+    case NumericArrayType::Int8: lua_pushinteger(L, static_cast<const int8_t*>(v.data)[i]); return;
+    case NumericArrayType::Int16: lua_pushinteger(L, static_cast<const int16_t*>(v.data)[i]); return;
+    case NumericArrayType::Uint16: lua_pushinteger(L, static_cast<const uint16_t*>(v.data)[i]); return;
+    case NumericArrayType::Int32: lua_pushinteger(L, static_cast<const int32_t*>(v.data)[i]); return;
+    case NumericArrayType::Uint32: lua_pushinteger(L, static_cast<const uint32_t*>(v.data)[i]); return;
+    case NumericArrayType::Float32: lua_pushnumber(L, static_cast<const float*>(v.data)[i]); return;
+    case NumericArrayType::Float64: lua_pushnumber(L, static_cast<const double*>(v.data)[i]); return;
+  }
+}
+
+template <typename T>
+void StoreIntegerElement(lua_State* L, const NumericArrayView& v, const size_t i,
+                         const lua_Integer n) {
+  if (n < static_cast<lua_Integer>(std::numeric_limits<T>::min()) ||
+      n > static_cast<lua_Integer>(std::numeric_limits<T>::max())) {
+    luaL_error(L, "value %I is out of range for %s", n, NumericArrayTypeName(v.type));
+  }
+  static_cast<T*>(v.data)[i] = static_cast<T>(n);
+}
+
+// Stores the number at stack index `arg` into element `i` (0-based). The float
+// types take any number (Float32 rounds, as Float32Array does). The integer
+// types take only integral values within their range — raising instead of the
+// silent wrap a TypedArray assignment would do. Raises; holds no C++ locals.
+void StoreNumericElement(lua_State* L, const NumericArrayView& v, const size_t i,
+                         const int arg) {
+  if (v.type == NumericArrayType::Float64) {
+    static_cast<double*>(v.data)[i] = static_cast<double>(luaL_checknumber(L, arg));
+    return;
+  }
+  if (v.type == NumericArrayType::Float32) {
+    static_cast<float*>(v.data)[i] = static_cast<float>(luaL_checknumber(L, arg));
+    return;
+  }
+  const lua_Integer n = luaL_checkinteger(L, arg);
+  switch (v.type) {
+    case NumericArrayType::Int8: StoreIntegerElement<int8_t>(L, v, i, n); return;
+    case NumericArrayType::Int16: StoreIntegerElement<int16_t>(L, v, i, n); return;
+    case NumericArrayType::Uint16: StoreIntegerElement<uint16_t>(L, v, i, n); return;
+    case NumericArrayType::Int32: StoreIntegerElement<int32_t>(L, v, i, n); return;
+    case NumericArrayType::Uint32: StoreIntegerElement<uint32_t>(L, v, i, n); return;
+    default: return;
+  }
+}
+
+// --- vector library ---
+//
+// The opt-in `vector` library (libraries: [..., 'vector']): whole-array kernels
+// over numeric array views, so an aggregation over a JS Float64Array — or an
+// array made here with vector.new — runs as one native loop instead of an
+// interpreted one per element. The hot loops are written for the compiler's
+// vectorizer (independent accumulator lanes, no calls or branches in the
+// body) rather than with intrinsics, so the same code builds on every
+// platform binding.gyp targets. Arrays made by vector.new / vector.from live
+// in the userdata block itself (ref_id 0: nothing on the JS side to release).
+
+// Independent accumulators per reduction: enough to fill one AVX2 register of
+// doubles twice over, and to break the loop-carried dependency on a float add.
+constexpr size_t kVectorLanes = 8;
+
+size_t NumericElementSize(const NumericArrayType type) {
+  switch (type) {
+    case NumericArrayType::Int8: return 1;
+    case NumericArrayType::Int16:
+    case NumericArrayType::Uint16: return 2;
+    case NumericArrayType::Int32:
+    case NumericArrayType::Uint32:
+    case NumericArrayType::Float32: return 4;
+    case NumericArrayType::Float64: return 8;
+  }
+  return 8;
+}
+
+// Element type names as vector.new / vector.from / vector.type spell them.
+constexpr std::pair<const char*, NumericArrayType> kVectorTypeNames[] = {
+  {"int8", NumericArrayType::Int8},
+  {"int16", NumericArrayType::Int16},
+  {"uint16", NumericArrayType::Uint16},
+  {"int32", NumericArrayType::Int32},
+  {"uint32", NumericArrayType::Uint32},
+  {"float32", NumericArrayType::Float32},
+  {"float64", NumericArrayType::Float64},
+};
+
+NumericArrayType CheckVectorType(lua_State* L, const int arg) {
+  const char* name = luaL_optstring(L, arg, "float64");
+  for (const auto& [n, type] : kVectorTypeNames) {
+    if (std::strcmp(n, name) == 0) return type;
+  }
+  luaL_argerror(L, arg, lua_pushfstring(L, "unknown element type '%s'", name));
+  return NumericArrayType::Float64;
+}
+
+// Calls `f` with the view's data as a pointer to its element type.
+template <typename F>
+void VisitNumericArray(const NumericArrayView& v, F&& f) {
+  switch (v.type) {
+    case NumericArrayType::Int8: f(static_cast<int8_t*>(v.data)); return;
+    case NumericArrayType::Int16: f(static_cast<int16_t*>(v.data)); return;
+    case NumericArrayType::Uint16: f(static_cast<uint16_t*>(v.data)); return;
+    case NumericArrayType::Int32: f(static_cast<int32_t*>(v.data)); return;
+    case NumericArrayType::Uint32: f(static_cast<uint32_t*>(v.data)); return;
+    case NumericArrayType::Float32: f(static_cast<float*>(v.data)); return;
+    case NumericArrayType::Float64: f(static_cast<double*>(v.data)); return;
+  }
+}
+
+// Reductions accumulate floats in double and integers in uint64_t (wrapping,
+// as Lua integer arithmetic does, without signed-overflow UB).
+template <typename T>
+using VectorAcc = std::conditional_t<std::is_floating_point_v<T>, double, uint64_t>;
+
+template <typename T>
+VectorAcc<T> Widen(const T x) {
+  if constexpr (std::is_floating_point_v<T>) {
+    return static_cast<double>(x);
+  } else {
+    return static_cast<uint64_t>(static_cast<int64_t>(x));
+  }
+}
+
+template <typename T>
+void PushVectorAcc(lua_State* L, const VectorAcc<T> acc) {
+  if constexpr (std::is_floating_point_v<T>) {
+    lua_pushnumber(L, acc);
+  } else {
+    lua_pushinteger(L, static_cast<lua_Integer>(acc));
+  }
+}
+
+// The error to raise before touching `block`'s elements, or nullptr. A view
+// over a JS TypedArray (ref_id != 0) is re-resolved once per epoch, since JS
+// that ran in between can detach its buffer; in between, and throughout async
+// execution, the cached pointer and length are used as they are. Vector
+// library storage belongs to the block itself.
+const char* RefreshNumericBlock(lua_State* L, NumericArrayBlock* block) {
+  if (block->ref_id == 0) return nullptr;
+  const auto* runtime = *static_cast<LuaRuntime**>(lua_getextraspace(L));
+  if (!runtime || runtime->IsAsyncMode() || block->epoch == runtime->NumericViewEpoch()) {
+    return nullptr;
+  }
+  const char* error = runtime->RefreshNumericView(block->ref_id, block->view);
+  if (!error) block->epoch = runtime->NumericViewEpoch();
+  return error;
+}
+
+// The numeric array at `arg`, refreshed and safe to access.
+NumericArrayBlock* CheckNumericArray(lua_State* L, const int arg) {
+  auto* block = static_cast<NumericArrayBlock*>(
+      luaL_checkudata(L, arg, LuaRuntime::kNumericArrayMetaName));
+  if (const char* error = RefreshNumericBlock(L, block)) luaL_error(L, "%s", error);
+  return block;
+}
+
+const NumericArrayBlock* CheckVector(lua_State* L, const int arg) {
+  return CheckNumericArray(L, arg);
+}
+
+// Binary kernels pair elements one to one: same element type, same length.
+void CheckSameShape(lua_State* L, const NumericArrayView& a, const NumericArrayView& b) {
+  if (a.type != b.type) {
+    luaL_error(L, "vector: element types differ (%s and %s)",
+               NumericArrayTypeName(a.type), NumericArrayTypeName(b.type));
+  }
+  if (a.length != b.length) {
+    luaL_error(L, "vector: lengths differ (%I and %I)",
+               static_cast<lua_Integer>(a.length), static_cast<lua_Integer>(b.length));
+  }
+}
+
+// Pushes a zero-filled array of `length` elements whose storage trails the
+// block in the same userdata allocation.
+NumericArrayBlock* NewVector(lua_State* L, const size_t length, const NumericArrayType type) {
+  const size_t elem = NumericElementSize(type);
+  if (length > (std::numeric_limits<size_t>::max() - sizeof(NumericArrayBlock)) / elem) {
+    luaL_error(L, "vector: array too large");
+  }
+  auto* block = static_cast<NumericArrayBlock*>(
+      lua_newuserdatauv(L, sizeof(NumericArrayBlock) + length * elem, 0));
+  block->ref_id = 0;
+  block->epoch = 0;
+  block->view.data = length ? static_cast<void*>(block + 1) : nullptr;
+  block->view.length = length;
+  block->view.type = type;
+  if (length) std::memset(block->view.data, 0, length * elem);
+  luaL_setmetatable(L, LuaRuntime::kNumericArrayMetaName);
+  return block;
+}
+
+// vector.new(n [, type]) -> array of n zeros (type defaults to "float64")
+int VectorNew(lua_State* L) {
+  const lua_Integer n = luaL_checkinteger(L, 1);
+  luaL_argcheck(L, n >= 0, 1, "length must be non-negative");
+  NewVector(L, static_cast<size_t>(n), CheckVectorType(L, 2));
+  return 1;
+}
+
+// vector.from(t [, type]) -> array holding t[1..#t]
+int VectorFrom(lua_State* L) {
+  luaL_checktype(L, 1, LUA_TTABLE);
+  const auto n = static_cast<size_t>(lua_rawlen(L, 1));
+  const NumericArrayBlock* block = NewVector(L, n, CheckVectorType(L, 2));
+  for (size_t i = 0; i < n; ++i) {
+    lua_rawgeti(L, 1, static_cast<lua_Integer>(i + 1));
+    StoreNumericElement(L, block->view, i, -1);
+    lua_pop(L, 1);
+  }
+  return 1;
+}
+
+// vector.totable(a) -> a plain Lua sequence copy of a
+int VectorToTable(lua_State* L) {
+  const NumericArrayView& v = CheckVector(L, 1)->view;
+  lua_createtable(L, static_cast<int>(std::min<size_t>(v.length, INT_MAX)), 0);
+  for (size_t i = 0; i < v.length; ++i) {
+    PushNumericElement(L, v, i);
+    lua_rawseti(L, -2, static_cast<lua_Integer>(i + 1));
+  }
+  return 1;
+}
+
+// vector.type(a) -> element type name
+int VectorType(lua_State* L) {
+  const NumericArrayType type = CheckVector(L, 1)->view.type;
+  for (const auto& [n, t] : kVectorTypeNames) {
+    if (t == type) {
+      lua_pushstring(L, n);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// vector.sum(a) -> integer for integer element types, float otherwise
+int VectorSum(lua_State* L) {
+  const NumericArrayView& v = CheckVector(L, 1)->view;
+  VisitNumericArray(v, [&](auto* p) {
+    using T = std::remove_pointer_t<decltype(p)>;
+    VectorAcc<T> lanes[kVectorLanes] = {};
+    size_t i = 0;
+    for (; i + kVectorLanes <= v.length; i += kVectorLanes) {
+      for (size_t j = 0; j < kVectorLanes; ++j) lanes[j] += Widen(p[i + j]);
+    }
+    VectorAcc<T> total = 0;
+    for (const auto lane : lanes) total += lane;
+    for (; i < v.length; ++i) total += Widen(p[i]);
+    PushVectorAcc<T>(L, total);
+  });
+  return 1;
+}
+
+// vector.dot(a, b) -> sum of a[i] * b[i]
+int VectorDot(lua_State* L) {
+  const NumericArrayView& a = CheckVector(L, 1)->view;
+  const NumericArrayView& b = CheckVector(L, 2)->view;
+  CheckSameShape(L, a, b);
+  VisitNumericArray(a, [&](auto* p) {
+    using T = std::remove_pointer_t<decltype(p)>;
+    const T* q = static_cast<const T*>(b.data);
+    VectorAcc<T> lanes[kVectorLanes] = {};
+    size_t i = 0;
+    for (; i + kVectorLanes <= a.length; i += kVectorLanes) {
+      for (size_t j = 0; j < kVectorLanes; ++j) lanes[j] += Widen(p[i + j]) * Widen(q[i + j]);
+    }
+    VectorAcc<T> total = 0;
+    for (const auto lane : lanes) total += lane;
+    for (; i < a.length; ++i) total += Widen(p[i]) * Widen(q[i]);
+    PushVectorAcc<T>(L, total);
+  });
+  return 1;
+}
+
+// vector.axpy(alpha, x, y): y[i] = alpha * x[i] + y[i], in place; returns y.
+// Float element types only — an integer y would need a rounding policy.
+int VectorAxpy(lua_State* L) {
+  const lua_Number alpha = luaL_checknumber(L, 1);
+  const NumericArrayView& x = CheckVector(L, 2)->view;
+  const NumericArrayView& y = CheckVector(L, 3)->view;
+  CheckSameShape(L, x, y);
+  if (y.type != NumericArrayType::Float32 && y.type != NumericArrayType::Float64) {
+    return luaL_error(L, "vector.axpy: needs float32 or float64 arrays, got %s",
+                      NumericArrayTypeName(y.type));
+  }
+  VisitNumericArray(y, [&](auto* q) {
+    using T = std::remove_pointer_t<decltype(q)>;
+    if constexpr (std::is_floating_point_v<T>) {
+      const T* p = static_cast<const T*>(x.data);
+      const T a = static_cast<T>(alpha);
+      for (size_t i = 0; i < y.length; ++i) q[i] = a * p[i] + q[i];
+    }
+  });
+  lua_settop(L, 3);
+  return 1;
+}
+
+// Shared by vector.min / vector.max: the extreme value and the 1-based index
+// of its first occurrence, or nil for an empty (or all-NaN) array. The value
+// pass keeps kVectorLanes running extremes; the index is found afterwards by
+// a plain scan, which keeps the hot loop branch-free.
+template <bool kMax>
+int VectorExtreme(lua_State* L) {
+  const NumericArrayView& v = CheckVector(L, 1)->view;
+  bool found = false;
+  VisitNumericArray(v, [&](auto* p) {
+    using T = std::remove_pointer_t<decltype(p)>;
+    T seed;
+    if constexpr (std::is_floating_point_v<T>) {
+      seed = kMax ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::infinity();
+    } else {
+      seed = kMax ? std::numeric_limits<T>::lowest() : std::numeric_limits<T>::max();
+    }
+    T lanes[kVectorLanes];
+    for (auto& lane : lanes) lane = seed;
+    size_t i = 0;
+    // `x > m ? x : m` rather than std::max: a NaN element compares false and
+    // is skipped instead of poisoning the lane.
+    for (; i + kVectorLanes <= v.length; i += kVectorLanes) {
+      for (size_t j = 0; j < kVectorLanes; ++j) {
+        const T x = p[i + j];
+        lanes[j] = (kMax ? x > lanes[j] : x < lanes[j]) ? x : lanes[j];
+      }
+    }
+    T best = seed;
+    for (const T lane : lanes) best = (kMax ? lane > best : lane < best) ? lane : best;
+    for (; i < v.length; ++i) best = (kMax ? p[i] > best : p[i] < best) ? p[i] : best;
+    for (size_t k = 0; k < v.length; ++k) {
+      if (p[k] == best) {
+        PushNumericElement(L, v, k);
+        lua_pushinteger(L, static_cast<lua_Integer>(k + 1));
+        found = true;
+        return;
+      }
+    }
+  });
+  if (!found) {
+    lua_pushnil(L);
+    return 1;
+  }
+  return 2;
+}
+
+// vector.sort(a): ascending, in place (NaNs last); returns a.
+int VectorSort(lua_State* L) {
+  const NumericArrayView& v = CheckVector(L, 1)->view;
+  VisitNumericArray(v, [&](auto* p) {
+    using T = std::remove_pointer_t<decltype(p)>;
+    if constexpr (std::is_floating_point_v<T>) {
+      // A NaN breaks the strict weak ordering std::sort needs; order it last.
+      std::sort(p, p + v.length, [](const T a, const T b) {
+        return a < b || (!std::isnan(a) && std::isnan(b));
+      });
+    } else {
+      std::sort(p, p + v.length);
+    }
+  });
+  lua_settop(L, 1);
+  return 1;
+}
+
+// vector.cumsum(a): inclusive prefix sum, in place; returns a. An integer sum
+// that leaves the element type's range raises rather than wrapping, and the
+// elements before that point are left updated.
+int VectorCumsum(lua_State* L) {
+  const NumericArrayView& v = CheckVector(L, 1)->view;
+  VisitNumericArray(v, [&](auto* p) {
+    using T = std::remove_pointer_t<decltype(p)>;
+    if constexpr (std::is_floating_point_v<T>) {
+      double acc = 0;
+      for (size_t i = 0; i < v.length; ++i) p[i] = static_cast<T>(acc += p[i]);
+    } else {
+      int64_t acc = 0;
+      for (size_t i = 0; i < v.length; ++i) {
+        acc += p[i];
+        if (acc < std::numeric_limits<T>::lowest() || acc > std::numeric_limits<T>::max()) {
+          luaL_error(L, "vector.cumsum: sum at index %I is out of range for %s",
+                     static_cast<lua_Integer>(i + 1), NumericArrayTypeName(v.type));
+        }
+        p[i] = static_cast<T>(acc);
+      }
+    }
+  });
+  lua_settop(L, 1);
+  return 1;
+}
+
+enum class VectorCmp { Lt, Le, Gt, Ge, Eq, Ne };
+
+template <typename T, typename U>
+bool VectorCompare(const VectorCmp op, const T x, const U y) {
+  switch (op) {
+    case VectorCmp::Lt: return x < y;
+    case VectorCmp::Le: return x <= y;
+    case VectorCmp::Gt: return x > y;
+    case VectorCmp::Ge: return x >= y;
+    case VectorCmp::Eq: return x == y;
+    case VectorCmp::Ne: return x != y;
+  }
+  return false;
+}
+
+// Runs the comparison with `op` fixed at compile time, so each instantiation
+// is a straight-line loop the vectorizer can turn into compare-and-mask.
+template <VectorCmp kOp, typename T, typename U, typename RhsAt>
+void CompareInto(int8_t* out, const T* p, const size_t n, RhsAt rhs) {
+  for (size_t i = 0; i < n; ++i) out[i] = VectorCompare<T, U>(kOp, p[i], rhs(i)) ? 1 : 0;
+}
+
+template <typename T, typename U, typename RhsAt>
+void CompareDispatch(const VectorCmp op, int8_t* out, const T* p, const size_t n, RhsAt rhs) {
+  switch (op) {
+    case VectorCmp::Lt: CompareInto<VectorCmp::Lt, T, U>(out, p, n, rhs); return;
+    case VectorCmp::Le: CompareInto<VectorCmp::Le, T, U>(out, p, n, rhs); return;
+    case VectorCmp::Gt: CompareInto<VectorCmp::Gt, T, U>(out, p, n, rhs); return;
+    case VectorCmp::Ge: CompareInto<VectorCmp::Ge, T, U>(out, p, n, rhs); return;
+    case VectorCmp::Eq: CompareInto<VectorCmp::Eq, T, U>(out, p, n, rhs); return;
+    case VectorCmp::Ne: CompareInto<VectorCmp::Ne, T, U>(out, p, n, rhs); return;
+  }
+}
+
+// vector.compare(a, op, b) -> int8 mask of 1/0 per element. `op` is one of
+// "<", "<=", ">", ">=", "==", "~="; `b` is a number or an array shaped like a.
+// vector.sum(mask) counts the matches.
+int VectorCompareMask(lua_State* L) {
+  const NumericArrayView& a = CheckVector(L, 1)->view;
+  static const char* const kOps[] = {"<", "<=", ">", ">=", "==", "~=", nullptr};
+  const auto op = static_cast<VectorCmp>(luaL_checkoption(L, 2, nullptr, kOps));
+  const bool scalar = lua_type(L, 3) == LUA_TNUMBER;
+  const NumericArrayView* b = scalar ? nullptr : &CheckVector(L, 3)->view;
+  if (b) CheckSameShape(L, a, *b);
+  const lua_Number x = scalar ? lua_tonumber(L, 3) : 0;
+  auto* out = static_cast<int8_t*>(NewVector(L, a.length, NumericArrayType::Int8)->view.data);
+  VisitNumericArray(a, [&](auto* p) {
+    using T = std::remove_pointer_t<decltype(p)>;
+    if (scalar) {
+      // Compared as doubles: exact for every element type here.
+      CompareDispatch<T, double>(op, out, p, a.length, [x](size_t) { return x; });
+    } else {
+      const T* q = static_cast<const T*>(b->data);
+      CompareDispatch<T, T>(op, out, p, a.length, [q](const size_t i) { return q[i]; });
+    }
+  });
+  return 1;
+}
+
+int OpenVectorLibrary(lua_State* L) {
+  static const luaL_Reg kFuncs[] = {
+    {"new", VectorNew},
+    {"from", VectorFrom},
+    {"totable", VectorToTable},
+    {"type", VectorType},
+    {"sum", VectorSum},
+    {"dot", VectorDot},
+    {"axpy", VectorAxpy},
+    {"min", VectorExtreme<false>},
+    {"max", VectorExtreme<true>},
+    {"sort", VectorSort},
+    {"cumsum", VectorCumsum},
+    {"compare", VectorCompareMask},
+    {nullptr, nullptr},
+  };
+  luaL_newlib(L, kFuncs);
+  return 1;
+}
+
+// --- Shared data views ---
+//
+// The userdata block behind a SharedData view. A root view (the global bound
+// by SetGlobalSharedData) keeps its slot and re-reads it whenever the slot's
+// version moves on; a nested view has no slot and stays on the version it was
+// read from. Either way `data` keeps that version alive.
+struct SharedDataBlock {
+  std::shared_ptr<SharedDataSlot> slot;
+  std::shared_ptr<const SharedData> data;
+  uint64_t version = 0;
+  uint32_t node = 0;
+};
+
+// Pushes an empty view with its metatable (and so its __gc) already attached:
+// the raise-capable steps come first, and the caller fills in the owners
+// afterwards, so no owner is ever live across a raise.
+SharedDataBlock* NewSharedDataBlock(lua_State* L) {
+  auto* block = static_cast<SharedDataBlock*>(
+      lua_newuserdatauv(L, sizeof(SharedDataBlock), 0));
+  new (block) SharedDataBlock();
+  luaL_setmetatable(L, LuaRuntime::kSharedDataMetaName);
+  return block;
+}
+
+// The version a view reads — a root view catches up with its slot first — or
+// null for a view already finalized.
+const SharedData* SharedDataOf(SharedDataBlock* block) {
+  if (block->slot && block->slot->version() != block->version) {
+    block->data = block->slot->Load(&block->version);
+    block->node = block->data ? block->data->root() : 0;
+  }
+  return block->data.get();
+}
+
+// Pushes node `i`: scalars as Lua values, containers as nested views sharing
+// `data`. Pass a block's own member for `data`, never a local — the pushes can
+// raise, and a raise would skip a local's destructor.
+void PushSharedDataValue(lua_State* L, const std::shared_ptr<const SharedData>& data,
+                         const uint32_t i) {
+  const SharedData::Node& n = data->node(i);
+  switch (n.kind) {
+    case SharedData::Kind::Nil: lua_pushnil(L); return;
+    case SharedData::Kind::Boolean: lua_pushboolean(L, n.boolean); return;
+    case SharedData::Kind::Integer: lua_pushinteger(L, static_cast<lua_Integer>(n.integer)); return;
+    case SharedData::Kind::Number: lua_pushnumber(L, static_cast<lua_Number>(n.number)); return;
+    case SharedData::Kind::String: {
+      const std::string_view s = data->string(n);
+      lua_pushlstring(L, s.data(), s.size());
+      return;
+    }
+    case SharedData::Kind::Array:
+    case SharedData::Kind::Object: {
+      SharedDataBlock* view = NewSharedDataBlock(L);
+      view->data = data;
+      view->node = i;
+      return;
+    }
+  }
+}
+
+// The value node under the key at stack index `key`: an integer 1..n in an
+// array; in an object a string — or an integer by its decimal form, the way JS
+// reads obj[1] as obj["1"]. Anything else finds nothing.
+std::optional<uint32_t> SharedDataLookup(lua_State* L, const SharedData& data,
+                                         const SharedData::Node& n, const int key) {
+  const int type = lua_type(L, key);
+  if (n.kind == SharedData::Kind::Array) {
+    int isint = 0;
+    const lua_Integer i = type == LUA_TNUMBER ? lua_tointegerx(L, key, &isint) : 0;
+    if (!isint || i < 1 || static_cast<lua_Unsigned>(i) > n.count) return std::nullopt;
+    return data.Element(n, static_cast<size_t>(i - 1));
+  }
+  if (n.kind != SharedData::Kind::Object) return std::nullopt;
+  std::optional<size_t> entry;
+  if (type == LUA_TSTRING) {
+    size_t len;
+    const char* s = lua_tolstring(L, key, &len);
+    entry = data.FindEntry(n, {s, len});
+  } else if (type == LUA_TNUMBER && lua_isinteger(L, key)) {
+    char buf[24];
+    const auto res = std::to_chars(buf, buf + sizeof(buf),
+                                   static_cast<int64_t>(lua_tointeger(L, key)));
+    entry = data.FindEntry(n, {buf, static_cast<size_t>(res.ptr - buf)});
+  }
+  if (!entry) return std::nullopt;
+  return data.EntryValue(n, *entry);
+}
+
+// A view leaving Lua: copied out as plain data, like a vector library array.
+LuaPtr SharedDataToValue(const SharedData& data, const uint32_t i, const int depth) {
+  if (depth > LuaRuntime::kMaxDepth) {
+    throw std::runtime_error("Value nesting depth exceeds the maximum of "
+      + std::to_string(LuaRuntime::kMaxDepth) + " levels");
+  }
+  const SharedData::Node& n = data.node(i);
+  switch (n.kind) {
+    case SharedData::Kind::Nil: return std::make_shared<LuaValue>(LuaValue::nil());
+    case SharedData::Kind::Boolean: return std::make_shared<LuaValue>(LuaValue::from(n.boolean));
+    case SharedData::Kind::Integer: return std::make_shared<LuaValue>(LuaValue::from(n.integer));
+    case SharedData::Kind::Number: return std::make_shared<LuaValue>(LuaValue::from(n.number));
+    case SharedData::Kind::String:
+      return std::make_shared<LuaValue>(LuaValue::from(std::string(data.string(n))));
+    case SharedData::Kind::Array: {
+      LuaArray arr;
+      arr.reserve(n.count);
+      for (size_t k = 0; k < n.count; ++k) {
+        arr.push_back(SharedDataToValue(data, data.Element(n, k), depth + 1));
+      }
+      return std::make_shared<LuaValue>(LuaValue::from(std::move(arr)));
+    }
+    case SharedData::Kind::Object: {
+      LuaTable tbl;
+      tbl.reserve(n.count);
+      for (size_t k = 0; k < n.count; ++k) {
+        tbl.emplace(std::string(data.EntryKey(n, k)),
+                    SharedDataToValue(data, data.EntryValue(n, k), depth + 1));
+      }
+      return std::make_shared<LuaValue>(LuaValue::from(std::move(tbl)));
+    }
+  }
+  return std::make_shared<LuaValue>(LuaValue::nil());
+}
+
+// --- Lazy tables ---
+//
+// The userdata behind a lazy table global, shared as upvalue 1 by the proxy's
+// metamethods. Its one user value is the cache: fields pulled (or assigned)
+// since `seen`, the source version they belong to.
+struct LazyTableBlock {
+  std::shared_ptr<const LazyTableSource> source;
+  uint64_t seen = 0;      // 0: nothing pulled yet (versions start at 1)
+  bool complete = false;  // the cache holds the whole table; a miss is absent
+};
+
+// Cached in place of nil for a key the source doesn't have, so a miss is
+// pulled once per version rather than on every read.
+char lazy_absent_anchor;
+
+LazyTableBlock* NewLazyTableBlock(lua_State* L) {
+  auto* block = static_cast<LazyTableBlock*>(
+      lua_newuserdatauv(L, sizeof(LazyTableBlock), 1));
+  new (block) LazyTableBlock();
+  luaL_setmetatable(L, LuaRuntime::kLazyTableMetaName);
+  return block;
+}
+
+// The iterator pairs() hands out: a raw next over the materialized cache,
+// independent of whatever the script's global `next` is.
+int LazyTableNext(lua_State* L) {
+  luaL_checktype(L, 1, LUA_TTABLE);
+  lua_settop(L, 2);
+  if (lua_next(L, 1)) return 2;
+  lua_pushnil(L);
+  return 1;
+}
+
+// Starts an empty cache when the source has changed since the last read.
+void RefreshLazyTable(lua_State* L, const int block_index, LazyTableBlock* block) {
+  const uint64_t version = block->source->version->load(std::memory_order_acquire);
+  if (block->seen == version) return;
+  lua_newtable(L);
+  lua_setiuservalue(L, block_index, 1);
+  block->seen = version;
+  block->complete = false;
+}
+
+// --- Class instance fields ---
+//
+// The block of an instance whose class declares fields: the usual ref_id
+// first (so UserdataGC and ToLuaValue read it unchanged), then the record the
+// fields live in, owned by the runtime's record for ref_id.
+struct ClassFieldBlock {
+  int ref_id;
+  ClassInstanceFields* fields;
+};
+
+// Pushes slot `slot` (0-based) of `record`. May raise ERRMEM for a string.
+void PushClassField(lua_State* L, const ClassInstanceFields& record, const size_t slot) {
+  switch ((*record.layout)[slot].type) {
+    case ClassFieldType::Number: lua_pushnumber(L, record.scalars[slot].number); break;
+    case ClassFieldType::Integer: lua_pushinteger(L, record.scalars[slot].integer); break;
+    case ClassFieldType::Boolean: lua_pushboolean(L, record.scalars[slot].boolean); break;
+    case ClassFieldType::String: {
+      const std::string& str = record.strings[slot];
+      lua_pushlstring(L, str.data(), str.size());
+      break;
+    }
+  }
+}
+
+// --- JSON decoding ---
+//
+// Builds Lua values straight from JSON text on the Lua stack, with the same
+// mapping NapiToCore applies to the equivalent JS value: objects become tables
+// with string keys, arrays become 1-based sequences, null becomes nil, and a
+// number with no fractional part in int64 range becomes an integer. Skipping
+// the JS object graph removes the per-property N-API calls (property names,
+// key ToString, Get) that dominate converting a large payload.
+//
+// Raises on malformed input, so it must run inside a protected frame, and
+// holds no C++ locals with destructors across the raises: escaped strings are
+// assembled in a luaL_Buffer, which Lua owns.
+
+struct JsonReader {
+  lua_State* L;
+  const char* begin;
+  const char* p;
+  const char* end;
+  int null_index;  // stack index of the value JSON null decodes to; 0 = nil
+};
+
+// json.null: a light userdata standing for JSON null where nil cannot (array
+// slots, table values). Only its address matters.
+char json_null_anchor;
+
+int JsonFail(const JsonReader& r, const char* what) {
+  return luaL_error(r.L, "JSON parse error at offset %I: %s",
+                    static_cast<lua_Integer>(r.p - r.begin), what);
+}
+
+void JsonSkipSpace(JsonReader& r) {
+  while (r.p < r.end && (*r.p == ' ' || *r.p == '\n' || *r.p == '\r' || *r.p == '\t')) ++r.p;
+}
+
+// SWAR string scan: tests eight bytes per step for a quote, a backslash or a
+// control character (which JSON forbids raw in a string), so the common
+// unescaped run is skipped a word at a time without platform intrinsics.
+// Returns a pointer to the first such byte, or `end`.
+const char* JsonScanString(const char* p, const char* end) {
+  constexpr uint64_t kOnes = 0x0101010101010101ULL;
+  constexpr uint64_t kHighs = 0x8080808080808080ULL;
+  while (end - p >= 8) {
+    uint64_t w;
+    std::memcpy(&w, p, 8);
+    const uint64_t quote = w ^ (kOnes * '"');
+    const uint64_t slash = w ^ (kOnes * '\\');
+    const uint64_t hit = ((quote - kOnes) & ~quote) | ((slash - kOnes) & ~slash) |
+                         (w - kOnes * 0x20);
+    if ((hit & ~w & kHighs) != 0) break;
+    p += 8;
+  }
+  while (p < end) {
+    const auto c = static_cast<unsigned char>(*p);
+    if (c == '"' || c == '\\' || c < 0x20) return p;
+    ++p;
+  }
+  return end;
+}
+
+unsigned JsonHex4(JsonReader& r) {
+  if (r.end - r.p < 4) return JsonFail(r, "truncated \\u escape");
+  unsigned v = 0;
+  for (int i = 0; i < 4; ++i) {
+    const char c = *r.p++;
+    v <<= 4;
+    if (c >= '0' && c <= '9') v |= static_cast<unsigned>(c - '0');
+    else if (c >= 'a' && c <= 'f') v |= static_cast<unsigned>(c - 'a' + 10);
+    else if (c >= 'A' && c <= 'F') v |= static_cast<unsigned>(c - 'A' + 10);
+    else return JsonFail(r, "invalid \\u escape");
+  }
+  return v;
+}
+
+void JsonAddUtf8(luaL_Buffer* b, const unsigned cp) {
+  char out[4];
+  size_t n;
+  if (cp < 0x80) {
+    out[0] = static_cast<char>(cp);
+    n = 1;
+  } else if (cp < 0x800) {
+    out[0] = static_cast<char>(0xC0 | (cp >> 6));
+    out[1] = static_cast<char>(0x80 | (cp & 0x3F));
+    n = 2;
+  } else if (cp < 0x10000) {
+    out[0] = static_cast<char>(0xE0 | (cp >> 12));
+    out[1] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    out[2] = static_cast<char>(0x80 | (cp & 0x3F));
+    n = 3;
+  } else {
+    out[0] = static_cast<char>(0xF0 | (cp >> 18));
+    out[1] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = static_cast<char>(0x80 | (cp & 0x3F));
+    n = 4;
+  }
+  luaL_addlstring(b, out, n);
+}
+
+// [..] -> [.., string]. r.p is just past the opening quote.
+void JsonPushString(JsonReader& r) {
+  const char* stop = JsonScanString(r.p, r.end);
+  if (stop < r.end && *stop == '"') {  // no escapes: one copy, straight in
+    lua_pushlstring(r.L, r.p, static_cast<size_t>(stop - r.p));
+    r.p = stop + 1;
+    return;
+  }
+  luaL_Buffer b;
+  luaL_buffinit(r.L, &b);
+  for (;;) {
+    luaL_addlstring(&b, r.p, static_cast<size_t>(stop - r.p));
+    r.p = stop;
+    if (r.p >= r.end) {
+      JsonFail(r, "unterminated string");
+      return;
+    }
+    const char c = *r.p++;
+    if (c == '"') break;
+    if (c != '\\') {
+      --r.p;
+      JsonFail(r, "control character in string");
+      return;
+    }
+    if (r.p >= r.end) {
+      JsonFail(r, "unterminated string");
+      return;
+    }
+    switch (*r.p++) {
+      case '"': luaL_addchar(&b, '"'); break;
+      case '\\': luaL_addchar(&b, '\\'); break;
+      case '/': luaL_addchar(&b, '/'); break;
+      case 'b': luaL_addchar(&b, '\b'); break;
+      case 'f': luaL_addchar(&b, '\f'); break;
+      case 'n': luaL_addchar(&b, '\n'); break;
+      case 'r': luaL_addchar(&b, '\r'); break;
+      case 't': luaL_addchar(&b, '\t'); break;
+      case 'u': {
+        unsigned cp = JsonHex4(r);
+        if (cp >= 0xD800 && cp <= 0xDBFF && r.end - r.p >= 6 && r.p[0] == '\\' && r.p[1] == 'u') {
+          const char* save = r.p;
+          r.p += 2;
+          const unsigned lo = JsonHex4(r);
+          if (lo >= 0xDC00 && lo <= 0xDFFF) {
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+          } else {
+            r.p = save;  // not a pair: the high half stands alone
+          }
+        }
+        // A lone surrogate has no UTF-8 form; it becomes U+FFFD, as the same
+        // string does when a JS string crosses through Utf8Value.
+        if (cp >= 0xD800 && cp <= 0xDFFF) cp = 0xFFFD;
+        JsonAddUtf8(&b, cp);
+        break;
+      }
+      default:
+        --r.p;
+        JsonFail(r, "invalid escape");
+        return;
+    }
+    stop = JsonScanString(r.p, r.end);
+  }
+  luaL_pushresult(&b);
+}
+
+// Pushes a number as NapiToCore maps a JS number: integral values in int64
+// range become integers. A plain digit run that fits int64 is taken exactly,
+// without the detour through a double.
+void JsonPushNumber(JsonReader& r) {
+  const char* start = r.p;
+  bool integral = true;
+  if (r.p < r.end && *r.p == '-') ++r.p;
+  if (r.p < r.end && *r.p == '0') {
+    ++r.p;
+  } else if (r.p < r.end && *r.p >= '1' && *r.p <= '9') {
+    while (r.p < r.end && *r.p >= '0' && *r.p <= '9') ++r.p;
+  } else {
+    JsonFail(r, "invalid number");
+    return;
+  }
+  if (r.p < r.end && *r.p == '.') {
+    integral = false;
+    ++r.p;
+    if (r.p >= r.end || *r.p < '0' || *r.p > '9') {
+      JsonFail(r, "invalid number");
+      return;
+    }
+    while (r.p < r.end && *r.p >= '0' && *r.p <= '9') ++r.p;
+  }
+  if (r.p < r.end && (*r.p == 'e' || *r.p == 'E')) {
+    integral = false;
+    ++r.p;
+    if (r.p < r.end && (*r.p == '+' || *r.p == '-')) ++r.p;
+    if (r.p >= r.end || *r.p < '0' || *r.p > '9') {
+      JsonFail(r, "invalid number");
+      return;
+    }
+    while (r.p < r.end && *r.p >= '0' && *r.p <= '9') ++r.p;
+  }
+  const auto len = static_cast<size_t>(r.p - start);
+  if (integral) {
+    const bool negative = *start == '-';
+    uint64_t mag = 0;
+    bool fits = true;
+    for (const char* d = start + (negative ? 1 : 0); d < r.p && fits; ++d) {
+      const auto digit = static_cast<uint64_t>(*d - '0');
+      if (mag > (std::numeric_limits<uint64_t>::max() - digit) / 10) fits = false;
+      else mag = mag * 10 + digit;
+    }
+    constexpr uint64_t kMaxMag = static_cast<uint64_t>(std::numeric_limits<int64_t>::max());
+    if (fits && (negative ? mag <= kMaxMag + 1 : mag <= kMaxMag)) {
+      lua_pushinteger(r.L, negative ? static_cast<lua_Integer>(0 - mag)
+                                    : static_cast<lua_Integer>(mag));
+      return;
+    }
+  }
+  // Lua's own numeral reader handles the locale's decimal point; it needs a
+  // NUL-terminated copy, which a Lua string provides.
+  lua_pushlstring(r.L, start, len);
+  if (lua_stringtonumber(r.L, lua_tostring(r.L, -1)) == 0) {
+    JsonFail(r, "invalid number");
+    return;
+  }
+  lua_remove(r.L, -2);
+  const lua_Number d = lua_tonumber(r.L, -1);
+  constexpr double kInt64UpperExclusive = 9223372036854775808.0;  // 2^63
+  double intpart;
+  if (std::isfinite(d) && d >= static_cast<double>(std::numeric_limits<int64_t>::min()) &&
+      d < kInt64UpperExclusive && std::modf(d, &intpart) == 0.0) {
+    lua_pop(r.L, 1);
+    lua_pushinteger(r.L, static_cast<lua_Integer>(d));
+  }
+}
+
+void JsonExpectLiteral(JsonReader& r, const char* word, const size_t len) {
+  if (static_cast<size_t>(r.end - r.p) < len || std::memcmp(r.p, word, len) != 0) {
+    JsonFail(r, "unexpected token");
+    return;
+  }
+  r.p += len;
+}
+
+// [..] -> [.., value]
+void JsonPushValue(JsonReader& r, const int depth) {
+  if (depth > LuaRuntime::kMaxDepth) {
+    luaL_error(r.L, "JSON nesting depth exceeds the maximum of %d levels", LuaRuntime::kMaxDepth);
+    return;
+  }
+  luaL_checkstack(r.L, 4, "JSON document too deeply nested");
+  JsonSkipSpace(r);
+  if (r.p >= r.end) {
+    JsonFail(r, "unexpected end of input");
+    return;
+  }
+  switch (*r.p) {
+    case '{': {
+      ++r.p;
+      lua_newtable(r.L);
+      JsonSkipSpace(r);
+      if (r.p < r.end && *r.p == '}') {
+        ++r.p;
+        return;
+      }
+      for (;;) {
+        JsonSkipSpace(r);
+        if (r.p >= r.end || *r.p != '"') {
+          JsonFail(r, "expected a string key");
+          return;
+        }
+        ++r.p;
+        JsonPushString(r);
+        JsonSkipSpace(r);
+        if (r.p >= r.end || *r.p != ':') {
+          JsonFail(r, "expected ':'");
+          return;
+        }
+        ++r.p;
+        JsonPushValue(r, depth + 1);
+        lua_rawset(r.L, -3);  // a later duplicate key wins, as in JSON.parse
+        JsonSkipSpace(r);
+        if (r.p < r.end && *r.p == ',') {
+          ++r.p;
+          continue;
+        }
+        if (r.p < r.end && *r.p == '}') {
+          ++r.p;
+          return;
+        }
+        JsonFail(r, "expected ',' or '}'");
+        return;
+      }
+    }
+    case '[': {
+      ++r.p;
+      lua_newtable(r.L);
+      JsonSkipSpace(r);
+      if (r.p < r.end && *r.p == ']') {
+        ++r.p;
+        return;
+      }
+      for (lua_Integer i = 1;; ++i) {
+        JsonPushValue(r, depth + 1);
+        lua_rawseti(r.L, -2, i);
+        JsonSkipSpace(r);
+        if (r.p < r.end && *r.p == ',') {
+          ++r.p;
+          continue;
+        }
+        if (r.p < r.end && *r.p == ']') {
+          ++r.p;
+          return;
+        }
+        JsonFail(r, "expected ',' or ']'");
+        return;
+      }
+    }
+    case '"':
+      ++r.p;
+      JsonPushString(r);
+      return;
+    case 't':
+      JsonExpectLiteral(r, "true", 4);
+      lua_pushboolean(r.L, 1);
+      return;
+    case 'f':
+      JsonExpectLiteral(r, "false", 5);
+      lua_pushboolean(r.L, 0);
+      return;
+    case 'n':
+      JsonExpectLiteral(r, "null", 4);
+      if (r.null_index) lua_pushvalue(r.L, r.null_index);
+      else lua_pushnil(r.L);
+      return;
+    default:
+      JsonPushNumber(r);
+      return;
+  }
+}
+
+// [..] -> [.., value]: one complete JSON document, nothing but whitespace after.
+void PushJsonDocument(lua_State* L, const char* data, const size_t len,
+                      const int null_index = 0) {
+  JsonReader r{L, data, data, data + len, null_index};
+  JsonPushValue(r, 0);
+  JsonSkipSpace(r);
+  if (r.p != r.end) JsonFail(r, "unexpected trailing characters");
+}
+
+// --- JSON encoding ---
+//
+// Serializes Lua values straight from the stack into one byte buffer: the
+// reverse of the decoder above, and the JSON counterpart of ToLuaValue's walk
+// (same sequence test, isSequentialArray, and the same key stringification),
+// without a LuaValue tree or a JS object per table in between. Reports
+// unencodable input by throwing std::runtime_error; callers run it inside a
+// protected frame (RunProtected) since the userdata check can allocate. The
+// output and the cycle-check list are the caller's, held outside that frame,
+// so a Lua raise through the writer skips nothing that needs destroying.
+
+class JsonWriter {
+ public:
+  JsonWriter(lua_State* L, const JsonEncodeOptions& options, std::string& out,
+             std::vector<const void*>& open)
+      : L_(L), options_(options), out_(out), open_(open) {}
+
+  void Value(const int index, const int depth) {
+    const int idx = lua_absindex(L_, index);
+    switch (lua_type(L_, idx)) {
+      case LUA_TNIL:
+        out_ += "null";
+        return;
+      case LUA_TBOOLEAN:
+        out_ += lua_toboolean(L_, idx) ? "true" : "false";
+        return;
+      case LUA_TNUMBER:
+        if (lua_isinteger(L_, idx)) {
+          Integer(lua_tointeger(L_, idx));
+        } else {
+          Float(lua_tonumber(L_, idx));
+        }
+        return;
+      case LUA_TSTRING: {
+        size_t len;
+        const char* str = lua_tolstring(L_, idx, &len);
+        String(str, len);
+        return;
+      }
+      case LUA_TTABLE:
+        // A lazy shared table's proxy is empty: encode what it stands for.
+        if (LuaRuntime::PushLazyTableContents(L_, idx)) {
+          Table(lua_gettop(L_), depth);
+          lua_pop(L_, 1);
+          return;
+        }
+        Table(idx, depth);
+        return;
+      case LUA_TLIGHTUSERDATA:
+        if (lua_touserdata(L_, idx) == &json_null_anchor) {
+          out_ += "null";
+          return;
+        }
+        break;
+      case LUA_TUSERDATA:
+        if (auto* block = static_cast<NumericArrayBlock*>(
+                luaL_testudata(L_, idx, LuaRuntime::kNumericArrayMetaName))) {
+          if (const char* error = RefreshNumericBlock(L_, block)) {
+            throw std::runtime_error(error);
+          }
+          NumericArray(block->view);
+          return;
+        }
+        if (auto* block = static_cast<SharedDataBlock*>(
+                luaL_testudata(L_, idx, LuaRuntime::kSharedDataMetaName))) {
+          if (const SharedData* data = SharedDataOf(block)) {
+            SharedDataNode(*data, block->node, depth);
+          } else {
+            out_ += "null";
+          }
+          return;
+        }
+        break;
+      default:
+        break;
+    }
+    std::string msg = "cannot encode a ";
+    msg += luaL_typename(L_, idx);
+    msg += " as JSON";
+    throw std::runtime_error(msg);
+  }
+
+ private:
+  void Integer(const lua_Integer n) {
+    char buf[24];
+    const auto res = std::to_chars(buf, buf + sizeof(buf), static_cast<int64_t>(n));
+    out_.append(buf, res.ptr);
+  }
+
+  // Shortest round-trip form, as JSON.stringify writes it; NaN and the
+  // infinities have no JSON form and become null, as there.
+  void Float(const lua_Number d) {
+    if (!std::isfinite(d)) {
+      out_ += "null";
+      return;
+    }
+    char buf[32];
+    const auto res = std::to_chars(buf, buf + sizeof(buf), static_cast<double>(d));
+    out_.append(buf, res.ptr);
+  }
+
+  void String(const char* s, const size_t len) {
+    static constexpr char kHex[] = "0123456789abcdef";
+    out_.reserve(out_.size() + len + 2);
+    out_ += '"';
+    size_t run = 0;  // start of the pending unescaped run
+    for (size_t i = 0; i < len; ++i) {
+      const auto c = static_cast<unsigned char>(s[i]);
+      if (c >= 0x20 && c != '"' && c != '\\') continue;
+      out_.append(s + run, i - run);
+      run = i + 1;
+      switch (c) {
+        case '"': out_ += "\\\""; break;
+        case '\\': out_ += "\\\\"; break;
+        case '\b': out_ += "\\b"; break;
+        case '\f': out_ += "\\f"; break;
+        case '\n': out_ += "\\n"; break;
+        case '\r': out_ += "\\r"; break;
+        case '\t': out_ += "\\t"; break;
+        default:
+          out_ += "\\u00";
+          out_ += kHex[c >> 4];
+          out_ += kHex[c & 0xF];
+          break;
+      }
+    }
+    out_.append(s + run, len - run);
+    out_ += '"';
+  }
+
+  // An object key: strings as-is, numbers in the form lua_tostring gives
+  // them (the form ToLuaValue uses for the same key).
+  void Key(const int idx) {
+    if (lua_type(L_, idx) == LUA_TSTRING) {
+      size_t len;
+      const char* str = lua_tolstring(L_, idx, &len);
+      String(str, len);
+      return;
+    }
+    out_ += '"';
+    if (lua_isinteger(L_, idx)) {
+      Integer(lua_tointeger(L_, idx));
+    } else {
+      // LUAI_NUMFFORMAT plus the ".0" Lua appends to an integral-looking float,
+      // formatted here rather than by lua_tostring, which would convert the
+      // key in place and derail lua_next.
+      char buf[64];
+      const int n = std::snprintf(buf, sizeof(buf), "%.14g", static_cast<double>(lua_tonumber(L_, idx)));
+      out_.append(buf, static_cast<size_t>(n));
+      if (buf[std::strspn(buf, "-0123456789")] == '\0') out_ += ".0";
+    }
+    out_ += '"';
+  }
+
+  void NumericArray(const NumericArrayView& v) {
+    out_ += '[';
+    VisitNumericArray(v, [&](auto* p) {
+      using T = std::remove_pointer_t<decltype(p)>;
+      for (size_t i = 0; i < v.length; ++i) {
+        if (i) out_ += ',';
+        if constexpr (std::is_floating_point_v<T>) {
+          Float(p[i]);
+        } else {
+          Integer(p[i]);
+        }
+      }
+    });
+    out_ += ']';
+  }
+
+  // A shared data view encodes from its nodes; its kind already says array
+  // or object, so the table options don't apply.
+  void SharedDataNode(const SharedData& data, const uint32_t i, const int depth) {
+    if (depth > LuaRuntime::kMaxDepth) {
+      throw std::runtime_error("Value nesting depth exceeds the maximum of "
+        + std::to_string(LuaRuntime::kMaxDepth) + " levels");
+    }
+    const SharedData::Node& n = data.node(i);
+    switch (n.kind) {
+      case SharedData::Kind::Nil: out_ += "null"; return;
+      case SharedData::Kind::Boolean: out_ += n.boolean ? "true" : "false"; return;
+      case SharedData::Kind::Integer: Integer(static_cast<lua_Integer>(n.integer)); return;
+      case SharedData::Kind::Number: Float(static_cast<lua_Number>(n.number)); return;
+      case SharedData::Kind::String: {
+        const std::string_view str = data.string(n);
+        String(str.data(), str.size());
+        return;
+      }
+      case SharedData::Kind::Array:
+        out_ += '[';
+        for (size_t k = 0; k < n.count; ++k) {
+          if (k) out_ += ',';
+          SharedDataNode(data, data.Element(n, k), depth + 1);
+        }
+        out_ += ']';
+        return;
+      case SharedData::Kind::Object:
+        out_ += '{';
+        for (size_t k = 0; k < n.count; ++k) {
+          if (k) out_ += ',';
+          const std::string_view key = data.EntryKey(n, k);
+          String(key.data(), key.size());
+          out_ += ':';
+          SharedDataNode(data, data.EntryValue(n, k), depth + 1);
+        }
+        out_ += '}';
+        return;
+    }
+  }
+
+  void Table(const int idx, const int depth) {
+    if (depth > LuaRuntime::kMaxDepth) {
+      throw std::runtime_error("Value nesting depth exceeds the maximum of "
+        + std::to_string(LuaRuntime::kMaxDepth) + " levels");
+    }
+    const void* self = lua_topointer(L_, idx);
+    if (std::find(open_.begin(), open_.end(), self) != open_.end()) {
+      throw std::runtime_error("cannot encode a cyclic table as JSON");
+    }
+    if (!lua_checkstack(L_, 4)) throw std::runtime_error("stack overflow encoding JSON");
+    open_.push_back(self);
+
+    // Shape pass: the isSequentialArray test, plus what sparse_arrays needs.
+    const auto len = static_cast<lua_Integer>(lua_rawlen(L_, idx));
+    lua_Integer count = 0;
+    lua_Integer max_key = 0;
+    bool sequence = true;
+    bool positive_int_keys = true;
+    lua_pushnil(L_);
+    while (lua_next(L_, idx) != 0) {
+      lua_pop(L_, 1);
+      ++count;
+      if (!lua_isinteger(L_, -1)) {
+        sequence = positive_int_keys = false;
+        continue;
+      }
+      const lua_Integer k = lua_tointeger(L_, -1);
+      if (k < 1 || k > len) sequence = false;
+      if (k < 1) positive_int_keys = false;
+      else max_key = std::max(max_key, k);
+    }
+    sequence = sequence && count == len;
+
+    if (count == 0) {
+      out_ += options_.empty_table_as_object ? "{}" : "[]";
+    } else if (sequence ||
+               (options_.sparse_arrays && positive_int_keys &&
+                static_cast<lua_Unsigned>(max_key) <= 2 * static_cast<lua_Unsigned>(count))) {
+      const lua_Integer n = sequence ? len : max_key;
+      out_ += '[';
+      for (lua_Integer i = 1; i <= n; ++i) {
+        if (i > 1) out_ += ',';
+        lua_rawgeti(L_, idx, i);
+        Value(-1, depth + 1);
+        lua_pop(L_, 1);
+      }
+      out_ += ']';
+    } else {
+      out_ += '{';
+      bool first = true;
+      lua_pushnil(L_);
+      while (lua_next(L_, idx) != 0) {
+        const int key_type = lua_type(L_, -2);
+        // Keys other than strings and numbers are skipped, as ToLuaValue does.
+        if (key_type == LUA_TSTRING || key_type == LUA_TNUMBER) {
+          if (!first) out_ += ',';
+          first = false;
+          Key(lua_absindex(L_, -2));
+          out_ += ':';
+          Value(-1, depth + 1);
+        }
+        lua_pop(L_, 1);
+      }
+      out_ += '}';
+    }
+    open_.pop_back();
+  }
+
+  lua_State* L_;
+  const JsonEncodeOptions& options_;
+  std::string& out_;
+  std::vector<const void*>& open_;  // tables being encoded, for the cycle check
+};
+
+// --- json library ---
+//
+// The opt-in `json` library (libraries: [..., 'json']): the decoder and
+// encoder above, callable from Lua, so scripts stop crossing into JS for
+// JSON.parse / JSON.stringify.
+
+// Reads json.encode's option table (argument `arg`, optional) — the Lua
+// spelling of JsonEncodeOptions.
+JsonEncodeOptions CheckJsonEncodeOptions(lua_State* L, const int arg) {
+  JsonEncodeOptions options;
+  if (lua_isnoneornil(L, arg)) return options;
+  luaL_checktype(L, arg, LUA_TTABLE);
+  lua_getfield(L, arg, "empty_table");
+  if (!lua_isnil(L, -1)) {
+    static const char* const kModes[] = {"array", "object", nullptr};
+    options.empty_table_as_object = luaL_checkoption(L, -1, nullptr, kModes) == 1;
+  }
+  lua_getfield(L, arg, "sparse_arrays");
+  options.sparse_arrays = lua_toboolean(L, -1);
+  lua_pop(L, 2);
+  return options;
+}
+
+// json.encode's working state. Owned by JsonEncode's frame, outside the
+// protected one, so a raise during the encode skips no destructor; the writer's
+// error is copied into a fixed buffer rather than a string for the same reason.
+struct JsonEncodeCall {
+  const JsonEncodeOptions* options;
+  std::string text;
+  std::vector<const void*> open;
+  char error[256];
+};
+
+// The whole of json.encode, run under lua_pcall by JsonEncode (the json library
+// runs on whichever thread called it, so it can't borrow the runtime's
+// RunProtected frame, which is bound to the main state):
+// [value, lightuserdata JsonEncodeCall*] -> [string]. Userdata checks, numeric
+// view refreshes, and the final push can all raise; the writer's own failures
+// are raised too, once its exception has been caught and left behind.
+int ProtectedJsonEncode(lua_State* L) {
+  auto* call = static_cast<JsonEncodeCall*>(lua_touserdata(L, 2));
+  bool failed = false;
+  try {
+    JsonWriter(L, *call->options, call->text, call->open).Value(1, 0);
+  } catch (const std::exception& e) {
+    std::snprintf(call->error, sizeof(call->error), "json.encode: %s", e.what());
+    failed = true;
+  }
+  if (failed) return luaL_error(L, "%s", call->error);
+  lua_pushlstring(L, call->text.data(), call->text.size());
+  return 1;
+}
+
+// json.encode(value [, options]) -> string
+int JsonEncode(lua_State* L) {
+  luaL_checkany(L, 1);
+  const JsonEncodeOptions options = CheckJsonEncodeOptions(L, 2);
+  lua_settop(L, 1);
+  int status;
+  {
+    // Three setup slots fit the LUA_MINSTACK this frame is guaranteed, and
+    // none of the pushes allocates. The error is raised only once `call` is
+    // destroyed.
+    JsonEncodeCall call{&options, {}, {}, {}};
+    lua_pushcfunction(L, ProtectedJsonEncode);
+    lua_pushvalue(L, 1);
+    lua_pushlightuserdata(L, &call);
+    status = lua_pcall(L, 2, 1, 0);  // -> [string] or [error]
+  }
+  if (status != LUA_OK) return lua_error(L);
+  return 1;
+}
+
+// json.decode(text [, options]) -> value. options.null is the value JSON null
+// decodes to (e.g. json.null); the default is nil.
+int JsonDecode(lua_State* L) {
+  size_t len;
+  const char* text = luaL_checklstring(L, 1, &len);
+  int null_index = 0;
+  if (!lua_isnoneornil(L, 2)) {
+    luaL_checktype(L, 2, LUA_TTABLE);
+    lua_settop(L, 2);            // an extra argument must not pose as the null
+    lua_getfield(L, 2, "null");  // index 3
+    if (!lua_isnil(L, 3)) null_index = 3;
+  }
+  PushJsonDocument(L, text, len, null_index);
+  return 1;
+}
+
+int OpenJsonLibrary(lua_State* L) {
+  static const luaL_Reg kFuncs[] = {
+    {"encode", JsonEncode},
+    {"decode", JsonDecode},
+    {"null", nullptr},
+    {nullptr, nullptr},
+  };
+  luaL_newlib(L, kFuncs);
+  lua_pushlightuserdata(L, &json_null_anchor);
+  lua_setfield(L, -2, "null");
+  return 1;
+}
+
+// Libraries beyond Lua's own, named in the libraries option like the standard
+// ones but never part of a preset. Opened after InitState(): they build on the
+// metatables it registers.
+constexpr std::pair<const char*, lua_CFunction> kExtraLibraries[] = {
+  {"vector", OpenVectorLibrary},
+  {"json", OpenJsonLibrary},
+};
+
+bool IsExtraLibrary(const std::string& name) {
+  for (const auto& [lib, open] : kExtraLibraries) {
+    if (name == lib) return true;
+  }
+  return false;
+}
+
 // Protected __tostring trampoline: [value] -> [string]. Run under lua_pcall so a
 // raising __tostring metamethod (on an error object surfaced from an unprotected
 // coroutine path) becomes a caught failure rather than a panic/abort.
@@ -137,6 +1594,8 @@ int LuaRuntime::LibraryMask(const std::vector<std::string>& libraries) {
 
   int mask = 0;
   for (const auto& lib : libraries) {
+    // Not a standard library: opened by the constructor after InitState().
+    if (IsExtraLibrary(lib)) continue;
     const auto it = kLibFlags.find(lib);
     if (it == kLibFlags.end()) {
       std::string msg = "Unknown Lua library: '";
@@ -149,8 +1608,58 @@ int LuaRuntime::LibraryMask(const std::vector<std::string>& libraries) {
   return mask;
 }
 
+// Environment accounting prefixes every block with the id of the account it is
+// charged to. Eight bytes keeps the payload at the alignment Lua asks of an
+// allocator (LUAI_MAXALIGN: double, pointer, lua_Integer).
+struct alignas(8) AllocHeader {
+  uint32_t account;
+};
+static_assert(sizeof(AllocHeader) == 8);
+
+// LuaAllocator for a tagged state. A block is charged to the account active
+// when it was allocated or last resized — outside any accounted run a resize
+// leaves it with its owner — and is credited back to that owner when freed.
+static void* TaggedAllocate(MemoryAllocator* alloc, void* ptr, size_t osize, size_t nsize) {
+  auto* block = ptr ? reinterpret_cast<AllocHeader*>(static_cast<char*>(ptr) - sizeof(AllocHeader))
+                    : nullptr;
+  const uint32_t owner = block ? block->account : 0;
+
+  if (nsize == 0) {
+    if (block) {
+      alloc->current -= osize;
+      alloc->Uncharge(owner, osize);
+      free(block);
+    }
+    return nullptr;
+  }
+
+  const size_t old_size = block ? osize : 0;  // see LuaAllocator
+  if (alloc->limit > 0 && alloc->current - old_size + nsize > alloc->limit) {
+    return nullptr;
+  }
+
+  uint32_t charge = (alloc->active != 0 || !block) ? alloc->active : owner;
+  if (charge != 0 && !alloc->accounts[charge].live) charge = 0;
+  if (charge != 0 && (charge != owner || nsize > old_size)) {
+    const EnvironmentAccount& acct = alloc->accounts[charge];
+    const size_t held = acct.memory - (charge == owner ? old_size : 0);
+    if (acct.max_memory > 0 && held + nsize > acct.max_memory) {
+      return nullptr;  // the tenant's OOM, raised in its own run
+    }
+  }
+
+  auto* moved = static_cast<AllocHeader*>(realloc(block, sizeof(AllocHeader) + nsize));
+  if (!moved) return nullptr;
+  alloc->current = alloc->current - old_size + nsize;
+  if (block) alloc->Uncharge(owner, old_size);
+  alloc->Charge(charge, nsize);
+  moved->account = charge;
+  return moved + 1;
+}
+
 void* LuaRuntime::LuaAllocator(void* ud, void* ptr, size_t osize, size_t nsize) {
   auto* alloc = static_cast<MemoryAllocator*>(ud);
+  if (alloc->tagged) return TaggedAllocate(alloc, ptr, osize, nsize);
 
   if (nsize == 0) {
     // Free: when ptr is non-null, osize is the old block size
@@ -189,10 +1698,31 @@ void LuaRuntime::InitState() {
   // execution, after construction), so the deleter always reads a valid pointer.
   *static_cast<LuaRuntime**>(lua_getextraspace(L_)) = this;
 
+  lua_newtable(L_);
+  lua_setfield(L_, LUA_REGISTRYINDEX, kUserdataMethodsKey);
+
   // Register userdata metatables
   RegisterUserdataMetatable();
   RegisterProxyUserdataMetatable();
+  RegisterNumericArrayMetatable();
+  RegisterSharedDataMetatable();
+  RegisterLazyTableMetatable();
   RegisterHostFnSentinelMetatable();
+  RegisterHostFnSlotMetatable();
+  RegisterFastFnSlotMetatable();
+
+  // Environment accounts (SetEnvironmentLimits): weak keys, so an account
+  // never keeps its environment alive.
+  luaL_newmetatable(L_, kEnvAccountMeta);
+  lua_pushcfunction(L_, EnvironmentAccountGC);
+  lua_setfield(L_, -2, "__gc");
+  lua_pop(L_, 1);
+  lua_newtable(L_);
+  lua_newtable(L_);
+  lua_pushstring(L_, "k");
+  lua_setfield(L_, -2, "__mode");
+  lua_setmetatable(L_, -2);
+  env_accounts_ref_ = luaL_ref(L_, LUA_REGISTRYINDEX);
 
   // Install the instruction/cancel count-hook if a limit was configured. Must
   // run after the runtime pointer is in the registry (the hook reads it back).
@@ -233,6 +1763,20 @@ void LuaRuntime::ExecutionHook(lua_State* L, lua_Debug* ar) {
       }
     }
 
+    // The innermost environment run's account (SetEnvironmentLimits). The
+    // reference is trivially destructible, so the raise skips nothing.
+    if (const uint32_t id = runtime->allocator_.active; id != 0) {
+      EnvironmentAccount& acct = runtime->allocator_.accounts[id];
+      const auto step = static_cast<size_t>(runtime->instruction_hook_interval_);
+      acct.instructions += step;
+      runtime->env_run_instructions_ += step;
+      if (acct.max_instructions > 0 &&
+          runtime->env_run_instructions_ >= acct.max_instructions) {
+        luaL_error(L, "environment instruction limit exceeded");
+        return;  // unreachable
+      }
+    }
+
     // Wall-clock deadline for this execution. steady_clock is monotonic, so a
     // system clock adjustment can't shorten or extend a running script.
     if (runtime->timeout_ms_ > 0 &&
@@ -314,6 +1858,19 @@ void LuaRuntime::InstallExecutionHook() {
     mask |= LUA_MASKCOUNT;
     interval = 1000;
   }
+  if (allocator_.accounts.size() > 1) {
+    // Environment accounts count every run's instructions, so any account
+    // keeps the count event on; a per-run limit below 1000 tightens it.
+    int env_interval = 1000;
+    for (const auto& acct : allocator_.accounts) {
+      if (acct.live && acct.max_instructions > 0 &&
+          acct.max_instructions < static_cast<size_t>(env_interval)) {
+        env_interval = static_cast<int>(acct.max_instructions);
+      }
+    }
+    mask |= LUA_MASKCOUNT;
+    interval = interval > 0 ? std::min(interval, env_interval) : env_interval;
+  }
   if ((mask & LUA_MASKCOUNT) && debug_count_interval_ > 0) {
     interval = interval > 0 ? std::min(interval, debug_count_interval_)
                             : debug_count_interval_;
@@ -500,6 +2057,11 @@ LuaRuntime::LuaRuntime(const RuntimeConfig& config) : config_(config) {
   allocator_.limit = config.max_memory;
   max_instructions_ = config.max_instructions;  // installed by InitState()
   timeout_ms_ = config.timeout_ms;              // ditto
+  coroutine_pool_size_ = config.coroutine_pool_size;
+  // Before lua_newstate: the state's first block is already tagged or not.
+  allocator_.tagged = config.environment_accounting;
+  allocator_.accounts.resize(1);  // the unattributed bucket
+  allocator_.accounts[0].live = true;
   L_ = lua_newstate(LuaAllocator, &allocator_, 0);
   if (!L_) {
     throw std::runtime_error("Failed to create Lua state");
@@ -508,6 +2070,26 @@ LuaRuntime::LuaRuntime(const RuntimeConfig& config) : config_(config) {
     luaL_openselectedlibs(L_, LibraryMask(config.libraries), 0);
   }
   InitState();
+  // Opening a library allocates its table and package.loaded entry, which can
+  // raise under maxMemory; do it in a protected frame so that surfaces as a
+  // std::runtime_error rather than a panic. The destructor won't run for a
+  // constructor that throws, so close the state here on the way out.
+  try {
+    RunProtected([&]() {
+      for (const auto& [lib, open] : kExtraLibraries) {
+        if (std::find(config.libraries.begin(), config.libraries.end(), lib) !=
+            config.libraries.end()) {
+          luaL_requiref(L_, lib, open, 1);
+          lua_pop(L_, 1);
+        }
+      }
+    });
+  } catch (...) {
+    lua_sethook(L_, nullptr, 0, 0);
+    lua_close(L_);
+    L_ = nullptr;
+    throw;
+  }
 }
 
 LuaRuntime::~LuaRuntime() {
@@ -534,11 +2116,228 @@ LuaRuntime::~LuaRuntime() {
   for (auto& [data, destructor] : stored_function_data_) {
     if (destructor) destructor(data);
   }
-  stored_function_data_.clear();
+  stored_function_data_.clear();
+
+  // Parked coroutine threads are anchored by registry slots that lua_close
+  // frees wholesale; just forget them.
+  thread_pool_.clear();
+  pooled_threads_.clear();
+
+  if (L_) {
+    lua_close(L_);
+    L_ = nullptr;
+  }
+}
+
+// --- Shared data ---
+
+std::optional<size_t> SharedData::FindEntry(const Node& object, const std::string_view key) const {
+  size_t lo = 0;
+  size_t hi = object.count;
+  while (lo < hi) {
+    const size_t mid = lo + (hi - lo) / 2;
+    const int cmp = EntryKey(object, mid).compare(key);
+    if (cmp == 0) return mid;
+    if (cmp < 0) lo = mid + 1;
+    else hi = mid;
+  }
+  return std::nullopt;
+}
+
+std::shared_ptr<const SharedData> SharedData::FromValue(const LuaValue& value) {
+  SharedDataBuilder builder;
+  const std::function<uint32_t(const LuaPtr&, int)> build =
+      [&](const LuaPtr& v, const int depth) -> uint32_t {
+    if (depth > LuaRuntime::kMaxDepth) {
+      throw std::runtime_error("Value nesting depth exceeds the maximum of "
+        + std::to_string(LuaRuntime::kMaxDepth) + " levels");
+    }
+    if (!v) return builder.AddNil();
+    return std::visit([&](const auto& x) -> uint32_t {
+      using T = std::decay_t<decltype(x)>;
+      if constexpr (std::is_same_v<T, std::monostate>) {
+        return builder.AddNil();
+      } else if constexpr (std::is_same_v<T, bool>) {
+        return builder.AddBoolean(x);
+      } else if constexpr (std::is_same_v<T, int64_t>) {
+        return builder.AddInteger(x);
+      } else if constexpr (std::is_same_v<T, double>) {
+        return builder.AddNumber(x);
+      } else if constexpr (std::is_same_v<T, std::string>) {
+        return builder.AddString(x);
+      } else if constexpr (std::is_same_v<T, LuaArray>) {
+        const uint32_t array = builder.AddArray(x.size());
+        for (size_t k = 0; k < x.size(); ++k) {
+          builder.SetElement(array, k, build(x[k], depth + 1));
+        }
+        return array;
+      } else if constexpr (std::is_same_v<T, LuaTable>) {
+        const uint32_t object = builder.AddObject(x.size());
+        size_t k = 0;
+        for (const auto& [key, field] : x) {
+          builder.SetEntry(object, k++, key, build(field, depth + 1));
+        }
+        return object;
+      } else {
+        throw std::runtime_error(
+          "shared data can only hold plain data (nil, booleans, numbers, "
+          "strings, arrays and tables)");
+      }
+    }, v->value);
+  };
+  return builder.Finish(build(std::make_shared<LuaValue>(value), 0));
+}
+
+SharedDataBuilder::SharedDataBuilder() : data_(std::make_shared<SharedData>()) {
+  data_->nodes_.emplace_back();  // node 0: nil
+}
+
+uint32_t SharedDataBuilder::Add(const SharedData::Node& n) {
+  if (data_->nodes_.size() >= std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error("shared data is too large");
+  }
+  data_->nodes_.push_back(n);
+  return static_cast<uint32_t>(data_->nodes_.size() - 1);
+}
+
+uint64_t SharedDataBuilder::Reserve(const size_t slots) {
+  const size_t offset = data_->slots_.size();
+  if (slots > std::numeric_limits<uint32_t>::max() - offset) {
+    throw std::runtime_error("shared data is too large");
+  }
+  data_->slots_.resize(offset + slots, 0);
+  return offset;
+}
+
+uint32_t SharedDataBuilder::AddBoolean(const bool b) {
+  SharedData::Node n;
+  n.kind = SharedData::Kind::Boolean;
+  n.boolean = b;
+  return Add(n);
+}
+
+uint32_t SharedDataBuilder::AddInteger(const int64_t i) {
+  SharedData::Node n;
+  n.kind = SharedData::Kind::Integer;
+  n.integer = i;
+  return Add(n);
+}
+
+uint32_t SharedDataBuilder::AddNumber(const double d) {
+  SharedData::Node n;
+  n.kind = SharedData::Kind::Number;
+  n.number = d;
+  return Add(n);
+}
+
+uint32_t SharedDataBuilder::AddString(const std::string_view s) {
+  if (s.size() > std::numeric_limits<uint32_t>::max()) {
+    throw std::runtime_error("shared data string is too long");
+  }
+  SharedData::Node n;
+  n.kind = SharedData::Kind::String;
+  n.count = static_cast<uint32_t>(s.size());
+  n.offset = data_->strings_.size();
+  data_->strings_.append(s);
+  return Add(n);
+}
+
+uint32_t SharedDataBuilder::AddArray(const size_t count) {
+  SharedData::Node n;
+  n.kind = SharedData::Kind::Array;
+  n.offset = Reserve(count);
+  n.count = static_cast<uint32_t>(count);  // Reserve bounds it
+  return Add(n);
+}
+
+uint32_t SharedDataBuilder::AddObject(const size_t count) {
+  if (count > std::numeric_limits<uint32_t>::max() / 2) {
+    throw std::runtime_error("shared data is too large");
+  }
+  SharedData::Node n;
+  n.kind = SharedData::Kind::Object;
+  n.offset = Reserve(2 * count);
+  n.count = static_cast<uint32_t>(count);
+  const uint32_t object = Add(n);
+  objects_.push_back(object);
+  return object;
+}
+
+void SharedDataBuilder::SetElement(const uint32_t array, const size_t k, const uint32_t value) {
+  const SharedData::Node& n = data_->nodes_.at(array);
+  if (n.kind != SharedData::Kind::Array || k >= n.count) {
+    throw std::out_of_range("SharedDataBuilder::SetElement: no such element");
+  }
+  data_->slots_[n.offset + k] = value;
+}
+
+void SharedDataBuilder::SetEntry(const uint32_t object, const size_t k,
+                                 const std::string_view key, const uint32_t value) {
+  const uint32_t key_node = AddString(key);
+  const SharedData::Node& n = data_->nodes_.at(object);  // after AddString grew nodes_
+  if (n.kind != SharedData::Kind::Object || k >= n.count) {
+    throw std::out_of_range("SharedDataBuilder::SetEntry: no such entry");
+  }
+  data_->slots_[n.offset + 2 * k] = key_node;
+  data_->slots_[n.offset + 2 * k + 1] = value;
+}
+
+std::shared_ptr<const SharedData> SharedDataBuilder::Finish(const uint32_t root) {
+  SharedData& data = *data_;
+  std::vector<std::pair<uint32_t, uint32_t>> entries;
+  for (const uint32_t object : objects_) {
+    const SharedData::Node& n = data.nodes_[object];
+    entries.clear();
+    entries.reserve(n.count);
+    for (size_t k = 0; k < n.count; ++k) {
+      const uint32_t key = data.slots_[n.offset + 2 * k];
+      if (data.nodes_[key].kind != SharedData::Kind::String) {
+        throw std::runtime_error("shared data object has an unset entry");
+      }
+      entries.emplace_back(key, data.slots_[n.offset + 2 * k + 1]);
+    }
+    const auto key_of = [&](const std::pair<uint32_t, uint32_t>& e) {
+      return data.string(data.nodes_[e.first]);
+    };
+    std::sort(entries.begin(), entries.end(), [&](const auto& a, const auto& b) {
+      return key_of(a) < key_of(b);
+    });
+    for (size_t k = 0; k < entries.size(); ++k) {
+      if (k > 0 && key_of(entries[k - 1]) == key_of(entries[k])) {
+        throw std::runtime_error("shared data object has a duplicate key '" +
+                                 std::string(key_of(entries[k])) + "'");
+      }
+      data.slots_[n.offset + 2 * k] = entries[k].first;
+      data.slots_[n.offset + 2 * k + 1] = entries[k].second;
+    }
+  }
+  data.nodes_.shrink_to_fit();
+  data.slots_.shrink_to_fit();
+  data.strings_.shrink_to_fit();
+  data.root_ = root;
 
-  if (L_) {
-    lua_close(L_);
-    L_ = nullptr;
+  std::shared_ptr<const SharedData> result = std::move(data_);
+  data_ = std::make_shared<SharedData>();
+  data_->nodes_.emplace_back();
+  objects_.clear();
+  return result;
+}
+
+std::shared_ptr<const SharedData> SharedDataSlot::Load(uint64_t* version) const {
+  std::lock_guard lock(mutex_);
+  if (version) *version = version_.load(std::memory_order_relaxed);
+  return data_;
+}
+
+void SharedDataSlot::Store(std::shared_ptr<const SharedData> data) {
+  // The replaced version is released outside the lock: if this was its last
+  // owner, freeing a large tree must not stall readers loading the new one.
+  std::shared_ptr<const SharedData> previous;
+  {
+    std::lock_guard lock(mutex_);
+    previous = std::move(data_);
+    data_ = std::move(data);
+    version_.fetch_add(1, std::memory_order_release);
   }
 }
 
@@ -562,6 +2361,43 @@ void LuaRuntime::RegisterProxyUserdataMetatable() {
   lua_pop(L_, 1);
 }
 
+void LuaRuntime::RegisterNumericArrayMetatable() {
+  luaL_newmetatable(L_, kNumericArrayMetaName);
+  lua_pushcfunction(L_, NumericArrayGC);
+  lua_setfield(L_, -2, "__gc");
+  lua_pushcfunction(L_, NumericArrayIndex);
+  lua_setfield(L_, -2, "__index");
+  lua_pushcfunction(L_, NumericArrayNewIndex);
+  lua_setfield(L_, -2, "__newindex");
+  lua_pushcfunction(L_, NumericArrayLen);
+  lua_setfield(L_, -2, "__len");
+  lua_pop(L_, 1);
+}
+
+void LuaRuntime::RegisterLazyTableMetatable() {
+  luaL_newmetatable(L_, kLazyTableMetaName);
+  lua_pushcfunction(L_, LazyTableGC);
+  lua_setfield(L_, -2, "__gc");
+  lua_pop(L_, 1);
+}
+
+void LuaRuntime::RegisterSharedDataMetatable() {
+  luaL_newmetatable(L_, kSharedDataMetaName);
+  lua_pushcfunction(L_, SharedDataGC);
+  lua_setfield(L_, -2, "__gc");
+  lua_pushcfunction(L_, SharedDataIndex);
+  lua_setfield(L_, -2, "__index");
+  lua_pushcfunction(L_, SharedDataNewIndex);
+  lua_setfield(L_, -2, "__newindex");
+  lua_pushcfunction(L_, SharedDataLen);
+  lua_setfield(L_, -2, "__len");
+  lua_pushcfunction(L_, SharedDataPairs);
+  lua_setfield(L_, -2, "__pairs");
+  lua_pushcfunction(L_, SharedDataEq);
+  lua_setfield(L_, -2, "__eq");
+  lua_pop(L_, 1);
+}
+
 // --- Userdata metamethods ---
 
 int LuaRuntime::UserdataGC(lua_State* L) {
@@ -578,6 +2414,360 @@ int LuaRuntime::UserdataGC(lua_State* L) {
   return 0;
 }
 
+// Numeric array views: 1-based like a Lua sequence, fixed length. The
+// metamethods read and write the TypedArray's memory directly, after the
+// binding has confirmed it is still attached (CheckNumericArray); __gc goes
+// through the shared userdata ref count.
+int LuaRuntime::NumericArrayGC(lua_State* L) {
+  auto* block = static_cast<NumericArrayBlock*>(lua_touserdata(L, 1));
+  // ref_id 0: a vector library array, whose storage dies with the block.
+  if (!block || block->ref_id == 0) return 0;
+  if (auto* runtime = *static_cast<LuaRuntime**>(lua_getextraspace(L))) {
+    runtime->DecrementUserdataRefCount(block->ref_id);
+  }
+  return 0;
+}
+
+int LuaRuntime::NumericArrayIndex(lua_State* L) {
+  const NumericArrayBlock* block = CheckNumericArray(L, 1);
+  int isnum = 0;
+  const lua_Integer i = lua_tointegerx(L, 2, &isnum);
+  // Out-of-range and non-integer keys read as nil, so ipairs() stops at the end.
+  if (!isnum || i < 1 || static_cast<lua_Unsigned>(i) > block->view.length) {
+    lua_pushnil(L);
+    return 1;
+  }
+  PushNumericElement(L, block->view, static_cast<size_t>(i - 1));
+  return 1;
+}
+
+int LuaRuntime::NumericArrayNewIndex(lua_State* L) {
+  const NumericArrayBlock* block = CheckNumericArray(L, 1);
+  int isnum = 0;
+  const lua_Integer i = lua_tointegerx(L, 2, &isnum);
+  if (!isnum || i < 1 || static_cast<lua_Unsigned>(i) > block->view.length) {
+    // The length is fixed by the JS side: there is nowhere to put a new key.
+    return luaL_error(L, "%s index out of range (1..%I)",
+                      NumericArrayTypeName(block->view.type),
+                      static_cast<lua_Integer>(block->view.length));
+  }
+  StoreNumericElement(L, block->view, static_cast<size_t>(i - 1), 3);
+  return 0;
+}
+
+int LuaRuntime::NumericArrayLen(lua_State* L) {
+  const NumericArrayBlock* block = CheckNumericArray(L, 1);
+  lua_pushinteger(L, static_cast<lua_Integer>(block->view.length));
+  return 1;
+}
+
+// Shared data views: read-only, 1-based arrays and string-keyed objects
+// served straight from the SharedData nodes.
+int LuaRuntime::SharedDataGC(lua_State* L) {
+  // reset() rather than the destructor, as in HostFnSlotGC: a repeated __gc
+  // finds empty owners instead of releasing twice.
+  auto* block = static_cast<SharedDataBlock*>(lua_touserdata(L, 1));
+  if (block) {
+    block->data.reset();
+    block->slot.reset();
+  }
+  return 0;
+}
+
+int LuaRuntime::SharedDataIndex(lua_State* L) {
+  auto* block = static_cast<SharedDataBlock*>(luaL_checkudata(L, 1, kSharedDataMetaName));
+  const SharedData* data = SharedDataOf(block);
+  const auto found = data ? SharedDataLookup(L, *data, data->node(block->node), 2)
+                          : std::nullopt;
+  if (!found) {
+    lua_pushnil(L);
+    return 1;
+  }
+  PushSharedDataValue(L, block->data, *found);
+  return 1;
+}
+
+int LuaRuntime::SharedDataNewIndex(lua_State* L) {
+  luaL_checkudata(L, 1, kSharedDataMetaName);
+  return luaL_error(L, "shared data is read-only");
+}
+
+// An array's element count; 0 for an object, as # gives for a table with no
+// sequence part.
+int LuaRuntime::SharedDataLen(lua_State* L) {
+  auto* block = static_cast<SharedDataBlock*>(luaL_checkudata(L, 1, kSharedDataMetaName));
+  const SharedData* data = SharedDataOf(block);
+  const SharedData::Node* n = data ? &data->node(block->node) : nullptr;
+  lua_pushinteger(L, n && n->kind == SharedData::Kind::Array
+                       ? static_cast<lua_Integer>(n->count) : 0);
+  return 1;
+}
+
+// pairs(view) -> SharedDataNext, state, nil. A root view iterates a nested view
+// of its current version, so an update mid-loop can't shift the keys under it.
+int LuaRuntime::SharedDataPairs(lua_State* L) {
+  auto* block = static_cast<SharedDataBlock*>(luaL_checkudata(L, 1, kSharedDataMetaName));
+  lua_pushcfunction(L, SharedDataNext);
+  if (block->slot && SharedDataOf(block)) {
+    SharedDataBlock* pinned = NewSharedDataBlock(L);
+    pinned->data = block->data;
+    pinned->node = block->node;
+  } else {
+    lua_pushvalue(L, 1);
+  }
+  lua_pushnil(L);
+  return 3;
+}
+
+// next() over a view: arrays in index order, objects in key order. Finding the
+// position of the previous key is a binary search for objects.
+int LuaRuntime::SharedDataNext(lua_State* L) {
+  auto* block = static_cast<SharedDataBlock*>(luaL_checkudata(L, 1, kSharedDataMetaName));
+  const SharedData* data = SharedDataOf(block);
+  if (!data) {
+    lua_pushnil(L);
+    return 1;
+  }
+  const SharedData::Node& n = data->node(block->node);
+  size_t k = 0;  // 0-based position of the entry to return
+  if (!lua_isnil(L, 2)) {
+    std::optional<size_t> prev;
+    if (n.kind == SharedData::Kind::Array) {
+      int isint = 0;
+      const lua_Integer i = lua_tointegerx(L, 2, &isint);
+      if (isint && i >= 1 && static_cast<lua_Unsigned>(i) <= n.count) {
+        prev = static_cast<size_t>(i - 1);
+      }
+    } else if (n.kind == SharedData::Kind::Object && lua_type(L, 2) == LUA_TSTRING) {
+      size_t len;
+      const char* s = lua_tolstring(L, 2, &len);
+      prev = data->FindEntry(n, {s, len});
+    }
+    if (!prev) return luaL_error(L, "invalid key to 'next'");
+    k = *prev + 1;
+  }
+  if (n.kind == SharedData::Kind::Array && k < n.count) {
+    lua_pushinteger(L, static_cast<lua_Integer>(k + 1));
+    PushSharedDataValue(L, block->data, data->Element(n, k));
+    return 2;
+  }
+  if (n.kind == SharedData::Kind::Object && k < n.count) {
+    const std::string_view key = data->EntryKey(n, k);
+    lua_pushlstring(L, key.data(), key.size());
+    PushSharedDataValue(L, block->data, data->EntryValue(n, k));
+    return 2;
+  }
+  lua_pushnil(L);
+  return 1;
+}
+
+// Two views are equal when they read the same node of the same version — so
+// `t.items == t.items` holds even though each read makes a new view.
+int LuaRuntime::SharedDataEq(lua_State* L) {
+  auto* a = static_cast<SharedDataBlock*>(luaL_testudata(L, 1, kSharedDataMetaName));
+  auto* b = static_cast<SharedDataBlock*>(luaL_testudata(L, 2, kSharedDataMetaName));
+  const SharedData* da = a ? SharedDataOf(a) : nullptr;
+  const SharedData* db = b ? SharedDataOf(b) : nullptr;
+  lua_pushboolean(L, da && da == db && a->node == b->node);
+  return 1;
+}
+
+// Lazy tables: the global is an always-empty proxy, so every read reaches
+// __index, which checks the source version before trusting the cache.
+int LuaRuntime::LazyTableGC(lua_State* L) {
+  auto* block = static_cast<LazyTableBlock*>(lua_touserdata(L, 1));
+  if (block) block->source.reset();
+  return 0;
+}
+
+bool LuaRuntime::PullLazyValue(lua_State* L, const std::function<LuaPtr()>& pull) {
+  bool ok = true;
+  {
+    LuaPtr value;
+    try {
+      const NumericViewsCallout callout{*static_cast<LuaRuntime**>(lua_getextraspace(L))};
+      value = pull();
+    } catch (const std::exception& e) {
+      lua_pushfstring(L, "shared table read failed: %s", e.what());
+      ok = false;
+    }
+    if (ok) {
+      try {
+        // ERRMEM mid-push leaves the message on top, like a caught throw.
+        if (PushLuaValueProtected(L, value) != LUA_OK) ok = false;
+      } catch (const std::exception& e) {
+        lua_pushfstring(L, "shared table read failed: %s", e.what());
+        ok = false;
+      }
+    }
+  }
+  return ok;
+}
+
+bool LuaRuntime::MaterializeLazyTable(lua_State* L, const int block_index) {
+  auto* block = static_cast<LazyTableBlock*>(lua_touserdata(L, block_index));
+  if (!PullLazyValue(L, block->source->fetch_all)) return false;
+  if (!lua_istable(L, -1)) {
+    lua_pop(L, 1);
+    lua_newtable(L);
+  }
+  const int full = lua_gettop(L);
+  // Entries cached earlier in this version win: a pulled nested table keeps
+  // its identity, and a Lua-side assignment (or removal) survives.
+  lua_getiuservalue(L, block_index, 1);
+  lua_pushnil(L);
+  while (lua_next(L, -2) != 0) {
+    lua_pushvalue(L, -2);
+    if (lua_touserdata(L, -2) == &lazy_absent_anchor) lua_pushnil(L);
+    else lua_pushvalue(L, -2);
+    lua_rawset(L, full);
+    lua_pop(L, 1);
+  }
+  lua_pop(L, 1);
+  lua_pushvalue(L, full);
+  lua_setiuservalue(L, block_index, 1);
+  block->complete = true;
+  return true;
+}
+
+int LuaRuntime::LazyTableIndex(lua_State* L) {
+  const int upv = lua_upvalueindex(1);
+  auto* block = static_cast<LazyTableBlock*>(lua_touserdata(L, upv));
+  if (!block || !block->source) return 0;
+  RefreshLazyTable(L, upv, block);
+  lua_getiuservalue(L, upv, 1);  // [proxy, key, cache]
+  lua_pushvalue(L, 2);
+  if (lua_rawget(L, 3) != LUA_TNIL) {
+    if (lua_touserdata(L, -1) == &lazy_absent_anchor) lua_pushnil(L);
+    return 1;
+  }
+  lua_pop(L, 1);
+  if (block->complete) {
+    lua_pushnil(L);
+    return 1;
+  }
+
+  // Host keys are strings; an integer key is looked up by its decimal form.
+  char buf[24];
+  const char* key = nullptr;
+  size_t len = 0;
+  if (lua_type(L, 2) == LUA_TSTRING) {
+    key = lua_tolstring(L, 2, &len);
+  } else if (lua_isinteger(L, 2)) {
+    const auto res = std::to_chars(buf, buf + sizeof(buf),
+                                   static_cast<int64_t>(lua_tointeger(L, 2)));
+    key = buf;
+    len = static_cast<size_t>(res.ptr - buf);
+  } else {
+    lua_pushnil(L);
+    return 1;
+  }
+  if (auto* runtime = *static_cast<LuaRuntime**>(lua_getextraspace(L));
+      runtime && runtime->async_mode_) {
+    return luaL_error(L,
+      "shared table field '%s' changed and cannot be read in async mode", key);
+  }
+  if (!PullLazyValue(L, [&]() { return block->source->fetch(std::string(key, len)); })) {
+    return lua_error(L);
+  }
+  lua_pushvalue(L, 2);  // [proxy, key, cache, value, key]
+  if (lua_isnil(L, -2)) lua_pushlightuserdata(L, &lazy_absent_anchor);
+  else lua_pushvalue(L, -2);
+  lua_rawset(L, 3);
+  return 1;
+}
+
+// An assignment goes to the cache: visible to this state's reads until the
+// source next changes.
+int LuaRuntime::LazyTableNewIndex(lua_State* L) {
+  const int upv = lua_upvalueindex(1);
+  auto* block = static_cast<LazyTableBlock*>(lua_touserdata(L, upv));
+  if (!block || !block->source) return 0;
+  RefreshLazyTable(L, upv, block);
+  lua_getiuservalue(L, upv, 1);
+  lua_pushvalue(L, 2);
+  // Incomplete caches need the marker: nil would just mean "not pulled yet".
+  if (lua_isnil(L, 3) && !block->complete) lua_pushlightuserdata(L, &lazy_absent_anchor);
+  else lua_pushvalue(L, 3);
+  lua_rawset(L, -3);
+  return 0;
+}
+
+// pairs(proxy) -> next, <the whole table for this version>, nil
+int LuaRuntime::LazyTablePairs(lua_State* L) {
+  const int upv = lua_upvalueindex(1);
+  auto* block = static_cast<LazyTableBlock*>(lua_touserdata(L, upv));
+  if (!block || !block->source) return 0;
+  RefreshLazyTable(L, upv, block);
+  if (block->complete) {
+    lua_getiuservalue(L, upv, 1);
+  } else {
+    if (auto* runtime = *static_cast<LuaRuntime**>(lua_getextraspace(L));
+        runtime && runtime->async_mode_) {
+      return luaL_error(L, "shared table changed and cannot be read in async mode");
+    }
+    if (!MaterializeLazyTable(L, upv)) return lua_error(L);
+  }
+  lua_pushcfunction(L, LazyTableNext);
+  lua_insert(L, -2);
+  lua_pushnil(L);
+  return 3;
+}
+
+// Runs the proxy's own __pairs under pcall, so a failed pull or an async read
+// of a changed table arrives as an exception rather than a longjmp through the
+// caller's C++ frames.
+bool LuaRuntime::PushLazyTableContents(lua_State* L, const int index) {
+  const int abs_index = lua_absindex(L, index);
+  if (!lua_checkstack(L, 4)) {
+    throw std::runtime_error("Lua stack overflow while reading a value");
+  }
+  if (!lua_getmetatable(L, abs_index)) return false;  // [mt]
+  lua_pushstring(L, "__pairs");                       // interned: no allocation
+  lua_rawget(L, -2);                                  // [mt, __pairs]
+  if (lua_tocfunction(L, -1) != LazyTablePairs) {
+    lua_pop(L, 2);
+    return false;
+  }
+  lua_pushvalue(L, abs_index);  // [mt, __pairs, proxy]
+  if (lua_pcall(L, 1, 3, 0) != LUA_OK) {
+    const char* msg = lua_tostring(L, -1);
+    std::string error = msg ? msg : "shared table read failed";
+    lua_pop(L, 2);
+    throw std::runtime_error(error);
+  }
+  lua_pop(L, 1);     // [mt, next, contents]
+  lua_replace(L, -3);
+  lua_pop(L, 1);     // [contents]
+  return true;
+}
+
+int LuaRuntime::LazyTableLen(lua_State* L) {
+  const int upv = lua_upvalueindex(1);
+  auto* block = static_cast<LazyTableBlock*>(lua_touserdata(L, upv));
+  if (!block || !block->source) return 0;
+  RefreshLazyTable(L, upv, block);
+  if (block->complete) {
+    lua_getiuservalue(L, upv, 1);
+  } else {
+    if (auto* runtime = *static_cast<LuaRuntime**>(lua_getextraspace(L));
+        runtime && runtime->async_mode_) {
+      return luaL_error(L, "shared table changed and cannot be read in async mode");
+    }
+    if (!MaterializeLazyTable(L, upv)) return lua_error(L);
+  }
+  lua_pushinteger(L, static_cast<lua_Integer>(lua_rawlen(L, -1)));
+  return 1;
+}
+
+uint8_t LuaRuntime::UserdataAccess(lua_State* L) {
+  const auto access = lua_getiuservalue(L, 1, kUserdataAccessUV) == LUA_TNUMBER
+      ? static_cast<uint8_t>(lua_tointeger(L, -1))
+      : static_cast<uint8_t>(kUserdataRead | kUserdataWrite);
+  lua_pop(L, 1);
+  return access;
+}
+
 int LuaRuntime::UserdataIndex(lua_State* L) {
   auto* block = static_cast<int*>(lua_touserdata(L, 1));
   if (!block) return 0;
@@ -585,85 +2775,75 @@ int LuaRuntime::UserdataIndex(lua_State* L) {
   const char* key = lua_tostring(L, 2);
   if (!key) return 0;
 
-  lua_getfield(L, LUA_REGISTRYINDEX, kRuntimeRegistryKey);
-  auto* runtime = static_cast<LuaRuntime*>(lua_touserdata(L, -1));
-  lua_pop(L, 1);
-
+  auto* runtime = *static_cast<LuaRuntime**>(lua_getextraspace(L));
   if (!runtime) {
     lua_pushnil(L);
     return 1;
   }
 
-  // Stage any error on the Lua stack while the std::string / caught exception
-  // are alive, then longjmp (lua_error) only after they are destroyed.
-  bool raise = false;
-  bool have_result = false;
-  {
-    // 1. Check for a registered method
-    bool has_method_table = false;
-    std::string registry_key = kUserdataMethodsPrefix;
-    registry_key += std::to_string(*block);
-    lua_getfield(L, LUA_REGISTRYINDEX, registry_key.c_str());
-    if (lua_istable(L, -1)) {
-      has_method_table = true;
-      lua_getfield(L, -1, key);
-      if (lua_isfunction(L, -1)) {
+  // 1. Check the block's own method table: one user value fetch and a raw get
+  // of the (already interned) key.
+  const bool has_method_table =
+      lua_getiuservalue(L, 1, kUserdataMethodsUV) == LUA_TTABLE;  // [ud, key, mt]
+  if (has_method_table) {
+    lua_pushvalue(L, 2);
+    switch (lua_rawget(L, 3)) {
+      case LUA_TFUNCTION:
         // Cached closure from a previous access: return it (so obj.m == obj.m).
-        lua_remove(L, -2);  // remove method table
-        have_result = true;
-      } else if (lua_isstring(L, -1)) {
+        return 1;
+      case LUA_TSTRING:
         // First access: the value is the host function name. Build a closure
         // (upvalue 1: name), cache it back into the method table, and return it.
         lua_pushcclosure(L, UserdataMethodCall, 1);  // consumes the name string
-        lua_pushvalue(L, -1);       // dup the closure
-        lua_setfield(L, -3, key);   // method_table[key] = closure
-        lua_remove(L, -2);          // remove method table
-        have_result = true;
-      } else {
-        lua_pop(L, 1);  // pop nil (key not found in method table)
-      }
+        lua_pushvalue(L, 2);
+        lua_pushvalue(L, -2);
+        lua_rawset(L, 3);  // method_table[key] = closure
+        return 1;
+      default:
+        break;  // not a method; fall through to property access
     }
+  }
+  lua_settop(L, 2);
 
-    if (!have_result) {
-      lua_pop(L, 1);  // pop method table (or nil if no table)
-
-      // 2. Fall through to property access
-      if (runtime->property_getter_) {
-        if (runtime->async_mode_) {
-          // A worker thread owns the state; the getter would call into JS
-          // off the main thread. Reject like the host-function path does.
-          lua_pushfstring(L,
-            "property access is not available in async mode (reading '%s')", key);
-          raise = true;
-        } else {
-        try {
-          auto result = runtime->property_getter_(*block, key);
-          if (PushLuaValueProtected(L, result) == LUA_OK) {
-            have_result = true;
-          } else {
-            // ERRMEM mid-push (F6): the frame unwound with the message on
-            // top; raise it after the locals below are destroyed.
-            raise = true;
-          }
-        } catch (const std::exception& e) {
-          // If this userdata has methods but isn't readable, return nil instead
-          // of erroring (methods work independently of readable).
-          if (has_method_table) {
-            lua_pushnil(L);
-            have_result = true;
-          } else {
-            lua_pushfstring(L, "Error reading property '%s': %s", key, e.what());
-            raise = true;
-          }
-        }
-        }
-      }
+  // 2. Fall through to property access
+  if (!runtime->property_getter_) {
+    lua_pushnil(L);
+    return 1;
+  }
+  if (runtime->async_mode_) {
+    // A worker thread owns the state; the getter would call into JS off the
+    // main thread. Reject like the host-function path does.
+    return luaL_error(L,
+      "property access is not available in async mode (reading '%s')", key);
+  }
+  if (!(UserdataAccess(L) & kUserdataRead)) {
+    // Methods work independently of readable: a miss on a userdata that has
+    // them reads as nil rather than an error.
+    if (has_method_table) {
+      lua_pushnil(L);
+      return 1;
     }
-  }  // registry_key destroyed here, before any longjmp
+    return luaL_error(L, "Error reading property '%s': userdata is not readable", key);
+  }
 
+  // Stage any error on the Lua stack while the caught exception is alive, then
+  // longjmp (lua_error) only after it is destroyed.
+  bool raise = false;
+  try {
+    const NumericViewsCallout callout{runtime};
+    auto result = runtime->property_getter_(*block, key);
+    // ERRMEM mid-push (F6): the frame unwound with the message on top; raise
+    // it after the locals here are destroyed.
+    if (PushLuaValueProtected(L, result) != LUA_OK) raise = true;
+  } catch (const std::exception& e) {
+    if (has_method_table) {
+      lua_pushnil(L);
+    } else {
+      lua_pushfstring(L, "Error reading property '%s': %s", key, e.what());
+      raise = true;
+    }
+  }
   if (raise) return lua_error(L);
-  if (have_result) return 1;
-  lua_pushnil(L);
   return 1;
 }
 
@@ -674,9 +2854,7 @@ int LuaRuntime::UserdataNewIndex(lua_State* L) {
   const char* key = lua_tostring(L, 2);
   if (!key) return 0;
 
-  lua_getfield(L, LUA_REGISTRYINDEX, kRuntimeRegistryKey);
-  auto* runtime = static_cast<LuaRuntime*>(lua_touserdata(L, -1));
-  lua_pop(L, 1);
+  auto* runtime = *static_cast<LuaRuntime**>(lua_getextraspace(L));
 
   bool raise = false;
   if (runtime && runtime->property_setter_) {
@@ -686,9 +2864,13 @@ int LuaRuntime::UserdataNewIndex(lua_State* L) {
       lua_pushfstring(L,
         "property access is not available in async mode (writing '%s')", key);
       raise = true;
+    } else if (!(UserdataAccess(L) & kUserdataWrite)) {
+      lua_pushfstring(L, "Error writing property '%s': userdata is not writable", key);
+      raise = true;
     } else {
       try {
         auto value = ToLuaValue(L, 3);
+        const NumericViewsCallout callout{runtime};
         runtime->property_setter_(*block, key, value);
       } catch (const std::exception& e) {
         lua_pushfstring(L, "Error writing property '%s': %s", key, e.what());
@@ -711,6 +2893,27 @@ void LuaRuntime::SetPropertyHandlers(PropertyGetter getter, PropertySetter sette
   property_setter_ = std::move(setter);
 }
 
+void LuaRuntime::SetNumericViewResolver(NumericViewResolver resolver) {
+  numeric_view_resolver_ = std::move(resolver);
+}
+
+// Called from Lua C functions: holds no C++ locals of its own across the
+// caller's raise, and contains anything the resolver throws.
+const char* LuaRuntime::RefreshNumericView(const int ref_id, NumericArrayView& view) const {
+  if (!numeric_view_resolver_) return nullptr;
+  if (async_mode_) return "typed array views are not available in async mode";
+  bool live = false;
+  try {
+    live = numeric_view_resolver_(ref_id, view);
+  } catch (...) {
+    live = false;
+  }
+  return live ? nullptr : "typed array has been detached";
+}
+
+void LuaRuntime::InvalidateNumericViews() { ++numeric_view_epoch_; }
+uint64_t LuaRuntime::NumericViewEpoch() const { return numeric_view_epoch_; }
+
 void LuaRuntime::SetAsyncMode(bool enabled) { async_mode_ = enabled; }
 bool LuaRuntime::IsAsyncMode() const { return async_mode_; }
 
@@ -758,6 +2961,117 @@ void detail::UnrefRegistrySlot(lua_State* mainL, int ref) {
   }
 }
 
+// --- Coroutine thread pool ---
+
+void LuaRuntime::SetCoroutinePoolSize(size_t cap) {
+  std::lock_guard<std::mutex> lk(deferred_unref_mutex_);
+  coroutine_pool_size_ = cap;
+  config_.coroutine_pool_size = cap;  // so a binding-level reset() replays it
+  while (thread_pool_.size() > cap) {
+    const PooledThread idle = thread_pool_.back();
+    thread_pool_.pop_back();
+    pooled_threads_.erase(idle.thread);
+    if (worker_active_) {
+      deferred_unrefs_.push_back(idle.ref);
+    } else {
+      luaL_unref(L_, LUA_REGISTRYINDEX, idle.ref);
+    }
+  }
+}
+
+CoroutinePoolStats LuaRuntime::GetCoroutinePoolStats() const {
+  std::lock_guard<std::mutex> lk(deferred_unref_mutex_);
+  CoroutinePoolStats stats;
+  stats.capacity = coroutine_pool_size_;
+  stats.idle = thread_pool_.size();
+  stats.created = threads_created_;
+  stats.reused = threads_reused_;
+  return stats;
+}
+
+void LuaRuntime::RecycleOrUnrefThread(int ref, lua_State* thread) {
+  std::lock_guard<std::mutex> lk(deferred_unref_mutex_);
+  const auto it = pooled_threads_.find(thread);
+  const bool tracked = it != pooled_threads_.end() && it->second == ref;
+  if (worker_active_) {
+    // The worker owns the state: neither lua_closethread nor luaL_unref may run
+    // here. Give the thread up and queue the unref (H9c).
+    if (tracked) pooled_threads_.erase(it);
+    deferred_unrefs_.push_back(ref);
+    return;
+  }
+  // Recycle only a thread that has nothing left to run: status OK with no
+  // active frame is either finished or never started. A yielded or errored
+  // thread may still own to-be-closed variables, and a thread with a live frame
+  // is mid-call (its body is running a host function that dropped the last
+  // handle) — neither may be reset underneath Lua. (lua_gettop is not a usable
+  // signal for this: a running thread inside a host call can report 0.)
+  lua_Debug ar;
+  if (tracked && thread_pool_.size() < coroutine_pool_size_ &&
+      lua_status(thread) == LUA_OK && lua_getstack(thread, 0, &ar) == 0) {
+    lua_closethread(thread, L_);  // drops the stack, closes upvalues
+    thread_pool_.push_back({ref, thread});
+    return;
+  }
+  if (tracked) pooled_threads_.erase(it);
+  luaL_unref(L_, LUA_REGISTRYINDEX, ref);
+}
+
+void detail::ReleaseThreadSlot(lua_State* mainL, int ref, lua_State* thread) {
+  auto* runtime = *static_cast<LuaRuntime**>(lua_getextraspace(mainL));
+  if (runtime) {
+    runtime->RecycleOrUnrefThread(ref, thread);
+  } else {
+    luaL_unref(mainL, LUA_REGISTRYINDEX, ref);  // see UnrefRegistrySlot
+  }
+}
+
+LuaThreadRef LuaRuntime::MakeCoroutineThread() const {
+  lua_State* thread = nullptr;
+  int ref = LUA_NOREF;
+  {
+    std::lock_guard<std::mutex> lk(deferred_unref_mutex_);
+    if (!thread_pool_.empty()) {
+      ref = thread_pool_.back().ref;
+      thread = thread_pool_.back().thread;
+      thread_pool_.pop_back();
+      ++threads_reused_;
+    }
+  }
+  if (thread) {
+    // lua_newthread copies the main state's hook, and a parked thread kept the
+    // one it was born with. Re-sync so a set_hook / instruction budget installed
+    // since then applies to the reused thread too.
+    lua_sethook(thread, lua_gethook(L_), lua_gethookmask(L_), lua_gethookcount(L_));
+  } else {
+    // Build and anchor the thread inside a protected frame so an OOM under
+    // maxMemory in lua_newthread/luaL_ref throws instead of aborting (M3).
+    RunProtected([&]() {
+      thread = lua_newthread(L_);               // [thread]
+      ref = luaL_ref(L_, LUA_REGISTRYINDEX);    // anchors it (pops thread)
+    });
+    if (!thread) throw std::runtime_error("Failed to create coroutine thread");
+    std::lock_guard<std::mutex> lk(deferred_unref_mutex_);
+    ++threads_created_;
+    if (coroutine_pool_size_ == 0) return LuaThreadRef(ref, L_, thread);
+    pooled_threads_[thread] = ref;
+  }
+  return LuaThreadRef(ref, L_, thread, detail::MakeThreadOwner(L_, ref, thread));
+}
+
+void LuaRuntime::MarkThreadEscaped(lua_State* thread) const {
+  std::lock_guard<std::mutex> lk(deferred_unref_mutex_);
+  if (pooled_threads_.erase(thread) == 0) return;
+  // An idle thread surfacing from Lua means something captured it (e.g. a
+  // stashed coroutine.running()); it can no longer be handed out.
+  const auto it = std::find_if(thread_pool_.begin(), thread_pool_.end(),
+                               [thread](const PooledThread& p) { return p.thread == thread; });
+  if (it != thread_pool_.end()) {
+    luaL_unref(L_, LUA_REGISTRYINDEX, it->ref);
+    thread_pool_.erase(it);
+  }
+}
+
 void LuaRuntime::CreateUserdataGlobal(const std::string& name, int ref_id) {
   // Protected so an OOM (under maxMemory) allocating the userdata, or a raising
   // __newindex on a _G metatable, throws instead of aborting (M3). The build is
@@ -776,9 +3090,7 @@ void LuaRuntime::CreateUserdataGlobal(const std::string& name, int ref_id) {
 
 void LuaRuntime::CreateProxyUserdataGlobal(const std::string& name, int ref_id) {
   RunProtected([&]() {
-    auto* block = static_cast<int*>(lua_newuserdata(L_, sizeof(int)));
-    *block = ref_id;
-    luaL_setmetatable(L_, kProxyUserdataMetaName);     // [ud]
+    NewProxyUserdata(L_, ref_id);                      // [ud]
     lua_rawgeti(L_, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);  // [ud, _G]
     lua_pushlstring(L_, name.data(), name.size());     // [ud, _G, key]
     lua_pushvalue(L_, -3);                             // [ud, _G, key, ud]
@@ -799,51 +3111,161 @@ void LuaRuntime::RemoveGlobalRaw(const std::string& name) const {
   });
 }
 
-void LuaRuntime::IncrementUserdataRefCount(int ref_id) {
-  userdata_ref_counts_[ref_id]++;
+LuaRuntime::UserdataRecord* LuaRuntime::FindUserdataRecord(int ref_id) {
+  if (ref_id <= 0) return nullptr;
+  const size_t slot = UserdataSlotOf(ref_id);
+  if (slot >= userdata_records_.size()) return nullptr;
+  UserdataRecord& record = userdata_records_[slot];
+  return record.ref_id == ref_id ? &record : nullptr;
+}
+
+const LuaRuntime::UserdataRecord* LuaRuntime::FindUserdataRecord(int ref_id) const {
+  return const_cast<LuaRuntime*>(this)->FindUserdataRecord(ref_id);
+}
+
+LuaRuntime::UserdataRecord& LuaRuntime::ClaimUserdataRecord(int ref_id) {
+  const size_t slot = UserdataSlotOf(ref_id);
+  if (slot >= userdata_records_.size()) userdata_records_.resize(slot + 1);
+  UserdataRecord& record = userdata_records_[slot];
+  if (record.ref_id != ref_id) {
+    record = UserdataRecord{};
+    record.ref_id = ref_id;
+  }
+  return record;
+}
+
+void LuaRuntime::IncrementUserdataRefCount(int ref_id) {
+  ClaimUserdataRecord(ref_id).ref_count++;
+}
+
+void LuaRuntime::DecrementUserdataRefCount(int ref_id) {
+  UserdataRecord* record = FindUserdataRecord(ref_id);
+  if (!record || record->ref_count <= 0 || --record->ref_count > 0) return;
+
+  ClearUserdataMethodTable(ref_id);
+
+  // The GC callback reaches into the binding layer's N-API state (it frees a
+  // Napi::ObjectReference and writes native fields back to the object).
+  // During worker-thread async that would be an off-thread N-API call, so the
+  // record — dirty fields included — is kept and finished by
+  // DrainAsyncUserdataReleases once the run is over.
+  if (async_mode_) {
+    async_released_userdata_.push_back(ref_id);
+    return;
+  }
+  if (userdata_gc_callback_) {
+    const NumericViewsCallout callout{this};  // field write-back runs JS setters
+    userdata_gc_callback_(ref_id);
+  }
+  // After the callback, which may still write the fields back to JS. Looked up
+  // again: the callback may have grown the records.
+  if (UserdataRecord* done = FindUserdataRecord(ref_id); done && done->ref_count == 0) {
+    *done = UserdataRecord{};
+  }
+}
+
+void LuaRuntime::DrainAsyncUserdataReleases() {
+  std::vector<int> released;
+  released.swap(async_released_userdata_);
+  for (const int ref_id : released) {
+    // Skip one pushed back into Lua since: it is live again.
+    const UserdataRecord* record = FindUserdataRecord(ref_id);
+    if (!record || record->ref_count != 0) continue;
+    if (userdata_gc_callback_) userdata_gc_callback_(ref_id);
+    if (UserdataRecord* done = FindUserdataRecord(ref_id); done && done->ref_count == 0) {
+      *done = UserdataRecord{};
+    }
+  }
 }
 
-void LuaRuntime::DecrementUserdataRefCount(int ref_id) {
-  auto it = userdata_ref_counts_.find(ref_id);
-  if (it != userdata_ref_counts_.end()) {
-    if (--it->second <= 0) {
-      userdata_ref_counts_.erase(it);
-
-      // Clean up method table if one exists
-      std::string registry_key = kUserdataMethodsPrefix;
-      registry_key += std::to_string(ref_id);
-      lua_pushnil(L_);
-      lua_setfield(L_, LUA_REGISTRYINDEX, registry_key.c_str());
+ClassInstanceFields* LuaRuntime::FieldsForPush(lua_State* L, int ref_id,
+                                               const std::string& class_name) {
+  if (class_name.empty()) return nullptr;
+  auto* runtime = *static_cast<LuaRuntime**>(lua_getextraspace(L));
+  if (!runtime) return nullptr;
+  if (UserdataRecord* record = runtime->FindUserdataRecord(ref_id); record && record->fields) {
+    return record->fields.get();
+  }
+  // An instance the host never seeded starts at the zero values.
+  const auto layout = runtime->class_layouts_.find(class_name);
+  if (layout == runtime->class_layouts_.end()) return nullptr;
+  auto fields = std::make_unique<ClassInstanceFields>();
+  fields->layout = layout->second;
+  fields->scalars.resize(layout->second->size(), FastScalar{});
+  fields->strings.resize(layout->second->size());
+  UserdataRecord& record = runtime->ClaimUserdataRecord(ref_id);
+  record.fields = std::move(fields);
+  return record.fields.get();
+}
 
-      // The GC callback reaches into the binding layer's N-API state (it frees a
-      // Napi::ObjectReference). During worker-thread async that would be an
-      // off-thread N-API call, so skip it. The binding entry is reclaimed when
-      // the context is destroyed; leaking it for the run is better than a crash.
-      if (userdata_gc_callback_ && !async_mode_) {
-        userdata_gc_callback_(ref_id);
-      }
-    }
+void LuaRuntime::ReleaseUserdataPin(int ref_id) {
+  UserdataRecord* record = FindUserdataRecord(ref_id);
+  if (!record || record->ref_count <= 0 || --record->ref_count > 0) return;
+  // Same off-thread rule as DecrementUserdataRefCount.
+  if (async_mode_) {
+    async_released_userdata_.push_back(ref_id);
+    return;
   }
+  if (userdata_gc_callback_) userdata_gc_callback_(ref_id);
 }
 
 void LuaRuntime::SetUserdataMethodTable(
     int ref_id,
     const std::unordered_map<std::string, std::string>& method_map) {
-  std::string registry_key = kUserdataMethodsPrefix;
-  registry_key += std::to_string(ref_id);
   // Protected so an OOM building the method table throws instead of aborting (M3).
   RunProtected([&]() {
+    lua_getfield(L_, LUA_REGISTRYINDEX, kUserdataMethodsKey);
     // Create a table: { method_name = "host_func_name", ... }
-    lua_newtable(L_);
+    lua_createtable(L_, 0, static_cast<int>(method_map.size()));
     for (const auto& [name, func_name] : method_map) {
       lua_pushstring(L_, func_name.c_str());
       lua_setfield(L_, -2, name.c_str());
     }
-    // Store in registry: _ud_methods_<ref_id> = table (consumes the table)
-    lua_setfield(L_, LUA_REGISTRYINDEX, registry_key.c_str());
+    lua_rawseti(L_, -2, ref_id);  // methods[ref_id] = table
+    lua_pop(L_, 1);
   });
 }
 
+void LuaRuntime::SetUserdataAccess(int ref_id, bool readable, bool writable) {
+  ClaimUserdataRecord(ref_id).access = static_cast<uint8_t>(
+      (readable ? kUserdataRead : 0) | (writable ? kUserdataWrite : 0));
+}
+
+void LuaRuntime::ClearUserdataMethodTable(int ref_id) {
+  if (UserdataRecord* record = FindUserdataRecord(ref_id)) {
+    record->access = kUserdataRead | kUserdataWrite;
+  }
+  // Storing nil into an existing table never allocates, so this is safe both
+  // inside __gc and outside any protected frame.
+  lua_getfield(L_, LUA_REGISTRYINDEX, kUserdataMethodsKey);
+  if (lua_istable(L_, -1)) {
+    lua_pushnil(L_);
+    lua_rawseti(L_, -2, ref_id);
+  }
+  lua_pop(L_, 1);
+}
+
+void LuaRuntime::NewProxyUserdata(lua_State* L, int ref_id) {
+  auto* block = static_cast<int*>(lua_newuserdatauv(L, sizeof(int), 2));
+  *block = ref_id;
+  luaL_setmetatable(L, kProxyUserdataMetaName);
+  lua_getfield(L, LUA_REGISTRYINDEX, kUserdataMethodsKey);
+  if (lua_istable(L, -1)) {
+    lua_rawgeti(L, -1, ref_id);
+    lua_setiuservalue(L, -3, kUserdataMethodsUV);  // nil when it has no methods
+  }
+  lua_pop(L, 1);
+  auto* runtime = *static_cast<LuaRuntime**>(lua_getextraspace(L));
+  uint8_t access = kUserdataRead | kUserdataWrite;
+  if (runtime) {
+    if (const UserdataRecord* record = runtime->FindUserdataRecord(ref_id)) {
+      access = record->access;
+    }
+  }
+  lua_pushinteger(L, access);
+  lua_setiuservalue(L, -2, kUserdataAccessUV);
+}
+
 int LuaRuntime::UserdataMethodCall(lua_State* L) {
   // upvalue 1: host function name (string)
   // When called as obj:method(a, b), the stack has: obj, a, b
@@ -892,7 +3314,8 @@ int LuaRuntime::UserdataMethodCall(lua_State* L) {
       LuaPtr resultHolder;
       bool called = true;
       try {
-        resultHolder = it->second(args);
+        const NumericViewsCallout callout{runtime};
+        resultHolder = it->second->fn(args);
       } catch (const std::exception& e) {
         if (runtime->HasPendingErrorValue()) {
           LuaPtr errVal = runtime->TakePendingErrorValue();
@@ -970,7 +3393,8 @@ void LuaRuntime::RegisterClass(
     const std::string& constructor_func_name,
     const std::unordered_map<std::string, std::string>& method_map,
     const std::vector<MetatableEntry>& metamethods,
-    const std::string& parent_class_name) {
+    const std::string& parent_class_name,
+    const std::vector<ClassField>& fields) {
   // The whole build (metatable, method table, class global) runs in one
   // protected frame so an OOM under maxMemory, or a raising __newindex on a _G
   // metatable at the final lua_setglobal, throws instead of aborting (M3). Every
@@ -983,6 +3407,10 @@ void LuaRuntime::RegisterClass(
   const std::string parent_mt_name =
     parent_class_name.empty() ? std::string() : kClassMetaPrefix + parent_class_name;
   const std::string parent_key = kClassParentPrefix + class_name;
+  // Registering a name again replaces its methods, so every class derived
+  // from it needs its flattened table rebuilt; a first registration has no
+  // descendants yet.
+  const bool reregistering = HasClass(class_name);
   RunProtected([&]() {
   // 0. A base class must already exist: the method chain and the metamethod
   // copy below both read its registry entries.
@@ -1003,15 +3431,38 @@ void LuaRuntime::RegisterClass(
   lua_pushcfunction(L_, UserdataGC);
   lua_setfield(L_, -2, "__gc");
 
-  // __index closure carries the class name as an upvalue so it can find the
-  // shared method table, then falls through to property access.
-  lua_pushstring(L_, class_name.c_str());
-  lua_pushcclosure(L_, ClassIndex, 1);
-  lua_setfield(L_, -2, "__index");
+  // Native fields: { name = slot } (1-based), or false for a class without.
+  if (fields.empty()) {
+    lua_pushboolean(L_, 0);
+  } else {
+    lua_createtable(L_, 0, static_cast<int>(fields.size()));
+    for (size_t i = 0; i < fields.size(); ++i) {
+      lua_pushinteger(L_, static_cast<lua_Integer>(i + 1));
+      lua_setfield(L_, -2, fields[i].name.c_str());
+    }
+  }
+  const int fields_idx = lua_gettop(L_);
 
-  // __newindex reuses the property-setter path (honors the writable flag).
-  lua_pushcfunction(L_, UserdataNewIndex);
-  lua_setfield(L_, -2, "__newindex");
+  // __index closure: upvalue 1 is the class name, upvalue 2 the flattened
+  // method table (installed by FlattenClassMethods once the method table
+  // below exists), upvalue 3 the field slots. A miss falls through to
+  // property access.
+  lua_pushstring(L_, class_name.c_str());
+  lua_pushboolean(L_, 0);
+  lua_pushvalue(L_, fields_idx);
+  lua_pushcclosure(L_, ClassIndex, 3);
+  lua_setfield(L_, mt_idx, "__index");
+
+  // __newindex reuses the property-setter path (honors the writable flag),
+  // after the field slots when the class has any.
+  if (fields.empty()) {
+    lua_pushcfunction(L_, UserdataNewIndex);
+  } else {
+    lua_pushvalue(L_, fields_idx);
+    lua_pushcclosure(L_, ClassNewIndex, 1);
+  }
+  lua_setfield(L_, mt_idx, "__newindex");
+  lua_settop(L_, mt_idx);
 
   // __name aids default tostring() and error messages.
   lua_pushstring(L_, class_name.c_str());
@@ -1024,7 +3475,7 @@ void LuaRuntime::RegisterClass(
 
   // Operator overloads / other metamethods dispatch through the host bridge.
   for (const auto& mm : metamethods) {
-    lua_pushstring(L_, mm.func_name.c_str());
+    PushHostFunctionSlot(L_, this, mm.func_name);
     lua_pushcclosure(L_, LuaCallHostFunction, 1);
     lua_setfield(L_, mt_idx, mm.key.c_str());
   }
@@ -1033,7 +3484,7 @@ void LuaRuntime::RegisterClass(
   // its own metamethods and every reserved key (__gc, __index, __newindex,
   // __name, the class marker) — is already present, so the "absent here" test
   // is all the filtering the copy needs. The values are plain Lua closures over
-  // a host-function name, so copying the reference is enough; the parent's
+  // a host-function slot, so copying the reference is enough; the parent's
   // registered callbacks stay the ones that run.
   if (!parent_class_name.empty()) {
     lua_getfield(L_, LUA_REGISTRYINDEX, parent_mt_name.c_str());
@@ -1057,7 +3508,7 @@ void LuaRuntime::RegisterClass(
     }
     lua_pop(L_, 1);  // pop parent metatable
 
-    // Record the link so ClassIndex can chain method lookups.
+    // Record the link so FlattenClassMethods can merge the chain's methods.
     lua_pushstring(L_, parent_class_name.c_str());
     lua_setfield(L_, LUA_REGISTRYINDEX, parent_key.c_str());
   }
@@ -1072,13 +3523,212 @@ void LuaRuntime::RegisterClass(
   }
   lua_setfield(L_, LUA_REGISTRYINDEX, methods_key.c_str());
 
+  FlattenClassMethods(L_, class_name.c_str());
+  if (reregistering) {
+    for (const auto& other : class_names_) {
+      if (other != class_name && ClassDerivesFrom(L_, other.c_str(), class_name.c_str())) {
+        FlattenClassMethods(L_, other.c_str());
+      }
+    }
+  }
+
   // 3. Create the class global table with a `new` constructor function.
   lua_newtable(L_);
-  lua_pushstring(L_, constructor_func_name.c_str());
+  PushHostFunctionSlot(L_, this, constructor_func_name);
   lua_pushcclosure(L_, LuaCallHostFunction, 1);
   lua_setfield(L_, -2, "new");
   lua_setglobal(L_, class_name.c_str());
   });
+  if (!reregistering) class_names_.push_back(class_name);
+  if (fields.empty()) {
+    class_layouts_.erase(class_name);
+  } else {
+    class_layouts_[class_name] = std::make_shared<const std::vector<ClassField>>(fields);
+  }
+}
+
+namespace {
+
+const char* ClassFieldTypeName(const ClassFieldType type) {
+  switch (type) {
+    case ClassFieldType::Number: return "a number";
+    case ClassFieldType::Integer: return "an integer";
+    case ClassFieldType::Boolean: return "a boolean";
+    default: return "a string";
+  }
+}
+
+}  // namespace
+
+void LuaRuntime::SetClassFields(int ref_id, const std::string& class_name,
+                                const std::vector<LuaPtr>& values) {
+  std::shared_ptr<const std::vector<ClassField>> layout;
+  UserdataRecord* existing = FindUserdataRecord(ref_id);
+  if (existing && existing->fields) {
+    layout = existing->fields->layout;
+  } else if (const auto it2 = class_layouts_.find(class_name); it2 != class_layouts_.end()) {
+    layout = it2->second;
+  } else {
+    return;
+  }
+
+  // Convert into a scratch record first, so a bad value changes nothing.
+  ClassInstanceFields next;
+  next.layout = layout;
+  next.scalars.resize(layout->size(), FastScalar{});
+  next.strings.resize(layout->size());
+  for (size_t i = 0; i < layout->size(); ++i) {
+    const ClassField& field = (*layout)[i];
+    if (i >= values.size() || !values[i] ||
+        std::holds_alternative<std::monostate>(values[i]->value)) {
+      continue;  // the zero value
+    }
+    const auto& v = values[i]->value;
+    bool ok = true;
+    switch (field.type) {
+      case ClassFieldType::Number:
+        if (const auto* n = std::get_if<int64_t>(&v)) next.scalars[i].number = static_cast<double>(*n);
+        else if (const auto* d = std::get_if<double>(&v)) next.scalars[i].number = *d;
+        else ok = false;
+        break;
+      case ClassFieldType::Integer:
+        if (const auto* n = std::get_if<int64_t>(&v)) {
+          next.scalars[i].integer = *n;
+        } else if (const auto* d = std::get_if<double>(&v);
+                   d && std::trunc(*d) == *d &&
+                   *d >= -9223372036854775808.0 && *d < 9223372036854775808.0) {
+          next.scalars[i].integer = static_cast<int64_t>(*d);
+        } else {
+          ok = false;
+        }
+        break;
+      case ClassFieldType::Boolean:
+        if (const auto* b = std::get_if<bool>(&v)) next.scalars[i].boolean = *b;
+        else ok = false;
+        break;
+      case ClassFieldType::String:
+        if (const auto* str = std::get_if<std::string>(&v)) next.strings[i] = *str;
+        else ok = false;
+        break;
+    }
+    if (!ok) {
+      throw std::runtime_error("field '" + field.name + "' must be " +
+                               ClassFieldTypeName(field.type));
+    }
+  }
+  // Assigned into the existing record, never replaced: blocks hold its address.
+  UserdataRecord& record = ClaimUserdataRecord(ref_id);
+  if (record.fields) {
+    *record.fields = std::move(next);
+  } else {
+    record.fields = std::make_unique<ClassInstanceFields>(std::move(next));
+  }
+}
+
+const std::vector<ClassField>* LuaRuntime::ClassFieldLayout(int ref_id) const {
+  const UserdataRecord* record = FindUserdataRecord(ref_id);
+  return record && record->fields ? record->fields->layout.get() : nullptr;
+}
+
+std::vector<LuaValue> LuaRuntime::ClassFieldValues(int ref_id) const {
+  std::vector<LuaValue> out;
+  const UserdataRecord* entry = FindUserdataRecord(ref_id);
+  if (!entry || !entry->fields) return out;
+  const ClassInstanceFields& record = *entry->fields;
+  out.reserve(record.layout->size());
+  for (size_t i = 0; i < record.layout->size(); ++i) {
+    switch ((*record.layout)[i].type) {
+      case ClassFieldType::Number: out.push_back(LuaValue::from(record.scalars[i].number)); break;
+      case ClassFieldType::Integer: out.push_back(LuaValue::from(record.scalars[i].integer)); break;
+      case ClassFieldType::Boolean: out.push_back(LuaValue::from(record.scalars[i].boolean)); break;
+      case ClassFieldType::String: out.push_back(LuaValue::from(record.strings[i])); break;
+    }
+  }
+  return out;
+}
+
+bool LuaRuntime::ClassFieldsDirty(int ref_id) const {
+  const UserdataRecord* record = FindUserdataRecord(ref_id);
+  return record && record->fields && record->fields->dirty;
+}
+
+void LuaRuntime::MarkClassFieldsClean(int ref_id) {
+  if (UserdataRecord* record = FindUserdataRecord(ref_id); record && record->fields) {
+    record->fields->dirty = false;
+  }
+}
+
+std::vector<int> LuaRuntime::DirtyClassInstances() {
+  // An id is appended each time its record goes clean -> dirty, so the list
+  // can hold ids since cleaned, collected, or listed twice: keep each live
+  // dirty id once.
+  std::vector<int> live;
+  std::unordered_set<int> listed;
+  listed.reserve(dirty_class_fields_.size());
+  for (const int ref_id : dirty_class_fields_) {
+    if (ClassFieldsDirty(ref_id) && listed.insert(ref_id).second) live.push_back(ref_id);
+  }
+  dirty_class_fields_ = live;
+  return live;
+}
+
+bool LuaRuntime::ClassDerivesFrom(lua_State* L, const char* class_name, const char* base) {
+  const int top = lua_gettop(L);
+  lua_pushstring(L, class_name);
+  bool found = false;
+  for (int depth = 0; depth < kMaxClassDepth; ++depth) {
+    if (std::strcmp(lua_tostring(L, -1), base) == 0) {
+      found = true;
+      break;
+    }
+    lua_pushfstring(L, "%s%s", kClassParentPrefix, lua_tostring(L, -1));
+    if (lua_rawget(L, LUA_REGISTRYINDEX) != LUA_TSTRING) break;
+    lua_remove(L, -2);  // one level at a time: the stack stays two slots deep
+  }
+  lua_settop(L, top);
+  return found;
+}
+
+void LuaRuntime::FlattenClassMethods(lua_State* L, const char* class_name) {
+  const int base = lua_gettop(L);
+
+  // The chain's names, leaf first, as Lua strings at base+1 .. top. A full
+  // chain plus the merge's working slots outgrows the LUA_MINSTACK a C frame
+  // is guaranteed, so reserve it (raising, inside the caller's protected frame).
+  luaL_checkstack(L, kMaxClassDepth + 8, "class chain");
+  lua_pushstring(L, class_name);
+  for (int depth = 1; depth < kMaxClassDepth; ++depth) {
+    lua_pushfstring(L, "%s%s", kClassParentPrefix, lua_tostring(L, -1));
+    if (lua_rawget(L, LUA_REGISTRYINDEX) != LUA_TSTRING) {
+      lua_pop(L, 1);
+      break;
+    }
+  }
+  const int top = lua_gettop(L);
+
+  // Root first, so a class's own entry overwrites the one it inherits.
+  lua_newtable(L);
+  const int flat = lua_gettop(L);
+  for (int i = top; i > base; --i) {
+    lua_pushfstring(L, "%s%s", kClassMethodsPrefix, lua_tostring(L, i));
+    if (lua_rawget(L, LUA_REGISTRYINDEX) == LUA_TTABLE) {
+      lua_pushnil(L);
+      while (lua_next(L, -2) != 0) {
+        lua_pushvalue(L, -2);
+        lua_insert(L, -2);
+        lua_rawset(L, flat);  // flat[name] = host function name
+      }
+    }
+    lua_pop(L, 1);
+  }
+
+  lua_pushfstring(L, "%s%s", kClassMetaPrefix, class_name);
+  if (lua_rawget(L, LUA_REGISTRYINDEX) == LUA_TTABLE &&
+      lua_getfield(L, -1, "__index") == LUA_TFUNCTION) {
+    lua_pushvalue(L, flat);
+    lua_setupvalue(L, -2, 2);
+  }
+  lua_settop(L, base);
 }
 
 int LuaRuntime::ClassIndex(lua_State* L) {
@@ -1088,138 +3738,169 @@ int LuaRuntime::ClassIndex(lua_State* L) {
   const char* key = lua_tostring(L, 2);
   if (!key) { lua_pushnil(L); return 1; }
 
-  const char* class_name = lua_tostring(L, lua_upvalueindex(1));
-
-  lua_getfield(L, LUA_REGISTRYINDEX, kRuntimeRegistryKey);
-  auto* runtime = static_cast<LuaRuntime*>(lua_touserdata(L, -1));
-  lua_pop(L, 1);
+  auto* runtime = *static_cast<LuaRuntime**>(lua_getextraspace(L));
   if (!runtime) { lua_pushnil(L); return 1; }
 
-  // Stage any error on the Lua stack while the std::string / caught exception
-  // are alive, then longjmp (lua_error) only after they are destroyed.
-  bool raise = false;
-  bool have_result = false;
-  {
-    // 1. Look up the key in the shared class method table, walking up the
-    // inheritance chain (C4) until it is found or the chain ends.
-    bool has_methods = false;
-    std::string scratch_key;  // registry key for the class being examined
-    std::string current = class_name ? class_name : "";
-
-    // The class's own method table stays at a fixed slot: it is the cache an
-    // inherited method is memoized into, so the walk happens once per class
-    // rather than once per call.
-    scratch_key = kClassMethodsPrefix;
-    scratch_key += current;
-    lua_getfield(L, LUA_REGISTRYINDEX, scratch_key.c_str());
-    const int own_idx = lua_gettop(L);
-
-    // Depth cap: a chain is acyclic by construction (a base class must already
-    // be registered, and a name cannot be registered twice), so this only bounds
-    // a registry someone tampered with from Lua.
-    constexpr int kMaxClassDepth = 32;
-    for (int depth = 0; depth < kMaxClassDepth && !current.empty(); ++depth) {
-      scratch_key = kClassMethodsPrefix;
-      scratch_key += current;
-      lua_getfield(L, LUA_REGISTRYINDEX, scratch_key.c_str());
-      const int methods_idx = lua_gettop(L);
-      if (lua_istable(L, methods_idx)) {
-        has_methods = true;
-        lua_getfield(L, methods_idx, key);
-        if (const int found = lua_type(L, -1); found == LUA_TFUNCTION) {
-          // Cached closure (shared across instances of this class).
-          have_result = true;
-        } else if (found == LUA_TSTRING) {
-          // First access: the value is the host function name. Build a bound
-          // method closure from it.
-          lua_pushcclosure(L, UserdataMethodCall, 1);  // consumes name as upvalue 1
-          have_result = true;
-        } else {
-          lua_pop(L, 1);  // pop nil (key not a method of this class)
-        }
-        if (have_result) {
-          if (lua_istable(L, own_idx)) {
-            lua_pushvalue(L, -1);        // dup the closure
-            lua_setfield(L, own_idx, key);  // own_methods[key] = closure
-          }
-          break;  // [.., own, methods, closure]
-        }
+  // 0. Native fields: read straight from the instance's record, no host call
+  // (so this works in async mode too).
+  if (lua_istable(L, lua_upvalueindex(3))) {
+    lua_pushvalue(L, 2);
+    if (lua_rawget(L, lua_upvalueindex(3)) == LUA_TNUMBER) {
+      const auto slot = static_cast<size_t>(lua_tointeger(L, -1) - 1);
+      lua_pop(L, 1);
+      // The size check guards a block pushed before the class had fields.
+      const auto* fb = static_cast<ClassFieldBlock*>(static_cast<void*>(block));
+      if (lua_rawlen(L, 1) >= sizeof(ClassFieldBlock) && fb->fields &&
+          slot < fb->fields->layout->size()) {
+        PushClassField(L, *fb->fields, slot);
+      } else {
+        lua_pushnil(L);
       }
-      lua_pop(L, 1);  // pop this class's method table (or nil)
+      return 1;
+    }
+    lua_pop(L, 1);
+  }
 
-      // Step to the base class, if this one has any.
-      scratch_key = kClassParentPrefix;
-      scratch_key += current;
-      lua_getfield(L, LUA_REGISTRYINDEX, scratch_key.c_str());
-      const char* parent = lua_tostring(L, -1);
-      current = parent ? parent : "";
-      lua_pop(L, 1);
+  // 1. Look the key up in the flattened method table (C4): the class's own
+  // methods and every inherited one, so there is no chain to walk.
+  const int methods_idx = lua_upvalueindex(2);
+  const bool has_methods = lua_istable(L, methods_idx);
+  if (has_methods) {
+    lua_pushvalue(L, 2);
+    switch (lua_rawget(L, methods_idx)) {
+      case LUA_TFUNCTION:
+        // Cached closure (shared across instances of this class).
+        return 1;
+      case LUA_TSTRING:
+        // First access: the value is the host function name. Build a bound
+        // method closure from it and memoize it in place of the name.
+        lua_pushcclosure(L, UserdataMethodCall, 1);  // consumes name as upvalue 1
+        lua_pushvalue(L, 2);
+        lua_pushvalue(L, -2);
+        lua_rawset(L, methods_idx);
+        return 1;
+      default:
+        lua_pop(L, 1);  // not a method
+        break;
     }
+  }
+
+  // 2. Fall through to property access.
+  if (!runtime->property_getter_) {
+    lua_pushnil(L);
+    return 1;
+  }
+  if (runtime->async_mode_) {
+    // A worker thread owns the state; the getter would call into JS off the
+    // main thread. Reject like the host-function path does.
+    return luaL_error(L,
+      "property access is not available in async mode (reading '%s')", key);
+  }
 
-    if (have_result) {
-      // Collapse [.., own, methods, closure] down to just the closure.
-      lua_remove(L, own_idx + 1);
-      lua_remove(L, own_idx);
+  // Stage any error on the Lua stack while the caught exception is alive, then
+  // longjmp (lua_error) only after it is destroyed.
+  bool raise = false;
+  try {
+    const NumericViewsCallout callout{runtime};
+    auto result = runtime->property_getter_(*block, key);
+    // ERRMEM mid-push (F6): the frame unwound with the message on top; raise
+    // it after the locals here are destroyed.
+    if (PushLuaValueProtected(L, result) != LUA_OK) raise = true;
+  } catch (const std::exception& e) {
+    // Class with methods but not readable: return nil rather than erroring
+    // (methods work independently of readable, matching userdata behavior).
+    if (has_methods) {
+      lua_pushnil(L);
     } else {
-      lua_pop(L, 1);  // pop the own method table (or nil)
+      // Reproduce luaL_error's "chunk:line: " location prefix.
+      luaL_where(L, 1);
+      lua_pushfstring(L, "Error reading property '%s': %s", key, e.what());
+      lua_concat(L, 2);
+      raise = true;
+    }
+  }
+  if (raise) return lua_error(L);
+  return 1;
+}
 
-      // 2. Fall through to property access.
-      if (runtime->property_getter_) {
-        if (runtime->async_mode_) {
-          // A worker thread owns the state; the getter would call into JS off
-          // the main thread. Reject like the host-function path does.
-          luaL_where(L, 1);
-          lua_pushfstring(L,
-            "property access is not available in async mode (reading '%s')", key);
-          lua_concat(L, 2);
-          raise = true;
-        } else {
+// __newindex of a class with fields (upvalue 1: { name = slot }). A field is
+// type-checked and stored in the instance's record, marking it for write-back;
+// any other key goes to the property setter as usual.
+int LuaRuntime::ClassNewIndex(lua_State* L) {
+  auto* fb = static_cast<ClassFieldBlock*>(lua_touserdata(L, 1));
+  if (!fb || lua_rawlen(L, 1) < sizeof(ClassFieldBlock) || lua_type(L, 2) != LUA_TSTRING) {
+    return UserdataNewIndex(L);
+  }
+  lua_pushvalue(L, 2);
+  if (lua_rawget(L, lua_upvalueindex(1)) != LUA_TNUMBER) {
+    lua_pop(L, 1);
+    return UserdataNewIndex(L);
+  }
+  const auto slot = static_cast<size_t>(lua_tointeger(L, -1) - 1);
+  lua_pop(L, 1);
+  ClassInstanceFields* record = fb->fields;
+  if (!record || slot >= record->layout->size()) return 0;
+
+  const ClassField& field = (*record->layout)[slot];
+  bool ok = false;
+  switch (field.type) {
+    case ClassFieldType::Number:
+      if ((ok = lua_type(L, 3) == LUA_TNUMBER)) record->scalars[slot].number = lua_tonumber(L, 3);
+      break;
+    case ClassFieldType::Integer: {
+      int isint = 0;
+      const lua_Integer v = lua_type(L, 3) == LUA_TNUMBER ? lua_tointegerx(L, 3, &isint) : 0;
+      if ((ok = isint != 0)) record->scalars[slot].integer = v;
+      break;
+    }
+    case ClassFieldType::Boolean:
+      if ((ok = lua_isboolean(L, 3))) record->scalars[slot].boolean = lua_toboolean(L, 3);
+      break;
+    case ClassFieldType::String:
+      if ((ok = lua_type(L, 3) == LUA_TSTRING)) {
+        size_t len = 0;
+        const char* str = lua_tolstring(L, 3, &len);
         try {
-          auto result = runtime->property_getter_(*block, key);
-          if (PushLuaValueProtected(L, result) == LUA_OK) {
-            have_result = true;
-          } else {
-            // ERRMEM mid-push (F6): the frame unwound with the message on
-            // top; raise it after the locals below are destroyed.
-            raise = true;
-          }
-        } catch (const std::exception& e) {
-          // Class with methods but not readable: return nil rather than erroring
-          // (methods work independently of readable, matching userdata behavior).
-          if (has_methods) {
-            lua_pushnil(L);
-            have_result = true;
-          } else {
-            // Reproduce luaL_error's "chunk:line: " location prefix.
-            luaL_where(L, 1);
-            lua_pushfstring(L, "Error reading property '%s': %s", key, e.what());
-            lua_concat(L, 2);
-            raise = true;
-          }
-        }
+          record->strings[slot].assign(str, len);
+        } catch (const std::bad_alloc&) {
+          ok = false;
         }
+        if (!ok) return luaL_error(L, "not enough memory");
       }
-    }
-  }  // scratch_key / current destroyed here, before any longjmp
+      break;
+  }
+  if (!ok) {
+    return luaL_error(L, "field '%s' must be %s, got %s", lua_tostring(L, 2),
+                      ClassFieldTypeName(field.type), luaL_typename(L, 3));
+  }
 
-  if (raise) return lua_error(L);
-  if (have_result) return 1;
-  lua_pushnil(L);
-  return 1;
+  if (!record->dirty) {
+    bool listed = true;
+    if (auto* runtime = *static_cast<LuaRuntime**>(lua_getextraspace(L))) {
+      try {
+        runtime->dirty_class_fields_.push_back(fb->ref_id);
+      } catch (const std::bad_alloc&) {
+        listed = false;
+      }
+    }
+    if (!listed) return luaL_error(L, "not enough memory");
+    record->dirty = true;
+  }
+  return 0;
 }
 
 // --- Metatable support ---
 
 void LuaRuntime::StoreHostFunction(const std::string& name, Function fn) {
-  host_functions_[name] = std::move(fn);
+  StoreHostFunctionSlot(name, std::move(fn));
 }
 
 void LuaRuntime::RemoveHostFunction(const std::string& name) {
-  host_functions_.erase(name);
+  EraseHostFunctionSlot(name);
 }
 
 void LuaRuntime::RegisterReclaimableHostFunction(const std::string& name, Function fn) {
-  host_functions_[name] = std::move(fn);
+  StoreHostFunctionSlot(name, std::move(fn));
   reclaimable_host_fns_[name] = 0;  // live-closure count, incremented on each push
 }
 
@@ -1227,10 +3908,91 @@ bool LuaRuntime::EraseReclaimableIfUnpushed(const std::string& name) {
   auto it = reclaimable_host_fns_.find(name);
   if (it == reclaimable_host_fns_.end() || it->second != 0) return false;
   reclaimable_host_fns_.erase(it);
-  host_functions_.erase(name);
+  EraseHostFunctionSlot(name);
   return true;
 }
 
+// --- Host function slots ---
+
+void LuaRuntime::StoreHostFunctionSlot(const std::string& name, Function fn) {
+  auto& slot = host_functions_[name];
+  if (slot) {
+    // Assign in place so closures already bound to this slot pick up the new
+    // callable, matching the old by-name lookup's re-registration semantics.
+    slot->fn = std::move(fn);
+  } else {
+    slot = std::make_shared<HostFunctionSlot>(HostFunctionSlot{name, std::move(fn)});
+  }
+}
+
+void LuaRuntime::EraseHostFunctionSlot(const std::string& name) {
+  const auto it = host_functions_.find(name);
+  if (it == host_functions_.end()) return;
+  // Closures still holding the slot see an empty fn and take the by-name
+  // fallback, so they raise "not found" (or rebind to a later registration).
+  it->second->fn = nullptr;
+  host_functions_.erase(it);
+}
+
+std::shared_ptr<LuaRuntime::HostFunctionSlot>
+LuaRuntime::HostFunctionSlotFor(const std::string& name) const {
+  const auto it = host_functions_.find(name);
+  if (it != host_functions_.end()) return it->second;
+  return std::make_shared<HostFunctionSlot>(HostFunctionSlot{name, nullptr});
+}
+
+void LuaRuntime::RegisterHostFnSlotMetatable() {
+  luaL_newmetatable(L_, kHostFnSlotMeta);
+  lua_pushcfunction(L_, HostFnSlotGC);
+  lua_setfield(L_, -2, "__gc");
+  lua_pop(L_, 1);
+}
+
+void LuaRuntime::PushHostFunctionSlot(lua_State* L, const std::shared_ptr<HostFunctionSlot>& slot) {
+  // Construct an empty owner and attach __gc before any copy: if either raise-
+  // capable step fails, nothing is owned yet, and once the copy is in, the
+  // userdata's __gc releases it however the caller unwinds.
+  auto* owner = static_cast<std::shared_ptr<HostFunctionSlot>*>(
+      lua_newuserdatauv(L, sizeof(std::shared_ptr<HostFunctionSlot>), 0));
+  new (owner) std::shared_ptr<HostFunctionSlot>();
+  luaL_setmetatable(L, kHostFnSlotMeta);
+  *owner = slot;
+}
+
+void LuaRuntime::PushHostFunctionSlot(lua_State* L, const LuaRuntime* runtime, const std::string& name) {
+  auto* owner = static_cast<std::shared_ptr<HostFunctionSlot>*>(
+      lua_newuserdatauv(L, sizeof(std::shared_ptr<HostFunctionSlot>), 0));
+  new (owner) std::shared_ptr<HostFunctionSlot>();
+  luaL_setmetatable(L, kHostFnSlotMeta);
+  // Resolved only after the raise-capable steps, so the temporary never spans
+  // a longjmp. An unregistered name gets an unbound slot that resolves on its
+  // first call (RegisterFunction installs its closure before storing).
+  *owner = runtime ? runtime->HostFunctionSlotFor(name)
+                   : std::make_shared<HostFunctionSlot>(HostFunctionSlot{name, nullptr});
+}
+
+void LuaRuntime::RegisterFastFnSlotMetatable() {
+  luaL_newmetatable(L_, kFastFnSlotMeta);
+  lua_pushcfunction(L_, FastFnSlotGC);
+  lua_setfield(L_, -2, "__gc");
+  lua_pop(L_, 1);
+}
+
+int LuaRuntime::FastFnSlotGC(lua_State* L) {
+  // See HostFnSlotGC.
+  auto* owner = static_cast<std::shared_ptr<FastFunctionSlot>*>(lua_touserdata(L, 1));
+  if (owner) owner->reset();
+  return 0;
+}
+
+int LuaRuntime::HostFnSlotGC(lua_State* L) {
+  // reset() rather than the destructor: the owner stays a valid (empty)
+  // shared_ptr, so a repeated __gc is a no-op instead of a double release.
+  auto* owner = static_cast<std::shared_ptr<HostFunctionSlot>*>(lua_touserdata(L, 1));
+  if (owner) owner->reset();
+  return 0;
+}
+
 void LuaRuntime::SetHostFunctionGCCallback(HostFunctionGCCallback cb) {
   host_fn_gc_callback_ = std::move(cb);
 }
@@ -1240,6 +4002,28 @@ void LuaRuntime::RegisterHostFnSentinelMetatable() {
   lua_pushcfunction(L_, HostFnSentinelGC);
   lua_setfield(L_, -2, "__gc");
   lua_pop(L_, 1);
+
+  // The weak-valued name -> closure cache PushLuaValue consults for
+  // reclaimable names (see the HostFunctionName branch there).
+  lua_newtable(L_);
+  lua_newtable(L_);
+  lua_pushstring(L_, "v");
+  lua_setfield(L_, -2, "__mode");
+  lua_setmetatable(L_, -2);
+  lua_setfield(L_, LUA_REGISTRYINDEX, kHostFnClosureCacheKey);
+}
+
+bool LuaRuntime::PinReclaimableHostFunction(const std::string& name) {
+  auto it = reclaimable_host_fns_.find(name);
+  if (it == reclaimable_host_fns_.end() || it->second <= 0) return false;
+  ++it->second;
+  return true;
+}
+
+void LuaRuntime::UnpinReclaimableHostFunction(const std::string& name) {
+  // A pin is counted exactly like a live closure, so releasing it is that
+  // closure's collection: the last one out reclaims the entry.
+  OnHostFnClosureCollected(name);
 }
 
 // __gc for the sentinel userdata carried as a reclaimable closure's upvalue.
@@ -1265,7 +4049,7 @@ void LuaRuntime::OnHostFnClosureCollected(const std::string& name) {
   if (it == reclaimable_host_fns_.end()) return;
   if (--it->second <= 0) {
     reclaimable_host_fns_.erase(it);
-    host_functions_.erase(name);
+    EraseHostFunctionSlot(name);
     // Drop the binding's paired JS reference. Skip during a worker run — that
     // would be an off-thread N-API call; the entry is then reclaimed with the
     // context instead, matching the userdata GC callback's tradeoff.
@@ -1299,8 +4083,8 @@ void LuaRuntime::SetGlobalMetatable(const std::string& name, const std::vector<M
 
     for (const auto& entry : entries) {
       if (entry.is_function) {
-        // Push function name as upvalue, then create closure
-        lua_pushstring(L_, entry.func_name.c_str());
+        // Push the function's slot as upvalue, then create closure
+        PushHostFunctionSlot(L_, this, entry.func_name);
         lua_pushcclosure(L_, LuaCallHostFunction, 1);
       } else {
         PushLuaValue(L_, entry.value);
@@ -1330,7 +4114,7 @@ void LuaRuntime::SetTableRefMetatable(const int registry_ref,
 
     for (const auto& entry : entries) {
       if (entry.is_function) {
-        lua_pushstring(L_, entry.func_name.c_str());
+        PushHostFunctionSlot(L_, this, entry.func_name);
         lua_pushcclosure(L_, LuaCallHostFunction, 1);
       } else {
         PushLuaValue(L_, entry.value);
@@ -1409,8 +4193,8 @@ void LuaRuntime::RegisterModuleTable(const std::string& name,
 
     for (const auto& entry : entries) {
       if (entry.is_function) {
-        // Push function name as upvalue, then create closure
-        lua_pushstring(L_, entry.func_name.c_str());
+        // Push the function's slot as upvalue, then create closure
+        PushHostFunctionSlot(L_, this, entry.func_name);
         lua_pushcclosure(L_, LuaCallHostFunction, 1);
       } else {
         PushLuaValue(L_, entry.value);
@@ -1488,6 +4272,7 @@ int LuaRuntime::LuaPrint(lua_State* L) {
   lua_pop(L, 1);
 
   if (runtime && runtime->output_handler_ && !runtime->async_mode_) {
+    const NumericViewsCallout callout{runtime};
     runtime->output_handler_(out);
   } else {
     fwrite(out.data(), 1, out.size(), stdout);
@@ -1529,6 +4314,7 @@ int LuaRuntime::LuaIoWrite(lua_State* L) {
   lua_pop(L, 1);
 
   if (runtime && runtime->output_handler_ && !runtime->async_mode_) {
+    const NumericViewsCallout callout{runtime};
     runtime->output_handler_(out);
   } else {
     fwrite(out.data(), 1, out.size(), stdout);
@@ -1631,7 +4417,8 @@ int LuaRuntime::JsSearcher(lua_State* L) {
     try {
       std::vector<LuaPtr> args{
         std::make_shared<LuaValue>(LuaValue::from(std::string(modname)))};
-      result = it->second(args);
+      const NumericViewsCallout callout{runtime};
+      result = it->second->fn(args);
     } catch (const std::exception& e) {
       luaL_where(L, 1);
       lua_pushfstring(L, "searcher for '%s' failed: %s", modname, e.what());
@@ -1697,23 +4484,35 @@ int LuaRuntime::JsSearcher(lua_State* L) {
 // --- Host function bridge ---
 
 int LuaRuntime::LuaCallHostFunction(lua_State* L) {
-  const char* func_name = lua_tostring(L, lua_upvalueindex(1));
-
-  // Get runtime
-  lua_getfield(L, LUA_REGISTRYINDEX, kRuntimeRegistryKey);
-  auto* runtime = static_cast<LuaRuntime*>(lua_touserdata(L, -1));
-  lua_pop(L, 1);
+  // The runtime pointer sits in the state's extra space (shared by every
+  // thread), and upvalue 1 owns the function's slot, so the common path is two
+  // pointer loads — no registry read and no hash of the name per call.
+  auto* runtime = *static_cast<LuaRuntime**>(lua_getextraspace(L));
+  auto* owner = static_cast<std::shared_ptr<HostFunctionSlot>*>(
+      lua_touserdata(L, lua_upvalueindex(1)));
   if (!runtime) {
     lua_pushstring(L, "LuaRuntime not found in registry");
     return lua_error(L);
   }
-
-  const auto it = runtime->host_functions_.find(func_name ? func_name : "");
-  if (it == runtime->host_functions_.end()) {
-    lua_pushfstring(L, "Host function '%s' not found", func_name ? func_name : "");
+  if (!owner || !*owner) {
+    lua_pushstring(L, "Host function closure has no bound slot");
     return lua_error(L);
   }
 
+  HostFunctionSlot* slot = owner->get();
+  if (!slot->fn) {
+    // Erased (or bound before its name was stored): one by-name lookup, and
+    // rebind this closure if the name has been registered since.
+    const auto it = runtime->host_functions_.find(slot->name);
+    if (it == runtime->host_functions_.end()) {
+      lua_pushfstring(L, "Host function '%s' not found", slot->name.c_str());
+      return lua_error(L);
+    }
+    *owner = it->second;
+    slot = owner->get();
+  }
+  const char* func_name = slot->name.c_str();
+
   if (runtime->async_mode_) {
     return luaL_error(L,
       "JS callbacks are not available in async mode (called '%s')",
@@ -1739,7 +4538,8 @@ int LuaRuntime::LuaCallHostFunction(lua_State* L) {
       LuaPtr resultHolder;
       bool called = true;
       try {
-        resultHolder = it->second(args);
+        const NumericViewsCallout callout{runtime};
+        resultHolder = slot->fn(args);
       } catch (const std::exception& e) {
         // If the wrapper staged a structured error (a JS Error object), raise
         // that table so the original error can be reconstructed on the way out.
@@ -1794,15 +4594,121 @@ int LuaRuntime::LuaCallHostFunction(lua_State* L) {
         }
       }
     }
-  }  // all C++ locals destroyed here, before any longjmp below
+  }  // all C++ locals destroyed here, before any longjmp below
+
+  switch (outcome) {
+    case HostCallOutcome::Raise:
+      return lua_error(L);
+    case HostCallOutcome::Yield:
+      return lua_yieldk(L, 0, 0, AsyncContinuation);
+    case HostCallOutcome::Return1:
+      return 1;
+  }
+  return 0;  // unreachable
+}
+
+namespace {
+const char* FastScalarTypeName(FastScalarType type) {
+  switch (type) {
+    case FastScalarType::Number: return "number";
+    case FastScalarType::Integer: return "integer";
+    case FastScalarType::Boolean: return "boolean";
+    case FastScalarType::Void: return "void";
+  }
+  return "?";
+}
+}  // namespace
+
+// Trampoline for RegisterFastFunction closures. The arguments are checked and
+// read into a fixed stack buffer (trivial, so the argument-error longjmps below
+// skip nothing), the callable runs, and its scalar result is pushed directly —
+// no LuaValue is built on either side. Errors are staged the same way as in
+// LuaCallHostFunction; there is no await path, since a Promise is not a scalar.
+int LuaRuntime::LuaCallFastFunction(lua_State* L) {
+  auto* runtime = *static_cast<LuaRuntime**>(lua_getextraspace(L));
+  auto* owner = static_cast<std::shared_ptr<FastFunctionSlot>*>(
+      lua_touserdata(L, lua_upvalueindex(1)));
+  if (!runtime) {
+    lua_pushstring(L, "LuaRuntime not found in registry");
+    return lua_error(L);
+  }
+  if (!owner || !*owner) {
+    lua_pushstring(L, "Host function closure has no bound slot");
+    return lua_error(L);
+  }
+
+  FastFunctionSlot* slot = owner->get();
+  if (!slot->fn) {
+    // Replaced under its name by a later registration: rebind, as in
+    // LuaCallHostFunction.
+    const auto it = runtime->fast_functions_.find(slot->name);
+    if (it == runtime->fast_functions_.end()) {
+      lua_pushfstring(L, "Host function '%s' not found", slot->name.c_str());
+      return lua_error(L);
+    }
+    *owner = it->second;
+    slot = owner->get();
+  }
+  const char* func_name = slot->name.c_str();
+
+  if (runtime->async_mode_) {
+    return luaL_error(L,
+      "JS callbacks are not available in async mode (called '%s')", func_name);
+  }
+
+  const FastSignature& sig = slot->signature;
+  const int argc = lua_gettop(L);
+  if (argc != static_cast<int>(sig.args.size())) {
+    return luaL_error(L, "'%s' expects %d argument(s), got %d",
+                      func_name, static_cast<int>(sig.args.size()), argc);
+  }
+  FastScalar args[kMaxFastArgs];
+  for (int i = 0; i < argc; ++i) {
+    const int idx = i + 1;
+    const FastScalarType type = sig.args[i];
+    if (type == FastScalarType::Boolean) {
+      if (lua_type(L, idx) != LUA_TBOOLEAN) return luaL_typeerror(L, idx, "boolean");
+      args[i].boolean = lua_toboolean(L, idx) != 0;
+      continue;
+    }
+    // Strict: lua_tonumberx alone would also accept a numeric string.
+    if (lua_type(L, idx) != LUA_TNUMBER) return luaL_typeerror(L, idx, FastScalarTypeName(type));
+    if (type == FastScalarType::Integer) {
+      int isint = 0;
+      args[i].integer = static_cast<int64_t>(lua_tointegerx(L, idx, &isint));
+      if (!isint) return luaL_argerror(L, idx, "number has no integer representation");
+    } else {
+      args[i].number = static_cast<double>(lua_tonumber(L, idx));
+    }
+  }
+
+  bool raise = false;
+  FastScalar result{};
+  {
+    try {
+      const NumericViewsCallout callout{runtime};
+      result = slot->fn(args, static_cast<size_t>(argc));
+    } catch (const std::exception& e) {
+      // See LuaCallHostFunction: raise a staged structured JS error if any.
+      if (runtime->HasPendingErrorValue()) {
+        LuaPtr errVal = runtime->TakePendingErrorValue();
+        try { PushLuaValueProtected(L, errVal); } catch (...) { lua_pushstring(L, e.what()); }
+      } else {
+        lua_pushfstring(L, "Host function '%s' threw an exception: %s", func_name, e.what());
+      }
+      raise = true;
+    } catch (...) {
+      lua_pushfstring(L, "Host function '%s' threw an unknown exception", func_name);
+      raise = true;
+    }
+  }  // errVal destroyed here, before the longjmp below
+  if (raise) return lua_error(L);
 
-  switch (outcome) {
-    case HostCallOutcome::Raise:
-      return lua_error(L);
-    case HostCallOutcome::Yield:
-      return lua_yieldk(L, 0, 0, AsyncContinuation);
-    case HostCallOutcome::Return1:
-      return 1;
+  switch (sig.returns) {
+    case FastScalarType::Number: lua_pushnumber(L, static_cast<lua_Number>(result.number)); return 1;
+    case FastScalarType::Integer: lua_pushinteger(L, static_cast<lua_Integer>(result.integer)); return 1;
+    case FastScalarType::Boolean: lua_pushboolean(L, result.boolean ? 1 : 0); return 1;
+    case FastScalarType::Void: return 0;
   }
   return 0;  // unreachable
 }
@@ -1950,13 +4856,26 @@ int LuaRuntime::ProtectedThunkRunner(lua_State* L) {
 // raise) becomes a caught std::runtime_error rather than an unprotected panic
 // (M5). See the header for the stack-self-containment contract.
 void LuaRuntime::RunProtected(const std::function<void()>& op) const {
+  RunProtected(op, 0);
+}
+
+void LuaRuntime::RunProtected(const std::function<void()>& op, const int nargs) const {
+  // The trampoline's slot, reserved up front: lua_checkstack reports failure
+  // by return value instead of raising.
+  if (!lua_checkstack(L_, 1)) {
+    lua_pop(L_, nargs);
+    throw std::runtime_error("Lua stack overflow");
+  }
   ProtectedThunk thunk{&op, nullptr};
   ProtectedThunk* prev = active_thunk_;
   active_thunk_ = &thunk;
   // Light C function (0 upvalues) — Lua guarantees this push never raises a
   // memory error, so the protected frame is established before any allocation.
+  // A pcall frame cannot address the caller's stack slots, so the arguments
+  // enter it the way any call's do.
   lua_pushcfunction(L_, ProtectedThunkRunner);
-  const int status = lua_pcall(L_, 0, 0, 0);
+  lua_insert(L_, -(nargs + 1));
+  const int status = lua_pcall(L_, nargs, 0, 0);
   active_thunk_ = prev;
 
   // A C++ exception thrown by `op` was caught in the trampoline: rethrow it here,
@@ -2219,6 +5138,51 @@ ScriptResult LuaRuntime::ExecuteScript(const std::string& script) const {
   return results;
 }
 
+JsonScriptResult LuaRuntime::ExecuteScriptJson(const std::string& script,
+                                               const JsonEncodeOptions& options) const {
+  last_error_value_.reset();
+  const int stackBefore = lua_gettop(L_);
+
+  if (luaL_loadbuffer(L_, script.data(), script.size(), script.c_str()) != LUA_OK) {
+    std::string error = CaptureError(L_);
+    lua_pop(L_, 1);
+    return error;
+  }
+  if (ProtectedCall(0, LUA_MULTRET) != LUA_OK) {
+    std::string error = CaptureError(L_);
+    lua_pop(L_, 1);
+    return error;
+  }
+
+  const int nresults = lua_gettop(L_) - stackBefore;
+  JsonText json;
+  std::vector<const void*> open;  // the writer's cycle list, outside the frame
+  try {
+    // The results are the protected frame's arguments, 1..nresults: it cannot
+    // reach them in the caller's slots.
+    RunProtected([&]() {
+      JsonWriter writer(L_, options, json.text, open);
+      if (nresults == 0) {
+        json.text = "null";
+      } else if (nresults == 1) {
+        writer.Value(1, 0);
+      } else {
+        json.text += '[';
+        for (int i = 1; i <= nresults; ++i) {
+          if (i > 1) json.text += ',';
+          writer.Value(i, 0);
+        }
+        json.text += ']';
+      }
+    }, nresults);
+  } catch (const std::exception& e) {
+    lua_settop(L_, stackBefore);
+    return std::string(e.what());
+  }
+  lua_settop(L_, stackBefore);
+  return json;
+}
+
 ScriptResult LuaRuntime::ExecuteFile(const std::string& filepath) const {
   if (filepath.empty()) {
     return std::string("File path cannot be empty");
@@ -2274,17 +5238,63 @@ void LuaRuntime::RegisterFunction(const std::string& name, Function fn) {
   // Install _G[name] = <closure> inside a protected frame so BOTH a __newindex
   // metamethod on the globals table (M4) AND an OOM allocating the key string /
   // closure (M5) surface as a std::runtime_error instead of an unprotected panic.
+  // The slot is resolved (or created unbound) out here so the closure binds
+  // to it directly; this frame, not the protected one, owns the reference.
+  const auto slot = HostFunctionSlotFor(name);
   RunProtected([&]() {
     lua_rawgeti(L_, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);  // globals table
     lua_pushlstring(L_, name.data(), name.size());          // key (size-aware)
-    lua_pushstring(L_, name.c_str());                       // closure upvalue
+    PushHostFunctionSlot(L_, slot);                         // closure upvalue
     lua_pushcclosure(L_, LuaCallHostFunction, 1);           // value = closure
     lua_settable(L_, -3);                                   // _G[key]=closure (may __newindex)
     lua_pop(L_, 1);                                         // pop globals table
   });
   // Stored only after the protected _G write succeeds, so a raising __newindex
-  // doesn't leave an entry with no global pointing at it (N5).
-  host_functions_[name] = std::move(fn);
+  // doesn't leave an entry with no global pointing at it (N5). A fast function
+  // registered under the name is replaced: its closures rebind by name, miss,
+  // and raise "not found" instead of calling the superseded callable.
+  slot->fn = std::move(fn);
+  host_functions_[name] = slot;
+  if (const auto it = fast_functions_.find(name); it != fast_functions_.end()) {
+    it->second->fn = nullptr;
+    fast_functions_.erase(it);
+  }
+}
+
+void LuaRuntime::RegisterFastFunction(const std::string& name, FastSignature signature,
+                                      FastFunction fn) {
+  if (signature.args.size() > kMaxFastArgs) {
+    throw std::invalid_argument("fast function '" + name + "' declares more than " +
+                                std::to_string(kMaxFastArgs) + " parameters");
+  }
+  for (const auto type : signature.args) {
+    if (type == FastScalarType::Void) {
+      throw std::invalid_argument("fast function '" + name + "' has a void parameter");
+    }
+  }
+  // Same shape and N5 ordering as RegisterFunction, over fast_functions_. A
+  // fresh slot replaces any earlier one (whose signature may differ); closures
+  // still bound to the old slot see it cleared and rebind by name.
+  auto slot = std::make_shared<FastFunctionSlot>(
+      FastFunctionSlot{name, std::move(signature), nullptr});
+  RunProtected([&]() {
+    lua_rawgeti(L_, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+    lua_pushlstring(L_, name.data(), name.size());
+    auto* owner = static_cast<std::shared_ptr<FastFunctionSlot>*>(
+        lua_newuserdatauv(L_, sizeof(std::shared_ptr<FastFunctionSlot>), 0));
+    new (owner) std::shared_ptr<FastFunctionSlot>();
+    luaL_setmetatable(L_, kFastFnSlotMeta);
+    *owner = slot;
+    lua_pushcclosure(L_, LuaCallFastFunction, 1);
+    lua_settable(L_, -3);
+    lua_pop(L_, 1);
+  });
+  slot->fn = std::move(fn);
+  auto& entry = fast_functions_[name];
+  if (entry) entry->fn = nullptr;
+  entry = std::move(slot);
+  // Likewise for a plain host function of the same name.
+  EraseHostFunctionSlot(name);
 }
 
 // Trampoline for PushProtectedGlobal: [] -> [value]. Light C function (0
@@ -2334,6 +5344,44 @@ LuaPtr LuaRuntime::GetGlobal(const std::string& name) const {
 }
 
 void LuaRuntime::SetGlobalPath(const std::vector<std::string>& path, const LuaPtr& value) const {
+  AssignGlobalPath(path, [&]() { PushLuaValue(L_, value); });
+}
+
+void LuaRuntime::SetGlobalJson(const std::vector<std::string>& path, const std::string_view json) const {
+  AssignGlobalPath(path, [&]() { PushJsonDocument(L_, json.data(), json.size()); });
+}
+
+void LuaRuntime::SetGlobalSharedData(const std::vector<std::string>& path,
+                                     std::shared_ptr<SharedDataSlot> slot) const {
+  // The slot is attached after the view is allocated (NewSharedDataBlock), and
+  // `slot` is a parameter, not a lambda local, so a raise skips no owner.
+  AssignGlobalPath(path, [&]() { NewSharedDataBlock(L_)->slot = slot; });
+}
+
+void LuaRuntime::SetGlobalLazyTable(const std::vector<std::string>& path,
+                                    std::shared_ptr<const LazyTableSource> source) const {
+  AssignGlobalPath(path, [&]() {
+    lua_newtable(L_);                         // [proxy]
+    lua_createtable(L_, 0, 4);                // [proxy, mt]
+    NewLazyTableBlock(L_)->source = source;   // [proxy, mt, block]
+    static constexpr std::pair<const char*, lua_CFunction> kMethods[] = {
+      {"__index", LazyTableIndex},
+      {"__newindex", LazyTableNewIndex},
+      {"__pairs", LazyTablePairs},
+      {"__len", LazyTableLen},
+    };
+    for (const auto& [name, fn] : kMethods) {
+      lua_pushvalue(L_, -1);
+      lua_pushcclosure(L_, fn, 1);
+      lua_setfield(L_, -3, name);
+    }
+    lua_pop(L_, 1);
+    lua_setmetatable(L_, -2);
+  });
+}
+
+void LuaRuntime::AssignGlobalPath(const std::vector<std::string>& path,
+                                  const std::function<void()>& push_value) const {
   // One protected frame covers the whole traversal: an __index/__newindex
   // metamethod raise, an OOM building a key/table/value, or an attempt to index
   // a non-table intermediate all surface as a std::runtime_error. StackGuard
@@ -2375,7 +5423,7 @@ void LuaRuntime::SetGlobalPath(const std::vector<std::string>& path, const LuaPt
     // Assign the leaf: container[last] = value.
     const std::string& last = path.back();
     lua_pushlstring(L_, last.data(), last.size());  // key
-    PushLuaValue(L_, value);                         // value (may allocate / recurse)
+    push_value();                                    // value (may allocate / recurse)
     lua_settable(L_, -3);                            // fires __newindex
   });
 }
@@ -2484,12 +5532,15 @@ LuaPtr LuaRuntime::ToLuaValue(lua_State* L, const int index, const int depth) {
     }
     case LUA_TTABLE: {
       StackGuard guard(L);
+      // A lazy shared table's proxy is empty: convert what it stands for.
+      if (PushLazyTableContents(L, abs_index)) return ToLuaValue(L, -1, depth);
       // Metatabled tables are kept as registry references to preserve metamethods
       if (lua_getmetatable(L, abs_index)) {
         lua_pop(L, 1);  // pop metatable
         lua_pushvalue(L, abs_index);
         int ref = luaL_ref(L, LUA_REGISTRYINDEX);
-        return std::make_shared<LuaValue>(LuaValue::from(LuaTableRef(ref, L)));
+        return std::make_shared<LuaValue>(
+          LuaValue::from(LuaTableRef(ref, L, lua_topointer(L, abs_index))));
       }
       // Plain tables (no metatable) are deep-copied as before
       if (isSequentialArray(L, abs_index)) {
@@ -2528,15 +5579,47 @@ LuaPtr LuaRuntime::ToLuaValue(lua_State* L, const int index, const int depth) {
     case LUA_TFUNCTION: {
       lua_pushvalue(L, abs_index);
       const int ref = luaL_ref(L, LUA_REGISTRYINDEX);
-      return std::make_shared<LuaValue>(LuaValue::from(LuaFunctionRef(ref, L)));
+      return std::make_shared<LuaValue>(
+        LuaValue::from(LuaFunctionRef(ref, L, lua_topointer(L, abs_index))));
     }
     case LUA_TTHREAD: {
       lua_State* thread = lua_tothread(L, abs_index);
+      // A thread seen on a Lua stack is reachable from Lua: keep it out of the
+      // coroutine pool (see SetCoroutinePoolSize).
+      if (auto* runtime = *static_cast<LuaRuntime**>(lua_getextraspace(L))) {
+        runtime->MarkThreadEscaped(thread);
+      }
       lua_pushvalue(L, abs_index);
       const int ref = luaL_ref(L, LUA_REGISTRYINDEX);
       return std::make_shared<LuaValue>(LuaValue::from(LuaThreadRef(ref, L, thread)));
     }
     case LUA_TUSERDATA: {
+      // A numeric array view goes back out as the JS-created userdata it came
+      // from, view attached, so the binding returns the original TypedArray.
+      if (const auto* block = static_cast<NumericArrayBlock*>(
+              luaL_testudata(L, abs_index, kNumericArrayMetaName))) {
+        // A vector library array has no JS object behind it: copy it out as a
+        // plain array of numbers.
+        if (block->ref_id == 0) {
+          LuaArray arr;
+          arr.reserve(block->view.length);
+          for (size_t i = 0; i < block->view.length; ++i) {
+            PushNumericElement(L, block->view, i);
+            arr.push_back(ToLuaValue(L, -1, depth + 1));
+            lua_pop(L, 1);
+          }
+          return std::make_shared<LuaValue>(LuaValue::from(std::move(arr)));
+        }
+        LuaUserdataRef ref(block->ref_id, L);
+        ref.numeric = block->view;
+        return std::make_shared<LuaValue>(LuaValue::from(std::move(ref)));
+      }
+      if (auto* block = static_cast<SharedDataBlock*>(
+              luaL_testudata(L, abs_index, kSharedDataMetaName))) {
+        const SharedData* data = SharedDataOf(block);
+        if (!data) return std::make_shared<LuaValue>(LuaValue::nil());
+        return SharedDataToValue(*data, block->node, depth);
+      }
       // Check if it's our proxy userdata (property-access-enabled)
       if (luaL_testudata(L, abs_index, kProxyUserdataMetaName)) {
         auto* block = static_cast<int*>(lua_touserdata(L, abs_index));
@@ -2624,24 +5707,55 @@ void LuaRuntime::PushLuaValue(lua_State* L, const LuaPtr& value, const int depth
             PushLuaValue(L, val, depth + 1);
             lua_settable(L, -3);
           }
+        } else if constexpr (std::is_same_v<T, LuaThreadRef>) {
+          // Once Lua holds the thread it can outlive the handle; it must not be
+          // recycled when the handle is dropped (see SetCoroutinePoolSize).
+          if (auto* runtime = *static_cast<LuaRuntime**>(lua_getextraspace(L))) {
+            runtime->MarkThreadEscaped(v.thread);
+          }
+          lua_rawgeti(L, LUA_REGISTRYINDEX, v.ref);
         } else if constexpr (std::is_same_v<T, LuaFunctionRef> ||
-                             std::is_same_v<T, LuaThreadRef> ||
                              std::is_same_v<T, LuaTableRef>) {
           lua_rawgeti(L, LUA_REGISTRYINDEX, v.ref);
         } else if constexpr (std::is_same_v<T, LuaUserdataRef>) {
           if (v.opaque) {
             // Lua-created userdata - push from registry
             lua_rawgeti(L, LUA_REGISTRYINDEX, v.registry_ref);
+          } else if (v.numeric) {
+            // Numeric array view: a block carrying the view itself, so the
+            // metamethods reach the memory without a trip to the binding.
+            auto* block = static_cast<NumericArrayBlock*>(
+                lua_newuserdatauv(L, sizeof(NumericArrayBlock), 0));
+            block->ref_id = v.ref_id;
+            block->view = *v.numeric;
+            block->epoch = 0;  // resolved again on first use
+            luaL_setmetatable(L, kNumericArrayMetaName);
+            if (auto* runtime = *static_cast<LuaRuntime**>(lua_getextraspace(L))) {
+              runtime->IncrementUserdataRefCount(v.ref_id);
+            }
           } else {
             // JS-created userdata - create a new userdata block with same ref_id
-            auto* block = static_cast<int*>(lua_newuserdata(L, sizeof(int)));
-            *block = v.ref_id;
-            if (!v.class_name.empty()) {
-              // Class instance - use the per-class metatable
+            if (v.proxy && v.class_name.empty()) {
+              NewProxyUserdata(L, v.ref_id);
+            } else if (ClassInstanceFields* fields = FieldsForPush(L, v.ref_id, v.class_name)) {
+              // Class with native fields: the block points at the instance's
+              // record, shared with any other block of the same instance.
+              auto* block = static_cast<ClassFieldBlock*>(
+                  lua_newuserdatauv(L, sizeof(ClassFieldBlock), 0));
+              block->ref_id = v.ref_id;
+              block->fields = fields;
               const std::string mt_name = kClassMetaPrefix + v.class_name;
               luaL_setmetatable(L, mt_name.c_str());
             } else {
-              luaL_setmetatable(L, v.proxy ? kProxyUserdataMetaName : kUserdataMetaName);
+              auto* block = static_cast<int*>(lua_newuserdata(L, sizeof(int)));
+              *block = v.ref_id;
+              if (!v.class_name.empty()) {
+                // Class instance - use the per-class metatable
+                const std::string mt_name = kClassMetaPrefix + v.class_name;
+                luaL_setmetatable(L, mt_name.c_str());
+              } else {
+                luaL_setmetatable(L, kUserdataMetaName);
+              }
             }
             // Increment ref count so __gc balances correctly
             lua_getfield(L, LUA_REGISTRYINDEX, kRuntimeRegistryKey);
@@ -2651,47 +5765,64 @@ void LuaRuntime::PushLuaValue(lua_State* L, const LuaPtr& value, const int depth
           }
         } else if constexpr (std::is_same_v<T, HostFunctionName>) {
           // Materialize a registered host function as a Lua closure (upvalue 1 =
-          // the host function name), the same shape RegisterFunction installs.
-          lua_pushlstring(L, v.name.c_str(), v.name.size());
+          // the host function's slot), the same shape RegisterFunction installs.
+          auto* rt = *static_cast<LuaRuntime**>(lua_getextraspace(L));
+          const bool reclaimable = rt && rt->reclaimable_host_fns_.count(v.name);
+          if (reclaimable) {
+            // One closure per name while it lives: a JS callback the binding
+            // deduplicated arrives here under the name it already has, and gets
+            // that name's existing closure back from the weak-valued cache —
+            // no new sentinel, so the live count is untouched. A weak entry is
+            // cleared only once its closure is dead, after which a fresh one is
+            // built below and counted as usual.
+            lua_getfield(L, LUA_REGISTRYINDEX, kHostFnClosureCacheKey);  // [cache]
+            lua_pushlstring(L, v.name.data(), v.name.size());
+            if (lua_rawget(L, -2) == LUA_TFUNCTION) {                  // [cache, closure]
+              lua_remove(L, -2);
+              return;
+            }
+            lua_pop(L, 1);                                               // [cache]
+          }
+          PushHostFunctionSlot(L, rt, v.name);
           // If the name is reclaimable (an anonymous nested callback), attach a
           // sentinel userdata as upvalue 2 whose __gc reclaims the registry
           // entry once this closure is collected, and bump the live-closure
           // count. LuaCallHostFunction only reads upvalue 1, so the extra
           // upvalue is inert to the call path (M2).
-          bool reclaimable = false;
-          lua_getfield(L, LUA_REGISTRYINDEX, kRuntimeRegistryKey);
-          if (auto* rt = static_cast<LuaRuntime*>(lua_touserdata(L, -1))) {
-            lua_pop(L, 1);
-            if (rt->reclaimable_host_fns_.count(v.name)) {
-              reclaimable = true;
-              // Build the sentinel fully before touching the live count: if
-              // either allocation below raises LUA_ERRMEM, no accounting has
-              // happened, so no phantom +1 can strand the entry (N1). The slot
-              // stays null (its __gc no-ops) until the count owns a decrement.
-              auto** slot = static_cast<std::string**>(
-                  lua_newuserdatauv(L, sizeof(std::string*), 0));
-              *slot = nullptr;
-              luaL_setmetatable(L, kHostFnSentinelMeta);
-              // Re-find after the raise-capable allocations: a GC step inside
-              // them can collect this name's last live closure and erase the
-              // entry (the count is not pinned yet). If that happened, the
-              // host function is gone — leave the sentinel inert; the closure
-              // raises the missing-function error if it is ever called.
-              auto it = rt->reclaimable_host_fns_.find(v.name);
-              if (it != rt->reclaimable_host_fns_.end()) {
-                // Arm, then count: a bad_alloc from the string copy leaves the
-                // slot null and the count untouched (still balanced), and once
-                // armed the increment cannot fail. If the closure push below
-                // raises, the unwound sentinel's __gc performs the matching
-                // decrement.
-                *slot = new std::string(v.name);
-                ++it->second;
-              }
+          if (reclaimable) {
+            // Build the sentinel fully before touching the live count: if
+            // either allocation below raises LUA_ERRMEM, no accounting has
+            // happened, so no phantom +1 can strand the entry (N1). The slot
+            // stays null (its __gc no-ops) until the count owns a decrement.
+            auto** slot = static_cast<std::string**>(
+                lua_newuserdatauv(L, sizeof(std::string*), 0));
+            *slot = nullptr;
+            luaL_setmetatable(L, kHostFnSentinelMeta);
+            // Re-find after the raise-capable allocations: a GC step inside
+            // them can collect this name's last live closure and erase the
+            // entry (the count is not pinned yet). If that happened, the
+            // host function is gone — leave the sentinel inert; the closure
+            // raises the missing-function error if it is ever called.
+            auto it = rt->reclaimable_host_fns_.find(v.name);
+            if (it != rt->reclaimable_host_fns_.end()) {
+              // Arm, then count: a bad_alloc from the string copy leaves the
+              // slot null and the count untouched (still balanced), and once
+              // armed the increment cannot fail. If the closure push below
+              // raises, the unwound sentinel's __gc performs the matching
+              // decrement.
+              *slot = new std::string(v.name);
+              ++it->second;
             }
-          } else {
-            lua_pop(L, 1);
           }
           lua_pushcclosure(L, LuaCallHostFunction, reclaimable ? 2 : 1);
+          if (reclaimable) {
+            // [cache, closure]. The closure is already counted; if this rawset
+            // raises, its sentinel's __gc still balances the count.
+            lua_pushlstring(L, v.name.data(), v.name.size());
+            lua_pushvalue(L, -2);
+            lua_rawset(L, -4);
+            lua_remove(L, -2);
+          }
         }
       },
       value->value);
@@ -2775,6 +5906,38 @@ bool LuaRuntime::HasTableFieldKeyed(int registry_ref, const TableKey& key) const
   return present;
 }
 
+std::vector<LuaPtr> LuaRuntime::GetTableFieldsKeyed(
+    int registry_ref, const std::vector<TableKey>& keys) const {
+  // Reserved up front so the thunk's push_backs never reallocate; like the
+  // single-field getters, the result lives outside the protected frame.
+  std::vector<LuaPtr> results;
+  results.reserve(keys.size());
+  RunProtected([&]() {
+    StackGuard guard(L_);
+    lua_rawgeti(L_, LUA_REGISTRYINDEX, registry_ref);  // table
+    for (const auto& key : keys) {
+      PushTableKey(L_, key);                           // table, key
+      lua_gettable(L_, -2);                            // may trigger __index
+      results.push_back(ToLuaValue(L_, -1));
+      lua_pop(L_, 1);                                  // table
+    }
+  });
+  return results;
+}
+
+void LuaRuntime::SetTableFieldsKeyed(
+    int registry_ref, const std::vector<std::pair<TableKey, LuaPtr>>& entries) const {
+  RunProtected([&]() {
+    StackGuard guard(L_);
+    lua_rawgeti(L_, LUA_REGISTRYINDEX, registry_ref);  // table
+    for (const auto& [key, value] : entries) {
+      PushTableKey(L_, key);                           // table, key
+      PushLuaValue(L_, value);                         // table, key, value
+      lua_settable(L_, -3);                            // may trigger __newindex
+    }
+  });
+}
+
 std::vector<std::string> LuaRuntime::GetTableKeys(int registry_ref) const {
   // Protected because stringifying a *number* key allocates the resulting Lua
   // string (M5); traversal itself is raw and fires no metamethod. `keys` is
@@ -2946,18 +6109,8 @@ std::vector<std::pair<LuaPtr, LuaPtr>> LuaRuntime::TablePairs(const int registry
   // before converting the value, so nothing is converted needlessly.
   lua_pushnil(L_);
   while (lua_next(L_, -2) != 0) {
-    LuaPtr key;
-    if (const int key_type = lua_type(L_, -2); key_type == LUA_TSTRING) {
-      size_t len;
-      const char* str = lua_tolstring(L_, -2, &len);
-      key = std::make_shared<LuaValue>(LuaValue::from(std::string(str, len)));
-    } else if (key_type == LUA_TNUMBER) {
-      if (lua_isinteger(L_, -2)) {
-        key = std::make_shared<LuaValue>(LuaValue::from(static_cast<int64_t>(lua_tointeger(L_, -2))));
-      } else {
-        key = std::make_shared<LuaValue>(LuaValue::from(static_cast<double>(lua_tonumber(L_, -2))));
-      }
-    } else {
+    LuaPtr key = PairsKeyToLuaValue(L_, -2);
+    if (!key) {
       // Skip non-string/non-number keys
       lua_pop(L_, 1);
       continue;
@@ -2970,6 +6123,112 @@ std::vector<std::pair<LuaPtr, LuaPtr>> LuaRuntime::TablePairs(const int registry
   return result;
 }
 
+std::vector<std::pair<LuaPtr, LuaPtr>> LuaRuntime::NextTableEntries(
+    LuaTableCursor& cursor, const size_t max) const {
+  std::vector<std::pair<LuaPtr, LuaPtr>> batch;
+  if (cursor.done || max == 0) return batch;
+  if (cursor.table.ref == LUA_NOREF) {
+    cursor.done = true;
+    return batch;
+  }
+  batch.reserve(max);
+  // Set inside the frame only when the first batch anchors its keys, so the
+  // owners can be minted out here where a bad_alloc cannot skip a longjmp.
+  int new_key_ref = LUA_NOREF;
+  int new_next_ref = LUA_NOREF;
+  bool ended = false;
+  bool moved = false;
+  try {
+    // Protected: lua_next raises on a key the table no longer holds, and
+    // anchoring the keys (luaL_ref) allocates. lua_next itself is raw
+    // traversal, so no metamethod runs.
+    RunProtected([&]() {
+      StackGuard guard(L_);
+      lua_rawgeti(L_, LUA_REGISTRYINDEX, cursor.table.ref);  // table
+      if (!lua_istable(L_, -1)) {
+        ended = true;
+        return;
+      }
+      const int t = lua_gettop(L_);
+      if (cursor.key_ref_ == LUA_NOREF) {
+        lua_pushnil(L_);
+      } else {
+        lua_rawgeti(L_, LUA_REGISTRYINDEX, cursor.key_ref_);  // table, key
+      }
+      if (cursor.next_ref_ != LUA_NOREF) {
+        // Batch boundary: the saved key must still lead to the key that
+        // followed it last time. The one legal way for it not to is that key
+        // having been cleared; anything else means the table was rebuilt or
+        // grew around the walk, and resuming would skip or repeat entries.
+        lua_pushvalue(L_, -1);                                // table, key, key
+        if (lua_next(L_, t) != 0) {
+          lua_pop(L_, 1);                                     // table, key, k
+        } else {
+          lua_pushnil(L_);                                    // table, key, nil
+        }
+        lua_rawgeti(L_, LUA_REGISTRYINDEX, cursor.next_ref_); // ..., k, expected
+        if (!lua_rawequal(L_, -1, -2) && lua_rawget(L_, t) != LUA_TNIL) {
+          moved = true;
+          return;
+        }
+        lua_settop(L_, t + 1);                                // table, key
+      }
+      while (batch.size() < max) {
+        if (lua_next(L_, -2) == 0) {                          // table
+          ended = true;
+          return;
+        }
+        if (LuaPtr key = PairsKeyToLuaValue(L_, -2)) {        // table, key, value
+          batch.emplace_back(std::move(key), ToLuaValue(L_, -1));
+        }
+        lua_pop(L_, 1);                                       // table, key
+      }
+      // Peek at the key that follows, for the next batch's boundary check. A
+      // walk with nothing left ends here rather than on an empty batch.
+      lua_pushvalue(L_, -1);                                  // table, key, key
+      if (lua_next(L_, t) == 0) {                             // table, key
+        ended = true;
+        return;
+      }
+      lua_pop(L_, 1);                                         // table, key, next
+      // Anchor both keys: overwrite the existing slots in place, or take them
+      // on the first batch. Each pops its key.
+      if (cursor.next_ref_ == LUA_NOREF) {
+        new_next_ref = luaL_ref(L_, LUA_REGISTRYINDEX);
+      } else {
+        lua_rawseti(L_, LUA_REGISTRYINDEX, cursor.next_ref_);
+      }
+      if (cursor.key_ref_ == LUA_NOREF) {
+        new_key_ref = luaL_ref(L_, LUA_REGISTRYINDEX);
+      } else {
+        lua_rawseti(L_, LUA_REGISTRYINDEX, cursor.key_ref_);
+      }
+    });
+  } catch (const std::runtime_error& e) {
+    // The second luaL_ref raising would strand the first slot.
+    if (new_next_ref != LUA_NOREF) luaL_unref(L_, LUA_REGISTRYINDEX, new_next_ref);
+    cursor.close();
+    if (std::string(e.what()).find("invalid key to 'next'") != std::string::npos) {
+      throw std::runtime_error("table was modified during iteration");
+    }
+    throw;
+  }
+  if (moved) {
+    cursor.close();
+    throw std::runtime_error("table was modified during iteration");
+  }
+  if (new_next_ref != LUA_NOREF) {
+    cursor.next_ref_ = new_next_ref;
+    cursor.next_owner_ = detail::MakeRegistryOwner(L_, new_next_ref);
+  }
+  if (new_key_ref != LUA_NOREF) {
+    cursor.key_ref_ = new_key_ref;
+    cursor.key_owner_ = detail::MakeRegistryOwner(L_, new_key_ref);
+  }
+  if (ended) cursor.close();
+  return batch;
+}
+
 std::vector<std::pair<int64_t, LuaPtr>> LuaRuntime::TableIPairs(int registry_ref) const {
   StackGuard guard(L_);
   std::vector<std::pair<int64_t, LuaPtr>> result;
@@ -3039,6 +6298,243 @@ int LuaRuntime::CreateEnvironment(const std::vector<std::string>& whitelist,
   return ref;
 }
 
+int LuaRuntime::CreateEnvironmentTemplate(const std::vector<std::string>& whitelist,
+                                          const bool inherit) const {
+  // Same protected-build reasoning as CreateEnvironment (M4 / M5); this is the
+  // only point where the whitelist is looked up.
+  int ref = LUA_NOREF;
+  RunProtected([&]() {
+    lua_createtable(L_, 0, 2);                                   // [mt]
+    lua_createtable(L_, 0, static_cast<int>(whitelist.size()));  // [mt, base]
+    lua_rawgeti(L_, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);        // [mt, base, _G]
+
+    for (const auto& name : whitelist) {
+      lua_pushlstring(L_, name.data(), name.size());  // [mt, base, _G, key]
+      lua_pushvalue(L_, -1);
+      lua_gettable(L_, -3);                           // [mt, base, _G, key, _G[key]]
+      lua_rawset(L_, -4);                             // base[key] = value
+    }
+
+    if (inherit) {
+      lua_createtable(L_, 0, 1);      // [mt, base, _G, base_mt]
+      lua_pushvalue(L_, -2);
+      lua_setfield(L_, -2, "__index");
+      lua_setmetatable(L_, -3);       // setmetatable(base, base_mt)
+    }
+    lua_pop(L_, 1);                   // [mt, base]
+
+    lua_setfield(L_, -2, "__index");  // mt.__index = base
+    lua_pushboolean(L_, 0);
+    lua_setfield(L_, -2, "__metatable");
+    ref = luaL_ref(L_, LUA_REGISTRYINDEX);  // pops mt
+  });
+  return ref;
+}
+
+int LuaRuntime::InstantiateEnvironment(const int template_ref) const {
+  int ref = LUA_NOREF;
+  RunProtected([&]() {
+    lua_createtable(L_, 0, 0);                         // [env]
+    lua_rawgeti(L_, LUA_REGISTRYINDEX, template_ref);  // [env, mt]
+    if (!lua_istable(L_, -1)) {
+      lua_pop(L_, 2);
+      return;
+    }
+    lua_setmetatable(L_, -2);                  // [env]
+    ref = luaL_ref(L_, LUA_REGISTRYINDEX);     // pops env
+  });
+  if (ref == LUA_NOREF) throw std::runtime_error("invalid environment template");
+  return ref;
+}
+
+bool LuaRuntime::ClearEnvironment(const int env_ref, const int template_ref) const {
+  bool cleared = false;
+  RunProtected([&]() {
+    lua_rawgeti(L_, LUA_REGISTRYINDEX, env_ref);  // [env]
+    const int env = lua_gettop(L_);
+    // Raw metatable read: __metatable only hides it from scripts.
+    if (!lua_istable(L_, env) || !lua_getmetatable(L_, env)) {
+      lua_settop(L_, env - 1);
+      return;
+    }
+    lua_rawgeti(L_, LUA_REGISTRYINDEX, template_ref);  // [env, mt, template mt]
+    const bool ours = lua_rawequal(L_, -1, -2);
+    lua_pop(L_, 2);                                    // [env]
+    if (ours) {
+      // Assigning nil to a field that already exists is allowed mid-traversal
+      // and never allocates.
+      lua_pushnil(L_);                      // [env, nil]
+      while (lua_next(L_, env) != 0) {      // [env, key, value]
+        lua_pop(L_, 1);                     // [env, key]
+        lua_pushvalue(L_, -1);              // [env, key, key]
+        lua_pushnil(L_);                    // [env, key, key, nil]
+        lua_rawset(L_, env);                // env[key] = nil -> [env, key]
+      }
+      // The next tenant starts without an account. Blocks still charged to
+      // this one are credited back to it as they are freed.
+      lua_rawgeti(L_, LUA_REGISTRYINDEX, env_accounts_ref_);  // [env, accounts]
+      lua_pushvalue(L_, env);
+      lua_rawget(L_, -2);                   // [env, accounts, token]
+      if (auto* id = static_cast<uint32_t*>(lua_touserdata(L_, -1)); id && *id != 0) {
+        ReleaseEnvironmentAccount(*id);
+        *id = 0;                            // its __gc now has nothing to do
+        lua_pushvalue(L_, env);
+        lua_pushnil(L_);
+        lua_rawset(L_, -4);                 // accounts[env] = nil
+      }
+      lua_pop(L_, 2);                       // [env]
+      cleared = true;
+    }
+    lua_pop(L_, 1);                         // pop env
+  });
+  return cleared;
+}
+
+// --- Environment accounts ---
+
+// Makes an environment's account the active one for the life of a run, and
+// restores the enclosing run's account and tally after, so a host callback
+// that runs another environment nests rather than clobbering it. The run is
+// counted only by Admit(), once the chunk is about to be called: a compile
+// error or a rejected argument charges its allocations but is not a run.
+class LuaRuntime::EnvironmentRun {
+ public:
+  EnvironmentRun(const LuaRuntime& runtime, const int env_ref)
+      : runtime_(runtime),
+        id_(runtime.FindEnvironmentAccount(env_ref)),
+        saved_account_(runtime.allocator_.active),
+        saved_instructions_(runtime.env_run_instructions_) {
+    runtime.allocator_.active = id_;
+    runtime.env_run_instructions_ = 0;
+  }
+  ~EnvironmentRun() {
+    runtime_.allocator_.active = saved_account_;
+    runtime_.env_run_instructions_ = saved_instructions_;
+  }
+  EnvironmentRun(const EnvironmentRun&) = delete;
+  EnvironmentRun& operator=(const EnvironmentRun&) = delete;
+
+  void Admit() const {
+    if (id_ != 0) ++runtime_.allocator_.accounts[id_].runs;
+  }
+
+ private:
+  const LuaRuntime& runtime_;
+  uint32_t id_;
+  uint32_t saved_account_;
+  size_t saved_instructions_;
+};
+
+// Raw reads of a table that already exists: nothing here allocates, so it is
+// safe outside a protected frame. Returns 0 when `env_ref` has no account.
+uint32_t LuaRuntime::FindEnvironmentAccount(const int env_ref) const {
+  if (allocator_.accounts.size() <= 1) return 0;  // none ever opened
+  lua_rawgeti(L_, LUA_REGISTRYINDEX, env_accounts_ref_);  // [accounts]
+  lua_rawgeti(L_, LUA_REGISTRYINDEX, env_ref);            // [accounts, env]
+  uint32_t id = 0;
+  if (lua_istable(L_, -1)) {
+    lua_rawget(L_, -2);                                   // [accounts, token]
+    if (const auto* token = static_cast<const uint32_t*>(lua_touserdata(L_, -1))) {
+      id = *token;
+    }
+  }
+  lua_pop(L_, 2);
+  return id;
+}
+
+void LuaRuntime::ReleaseEnvironmentAccount(const uint32_t id) const {
+  EnvironmentAccount& acct = allocator_.accounts[id];
+  if (!acct.live) return;
+  acct.live = false;
+  // With blocks still charged, the allocator frees the id when the last goes.
+  if (acct.memory == 0) {
+    acct.next_free = allocator_.free_head;
+    allocator_.free_head = id;
+  }
+}
+
+// __gc for an account token: its environment has been collected.
+int LuaRuntime::EnvironmentAccountGC(lua_State* L) {
+  auto* id = static_cast<uint32_t*>(lua_touserdata(L, 1));
+  if (!id || *id == 0) return 0;
+  lua_getfield(L, LUA_REGISTRYINDEX, kRuntimeRegistryKey);
+  const auto* runtime = static_cast<LuaRuntime*>(lua_touserdata(L, -1));
+  lua_pop(L, 1);
+  if (runtime) runtime->ReleaseEnvironmentAccount(*id);
+  *id = 0;
+  return 0;
+}
+
+void LuaRuntime::SetEnvironmentLimits(const int env_ref, const EnvironmentLimits& limits) {
+  if (limits.max_memory > 0 && !allocator_.tagged) {
+    throw std::runtime_error(
+        "per-environment memory limits require environment accounting to be enabled");
+  }
+
+  uint32_t id = FindEnvironmentAccount(env_ref);
+  if (id == 0) {
+    // Take a released id whose blocks are all gone, or a new one. Reserved in
+    // the vector before any Lua allocation, so the allocator never sees the
+    // vector grow under it.
+    if (allocator_.free_head != 0) {
+      id = allocator_.free_head;
+      allocator_.free_head = allocator_.accounts[id].next_free;
+    } else {
+      allocator_.accounts.emplace_back();
+      id = static_cast<uint32_t>(allocator_.accounts.size() - 1);
+    }
+    allocator_.accounts[id] = EnvironmentAccount{};
+    // An id that never went live goes straight back on the free list.
+    auto unclaim = [this, id]() {
+      allocator_.accounts[id].next_free = allocator_.free_head;
+      allocator_.free_head = id;
+    };
+
+    bool is_table = false;
+    try {
+      RunProtected([&]() {
+        lua_rawgeti(L_, LUA_REGISTRYINDEX, env_accounts_ref_);  // [accounts]
+        lua_rawgeti(L_, LUA_REGISTRYINDEX, env_ref);            // [accounts, env]
+        is_table = lua_istable(L_, -1);
+        if (is_table) {
+          lua_pushvalue(L_, -1);                                // [accounts, env, env]
+          auto* token = static_cast<uint32_t*>(lua_newuserdatauv(L_, sizeof(uint32_t), 0));
+          *token = 0;  // filled in once stored: a failed store releases nothing
+          luaL_setmetatable(L_, kEnvAccountMeta);
+          lua_rawset(L_, -4);                                   // accounts[env] = token
+          *token = id;
+        }
+        lua_pop(L_, 2);
+      });
+    } catch (...) {
+      unclaim();
+      throw;
+    }
+    if (!is_table) {
+      unclaim();
+      throw std::runtime_error("environment reference is not a table");
+    }
+    allocator_.accounts[id].live = true;
+  }
+
+  allocator_.accounts[id].max_memory = limits.max_memory;
+  allocator_.accounts[id].max_instructions = limits.max_instructions;
+  InstallExecutionHook();  // the count event, at an interval the limit needs
+}
+
+std::optional<EnvironmentUsage> LuaRuntime::GetEnvironmentUsage(const int env_ref) const {
+  const uint32_t id = FindEnvironmentAccount(env_ref);
+  if (id == 0) return std::nullopt;
+  const EnvironmentAccount& acct = allocator_.accounts[id];
+  EnvironmentUsage usage;
+  usage.memory = acct.memory;
+  usage.max_memory = acct.max_memory;
+  usage.max_instructions = acct.max_instructions;
+  usage.instructions = acct.instructions;
+  usage.runs = acct.runs;
+  return usage;
+}
+
 ScriptResult LuaRuntime::ExecuteScriptInEnvironment(const int env_ref,
                                                     const std::string& script) const {
   if (env_ref == LUA_NOREF || env_ref == LUA_REFNIL) {
@@ -3047,6 +6543,8 @@ ScriptResult LuaRuntime::ExecuteScriptInEnvironment(const int env_ref,
 
   last_error_value_.reset();
   const int stackBefore = lua_gettop(L_);
+  // From the compile on, so the chunk itself is charged to the environment.
+  EnvironmentRun run(*this, env_ref);
 
   // Size-aware load so scripts with embedded NULs aren't silently truncated
   // (mirrors ExecuteScript, chunk name included).
@@ -3069,6 +6567,7 @@ ScriptResult LuaRuntime::ExecuteScriptInEnvironment(const int env_ref,
     return std::string("chunk has no _ENV upvalue");
   }
 
+  run.Admit();
   if (ProtectedCall(0, LUA_MULTRET) != LUA_OK) {
     std::string error = CaptureError(L_);
     lua_pop(L_, 1);
@@ -3090,28 +6589,119 @@ ScriptResult LuaRuntime::ExecuteScriptInEnvironment(const int env_ref,
   return results;
 }
 
+std::variant<LuaFunctionRef, std::string> LuaRuntime::PrepareChunk(
+    const std::string& script, const std::string& chunk_name) const {
+  last_error_value_.reset();
+  StackGuard guard(L_);
+
+  std::string source;
+  source.reserve(script.size() + 40);
+  source += "return function(_ENV, ...) ";
+  source += script;
+  source += "\nend";  // own line: a trailing `--` comment can't swallow it
+
+  // Named after the script itself (as ExecuteScript does), not the wrapper.
+  const int base = lua_gettop(L_);
+  if (luaL_loadbuffer(L_, source.data(), source.size(),
+                      chunk_name.empty() ? script.c_str() : chunk_name.c_str()) != LUA_OK) {
+    return std::string(lua_tostring(L_, -1));
+  }
+  lua_pushnil(L_);
+  lua_setupvalue(L_, -2, 1);  // the loader's _ENV
+
+  if (ProtectedCall(0, LUA_MULTRET) != LUA_OK) return CaptureError(L_);
+  // The loader is `return function(_ENV, ...)`: exactly one result, and that
+  // very function. Text that closes the wrapper early (`end, x, function(`)
+  // still parses and has just run — with no globals to reach — but any extra
+  // result, or a function in its place, is rejected.
+  bool wrapper = lua_gettop(L_) == base + 1 && lua_isfunction(L_, -1) &&
+                 !lua_iscfunction(L_, -1);
+  if (wrapper) {
+    lua_Debug ar;
+    lua_pushvalue(L_, -1);
+    lua_getinfo(L_, ">u", &ar);  // pops the copy
+    const char* first = lua_getlocal(L_, nullptr, 1);  // parameter names only
+    wrapper = ar.nparams == 1 && ar.isvararg && first && std::strcmp(first, "_ENV") == 0;
+  }
+  if (!wrapper) {
+    return std::string("script closes the prepared chunk's function early");
+  }
+  try {
+    const LuaPtr fn = ToLuaValueProtected(L_, lua_gettop(L_));
+    return std::get<LuaFunctionRef>(fn->value);
+  } catch (const std::exception& e) {
+    return std::string(e.what());
+  }
+}
+
+ScriptResult LuaRuntime::RunPreparedChunk(const LuaFunctionRef& chunk, const int env_ref,
+                                          const std::vector<LuaPtr>& args) const {
+  last_error_value_.reset();
+  const int stackBefore = lua_gettop(L_);
+
+  if (!lua_checkstack(L_, static_cast<int>(args.size()) + LUA_MINSTACK)) {
+    return std::string("stack overflow: too many arguments to Lua function");
+  }
+  EnvironmentRun run(*this, env_ref);  // see ExecuteScriptInEnvironment
+  lua_rawgeti(L_, LUA_REGISTRYINDEX, chunk.ref);  // [chunk]
+  lua_rawgeti(L_, LUA_REGISTRYINDEX, env_ref);    // [chunk, env]
+  if (!lua_istable(L_, -1)) {
+    lua_settop(L_, stackBefore);
+    return std::string("environment reference is not a table");
+  }
+  if (!lua_isfunction(L_, -2)) {
+    lua_settop(L_, stackBefore);
+    return std::string("prepared chunk has been released");
+  }
+
+  // See CallFunction: a failed push restores the stack and reports as text.
+  try {
+    for (const auto& arg : args) {
+      PushLuaValue(L_, arg);
+    }
+  } catch (const std::exception& e) {
+    lua_settop(L_, stackBefore);
+    std::string msg = "Error converting argument to Lua function: ";
+    msg += e.what();
+    return msg;
+  }
+
+  run.Admit();
+  if (ProtectedCall(static_cast<int>(args.size()) + 1, LUA_MULTRET) != LUA_OK) {
+    std::string error = CaptureError(L_);
+    lua_pop(L_, 1);
+    return error;
+  }
+
+  const int nresults = lua_gettop(L_) - stackBefore;
+  std::vector<LuaPtr> results;
+  results.reserve(nresults);
+  try {
+    for (int i = 0; i < nresults; ++i) {
+      results.push_back(ToLuaValueProtected(L_, stackBefore + 1 + i));
+    }
+  } catch (const std::exception& e) {
+    lua_pop(L_, nresults);
+    return std::string(e.what());
+  }
+  lua_pop(L_, nresults);
+  return results;
+}
+
 // --- Coroutine support ---
 
 std::variant<LuaThreadRef, std::string> LuaRuntime::CreateCoroutine(const LuaFunctionRef& funcRef) const {
-  // Build and anchor the thread inside a protected frame so an OOM under
+  // The thread is built and anchored inside a protected frame so an OOM under
   // maxMemory in lua_newthread/luaL_ref throws instead of aborting (M3).
-  lua_State* thread = nullptr;
-  int threadRef = LUA_NOREF;
+  // (MakeCoroutineThread reuses a pooled thread when one is parked.)
   try {
-    RunProtected([&]() {
-      thread = lua_newthread(L_);                     // [thread]
-      threadRef = luaL_ref(L_, LUA_REGISTRYINDEX);    // anchors it (pops thread)
-      lua_rawgeti(L_, LUA_REGISTRYINDEX, funcRef.ref);  // push the function
-      lua_xmove(L_, thread, 1);                        // move it onto the thread
-    });
+    LuaThreadRef co = MakeCoroutineThread();
+    lua_rawgeti(L_, LUA_REGISTRYINDEX, funcRef.ref);  // push the function
+    lua_xmove(L_, co.thread, 1);                       // move it onto the thread
+    return co;
   } catch (const std::exception& e) {
     return std::string(e.what());
   }
-  if (!thread) {
-    return std::string("Failed to create coroutine thread");
-  }
-
-  return LuaThreadRef(threadRef, L_, thread);
 }
 
 CoroutineResult LuaRuntime::ResumeCoroutine(const LuaThreadRef& threadRef,
@@ -3204,6 +6794,31 @@ CoroutineResult LuaRuntime::ResumeCoroutine(const LuaThreadRef& threadRef,
   return result;
 }
 
+CoroutineBatchResult LuaRuntime::ResumeCoroutineBatch(
+    const LuaThreadRef& threadRef, const size_t max_steps,
+    const std::vector<LuaPtr>& args) const {
+  CoroutineBatchResult batch;
+  if (GetCoroutineStatus(threadRef) == CoroutineStatus::Dead) return batch;
+
+  // Capped: `max_steps` may be "drain it" (SIZE_MAX).
+  batch.yields.reserve(std::min<size_t>(max_steps, 1024));
+  const std::vector<LuaPtr> no_args;
+  for (size_t step = 0; step < max_steps; ++step) {
+    CoroutineResult r = ResumeCoroutine(threadRef, step == 0 ? args : no_args);
+    if (r.error) {
+      batch.error = std::move(r.error);
+      return batch;  // status stays Dead
+    }
+    if (r.status != CoroutineStatus::Suspended) {
+      batch.returned = std::move(r.values);
+      return batch;
+    }
+    batch.yields.push_back(std::move(r.values));
+  }
+  batch.status = CoroutineStatus::Suspended;
+  return batch;
+}
+
 // Reports Suspended or Dead only. CoroutineStatus::Running is never returned:
 // with the single-threaded driver a coroutine is never observed mid-execution
 // from here (a resume runs to its next yield or completion before returning).
@@ -3244,22 +6859,15 @@ std::variant<LuaThreadRef, std::string> LuaRuntime::CreateCoroutineFromScript(
     const char* msg = lua_tostring(L_, -1);
     return std::string(msg ? msg : "failed to load script");
   }
-  // Stack: [chunk]. Create + anchor the thread inside a protected frame so an OOM
-  // in lua_newthread / luaL_ref throws instead of aborting (M5). These run in the
-  // pcall frame (above the chunk), so they don't touch the chunk left below.
-  lua_State* thread = nullptr;
-  int threadRef = LUA_NOREF;
-  RunProtected([&]() {
-    thread = lua_newthread(L_);
-    threadRef = luaL_ref(L_, LUA_REGISTRYINDEX);  // pops the thread, anchors it
-  });
-  if (!thread) {
-    return std::string("Failed to create coroutine thread");
-  }
+  // Stack: [chunk]. MakeCoroutineThread creates + anchors the thread inside a
+  // protected frame so an OOM in lua_newthread / luaL_ref throws instead of
+  // aborting (M5). That runs in the pcall frame (above the chunk), so it doesn't
+  // touch the chunk left below.
+  LuaThreadRef co = MakeCoroutineThread();
   // Stack: [chunk] again (pcall restored it). Move the chunk onto the thread.
-  lua_xmove(L_, thread, 1);
+  lua_xmove(L_, co.thread, 1);
 
-  return LuaThreadRef(threadRef, L_, thread);
+  return co;
 }
 
 // Continuation resumed after a host call suspended to await a JS promise.
@@ -3,11 +3,13 @@
 #include <lua.hpp>
 #include <atomic>
 #include <chrono>
+#include <climits>
 #include <exception>
 #include <functional>
 #include <mutex>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <variant>
 #include <vector>
@@ -61,6 +63,23 @@ inline std::shared_ptr<void> MakeRegistryOwner(lua_State* L, int ref) {
     UnrefRegistrySlot(mainL, ref);
   }};
 }
+
+// Releases the registry slot anchoring a coroutine thread minted by the
+// runtime's own coroutine constructors: the thread goes back to the runtime's
+// reuse pool when it is eligible, and is unref'd like any other slot otherwise.
+// Same threading and deferral rules as UnrefRegistrySlot.
+void ReleaseThreadSlot(lua_State* mainL, int ref, lua_State* thread);
+
+// The MakeRegistryOwner counterpart for pool-tracked threads. `mainL` must
+// already be the main state — the only callers are the runtime's coroutine
+// constructors, which hold it directly.
+inline std::shared_ptr<void> MakeThreadOwner(lua_State* mainL, int ref,
+                                             lua_State* thread) {
+  if (!mainL || ref == LUA_NOREF || ref == LUA_REFNIL) return nullptr;
+  return {nullptr, [mainL, ref, thread](void*) {
+    ReleaseThreadSlot(mainL, ref, thread);
+  }};
+}
 }  // namespace detail
 
 // Holds a reference to a Lua function in the registry.
@@ -72,9 +91,14 @@ inline std::shared_ptr<void> MakeRegistryOwner(lua_State* L, int ref) {
 struct LuaFunctionRef {
   int ref;
   lua_State* L;
+  // lua_topointer of the referenced function when ToLuaValue captured it (null
+  // if unknown). Stable for as long as any copy holds the slot — the ref keeps
+  // the object alive — so the binding keys its wrapper identity cache on it.
+  // Survives release(), so a cache entry can still be matched for eviction.
+  const void* identity = nullptr;
 
-  LuaFunctionRef(int r, lua_State* state)
-      : ref(r), L(state), owner_(detail::MakeRegistryOwner(state, r)) {}
+  LuaFunctionRef(int r, lua_State* state, const void* id = nullptr)
+      : ref(r), L(state), identity(id), owner_(detail::MakeRegistryOwner(state, r)) {}
 
   LuaFunctionRef(const LuaFunctionRef&) = default;
   LuaFunctionRef& operator=(const LuaFunctionRef&) = default;
@@ -102,6 +126,12 @@ struct LuaThreadRef {
       : ref(r), L(mainState), thread(threadState),
         owner_(detail::MakeRegistryOwner(mainState, r)) {}
 
+  // Adopts an already-built owner — used for pooled threads, whose owner
+  // recycles the slot instead of unref'ing it (see detail::MakeThreadOwner).
+  LuaThreadRef(int r, lua_State* mainState, lua_State* threadState,
+               std::shared_ptr<void> owner)
+      : ref(r), L(mainState), thread(threadState), owner_(std::move(owner)) {}
+
   LuaThreadRef(const LuaThreadRef&) = default;
   LuaThreadRef& operator=(const LuaThreadRef&) = default;
   LuaThreadRef(LuaThreadRef&&) noexcept = default;
@@ -118,6 +148,109 @@ struct LuaThreadRef {
   std::shared_ptr<void> owner_;
 };
 
+// Element type of a numeric array view, one per JS TypedArray kind it can wrap.
+enum class NumericArrayType : uint8_t {
+  Int8, Int16, Uint16, Int32, Uint32, Float32, Float64
+};
+
+// A JS TypedArray's backing store, indexed from Lua in place — no copy in
+// either direction. The core never owns the memory: the binding keeps the
+// TypedArray alive under the userdata's ref_id for as long as any Lua userdata
+// (or unpushed converted value) refers to it. `length` counts elements.
+struct NumericArrayView {
+  void* data = nullptr;
+  size_t length = 0;
+  NumericArrayType type = NumericArrayType::Float64;
+};
+
+// Userdata ids (LuaUserdataRef::ref_id) pack a slot index with that slot's
+// generation, so per-userdata bookkeeping on both layers is a vector index
+// rather than a hash lookup. Reusing a slot bumps its generation, so an id
+// that outlived its userdata (a stale class marker, an id minted before a
+// reset) stops matching instead of aliasing the slot's new owner. A slot whose
+// generation runs out is retired rather than wrapped: no id is issued twice.
+// Ids are always positive.
+inline constexpr int kUserdataSlotBits = 22;
+inline constexpr int kUserdataSlotMask = (1 << kUserdataSlotBits) - 1;
+inline constexpr int kUserdataMaxGeneration = INT_MAX >> kUserdataSlotBits;
+
+inline constexpr size_t UserdataSlotOf(int ref_id) {
+  return static_cast<size_t>(ref_id & kUserdataSlotMask);
+}
+
+// Generation-checked slab of T keyed by userdata id; the binding allocates its
+// ids here. Find is a bounds check, an index and a generation compare. Erased
+// slots go on a free list. Insert may move every value, so a T* from Find is
+// only good until the next Insert.
+template <typename T>
+class UserdataSlab {
+ public:
+  // Stores `value` under a fresh id. Throws std::runtime_error once all
+  // 2^kUserdataSlotBits slots are live or retired.
+  int Insert(T value) {
+    size_t slot;
+    if (!free_.empty()) {
+      slot = free_.back();
+      free_.pop_back();
+    } else {
+      if (slots_.size() > static_cast<size_t>(kUserdataSlotMask)) {
+        throw std::runtime_error("too many live userdata objects");
+      }
+      slot = slots_.size();
+      slots_.emplace_back();
+    }
+    Slot& s = slots_[slot];
+    s.value = std::move(value);
+    s.live = true;
+    ++size_;
+    return (s.generation << kUserdataSlotBits) | static_cast<int>(slot);
+  }
+
+  [[nodiscard]] T* Find(int ref_id) {
+    if (ref_id <= 0) return nullptr;
+    const size_t slot = UserdataSlotOf(ref_id);
+    if (slot >= slots_.size()) return nullptr;
+    Slot& s = slots_[slot];
+    return s.live && (ref_id >> kUserdataSlotBits) == s.generation ? &s.value : nullptr;
+  }
+
+  bool Erase(int ref_id) {
+    if (!Find(ref_id)) return false;
+    Release(UserdataSlotOf(ref_id));
+    return true;
+  }
+
+  // Erases every live id; none of them will match again.
+  void Clear() {
+    for (size_t slot = 0; slot < slots_.size(); ++slot) {
+      if (slots_[slot].live) Release(slot);
+    }
+  }
+
+  [[nodiscard]] size_t size() const { return size_; }
+
+ private:
+  struct Slot {
+    T value{};
+    int generation = 1;
+    bool live = false;
+  };
+
+  void Release(size_t slot) {
+    Slot& s = slots_[slot];
+    // Slot state first: dropping the value may run arbitrary destructors.
+    s.live = false;
+    --size_;
+    if (++s.generation <= kUserdataMaxGeneration) free_.push_back(slot);
+    T dropped = std::move(s.value);
+    s.value = T{};
+  }
+
+  std::vector<Slot> slots_;
+  std::vector<size_t> free_;
+  size_t size_ = 0;
+};
+
 // Holds a reference to userdata.
 // For JS-created userdata: ref_id maps to a JS object, registry_ref is LUA_NOREF.
 // For Lua-created userdata (opaque passthrough): ref_id is -1, registry_ref holds
@@ -129,6 +262,12 @@ struct LuaUserdataRef {
   bool opaque;          // true = Lua-created userdata (can't inspect internals)
   bool proxy;           // true = property access enabled (__index/__newindex)
   std::string class_name;  // non-empty => instance bound to a registered class metatable
+  // Set => JS-created numeric array: pushed as a view userdata indexable from
+  // Lua, rather than as the opaque ref_id block.
+  std::optional<NumericArrayView> numeric;
+  // Optional owner keeping ref_id's count up until this value is gone (see
+  // LuaRuntime::ReleaseUserdataPin). Opaque to the core.
+  std::shared_ptr<void> pin;
 
   LuaUserdataRef(int id, lua_State* state, bool is_opaque = false,
                  int reg_ref = LUA_NOREF, bool is_proxy = false,
@@ -159,9 +298,10 @@ struct LuaUserdataRef {
 struct LuaTableRef {
   int ref;
   lua_State* L;
+  const void* identity = nullptr;  // see LuaFunctionRef::identity
 
-  LuaTableRef(int r, lua_State* state)
-      : ref(r), L(state), owner_(detail::MakeRegistryOwner(state, r)) {}
+  LuaTableRef(int r, lua_State* state, const void* id = nullptr)
+      : ref(r), L(state), identity(id), owner_(detail::MakeRegistryOwner(state, r)) {}
 
   LuaTableRef(const LuaTableRef&) = default;
   LuaTableRef& operator=(const LuaTableRef&) = default;
@@ -178,9 +318,74 @@ struct LuaTableRef {
   std::shared_ptr<void> owner_;
 };
 
+// Position of a streaming pairs() walk over a table (see
+// LuaRuntime::NextTableEntries). Holds its own share of the table, so it stays
+// valid after the handle it was made from is released, plus registry slots
+// anchoring the last key handed out — lua_next resumes from that key — and the
+// key that followed it when the batch ended, which the next batch checks its
+// first step against. The slots are dropped through the usual registry owners
+// (H9c). `done` is set once the walk ends, whether by reaching the end or by
+// invalidation.
+struct LuaTableCursor {
+  LuaTableRef table;
+  bool done = false;
+
+  explicit LuaTableCursor(LuaTableRef t) : table(std::move(t)) {}
+
+  // Ends the walk early and drops the key slots now rather than with the cursor.
+  void close() {
+    done = true;
+    key_owner_.reset();
+    key_ref_ = LUA_NOREF;
+    next_owner_.reset();
+    next_ref_ = LUA_NOREF;
+  }
+
+ private:
+  friend class LuaRuntime;
+  int key_ref_ = LUA_NOREF;
+  std::shared_ptr<void> key_owner_;
+  int next_ref_ = LUA_NOREF;
+  std::shared_ptr<void> next_owner_;
+};
+
+// One environment's share of the state (see LuaRuntime::SetEnvironmentLimits).
+// Slot 0 of MemoryAllocator::accounts is the unattributed bucket: everything
+// allocated outside an accounted environment's run.
+struct EnvironmentAccount {
+  size_t memory = 0;            // live bytes charged to it (tagged states only)
+  size_t max_memory = 0;        // 0 = unlimited
+  size_t max_instructions = 0;  // per run; 0 = unlimited
+  uint64_t instructions = 0;    // across all runs, at count-hook granularity
+  uint64_t runs = 0;
+  bool live = false;            // false once its environment is gone
+  uint32_t next_free = 0;       // free-list link while reusable
+};
+
 struct MemoryAllocator {
   size_t current = 0;
   size_t limit = 0;  // 0 = unlimited
+
+  // Environment accounting. When `tagged` (RuntimeConfig::environment_accounting)
+  // every block carries the id of the account it is charged to, so a block is
+  // credited back to its owner when freed, whichever run the collector happens
+  // to free it in. `active` is the account charged for allocations right now.
+  bool tagged = false;
+  uint32_t active = 0;
+  uint32_t free_head = 0;  // released accounts with nothing left charged
+  std::vector<EnvironmentAccount> accounts;
+
+  void Charge(uint32_t id, size_t bytes) { accounts[id].memory += bytes; }
+  void Uncharge(uint32_t id, size_t bytes) {
+    EnvironmentAccount& acct = accounts[id];
+    acct.memory -= bytes;
+    // The last block of a released account makes its id reusable. Dead
+    // accounts are never charged again, so this happens at most once.
+    if (id != 0 && !acct.live && acct.memory == 0) {
+      acct.next_free = free_head;
+      free_head = id;
+    }
+  }
 };
 
 struct RuntimeConfig {
@@ -188,6 +393,33 @@ struct RuntimeConfig {
   size_t max_memory = 0;        // 0 = unlimited
   size_t max_instructions = 0;  // 0 = unlimited (VM instructions per execution)
   size_t timeout_ms = 0;        // 0 = no wall-clock timeout (per execution)
+  size_t coroutine_pool_size = 0;  // 0 = no thread reuse (see SetCoroutinePoolSize)
+  // Tag every block with the environment account it is charged to (8 bytes per
+  // block), which per-environment memory limits need; see SetEnvironmentLimits.
+  bool environment_accounting = false;
+};
+
+// Limits for one environment's runs (see LuaRuntime::SetEnvironmentLimits).
+struct EnvironmentLimits {
+  size_t max_memory = 0;        // 0 = unlimited; needs environment_accounting
+  size_t max_instructions = 0;  // per run; 0 = unlimited
+};
+
+// Snapshot of an environment's account (see LuaRuntime::GetEnvironmentUsage).
+struct EnvironmentUsage {
+  size_t memory = 0;
+  size_t max_memory = 0;
+  size_t max_instructions = 0;
+  uint64_t instructions = 0;
+  uint64_t runs = 0;
+};
+
+// Counters for the coroutine thread pool (see SetCoroutinePoolSize).
+struct CoroutinePoolStats {
+  size_t capacity = 0;  // the configured cap
+  size_t idle = 0;      // reset threads waiting in the pool right now
+  size_t created = 0;   // threads allocated with lua_newthread
+  size_t reused = 0;    // coroutines served from the pool instead
 };
 
 struct MetatableEntry {
@@ -209,6 +441,50 @@ struct CoroutineResult {
   std::optional<std::string> error;
 };
 
+// Result of a batched resume (see LuaRuntime::ResumeCoroutineBatch).
+struct CoroutineBatchResult {
+  CoroutineStatus status = CoroutineStatus::Dead;
+  std::vector<std::vector<LuaPtr>> yields;  // one entry per yield, in order
+  std::vector<LuaPtr> returned;  // the body's return values, if it finished
+  std::optional<std::string> error;
+};
+
+// Scalar types a fast host function declares for its parameters and result
+// (see LuaRuntime::RegisterFastFunction). Void is valid only as a result.
+enum class FastScalarType : uint8_t { Number, Integer, Boolean, Void };
+
+// One fast-call argument or result; the active member is named by the
+// signature's FastScalarType, so values cross without a LuaValue allocation.
+union FastScalar {
+  double number;
+  int64_t integer;
+  bool boolean;
+};
+
+struct FastSignature {
+  std::vector<FastScalarType> args;
+  FastScalarType returns = FastScalarType::Void;
+};
+
+// A typed field a registered class stores natively, in its instances' field
+// records rather than on the JS object (see LuaRuntime::RegisterClass).
+enum class ClassFieldType : uint8_t { Number, Integer, Boolean, String };
+
+struct ClassField {
+  std::string name;
+  ClassFieldType type;
+};
+
+// The native field values of one class instance, shared by every Lua block of
+// that instance (a re-push makes a new block, not a new record). `dirty` marks
+// a Lua-side write not yet written back to the JS object.
+struct ClassInstanceFields {
+  std::shared_ptr<const std::vector<ClassField>> layout;
+  std::vector<FastScalar> scalars;   // by slot; unused for String fields
+  std::vector<std::string> strings;  // by slot; unused for scalar fields
+  bool dirty = false;
+};
+
 // Result of one step of the coroutine-driven async executor.
 struct AsyncStepResult {
   enum class State { Finished, Awaiting, Error };
@@ -222,6 +498,9 @@ struct AsyncStepResult {
 // callables (not as their internal registry-name string).
 struct HostFunctionName {
   std::string name;
+  // Optional owner that keeps a reused reclaimable name pinned until this value
+  // is gone (see LuaRuntime::PinReclaimableHostFunction). Opaque to the core.
+  std::shared_ptr<void> pin;
 };
 
 struct LuaValue {
@@ -261,12 +540,165 @@ struct LuaValue {
 using ScriptResult = std::variant<std::vector<LuaPtr>, std::string>;
 using CompileResult = std::variant<std::vector<uint8_t>, std::string>;
 
+// Encoding choices for the native JSON encoder where a Lua table has no single
+// JSON reading. The defaults match how the value conversion hands the same
+// table to JS (an empty table is an empty array; a table with holes or
+// non-sequence integer keys is an object keyed by their decimal strings).
+struct JsonEncodeOptions {
+  // Encode {} as `{}` instead of `[]`.
+  bool empty_table_as_object = false;
+  // Encode a table whose keys are all positive integers, but which is not a
+  // sequence, as an array with `null` in the holes — when at least half the
+  // slots up to the largest key are filled; a sparser table stays an object.
+  bool sparse_arrays = false;
+};
+
+// The JSON text of a script's results (ExecuteScriptJson).
+struct JsonText {
+  std::string text;
+};
+using JsonScriptResult = std::variant<JsonText, std::string>;
+
+// An immutable tree of plain data — nil, booleans, numbers, strings, arrays
+// and string-keyed tables — built once and read in place by any number of Lua
+// states (see SharedDataSlot and LuaRuntime::SetGlobalSharedData). The layout
+// is flat: one 16-byte node per value, every string in one pool, each
+// container's children in one contiguous run of slots, and object entries
+// sorted by key for binary search. Nothing changes after SharedDataBuilder::
+// Finish, so reads take no lock from any thread.
+class SharedData {
+ public:
+  enum class Kind : uint8_t { Nil, Boolean, Integer, Number, String, Array, Object };
+
+  struct Node {
+    Kind kind = Kind::Nil;
+    // String: byte length. Array: element count. Object: entry count.
+    uint32_t count = 0;
+    union {
+      bool boolean;
+      int64_t integer;
+      double number;
+      // String: offset into the pool. Array/Object: first child slot. An
+      // object's slots alternate key (a String node) and value.
+      uint64_t offset = 0;
+    };
+  };
+
+  [[nodiscard]] uint32_t root() const { return root_; }
+  [[nodiscard]] const Node& node(const uint32_t i) const { return nodes_[i]; }
+  [[nodiscard]] std::string_view string(const Node& n) const {
+    return {strings_.data() + n.offset, n.count};
+  }
+  // Array element `k` (0-based).
+  [[nodiscard]] uint32_t Element(const Node& array, const size_t k) const {
+    return slots_[array.offset + k];
+  }
+  // Object entry `k`, in key order.
+  [[nodiscard]] std::string_view EntryKey(const Node& object, const size_t k) const {
+    return string(nodes_[slots_[object.offset + 2 * k]]);
+  }
+  [[nodiscard]] uint32_t EntryValue(const Node& object, const size_t k) const {
+    return slots_[object.offset + 2 * k + 1];
+  }
+  // The entry index of `key` in `object`, by binary search.
+  [[nodiscard]] std::optional<size_t> FindEntry(const Node& object, std::string_view key) const;
+
+  // Heap bytes held by the tree.
+  [[nodiscard]] size_t ByteSize() const {
+    return nodes_.capacity() * sizeof(Node) + slots_.capacity() * sizeof(uint32_t) +
+           strings_.capacity();
+  }
+
+  // Builds from a converted value. Throws std::runtime_error for anything that
+  // is not plain data (a function, userdata, a table or coroutine reference)
+  // and for nesting deeper than LuaRuntime::kMaxDepth.
+  static std::shared_ptr<const SharedData> FromValue(const LuaValue& value);
+
+ private:
+  friend class SharedDataBuilder;
+  std::vector<Node> nodes_;
+  std::vector<uint32_t> slots_;
+  std::string strings_;
+  uint32_t root_ = 0;
+};
+
+// Assembles a SharedData bottom-up, for callers that walk their own source
+// (the binding reads JS values straight into it, with no LuaValue tree in
+// between). Every Add* returns the new node's index. A container reserves its
+// slots when added; fill them with SetElement / SetEntry — an unfilled slot
+// reads as nil. Throws std::runtime_error past 2^32 nodes or slots.
+class SharedDataBuilder {
+ public:
+  SharedDataBuilder();
+
+  uint32_t AddNil() const { return 0; }  // node 0 is the one shared nil
+  uint32_t AddBoolean(bool b);
+  uint32_t AddInteger(int64_t i);
+  uint32_t AddNumber(double d);
+  uint32_t AddString(std::string_view s);
+  uint32_t AddArray(size_t count);
+  uint32_t AddObject(size_t count);
+  void SetElement(uint32_t array, size_t k, uint32_t value);
+  void SetEntry(uint32_t object, size_t k, std::string_view key, uint32_t value);
+
+  // Sorts each object's entries by key (throwing on a duplicate) and seals the
+  // tree with `root` as its top value. The builder is empty afterwards.
+  std::shared_ptr<const SharedData> Finish(uint32_t root);
+
+ private:
+  uint32_t Add(const SharedData::Node& n);
+  uint64_t Reserve(size_t slots);
+
+  std::shared_ptr<SharedData> data_;
+  std::vector<uint32_t> objects_;  // object nodes, for Finish's sort
+};
+
+// The published version of a SharedData. Every Lua global bound to the slot
+// reads the current version; Store swaps in a new one, safely against readers
+// on any thread (a state running on an async worker included). A view already
+// taken into an older version keeps that version alive, and consistent, until
+// the view is collected.
+class SharedDataSlot {
+ public:
+  explicit SharedDataSlot(std::shared_ptr<const SharedData> data)
+      : data_(std::move(data)) {}
+
+  // The current version and, optionally, its number.
+  [[nodiscard]] std::shared_ptr<const SharedData> Load(uint64_t* version = nullptr) const;
+  void Store(std::shared_ptr<const SharedData> data);
+  [[nodiscard]] uint64_t version() const { return version_.load(std::memory_order_acquire); }
+
+ private:
+  mutable std::mutex mutex_;
+  std::shared_ptr<const SharedData> data_;
+  std::atomic<uint64_t> version_{1};
+};
+
+// A host-side table that a state reads on demand (LuaRuntime::
+// SetGlobalLazyTable) instead of receiving a copy of every update. The host
+// bumps `version` whenever the table changes; a state notices on its next read
+// — a single atomic load — and only then drops what it had cached. Nothing is
+// sent to a state that never reads the table.
+struct LazyTableSource {
+  std::shared_ptr<const std::atomic<uint64_t>> version;
+  // One field, nil if absent. Integer keys arrive in decimal form.
+  std::function<LuaPtr(const std::string& key)> fetch;
+  // The whole table, for pairs() and #.
+  std::function<LuaPtr()> fetch_all;
+};
+
 class LuaRuntime {
 public:
   using Function = std::function<LuaPtr(const std::vector<LuaPtr>&)>;
+  // A fast host function reads `argc` scalars (argc == its signature's arity)
+  // and returns one; errors are thrown exactly as from a Function.
+  using FastFunction = std::function<FastScalar(const FastScalar* args, size_t argc)>;
   using UserdataGCCallback = std::function<void(int)>;
   using PropertyGetter = std::function<LuaPtr(int, const std::string&)>;
   using PropertySetter = std::function<void(int, const std::string&, const LuaPtr&)>;
+  // Re-reads the memory behind a JS-backed numeric array view (see
+  // SetNumericViewResolver). Returns false if it is gone.
+  using NumericViewResolver = std::function<bool(int ref_id, NumericArrayView& view)>;
 
   LuaRuntime();
   explicit LuaRuntime(const std::vector<std::string>& libraries);
@@ -288,6 +720,15 @@ public:
   LuaRuntime& operator=(LuaRuntime&&) = delete;
 
   [[nodiscard]] ScriptResult ExecuteScript(const std::string& script) const;
+  // ExecuteScript, with the results serialized to JSON natively in place of
+  // the LuaValue conversion: no result shows as `null`, one as itself, several
+  // as an array. Tables are read raw (no metamethods), except that a lazy
+  // shared table encodes as its contents, and numeric array views encode as
+  // arrays; NaN and infinities become `null`, as in JSON.stringify.
+  // Functions, threads, other userdata, cycles and nesting past kMaxDepth are
+  // errors, reported like script errors.
+  [[nodiscard]] JsonScriptResult ExecuteScriptJson(const std::string& script,
+                                                   const JsonEncodeOptions& options = {}) const;
   [[nodiscard]] ScriptResult ExecuteFile(const std::string& filepath) const;
 
   [[nodiscard]] CompileResult CompileScript(const std::string& script,
@@ -300,6 +741,15 @@ public:
 
   void SetGlobal(const std::string& name, const LuaPtr& value) const;
   void RegisterFunction(const std::string& name, Function fn);
+  // Installs _G[name] as a host function with a declared scalar signature. Its
+  // trampoline checks and reads the arguments straight off the Lua stack into
+  // a fixed buffer and pushes the scalar result directly, so a call allocates
+  // no LuaValues. Arity must match exactly and types are strict (a numeric
+  // string is not a number); a mismatch raises a Lua argument error. Throws
+  // std::invalid_argument for more than kMaxFastArgs parameters or a Void
+  // parameter. Re-registering a name (as either kind) replaces it.
+  void RegisterFastFunction(const std::string& name, FastSignature signature, FastFunction fn);
+  static constexpr size_t kMaxFastArgs = 8;
 
   [[nodiscard]] LuaPtr GetGlobal(const std::string& name) const;
 
@@ -312,6 +762,32 @@ public:
   // any intermediate is nil (optional-chaining semantics) and throws if an
   // intermediate is a non-nil, non-indexable value.
   void SetGlobalPath(const std::vector<std::string>& path, const LuaPtr& value) const;
+
+  // SetGlobalPath with the value given as JSON text, decoded natively straight
+  // onto the Lua stack — no LuaValue tree in between. The mapping matches what
+  // the equivalent JS value converts to (objects -> tables, arrays -> 1-based
+  // sequences, null -> nil, integral numbers -> integers). Throws on malformed
+  // JSON, with the byte offset of the problem, and leaves the target unset.
+  void SetGlobalJson(const std::vector<std::string>& path, std::string_view json) const;
+
+  // Binds `path` to a read-only view of `slot`: a userdata whose __index,
+  // __len and __pairs read the shared nodes in place, so the data is not
+  // copied into this state. The view follows the slot — each access sees the
+  // version current at that moment — while a nested table read out of it is a
+  // view pinned to the version it came from. Like every value leaving Lua, a
+  // view returned to the host is copied out as plain data.
+  void SetGlobalSharedData(const std::vector<std::string>& path,
+                           std::shared_ptr<SharedDataSlot> slot) const;
+
+  // Binds `path` to an empty proxy table whose metatable pulls fields from
+  // `source` on first read and caches them until the source's version moves
+  // on; pairs() and # pull the whole table once per version. Assignments from
+  // Lua land in the cache, so they last until the next change, as a local edit
+  // of a copied table lasts until the next publish. A pull calls into the host,
+  // so reading a stale field raises while the state runs in async mode; fields
+  // already cached for the current version still read normally.
+  void SetGlobalLazyTable(const std::vector<std::string>& path,
+                          std::shared_ptr<const LazyTableSource> source) const;
   [[nodiscard]] LuaPtr GetGlobalPath(const std::vector<std::string>& path) const;
 
   [[nodiscard]] ScriptResult CallFunction(const LuaFunctionRef& funcRef,
@@ -322,6 +798,37 @@ public:
   [[nodiscard]] CoroutineResult ResumeCoroutine(const LuaThreadRef& threadRef,
                                                  const std::vector<LuaPtr>& args) const;
   [[nodiscard]] static CoroutineStatus GetCoroutineStatus(const LuaThreadRef& threadRef);
+  // Resumes up to `max_steps` times in one call — `args` go to the first resume
+  // only — collecting each yield's values. Stops early when the coroutine
+  // finishes (its return values land in `returned`) or raises (`error`; the
+  // yields gathered before it are kept). A coroutine that is already dead
+  // yields nothing and reports no error. Each resume gets its own execution
+  // budget, exactly as a run of ResumeCoroutine calls would.
+  [[nodiscard]] CoroutineBatchResult ResumeCoroutineBatch(
+      const LuaThreadRef& threadRef, size_t max_steps,
+      const std::vector<LuaPtr>& args) const;
+
+  // Coroutine thread reuse. With a non-zero cap, the threads CreateCoroutine
+  // and CreateCoroutineFromScript mint are tracked, and when the last ref to one
+  // is dropped after its body has run to completion (or before it ever started)
+  // the thread is reset with lua_closethread and parked in a pool of up to `cap`
+  // threads instead of being left for the collector. The next coroutine is then
+  // built on a parked thread rather than a fresh lua_newthread.
+  //
+  // Only a thread that is provably finished is recycled: a suspended or errored
+  // one (which may hold pending to-be-closed variables whose __close would run
+  // Lua code) is unref'd as before. A thread that has been pushed into Lua as a
+  // value — passed back in as an argument, or converted out of Lua a second
+  // time — is treated as escaped and never recycled, since Lua could still
+  // hold it. The one escape this cannot see is a body that stashes
+  // coroutine.running() somewhere that outlives it; such a reference would
+  // observe the thread's next occupant. 0 (the default) disables reuse;
+  // lowering the cap trims the idle pool immediately.
+  void SetCoroutinePoolSize(size_t cap);
+  [[nodiscard]] CoroutinePoolStats GetCoroutinePoolStats() const;
+  // Release path for a pool-tracked thread's registry slot (see
+  // detail::ReleaseThreadSlot): parks the thread or unrefs the slot.
+  void RecycleOrUnrefThread(int ref, lua_State* thread);
 
   // Coroutine-driven async execution (main thread; awaits JS promises).
   // Loads `script` as a chunk on a fresh coroutine thread.
@@ -345,6 +852,23 @@ public:
   // Userdata support
   void SetUserdataGCCallback(UserdataGCCallback cb);
   void SetPropertyHandlers(PropertyGetter getter, PropertySetter setter);
+  // The binding's check that a numeric array view's TypedArray still owns its
+  // memory: a transfer or postMessage can detach the buffer whenever JS runs,
+  // so a view's data pointer and length are re-resolved through this on its
+  // first use after InvalidateNumericViews — which the runtime calls itself
+  // when a host function, property handler, shared table fetch, print handler
+  // or userdata GC callback returns, and the embedder calls on each entry into
+  // Lua. Between those points the cached pointer is used without a call. A view
+  // whose resolver fails raises a Lua error instead of reaching the memory.
+  // During async execution no resolver runs (it needs the JS thread) and views
+  // use the pointer resolved last. Without a resolver the view is trusted as
+  // created.
+  void SetNumericViewResolver(NumericViewResolver resolver);
+  // nullptr if the view may be used, otherwise the error to raise.
+  [[nodiscard]] const char* RefreshNumericView(int ref_id, NumericArrayView& view) const;
+  // Marks every numeric array view for re-resolution on its next use.
+  void InvalidateNumericViews();
+  [[nodiscard]] uint64_t NumericViewEpoch() const;
 
   void SetAsyncMode(bool enabled);
   bool IsAsyncMode() const;
@@ -378,6 +902,14 @@ public:
   // Returns true if erased (the binding should drop its paired JS reference).
   // Safe on pushed names: a non-zero count (or missing entry) is untouched.
   bool EraseReclaimableIfUnpushed(const std::string& name);
+  // Holds the reclaimable `name` as though one more closure were alive, so no
+  // GC step can reclaim it between a conversion that reuses the name and the
+  // push that materializes it. Only succeeds while a closure (or another pin)
+  // already keeps the entry live; returns false otherwise, and the caller
+  // should register a fresh name. Each successful pin is released with exactly
+  // one UnpinReclaimableHostFunction, which may itself reclaim the entry.
+  [[nodiscard]] bool PinReclaimableHostFunction(const std::string& name);
+  void UnpinReclaimableHostFunction(const std::string& name);
   // Invoked when a reclaimable host function's last live closure is collected,
   // so the binding layer can drop its paired js_callbacks_ reference. Runs on
   // the thread the GC fires on; skipped during worker-thread async (off-thread
@@ -432,11 +964,35 @@ public:
   void RemoveGlobalRaw(const std::string& name) const;
   void IncrementUserdataRefCount(int ref_id);
   void DecrementUserdataRefCount(int ref_id);
+  // Drops a count taken with IncrementUserdataRefCount on behalf of a converted
+  // value rather than a Lua userdata — the binding pins a fresh numeric array
+  // this way until the value carrying it is gone, so an entry minted by a
+  // conversion that is never pushed is still reclaimed. Touches no Lua state,
+  // so it is safe outside any protected frame; only for ref_ids that never get
+  // a method table (DecrementUserdataRefCount clears that in the registry).
+  void ReleaseUserdataPin(int ref_id);
+  // Finishes the userdata whose last reference went away during async
+  // execution, when the GC callback could not run off-thread: each one still
+  // unreferenced gets its callback now (which writes dirty native fields back)
+  // and then loses its record. Call on the JS thread once the worker is done.
+  void DrainAsyncUserdataReleases();
 
   /// Register a method table for a userdata ref_id.
   /// method_map: maps Lua-facing method name -> host function name
+  /// Proxy blocks carry their method table and access flags as user values,
+  /// copied in when the block is created, so register both before the first
+  /// CreateProxyUserdataGlobal / push of `ref_id` — a block made earlier has
+  /// neither.
   void SetUserdataMethodTable(int ref_id,
       const std::unordered_map<std::string, std::string>& method_map);
+  /// Record which of property reads / writes the binding allows on `ref_id`.
+  /// A refused access is rejected in the metamethod without calling the
+  /// property handler. Without a record both are allowed.
+  void SetUserdataAccess(int ref_id, bool readable, bool writable);
+  /// Drop the method table and access flags of `ref_id` (done automatically
+  /// when its last block is collected). For rolling back a registration whose
+  /// userdata never reached Lua. Raises nothing: it only clears entries.
+  void ClearUserdataMethodTable(int ref_id);
 
   /// Register a class/usertype. Creates a global table `class_name` with a
   /// `new` function that invokes the constructor host function, plus a shared
@@ -447,19 +1003,44 @@ public:
   /// metamethods: operator/metamethod entries (all is_function == true).
   /// parent_class_name: optional base class (C4). It must already be registered
   ///   on this state. Two things follow from it:
-  ///   * method lookup chains — a key missing from this class's method table is
-  ///     searched up the parent chain by ClassIndex, and memoized on the derived
-  ///     class once found;
+  ///   * methods are inherited — each class's __index holds a flattened table
+  ///     of its own methods over every ancestor's, built here (and rebuilt for
+  ///     the descendants when a base class is registered again), so ClassIndex
+  ///     resolves a method with one raw get and never walks the chain;
   ///   * the parent's metamethods are copied into this class's metatable unless
   ///     this definition supplies its own, so an inherited `__tostring` or
   ///     `__add` keeps working on derived instances.
   ///   Property access (readable/writable) is per-instance and set by the
   ///   constructor, so it is not inherited — each class states its own.
+  ///   Fields are not inherited either.
+  /// fields: typed fields stored natively per instance. Lua reads and writes
+  ///   them through __index/__newindex with no host call; a write of the wrong
+  ///   type raises. Seed an instance's values with SetClassFields before its
+  ///   first push (missing ones start at 0 / false / ""), and write dirty ones
+  ///   back with ClassFieldValues + MarkClassFieldsClean. The record lives as
+  ///   long as the instance's userdata ref count.
   void RegisterClass(const std::string& class_name,
       const std::string& constructor_func_name,
       const std::unordered_map<std::string, std::string>& method_map,
       const std::vector<MetatableEntry>& metamethods,
-      const std::string& parent_class_name = "");
+      const std::string& parent_class_name = "",
+      const std::vector<ClassField>& fields = {});
+
+  /// Set every field of instance `ref_id` (values in declared order; nil means
+  /// the zero value) and mark it clean. An existing record keeps its layout;
+  /// otherwise one is created from `class_name`'s. Throws std::runtime_error
+  /// for a value of the wrong type, leaving an existing record unchanged.
+  /// No-op when there is neither a record nor a class with fields.
+  void SetClassFields(int ref_id, const std::string& class_name,
+                      const std::vector<LuaPtr>& values);
+  /// The field layout of instance `ref_id`, or null if it has no field record.
+  [[nodiscard]] const std::vector<ClassField>* ClassFieldLayout(int ref_id) const;
+  /// Current field values of `ref_id`, in declared order (empty if none).
+  [[nodiscard]] std::vector<LuaValue> ClassFieldValues(int ref_id) const;
+  [[nodiscard]] bool ClassFieldsDirty(int ref_id) const;
+  void MarkClassFieldsClean(int ref_id);
+  /// Instances written from Lua since they were last marked clean.
+  [[nodiscard]] std::vector<int> DirtyClassInstances();
 
   /// True if `class_name` has a registered per-class metatable on this state.
   [[nodiscard]] bool HasClass(const std::string& class_name) const;
@@ -477,6 +1058,15 @@ public:
   [[nodiscard]] bool HasTableFieldKeyed(int registry_ref, const TableKey& key) const;
   [[nodiscard]] std::vector<std::string> GetTableKeys(int registry_ref) const;
   [[nodiscard]] int64_t GetTableLength(int registry_ref) const;
+  // Bulk forms of GetTableFieldKeyed / SetTableFieldKeyed: every access runs in
+  // one protected frame, with one registry fetch, instead of one frame per key.
+  // Each read/write still honors __index/__newindex. Values come back in `keys`
+  // order. Writes apply in order; a raise stops at that entry, leaving the
+  // earlier ones applied (as the equivalent sequence of single sets would).
+  [[nodiscard]] std::vector<LuaPtr> GetTableFieldsKeyed(
+      int registry_ref, const std::vector<TableKey>& keys) const;
+  void SetTableFieldsKeyed(
+      int registry_ref, const std::vector<std::pair<TableKey, LuaPtr>>& entries) const;
 
   // Table reference API — create and manage live table references
   [[nodiscard]] int CreateTable();
@@ -499,6 +1089,23 @@ public:
       int registry_ref, const TableKey& key) const;
   [[nodiscard]] std::vector<std::pair<LuaPtr, LuaPtr>> TablePairs(int registry_ref) const;
   [[nodiscard]] std::vector<std::pair<int64_t, LuaPtr>> TableIPairs(int registry_ref) const;
+  // The next at most `max` entries of the walk `cursor` describes, in lua_next
+  // order, with TablePairs' key filtering (entries under other key types are
+  // stepped over, not returned). Only one batch is ever materialized, so memory
+  // stays bounded however large the table is. Sets `cursor.done` once the end
+  // is reached, so the final batch may be short (or empty).
+  //
+  // Between batches the table follows Lua's next() rules: assigning to or
+  // clearing existing fields is fine, adding new keys is not. Each batch
+  // re-checks the boundary before resuming: if lua_next rejects the saved key
+  // (the table was rebuilt without it), or the saved key is no longer followed
+  // by the key that followed it when the last batch ended and that key is still
+  // set (the table was rebuilt or grew around it), the cursor is ended and this
+  // throws "table was modified during iteration". The check is at the
+  // boundary only: Lua exposes no rehash counter, so a modification that
+  // leaves the boundary pair adjacent goes unnoticed.
+  [[nodiscard]] std::vector<std::pair<LuaPtr, LuaPtr>> NextTableEntries(
+      LuaTableCursor& cursor, size_t max) const;
   void ReleaseTableRef(int registry_ref);
 
   // Environment tables — per-script global isolation via Lua's `_ENV`.
@@ -517,6 +1124,25 @@ public:
   [[nodiscard]] int CreateEnvironment(const std::vector<std::string>& whitelist,
                                       bool inherit = false) const;
 
+  // Environment templates — the whitelist resolved once, for callers that make
+  // an environment per request.
+  //
+  // CreateEnvironmentTemplate copies the whitelisted globals (and, with
+  // `inherit`, a `_G` fallback) into a base table once, and returns a ref to
+  // the metatable every environment of the template shares: `__index` is the
+  // base, and `__metatable` is false so scripts can neither reach the base nor
+  // swap the metatable. InstantiateEnvironment then only allocates an empty
+  // table and sets that metatable. Globals read through to the base; writes
+  // land in the environment, as with CreateEnvironment.
+  [[nodiscard]] int CreateEnvironmentTemplate(const std::vector<std::string>& whitelist,
+                                              bool inherit = false) const;
+  [[nodiscard]] int InstantiateEnvironment(int template_ref) const;
+  // Removes every key of environment `env_ref` so it can be handed out again.
+  // Returns false, clearing nothing, unless the table carries `template_ref`'s
+  // metatable. Only the table is reset: a closure from the previous run that
+  // is still reachable keeps it as its _ENV.
+  [[nodiscard]] bool ClearEnvironment(int env_ref, int template_ref) const;
+
   // Loads `script` and runs it with the registry table `env_ref` installed as
   // its `_ENV` — upvalue 1 of every Lua chunk — so the chunk's free-variable
   // reads and writes resolve against that table instead of `_G`. Same result /
@@ -525,6 +1151,46 @@ public:
   [[nodiscard]] ScriptResult ExecuteScriptInEnvironment(
       int env_ref, const std::string& script) const;
 
+  // Prepared chunks — one compile, run against any number of environments.
+  //
+  // PrepareChunk compiles `script` as the body of `function(_ENV, ...)` and
+  // returns that function, so the environment is a parameter of each call
+  // rather than the one shared upvalue ExecuteScriptInEnvironment rebinds:
+  // calls can nest or interleave, and closures a run creates keep that run's
+  // environment. The wrapper shares the script's first line, so line numbers
+  // in errors are unchanged. Text that closes the wrapper early is rejected:
+  // the loader must return that one function and nothing else. It runs with a
+  // nil _ENV, so such text reaches no globals before it is turned away. Errors
+  // are returned as text.
+  [[nodiscard]] std::variant<LuaFunctionRef, std::string> PrepareChunk(
+      const std::string& script, const std::string& chunk_name = "") const;
+  // Runs a prepared chunk with the registry table `env_ref` as its _ENV and
+  // `args` as its `...`. Same result / error contract as CallFunction.
+  [[nodiscard]] ScriptResult RunPreparedChunk(const LuaFunctionRef& chunk, int env_ref,
+                                              const std::vector<LuaPtr>& args) const;
+
+  // Per-environment accounting — many tenants in one state, each with its own
+  // budget.
+  //
+  // SetEnvironmentLimits opens an account for the table `env_ref` names (or
+  // updates its limits). While ExecuteScriptInEnvironment or RunPreparedChunk
+  // runs against that table, the account is the active one: the instructions
+  // the run executes are counted against it and a run past `max_instructions`
+  // fails with "environment instruction limit exceeded"; with
+  // environment_accounting, the blocks it allocates are charged to it and an
+  // allocation past `max_memory` fails as out of memory. Everything executed
+  // during the run counts, host callbacks included; a nested run against
+  // another environment charges that one until it returns.
+  //
+  // A block stays charged to the account that allocated (or last resized) it
+  // until it is freed, so `memory` is the tenant's live footprint, not a
+  // running total. The account is keyed by table identity, lives as long as
+  // the table, and is dropped by ClearEnvironment; runtime-wide limits still
+  // apply on top.
+  void SetEnvironmentLimits(int env_ref, const EnvironmentLimits& limits);
+  [[nodiscard]] std::optional<EnvironmentUsage> GetEnvironmentUsage(int env_ref) const;
+  [[nodiscard]] bool HasEnvironmentAccounting() const { return allocator_.tagged; }
+
   [[nodiscard]] size_t GetMemoryUsage() const { return allocator_.current; }
   [[nodiscard]] size_t GetMemoryLimit() const { return allocator_.limit; }
 
@@ -633,6 +1299,11 @@ public:
   [[nodiscard]] lua_State* RawState() const { return L_; }
 
   static LuaPtr ToLuaValue(lua_State* L, int index, int depth = 0);
+  // If the table at `index` is a lazy shared table's proxy (see
+  // SetGlobalLazyTable), pushes the whole table it stands for and returns
+  // true; a failed pull throws std::runtime_error. Returns false, pushing
+  // nothing, for any other table.
+  static bool PushLazyTableContents(lua_State* L, int index);
   static void PushLuaValue(lua_State* L, const LuaPtr& value, int depth = 0);
 
   void StoreFunctionData(void* data, void (*destructor)(void*)) {
@@ -642,11 +1313,20 @@ public:
   static constexpr int kMaxDepth = 100;
   static constexpr const char* kUserdataMetaName = "lua_native_userdata";
   static constexpr const char* kProxyUserdataMetaName = "lua_native_proxy_userdata";
+  static constexpr const char* kNumericArrayMetaName = "lua_native_numeric_array";
+  static constexpr const char* kSharedDataMetaName = "lua_native_shared_data";
+  static constexpr const char* kLazyTableMetaName = "lua_native_lazy_table";
   static constexpr const char* kHostFnSentinelMeta = "lua_native_hostfn_sentinel";
+  static constexpr const char* kHostFnSlotMeta = "lua_native_hostfn_slot";
+  static constexpr const char* kFastFnSlotMeta = "lua_native_fastfn_slot";
+  static constexpr const char* kEnvAccountMeta = "lua_native_env_account";
 
   // Registry keys / markers shared between the core and binding layers.
   static constexpr const char* kRuntimeRegistryKey = "_lua_core_runtime";
-  static constexpr const char* kUserdataMethodsPrefix = "_ud_methods_";
+  static constexpr const char* kHostFnClosureCacheKey = "_lua_core_hostfn_closures";
+  // Registry table: ref_id -> that userdata's method table (see
+  // SetUserdataMethodTable). Read once per block, when the block is created.
+  static constexpr const char* kUserdataMethodsKey = "_lua_core_ud_methods";
   static constexpr const char* kClassMetaPrefix = "_class_mt_";
   static constexpr const char* kClassMethodsPrefix = "_class_methods_";
   static constexpr const char* kClassParentPrefix = "_class_parent_";
@@ -656,20 +1336,64 @@ public:
 private:
   // allocator_ must be declared before L_ so it outlives the Lua state
   // (C++ destroys members in reverse declaration order, and lua_close calls the allocator).
+  // Mutable because switching the active environment account is part of a run,
+  // which const entry points start.
   // The destructor also runs an explicit teardown sequence — reset the
   // registry-backed error values, run stored_function_data_ destructors, then
   // lua_close — because lua_close fires __gc metamethods that can call back into
   // host_functions_ and read these members while the state is still open.
-  MemoryAllocator allocator_;
+  mutable MemoryAllocator allocator_;
   lua_State* L_ { nullptr };
   RuntimeConfig config_;  // see GetConfig()
-  std::unordered_map<std::string, Function> host_functions_;
+  // A host function's callable lives in a heap slot shared between the name map
+  // and every Lua closure bound to it (upvalue 1 holds a shared_ptr to the
+  // slot), so a call dispatches straight to `fn` with no per-call string hash.
+  // Re-registering a name assigns `fn` in place, which retargets every existing
+  // closure; erasing it clears `fn` and drops the map entry, and a closure
+  // that then finds `fn` empty falls back to one lookup by `name` (rebinding
+  // itself if the name was registered again) before raising "not found".
+  struct HostFunctionSlot {
+    std::string name;
+    Function fn;
+  };
+  std::unordered_map<std::string, std::shared_ptr<HostFunctionSlot>> host_functions_;
+  // Fast host functions (RegisterFastFunction), bound the same way: upvalue 1
+  // of each closure owns a shared_ptr to the slot.
+  struct FastFunctionSlot {
+    std::string name;
+    FastSignature signature;
+    FastFunction fn;
+  };
+  std::unordered_map<std::string, std::shared_ptr<FastFunctionSlot>> fast_functions_;
   std::vector<std::pair<void*, void (*)(void*)>> stored_function_data_;
 
   // Userdata support
   UserdataGCCallback userdata_gc_callback_;
-  std::unordered_map<int, int> userdata_ref_counts_;
+  std::vector<std::string> class_names_;  // registration order, for re-flattening
+  std::unordered_map<std::string, std::shared_ptr<const std::vector<ClassField>>> class_layouts_;
+  // Per-userdata state, indexed by UserdataSlotOf(ref_id). A record belongs to
+  // the ref_id it stores; to any other id whose slot matches it is vacant, and
+  // claiming it for that id resets it. The binding only reuses a slot once the
+  // old id's last block is gone, so a claim never evicts live state.
+  struct UserdataRecord {
+    int ref_id = 0;
+    int ref_count = 0;
+    uint8_t access = kUserdataRead | kUserdataWrite;
+    // Heap-held so the pointer every field block keeps survives the vector
+    // growing; dropped after the instance's last block is collected.
+    std::unique_ptr<ClassInstanceFields> fields;
+  };
+  std::vector<UserdataRecord> userdata_records_;
+  [[nodiscard]] UserdataRecord* FindUserdataRecord(int ref_id);
+  [[nodiscard]] const UserdataRecord* FindUserdataRecord(int ref_id) const;
+  UserdataRecord& ClaimUserdataRecord(int ref_id);
+  std::vector<int> dirty_class_fields_;  // ref_ids whose record went dirty
+  // ref_ids released during async mode, record kept for DrainAsyncUserdataReleases.
+  // Written by the worker, read after it completes, so never concurrently.
+  std::vector<int> async_released_userdata_;
   PropertyGetter property_getter_;
+  NumericViewResolver numeric_view_resolver_;
+  uint64_t numeric_view_epoch_ = 1;  // a view resolved at an older epoch is stale
   PropertySetter property_setter_;
 
   // Reclaimable host functions (M2). reclaimable_host_fns_ maps a name to the
@@ -690,10 +1414,32 @@ private:
   // happens under this mutex, so no two luaL_unref calls — and no unref and the
   // worker's own registry mutation — race. Accessed from the main thread
   // (finalizers) and the worker thread (Begin/End).
-  std::mutex deferred_unref_mutex_;
+  mutable std::mutex deferred_unref_mutex_;
   bool worker_active_ = false;
   std::vector<int> deferred_unrefs_;
 
+  // Coroutine thread pool (see SetCoroutinePoolSize). pooled_threads_ maps every
+  // live pool-tracked thread to the registry slot anchoring it — idle or handed
+  // out — and loses an entry when the thread escapes into Lua or is unref'd.
+  // thread_pool_ holds the idle, already-reset ones. Both are guarded by
+  // deferred_unref_mutex_, since the release path runs from the same finalizers
+  // the H9c queue serves.
+  struct PooledThread {
+    int ref;
+    lua_State* thread;
+  };
+  size_t coroutine_pool_size_ = 0;
+  mutable std::vector<PooledThread> thread_pool_;
+  mutable std::unordered_map<lua_State*, int> pooled_threads_;
+  mutable size_t threads_created_ = 0;
+  mutable size_t threads_reused_ = 0;
+  // Produces an empty, anchored coroutine thread — a parked one when the pool
+  // has one, a fresh lua_newthread otherwise — with a pool-tracking owner when
+  // reuse is enabled. Throws on OOM (the allocation runs inside RunProtected).
+  LuaThreadRef MakeCoroutineThread() const;
+  // Drops `thread` from pool tracking once it has been pushed into Lua.
+  void MarkThreadEscaped(lua_State* thread) const;
+
   // Error fidelity state (mutable: set while capturing errors in const methods)
   mutable LuaPtr last_error_value_;     // structured value of the last error
   LuaPtr pending_error_value_;          // staged by a host wrapper to be raised
@@ -724,6 +1470,18 @@ private:
   mutable size_t instruction_count_ = 0;    // instructions run this execution
   int instruction_hook_interval_ = 1000;    // count-hook firing granularity
 
+  // Environment accounts (see SetEnvironmentLimits). env_accounts_ref_ is a
+  // weak-keyed registry table, environment -> token userdata holding the
+  // account id; the token's __gc releases the account with its table.
+  // env_run_instructions_ is the active run's instruction tally, saved and
+  // restored around nested runs by EnvironmentRun.
+  int env_accounts_ref_ = LUA_NOREF;
+  mutable size_t env_run_instructions_ = 0;
+  class EnvironmentRun;
+  [[nodiscard]] uint32_t FindEnvironmentAccount(int env_ref) const;
+  void ReleaseEnvironmentAccount(uint32_t id) const;
+  static int EnvironmentAccountGC(lua_State* L);
+
   // Wall-clock timeout (see SetTimeout). deadline_ is the instant the current
   // execution must finish by; it is only read when timeout_ms_ > 0.
   size_t timeout_ms_ = 0;                   // 0 = no timeout
@@ -759,7 +1517,29 @@ private:
 
   void RegisterUserdataMetatable();
   void RegisterProxyUserdataMetatable();
+  void RegisterNumericArrayMetatable();
+  void RegisterSharedDataMetatable();
+  void RegisterLazyTableMetatable();
   void RegisterHostFnSentinelMetatable();
+  void RegisterHostFnSlotMetatable();
+
+  // Host function slots (see HostFunctionSlot). StoreHostFunctionSlot assigns
+  // into the name's existing slot or creates one; EraseHostFunctionSlot clears
+  // and unmaps it. HostFunctionSlotFor returns the registered slot, or a fresh
+  // unbound one for a name not (yet) registered — its first call resolves it.
+  void StoreHostFunctionSlot(const std::string& name, Function fn);
+  void EraseHostFunctionSlot(const std::string& name);
+  std::shared_ptr<HostFunctionSlot> HostFunctionSlotFor(const std::string& name) const;
+  // Push the slot userdata that is a LuaCallHostFunction closure's upvalue 1.
+  // Raise-capable (LUA_ERRMEM): the userdata is allocated and given its __gc
+  // before the shared_ptr is copied in, so no C++ owner is live across the
+  // raise. The name overload resolves the slot via HostFunctionSlotFor.
+  static void PushHostFunctionSlot(lua_State* L, const std::shared_ptr<HostFunctionSlot>& slot);
+  static void PushHostFunctionSlot(lua_State* L, const LuaRuntime* runtime, const std::string& name);
+  static int HostFnSlotGC(lua_State* L);
+  void RegisterFastFnSlotMetatable();
+  static int FastFnSlotGC(lua_State* L);
+  static int LuaCallFastFunction(lua_State* L);
 
   // Reclaims a reclaimable host function's entries once its last closure dies.
   void OnHostFnClosureCollected(const std::string& name);
@@ -767,10 +1547,56 @@ private:
 
   static int LuaCallHostFunction(lua_State* L);
   static int UserdataGC(lua_State* L);
+  static int NumericArrayGC(lua_State* L);
+  static int NumericArrayIndex(lua_State* L);
+  static int NumericArrayNewIndex(lua_State* L);
+  static int NumericArrayLen(lua_State* L);
+  static int SharedDataGC(lua_State* L);
+  static int SharedDataIndex(lua_State* L);
+  static int SharedDataNewIndex(lua_State* L);
+  static int SharedDataLen(lua_State* L);
+  static int SharedDataPairs(lua_State* L);
+  static int SharedDataNext(lua_State* L);
+  static int SharedDataEq(lua_State* L);
+  static int LazyTableGC(lua_State* L);
+  static int LazyTableIndex(lua_State* L);
+  static int LazyTableNewIndex(lua_State* L);
+  static int LazyTablePairs(lua_State* L);
+  static int LazyTableLen(lua_State* L);
+  // Runs `pull` and pushes its result; on failure pushes the message instead
+  // and returns false, for the caller to raise once its own locals are gone.
+  static bool PullLazyValue(lua_State* L, const std::function<LuaPtr()>& pull);
+  // Replaces the cache with the whole table (keeping what was already cached
+  // or assigned) and leaves it on the stack; false + message on failure.
+  static bool MaterializeLazyTable(lua_State* L, int block_index);
+  // Proxy userdata blocks: [int ref_id] with user values 1 = method table (or
+  // nil) and 2 = access flags, both attached here from the per-ref_id records.
+  static constexpr int kUserdataMethodsUV = 1;
+  static constexpr int kUserdataAccessUV = 2;
+  static constexpr uint8_t kUserdataRead = 1;
+  static constexpr uint8_t kUserdataWrite = 2;
+  static void NewProxyUserdata(lua_State* L, int ref_id);
+  // Access flags of the proxy block at index 1 (the __index/__newindex self).
+  static uint8_t UserdataAccess(lua_State* L);
   static int UserdataIndex(lua_State* L);
   static int UserdataNewIndex(lua_State* L);
   static int UserdataMethodCall(lua_State* L);
   static int ClassIndex(lua_State* L);
+  static int ClassNewIndex(lua_State* L);
+  // The field record a pushed instance block should point at: the existing
+  // one for `ref_id`, or a zeroed one if `class_name` declares fields; null
+  // for a class without. Throws std::bad_alloc (inside the protected push).
+  static ClassInstanceFields* FieldsForPush(lua_State* L, int ref_id,
+                                            const std::string& class_name);
+  // Builds the flattened method table of `class_name` (its ancestors' method
+  // tables, root first, overlaid by its own) and installs it as upvalue 2 of
+  // the class's __index closure. Raises on OOM; only for a protected frame.
+  static void FlattenClassMethods(lua_State* L, const char* class_name);
+  // True if `base` is `class_name` or one of its ancestors.
+  static bool ClassDerivesFrom(lua_State* L, const char* class_name, const char* base);
+  // Bounds a parent chain. A chain is acyclic by construction (a base class
+  // must already be registered), so this only limits a tampered registry.
+  static constexpr int kMaxClassDepth = 32;
   static int AsyncContinuation(lua_State* L, int status, lua_KContext ctx);
 
   // Error handling: message handler that appends a Lua traceback (leaving
@@ -794,8 +1620,15 @@ private:
   // unwinds). It must be self-contained on the Lua stack: a pcall frame can't see
   // the caller's stack slots, so any value `op` needs must be created inside it.
   // The light C-function trampoline is pushed without allocating, so the setup
-  // itself can never OOM.
+  // itself can never OOM. The `nargs` overload moves the top `nargs` values
+  // into the frame as its arguments (stack indices 1..nargs inside `op`); they
+  // are consumed either way.
   void RunProtected(const std::function<void()>& op) const;
+  void RunProtected(const std::function<void()>& op, int nargs) const;
+  // The body of SetGlobalPath / SetGlobalJson: walks `path` and assigns the
+  // value `push_value` pushes, all in one protected frame.
+  void AssignGlobalPath(const std::vector<std::string>& path,
+                        const std::function<void()>& push_value) const;
   // The operation + captured C++ exception for the active RunProtected call.
   struct ProtectedThunk {
     const std::function<void()>* op;
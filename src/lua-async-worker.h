@@ -98,3 +98,60 @@ private:
   Napi::Promise::Deferred deferred_;
   lua_core::ScriptResult result_;
 };
+
+struct LuaCoroStreamState;
+
+// Produces one batch of an iterate_async stream: resumes the coroutine up to
+// `count` times on a worker thread, off the event loop. Same deferral and
+// async-mode bracket as the script workers, so the body cannot call back into
+// JS. The collected yields cross to the main thread with the worker's
+// completion (no shared buffer is touched concurrently) and are converted and
+// queued for the consumer in OnOK.
+class LuaCoroutineBatchWorker : public Napi::AsyncWorker {
+public:
+  LuaCoroutineBatchWorker(
+    Napi::Env env,
+    std::shared_ptr<lua_core::LuaRuntime> runtime,
+    lua_core::LuaThreadRef thread,
+    size_t count,
+    LuaContext* context,
+    Napi::ObjectReference contextRef,
+    LuaCoroStreamState* state,
+    Napi::ObjectReference iteratorRef)
+    : Napi::AsyncWorker(env),
+      runtime_(std::move(runtime)),
+      thread_(std::move(thread)),
+      count_(count),
+      context_(context),
+      contextRef_(std::move(contextRef)),
+      state_(state),
+      // Keeps the iterator — and so `state_`, which its finalizer owns — alive
+      // until this worker is destroyed, even if the consumer drops it mid-batch.
+      iteratorRef_(std::move(iteratorRef)) {}
+
+protected:
+
+  void Execute() override {
+    // See LuaScriptAsyncWorker::Execute (H9c / H1).
+    runtime_->BeginWorkerUnrefDeferral();
+    runtime_->SetAsyncMode(true);
+    struct Teardown {
+      lua_core::LuaRuntime* rt;
+      ~Teardown() { rt->SetAsyncMode(false); rt->EndWorkerUnrefDeferral(); }
+    } teardown{runtime_.get()};
+    batch_ = runtime_->ResumeCoroutineBatch(thread_, count_, {});
+  }
+
+  void OnOK() override;
+  void OnError(const Napi::Error& error) override;
+
+private:
+  std::shared_ptr<lua_core::LuaRuntime> runtime_;
+  lua_core::LuaThreadRef thread_;
+  size_t count_;
+  LuaContext* context_;
+  Napi::ObjectReference contextRef_;
+  LuaCoroStreamState* state_;
+  Napi::ObjectReference iteratorRef_;
+  lua_core::CoroutineBatchResult batch_;
+};
@@ -1,10 +1,15 @@
 #include "lua-native.h"
 #include "lua-async-worker.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstdlib>
+#include <deque>
 #include <limits>
+#include <mutex>
 #include <optional>
 #include <functional>
+#include <set>
 
 // --- Built-in JS type conversion helpers (JS -> Lua) ---
 
@@ -59,6 +64,23 @@ static std::string BinaryBytesToString(const Napi::Value& value) {
   return len ? std::string(static_cast<const char*>(ab.Data()), len) : std::string();
 }
 
+// Element type of a TypedArray that crosses as a zero-copy numeric view in
+// `typedArrays: 'view'` mode. Byte arrays (Uint8Array, Uint8ClampedArray,
+// Buffer) keep the binary-string conversion — that is what they usually carry —
+// and the BigInt arrays have no lossless Lua element type.
+static std::optional<lua_core::NumericArrayType> NumericViewTypeOf(const Napi::TypedArray& ta) {
+  switch (ta.TypedArrayType()) {
+    case napi_int8_array: return lua_core::NumericArrayType::Int8;
+    case napi_int16_array: return lua_core::NumericArrayType::Int16;
+    case napi_uint16_array: return lua_core::NumericArrayType::Uint16;
+    case napi_int32_array: return lua_core::NumericArrayType::Int32;
+    case napi_uint32_array: return lua_core::NumericArrayType::Uint32;
+    case napi_float32_array: return lua_core::NumericArrayType::Float32;
+    case napi_float64_array: return lua_core::NumericArrayType::Float64;
+    default: return std::nullopt;
+  }
+}
+
 // Converts common JS built-in reference types to LuaValue. Returns nullopt if
 // `value` is not one of the handled types. `recurse` converts nested values
 // (Map values, Set elements) through the caller's conversion path so that
@@ -139,10 +161,28 @@ static bool RejectIfWorkerBusy(Napi::Env env, LuaTableRefData* data) {
   return false;
 }
 
+// The traps are created once per addon instance and shared by every table
+// Proxy, so they carry no data of their own: each call reads the LuaTableRefData
+// from the `_tableRef` External on the Proxy target (info[0]). The External
+// lives exactly as long as the target does, and the data is freed only by its
+// finalizer, so a pointer read here is always valid for the duration of the
+// call — no per-trap owner rooting is needed (H3). The marker is configurable
+// (the ownKeys invariant requires it), so `delete proxy._tableRef` forwards to
+// the target and removes it; from then on the Proxy behaves as released.
+// Throws and returns nullptr in that case.
+static LuaTableRefData* TrapTableRefData(const Napi::CallbackInfo& info) {
+  if (info.Length() > 0 && info[0].IsObject()) {
+    const Napi::Value marker = info[0].As<Napi::Object>().Get("_tableRef");
+    if (marker.IsExternal()) return marker.As<Napi::External<LuaTableRefData>>().Data();
+  }
+  Napi::Error::New(info.Env(), "table handle has been released").ThrowAsJavaScriptException();
+  return nullptr;
+}
+
 static Napi::Value TableRefGetTrap(const Napi::CallbackInfo& info) {
   Napi::Env env = info.Env();
-  auto* data = static_cast<LuaTableRefData*>(info.Data());
-  if (RejectIfWorkerBusy(env, data)) return env.Undefined();
+  auto* data = TrapTableRefData(info);
+  if (!data || RejectIfWorkerBusy(env, data)) return env.Undefined();
 
   auto target = info[0].As<Napi::Object>();
   auto prop = info[1];
@@ -184,8 +224,8 @@ static Napi::Value TableRefGetTrap(const Napi::CallbackInfo& info) {
 
 static Napi::Value TableRefSetTrap(const Napi::CallbackInfo& info) {
   Napi::Env env = info.Env();
-  auto* data = static_cast<LuaTableRefData*>(info.Data());
-  if (RejectIfWorkerBusy(env, data)) return env.Undefined();
+  auto* data = TrapTableRefData(info);
+  if (!data || RejectIfWorkerBusy(env, data)) return env.Undefined();
 
   auto prop = info[1];
   auto value = info[2];
@@ -215,8 +255,8 @@ static Napi::Value TableRefSetTrap(const Napi::CallbackInfo& info) {
 
 static Napi::Value TableRefHasTrap(const Napi::CallbackInfo& info) {
   Napi::Env env = info.Env();
-  auto* data = static_cast<LuaTableRefData*>(info.Data());
-  if (RejectIfWorkerBusy(env, data)) return env.Undefined();
+  auto* data = TrapTableRefData(info);
+  if (!data || RejectIfWorkerBusy(env, data)) return env.Undefined();
 
   auto prop = info[1];
 
@@ -246,8 +286,8 @@ static Napi::Value TableRefHasTrap(const Napi::CallbackInfo& info) {
 
 static Napi::Value TableRefOwnKeysTrap(const Napi::CallbackInfo& info) {
   Napi::Env env = info.Env();
-  auto* data = static_cast<LuaTableRefData*>(info.Data());
-  if (RejectIfWorkerBusy(env, data)) return env.Undefined();
+  auto* data = TrapTableRefData(info);
+  if (!data || RejectIfWorkerBusy(env, data)) return env.Undefined();
 
   // See TableRefGetTrap: a released Proxy fails clearly.
   if (data->tableRef.ref == LUA_NOREF) {
@@ -271,8 +311,8 @@ static Napi::Value TableRefOwnKeysTrap(const Napi::CallbackInfo& info) {
 
 static Napi::Value TableRefGetOwnPropertyDescriptorTrap(const Napi::CallbackInfo& info) {
   Napi::Env env = info.Env();
-  auto* data = static_cast<LuaTableRefData*>(info.Data());
-  if (RejectIfWorkerBusy(env, data)) return env.Undefined();
+  auto* data = TrapTableRefData(info);
+  if (!data || RejectIfWorkerBusy(env, data)) return env.Undefined();
 
   auto prop = info[1];
 
@@ -302,6 +342,19 @@ static Napi::Value TableRefGetOwnPropertyDescriptorTrap(const Napi::CallbackInfo
   return env.Undefined();
 }
 
+// Builds the trap handler every table Proxy of this addon instance shares.
+// Called once from InitModule; the handler is never reachable from JS.
+static Napi::Object CreateTableProxyHandler(const Napi::Env env) {
+  Napi::Object handler = Napi::Object::New(env);
+  (void)handler.Set("get", Napi::Function::New(env, TableRefGetTrap, "get"));
+  (void)handler.Set("set", Napi::Function::New(env, TableRefSetTrap, "set"));
+  (void)handler.Set("has", Napi::Function::New(env, TableRefHasTrap, "has"));
+  (void)handler.Set("ownKeys", Napi::Function::New(env, TableRefOwnKeysTrap, "ownKeys"));
+  (void)handler.Set("getOwnPropertyDescriptor", Napi::Function::New(
+    env, TableRefGetOwnPropertyDescriptorTrap, "getOwnPropertyDescriptor"));
+  return handler;
+}
+
 // --- Table handle method functions ---
 
 // Builds an explicitly-typed Lua table key from a LuaTableHandle argument. A JS
@@ -436,6 +489,133 @@ static Napi::Value TableHandleSet(const Napi::CallbackInfo& info) {
   return env.Undefined();
 }
 
+// Converts `count` JS keys into TableKeys for the bulk accessors. Throws a
+// TypeError naming `method` (and returns false) on the first unusable key.
+static bool NapiToTableKeys(const Napi::Env env, const char* method,
+                            const std::function<Napi::Value(uint32_t)>& at,
+                            const uint32_t count, std::vector<lua_core::TableKey>& out) {
+  out.reserve(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    lua_core::TableKey key;
+    if (!NapiToTableKey(at(i), key)) {
+      Napi::TypeError::New(env, std::string(method) + " keys must be strings or numbers")
+        .ThrowAsJavaScriptException();
+      return false;
+    }
+    out.push_back(std::move(key));
+  }
+  return true;
+}
+
+// get_many(keys) — reads every key in one protected frame (one crossing into
+// the core) and returns the values as an array in `keys` order. Reads honor
+// __index exactly as get() does.
+static Napi::Value TableHandleGetMany(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  auto* data = static_cast<LuaTableRefData*>(info.Data());
+  if (RejectIfWorkerBusy(env, data)) return env.Undefined();
+  if (!data || data->tableRef.ref == LUA_NOREF) {
+    Napi::Error::New(env, "table handle has been released").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (info.Length() < 1 || !info[0].IsArray()) {
+    Napi::TypeError::New(env, "get_many() requires an array of keys").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  const auto arr = info[0].As<Napi::Array>();
+  std::vector<lua_core::TableKey> keys;
+  if (!NapiToTableKeys(env, "get_many()", [&](uint32_t i) { return arr.Get(i); },
+                       arr.Length(), keys)) {
+    return env.Undefined();
+  }
+
+  try {
+    // See TableHandleGet: CallScope for the metamethod-capable reads (CR-8 F5).
+    LuaContext::CallScope scope(data->context);
+    const auto values = data->runtime->GetTableFieldsKeyed(data->tableRef.ref, keys);
+    Napi::Array result = Napi::Array::New(env, values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+      (void)result.Set(static_cast<uint32_t>(i), data->context->CoreToNapi(*values[i]));
+    }
+    return result;
+  } catch (const std::exception& e) {
+    Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+}
+
+// pick(...keys) — get_many() shaped as a plain object keyed by the requested
+// keys (as JS property names), for destructuring a config table in one call.
+static Napi::Value TableHandlePick(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  auto* data = static_cast<LuaTableRefData*>(info.Data());
+  if (RejectIfWorkerBusy(env, data)) return env.Undefined();
+  if (!data || data->tableRef.ref == LUA_NOREF) {
+    Napi::Error::New(env, "table handle has been released").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  std::vector<lua_core::TableKey> keys;
+  if (!NapiToTableKeys(env, "pick()", [&](uint32_t i) { return info[i]; },
+                       static_cast<uint32_t>(info.Length()), keys)) {
+    return env.Undefined();
+  }
+
+  try {
+    // See TableHandleGet: CallScope for the metamethod-capable reads (CR-8 F5).
+    LuaContext::CallScope scope(data->context);
+    const auto values = data->runtime->GetTableFieldsKeyed(data->tableRef.ref, keys);
+    Napi::Object result = Napi::Object::New(env);
+    for (size_t i = 0; i < values.size(); ++i) {
+      (void)result.Set(info[i], data->context->CoreToNapi(*values[i]));
+    }
+    return result;
+  } catch (const std::exception& e) {
+    Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+}
+
+// set_many(obj) — writes every own enumerable property of `obj` in one
+// protected frame. Property names are string keys verbatim, exactly as
+// set("name", v) would address them. Writes honor __newindex and apply in
+// property order; if one raises, the ones before it stay applied.
+static Napi::Value TableHandleSetMany(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  auto* data = static_cast<LuaTableRefData*>(info.Data());
+  if (RejectIfWorkerBusy(env, data)) return env.Undefined();
+  if (!data || data->tableRef.ref == LUA_NOREF) {
+    Napi::Error::New(env, "table handle has been released").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (info.Length() < 1 || !info[0].IsObject() || info[0].IsArray() || info[0].IsFunction()) {
+    Napi::TypeError::New(env, "set_many() requires a plain object").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  try {
+    LuaContext::CallScope scope(data->context);
+    // One collector spans every value conversion and the core call, so a later
+    // value (or the write itself) failing sweeps the callbacks minted by the
+    // earlier ones (F1), as in create_table().
+    LuaContext::JsCallbackCollectorScope collector(data->context);
+    const auto obj = info[0].As<Napi::Object>();
+    const auto names = obj.GetPropertyNames();
+    std::vector<std::pair<lua_core::TableKey, lua_core::LuaPtr>> entries;
+    entries.reserve(names.Length());
+    for (uint32_t i = 0; i < names.Length(); ++i) {
+      const Napi::Value name = names.Get(i);
+      entries.emplace_back(name.ToString().Utf8Value(),
+        std::make_shared<lua_core::LuaValue>(data->context->NapiToCoreInstance(obj.Get(name))));
+    }
+    data->runtime->SetTableFieldsKeyed(data->tableRef.ref, entries);
+  } catch (const std::exception& e) {
+    Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+  }
+  return env.Undefined();
+}
+
 static Napi::Value TableHandleHas(const Napi::CallbackInfo& info) {
   Napi::Env env = info.Env();
   auto* data = static_cast<LuaTableRefData*>(info.Data());
@@ -544,6 +724,205 @@ static Napi::Value TableHandleIPairs(const Napi::CallbackInfo& info) {
   }
 }
 
+// --- entries(): a streaming, bounded-memory pairs() walk ---
+
+static Napi::Value SymbolIteratorKey(Napi::Env env);
+static Napi::Value CoroIterResult(Napi::Env env, const Napi::Value& value, bool done);
+
+// One entries() iterator. Holds one core batch at a time and converts a single
+// entry per next(), so neither the whole table nor a JS array of it is ever
+// materialized. The cursor owns its own share of the table, so the walk is
+// unaffected by the handle being released meanwhile.
+struct LuaTableEntriesState {
+  std::shared_ptr<lua_core::LuaRuntime> runtime;
+  LuaContext* context = nullptr;
+  std::shared_ptr<std::atomic<bool>> contextAlive;
+  lua_core::LuaTableCursor cursor;
+  size_t batchSize = 256;
+  std::vector<std::pair<lua_core::LuaPtr, lua_core::LuaPtr>> batch;
+  size_t pos = 0;
+
+  explicit LuaTableEntriesState(lua_core::LuaTableRef table) : cursor(std::move(table)) {}
+
+  [[nodiscard]] bool ContextLive() const {
+    return context && contextAlive && contextAlive->load();
+  }
+};
+
+static Napi::Value TableEntriesNext(const Napi::CallbackInfo& info) {
+  const Napi::Env env = info.Env();
+  auto* state = static_cast<LuaTableEntriesState*>(info.Data());
+  if (!state || !state->ContextLive()) {
+    Napi::Error::New(env, "Lua table handle's context has been destroyed")
+      .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  if (state->pos == state->batch.size()) {
+    state->batch.clear();
+    state->pos = 0;
+    if (state->cursor.done) return CoroIterResult(env, env.Undefined(), true);
+    if (state->context->IsBusy()) {
+      Napi::Error::New(env, "Lua context is busy with an async operation")
+        .ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    try {
+      // Raw traversal: no metamethod runs, so no CallScope is needed (as for
+      // pairs()).
+      state->batch = state->runtime->NextTableEntries(state->cursor, state->batchSize);
+    } catch (const std::exception& e) {
+      Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    if (state->batch.empty()) return CoroIterResult(env, env.Undefined(), true);
+  }
+
+  auto& [key, value] = state->batch[state->pos++];
+  Napi::Array entry = Napi::Array::New(env, 2);
+  (void)entry.Set(static_cast<uint32_t>(0), state->context->CoreToNapi(*key));
+  (void)entry.Set(static_cast<uint32_t>(1), state->context->CoreToNapi(*value));
+  // Drop the converted entry's core values now rather than with the batch.
+  key.reset();
+  value.reset();
+  return CoroIterResult(env, entry, false);
+}
+
+// Called when a for..of loop exits early. Ends the walk and frees its cursor
+// slot immediately.
+static Napi::Value TableEntriesReturn(const Napi::CallbackInfo& info) {
+  const Napi::Env env = info.Env();
+  if (auto* state = static_cast<LuaTableEntriesState*>(info.Data())) {
+    state->cursor.close();
+    state->batch.clear();
+    state->pos = 0;
+  }
+  return CoroIterResult(env, info.Length() > 0 ? info[0] : env.Undefined(), true);
+}
+
+static Napi::Value TableEntriesSelf(const Napi::CallbackInfo& info) {
+  return info.This();
+}
+
+// entries({ batchSize }) — pairs() as an iterator that walks the table with
+// lua_next `batchSize` entries at a time (default 256), resuming from a key
+// anchored in the registry between batches. Adding keys to the table while a
+// walk is in progress is outside Lua's next() contract; if that rebuilds the
+// table, the next batch throws "table was modified during iteration".
+static Napi::Value TableHandleEntries(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  auto* data = static_cast<LuaTableRefData*>(info.Data());
+  if (RejectIfWorkerBusy(env, data)) return env.Undefined();
+  if (!data || data->tableRef.ref == LUA_NOREF) {
+    Napi::Error::New(env, "table handle has been released").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  size_t batchSize = 256;
+  if (info.Length() > 0 && !info[0].IsUndefined()) {
+    if (!info[0].IsObject()) {
+      Napi::TypeError::New(env, "entries() options must be an object")
+        .ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    const auto options = info[0].As<Napi::Object>();
+    if (options.Has("batchSize")) {
+      const auto batchVal = options.Get("batchSize");
+      if (!batchVal.IsNumber()) {
+        Napi::TypeError::New(env, "batchSize must be a number").ThrowAsJavaScriptException();
+        return env.Undefined();
+      }
+      const double n = batchVal.As<Napi::Number>().DoubleValue();
+      if (!(n >= 1) || !std::isfinite(n)) {
+        Napi::RangeError::New(env, "batchSize must be a positive integer")
+          .ThrowAsJavaScriptException();
+        return env.Undefined();
+      }
+      batchSize = static_cast<size_t>(n);
+    }
+  }
+
+  auto* state = new LuaTableEntriesState(data->tableRef);
+  state->runtime = data->runtime;
+  state->context = data->context;
+  state->contextAlive = data->contextAlive;
+  state->batchSize = batchSize;
+
+  const Napi::Object iterator = Napi::Object::New(env);
+  // Same ownership discipline as the coroutine iterators (H3 / L6): the
+  // External's finalizer solely owns `state`, rooted on the iterator and each
+  // method.
+  const auto owner = Napi::External<LuaTableEntriesState>::New(env, state,
+    [](Napi::Env, const LuaTableEntriesState* s) { delete s; });
+  DefineHiddenProp(env, iterator, "__tableEntriesOwner", owner, /*writable=*/false);
+  auto addMethod = [&](const char* name,
+                       Napi::Value (*cb)(const Napi::CallbackInfo&)) {
+    const Napi::Function fn = Napi::Function::New(env, cb, name, state);
+    DefineHiddenProp(env, fn, "__tableEntriesOwner", owner, /*writable=*/false);
+    (void)iterator.Set(name, fn);
+  };
+  addMethod("next", TableEntriesNext);
+  addMethod("return", TableEntriesReturn);
+  (void)iterator.Set(SymbolIteratorKey(env),
+    Napi::Function::New(env, TableEntriesSelf, "[Symbol.iterator]"));
+  return iterator;
+}
+
+// handle.run(chunk, ...args): runs a prepared chunk (lua.prepare) with this
+// table as its _ENV.
+static Napi::Value TableHandleRun(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  auto* data = static_cast<LuaTableRefData*>(info.Data());
+  if (RejectIfWorkerBusy(env, data)) return env.Undefined();
+  if (data->tableRef.ref == LUA_NOREF) {
+    Napi::Error::New(env, "table handle has been released").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  LuaPreparedChunkData* chunk = nullptr;
+  if (info.Length() > 0 && info[0].IsObject()) {
+    const Napi::Value marker = info[0].As<Napi::Object>().Get("_preparedChunk");
+    if (marker.IsExternal()) chunk = marker.As<Napi::External<LuaPreparedChunkData>>().Data();
+  }
+  if (!chunk) {
+    Napi::TypeError::New(env, "run() requires a chunk from prepare()").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  // Same policy as execute_script_in: a ref minted by another context (or by
+  // this one before a reset()) addresses an unrelated registry slot.
+  if (chunk->runtime.get() != data->runtime.get()) {
+    Napi::Error::New(env, "prepared chunk belongs to a different Lua context")
+      .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (chunk->chunk.ref == LUA_NOREF) {
+    Napi::Error::New(env, "prepared chunk has been released").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  // One collector across the arguments, as in LuaFunctionCallbackStatic (F1).
+  LuaContext::JsCallbackCollectorScope collector(data->context);
+  std::vector<lua_core::LuaPtr> args;
+  args.reserve(info.Length() - 1);
+  try {
+    for (size_t i = 1; i < info.Length(); ++i) {
+      args.push_back(std::make_shared<lua_core::LuaValue>(
+        data->context->NapiToCoreInstance(info[i])));
+    }
+  } catch (const std::exception& e) {
+    Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  LuaContext::CallScope _cs(data->context);
+  const auto result = data->runtime->RunPreparedChunk(chunk->chunk, data->tableRef.ref, args);
+  if (std::holds_alternative<std::string>(result)) {
+    data->context->ThrowLuaError(std::get<std::string>(result));
+    return env.Undefined();
+  }
+  return data->context->ResultsToJs(std::get<std::vector<lua_core::LuaPtr>>(result));
+}
+
 static Napi::Value TableHandleRelease(const Napi::CallbackInfo& info) {
   Napi::Env env = info.Env();
   auto* data = static_cast<LuaTableRefData*>(info.Data());
@@ -632,6 +1011,84 @@ Napi::Function SharedTable::DefineSharedTable(const Napi::Env env) {
   });
 }
 
+// Plain data a snapshot can look inside: arrays, and objects whose prototype is
+// Object.prototype or null. Anything else — a class instance, a Date, a Map — is
+// compared by identity, which is also how a registered type converter sees it.
+static bool IsPlainSharedContainer(const Napi::Env env, const Napi::Value& value,
+                                   const Napi::Value& objectProto) {
+  if (!value.IsObject() || value.IsFunction()) return false;
+  if (value.IsArray()) return true;
+  napi_value proto;
+  if (napi_get_prototype(env, value, &proto) != napi_ok) return false;
+  const Napi::Value p(env, proto);
+  return p.IsNull() || p.StrictEquals(objectProto);
+}
+
+static Napi::Value ObjectPrototypeOf(const Napi::Env env) {
+  return env.Global().Get("Object").As<Napi::Object>().Get("prototype");
+}
+
+// A copy of `value` as sync() will later need to compare it: plain containers
+// are copied level by level (bounded like every other JS->Lua walk), leaves are
+// held by reference. Keys are defined, not assigned, so a "__proto__" key in the
+// data stays an ordinary property of the copy.
+static Napi::Value SnapshotSharedValue(const Napi::Env env, const Napi::Value& value,
+                                       const Napi::Value& objectProto, int depth) {
+  if (depth > lua_core::LuaRuntime::kMaxDepth ||
+      !IsPlainSharedContainer(env, value, objectProto)) {
+    return value;
+  }
+  const auto src = value.As<Napi::Object>();
+  const Napi::Array names = src.GetPropertyNames();
+  Napi::Object copy = value.IsArray()
+    ? Napi::Array::New(env, value.As<Napi::Array>().Length())
+    : Napi::Object::New(env);
+  for (uint32_t i = 0; i < names.Length(); ++i) {
+    const Napi::Value key = names.Get(i);
+    copy.DefineProperty(Napi::PropertyDescriptor::Value(
+      key.As<Napi::Name>(),
+      SnapshotSharedValue(env, src.Get(key), objectProto, depth + 1),
+      napi_default_jsproperty));
+  }
+  return copy;
+}
+
+// Whether `value` still matches what SnapshotSharedValue recorded. Strict
+// equality, except that NaN matches NaN (a NaN field must not be re-sent on
+// every sync) and plain containers are compared by contents. Past the depth
+// bound the answer is "changed": a push is the safe side of the ambiguity.
+static bool SameAsSnapshot(const Napi::Env env, const Napi::Value& value,
+                           const Napi::Value& snap, const Napi::Value& objectProto,
+                           int depth) {
+  if (value.StrictEquals(snap)) return true;
+  if (value.IsNumber() && snap.IsNumber()) {
+    return std::isnan(value.As<Napi::Number>().DoubleValue()) &&
+           std::isnan(snap.As<Napi::Number>().DoubleValue());
+  }
+  if (depth > lua_core::LuaRuntime::kMaxDepth) return false;
+  if (!IsPlainSharedContainer(env, value, objectProto) ||
+      !IsPlainSharedContainer(env, snap, objectProto) ||
+      value.IsArray() != snap.IsArray()) {
+    return false;
+  }
+  if (value.IsArray() &&
+      value.As<Napi::Array>().Length() != snap.As<Napi::Array>().Length()) {
+    return false;
+  }
+  const auto obj = value.As<Napi::Object>();
+  const auto old = snap.As<Napi::Object>();
+  const Napi::Array names = obj.GetPropertyNames();
+  if (names.Length() != old.GetPropertyNames().Length()) return false;
+  for (uint32_t i = 0; i < names.Length(); ++i) {
+    const Napi::Value key = names.Get(i);
+    if (!old.HasOwnProperty(key)) return false;
+    if (!SameAsSnapshot(env, obj.Get(key), old.Get(key), objectProto, depth + 1)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 SharedTable::SharedTable(const Napi::CallbackInfo& info) : ObjectWrap(info) {
   const Napi::Env env_ = info.Env();
 
@@ -649,6 +1106,30 @@ SharedTable::SharedTable(const Napi::CallbackInfo& info) : ObjectWrap(info) {
   } else {
     value_ = Napi::Persistent(Napi::Object::New(env_));
   }
+
+  if (info.Length() > 1 && !info[1].IsUndefined()) {
+    if (!info[1].IsObject() || info[1].IsFunction()) {
+      Napi::TypeError::New(env_,
+        "createSharedTable(initial, options) requires an options object")
+        .ThrowAsJavaScriptException();
+      return;
+    }
+    lazy_ = info[1].As<Napi::Object>().Get("lazy").ToBoolean().Value();
+  }
+
+  // The baseline sync() diffs against: the value as every future subscriber
+  // will first receive it. A lazy table has no pushes to diff.
+  snapshot_ = Napi::Persistent(Napi::Object::New(env_));
+  if (lazy_) return;
+  const Napi::Value objectProto = ObjectPrototypeOf(env_);
+  const Napi::Object value = value_.Value();
+  const Napi::Array names = value.GetPropertyNames();
+  for (uint32_t i = 0; i < names.Length(); ++i) {
+    const Napi::Value key = names.Get(i);
+    snapshot_.Value().DefineProperty(Napi::PropertyDescriptor::Value(
+      key.As<Napi::Name>(), SnapshotSharedValue(env_, value.Get(key), objectProto, 1),
+      napi_default_jsproperty));
+  }
 }
 
 void SharedTable::PushValue(const Napi::Object& context, const std::string& name,
@@ -667,8 +1148,22 @@ void SharedTable::PushValue(const Napi::Object& context, const std::string& name
     {Napi::String::New(env_, name), value});
 }
 
-void SharedTable::PushTo(const Napi::Object& context, const std::string& name) const {
+// A delta is the same set_global call with a dotted path, `name.key`, which
+// assigns the one field of the context's existing table (creating the table if
+// Lua dropped it) and leaves every other field alone.
+void SharedTable::PushField(const Napi::Object& context, const std::string& name,
+                            const std::string& key, const Napi::Value& value) {
+  PushValue(context, name + "." + key, value);
+}
+
+void SharedTable::PushTo(const Napi::Object& context, const std::string& name) {
   PushValue(context, name, value_.Value());
+  for (const auto& sub : subscribers_) {
+    const Napi::Object ctx = sub.context.Value();
+    if (!ctx.IsEmpty() && ctx.StrictEquals(context) && sub.name == name) {
+      *sub.stale = false;
+    }
+  }
 }
 
 void SharedTable::Subscribe(const Napi::Object& context, const std::string& name) {
@@ -683,7 +1178,20 @@ void SharedTable::Subscribe(const Napi::Object& context, const std::string& name
   subscribers_.push_back(std::move(sub));
 }
 
-void SharedTable::Propagate(const Napi::Env env_) {
+void SharedTable::Remember(const Napi::Env env_, const std::string& key) {
+  const Napi::Object value = value_.Value();
+  Napi::Object snapshot = snapshot_.Value();
+  if (value.HasOwnProperty(key)) {
+    snapshot.DefineProperty(Napi::PropertyDescriptor::Value(
+      key, SnapshotSharedValue(env_, value.Get(key), ObjectPrototypeOf(env_), 1),
+      napi_default_jsproperty));
+  } else {
+    (void)snapshot.Delete(key);
+  }
+}
+
+void SharedTable::Propagate(const Napi::Env env_, const std::vector<std::string>& keys,
+                            const bool full) {
   // Snapshot the live subscribers first. Pushing runs user JS (type converters,
   // a __newindex host callback on the target global), which could construct
   // another context that subscribes to this table — mutating subscribers_ while
@@ -692,6 +1200,7 @@ void SharedTable::Propagate(const Napi::Env env_) {
   struct Target {
     Napi::Object context;
     std::string name;
+    std::shared_ptr<bool> stale;
   };
   std::vector<Target> targets;
   targets.reserve(subscribers_.size());
@@ -700,21 +1209,39 @@ void SharedTable::Propagate(const Napi::Env env_) {
   for (auto it = subscribers_.begin(); it != subscribers_.end(); ++it) {
     const Napi::Object ctx = it->context.Value();  // weak: empty once collected
     if (ctx.IsEmpty()) continue;                   // drop the dead entry
-    targets.push_back({ctx, it->name});
+    targets.push_back({ctx, it->name, it->stale});
     if (live != it) *live = std::move(*it);
     ++live;
   }
   subscribers_.erase(live, subscribers_.end());
 
-  const Napi::Value value = value_.Value();
+  const Napi::Object value = value_.Value();
+  // A key that is empty or contains a dot can't be addressed as one path
+  // segment, so a delta touching one falls back to the whole value.
+  bool whole = full || value.IsArray();
+  for (const auto& key : keys) {
+    if (key.empty() || key.find('.') != std::string::npos) whole = true;
+  }
+
   std::string failures;
   size_t failed = 0;
   for (const auto& target : targets) {
     try {
-      PushValue(target.context, target.name, value);
+      if (whole || *target.stale) {
+        PushValue(target.context, target.name, value);
+      } else {
+        // Read per key at push time: undefined for a removed key, which
+        // set_global writes as nil.
+        for (const auto& key : keys) {
+          PushField(target.context, target.name, key, value.Get(key));
+        }
+      }
+      *target.stale = false;
     } catch (const Napi::Error& e) {
       // Keep going: one unavailable context (busy with an async op, say) must
-      // not silently skip the updates the others can still receive.
+      // not silently skip the updates the others can still receive. It has
+      // missed a delta now, so its next update re-sends everything.
+      *target.stale = true;
       ++failed;
       if (!failures.empty()) failures += "; ";
       failures += target.name;
@@ -748,17 +1275,68 @@ Napi::Value SharedTable::Set(const Napi::CallbackInfo& info) {
       .ThrowAsJavaScriptException();
     return env_.Undefined();
   }
-  (void)value_.Value().Set(info[0].As<Napi::String>(), info[1]);
-  Propagate(env_);  // a failed push throws after every other context is updated
+  const std::string key = info[0].As<Napi::String>().Utf8Value();
+  (void)value_.Value().Set(key, info[1]);
+  if (lazy_) {
+    version_->fetch_add(1, std::memory_order_release);  // readers re-pull
+    return env_.Undefined();
+  }
+  // Only this key changed, so only this key is sent — and remembered, so a
+  // later sync() doesn't send it again.
+  Remember(env_, key);
+  Propagate(env_, {key}, false);  // a failed push throws after every other context is updated
   return env_.Undefined();
 }
 
+// sync() / sync({ full: true }). The default sends only the top-level keys that
+// differ from what was last published (nil for removed ones); `full` re-pushes
+// the whole value, e.g. after Lua code replaced or emptied its copy. On a lazy
+// table both only bump the version the contexts check on their next read.
 Napi::Value SharedTable::Sync(const Napi::CallbackInfo& info) {
   const Napi::Env env_ = info.Env();
-  Propagate(env_);
+  bool full = false;
+  if (info.Length() > 0 && !info[0].IsUndefined()) {
+    if (!info[0].IsObject() || info[0].IsFunction()) {
+      Napi::TypeError::New(env_, "sync(options) requires an options object")
+        .ThrowAsJavaScriptException();
+      return env_.Undefined();
+    }
+    full = info[0].As<Napi::Object>().Get("full").ToBoolean().Value();
+  }
+  if (lazy_) {
+    // No diff to take: invalidating is already as cheap as it gets.
+    version_->fetch_add(1, std::memory_order_release);
+    return env_.Undefined();
+  }
+
+  // Diff against the snapshot before any JS runs: changed and added keys from
+  // the live value, then keys only the snapshot still has (removed ones).
+  const Napi::Value objectProto = ObjectPrototypeOf(env_);
+  const Napi::Object value = value_.Value();
+  const Napi::Object snapshot = snapshot_.Value();
+  std::vector<std::string> changed;
+  const Napi::Array names = value.GetPropertyNames();
+  for (uint32_t i = 0; i < names.Length(); ++i) {
+    const Napi::Value key = names.Get(i);
+    if (!snapshot.HasOwnProperty(key) ||
+        !SameAsSnapshot(env_, value.Get(key), snapshot.Get(key), objectProto, 1)) {
+      changed.push_back(key.ToString().Utf8Value());
+    }
+  }
+  const Napi::Array oldNames = snapshot.GetPropertyNames();
+  for (uint32_t i = 0; i < oldNames.Length(); ++i) {
+    const Napi::Value key = oldNames.Get(i);
+    if (!value.HasOwnProperty(key)) changed.push_back(key.ToString().Utf8Value());
+  }
+  for (const auto& key : changed) Remember(env_, key);
+
+  // Even with nothing changed, stale subscribers still get their full push.
+  Propagate(env_, changed, full);
   return env_.Undefined();
 }
 
+static bool SplitGlobalPath(const std::string& name, std::vector<std::string>& out);
+
 // Resolves a `shared` option entry to its SharedTable, or nullptr if the value
 // wasn't minted by createSharedTable(). The InstanceOf check matters: Unwrap on
 // an arbitrary object would read a garbage pointer out of it.
@@ -771,17 +1349,142 @@ static SharedTable* AsSharedTable(const Napi::Env env, const Napi::Value& value)
   return SharedTable::Unwrap(obj);
 }
 
+// --- SharedDataStore: one native data tree read by many contexts ---
+
+// Reads a JS value straight into the builder: the same mapping set_global
+// applies (null/undefined -> nil, integral numbers -> integers, arrays ->
+// 1-based sequences, objects by their enumerable string keys), minus
+// everything that can't be plain data. Returns the value's node.
+static uint32_t BuildSharedDataNode(lua_core::SharedDataBuilder& builder,
+                                    const Napi::Value& value, const int depth) {
+  if (depth > lua_core::LuaRuntime::kMaxDepth) {
+    throw std::runtime_error("Value nesting depth exceeds the maximum of "
+      + std::to_string(lua_core::LuaRuntime::kMaxDepth) + " levels");
+  }
+  switch (value.Type()) {
+    case napi_undefined:
+    case napi_null:
+      return builder.AddNil();
+    case napi_boolean:
+      return builder.AddBoolean(value.As<Napi::Boolean>().Value());
+    case napi_number: {
+      const double num = value.As<Napi::Number>().DoubleValue();
+      // Same integer test as NapiToCoreImpl, 2^63 bound included.
+      constexpr double kInt64UpperExclusive = 9223372036854775808.0;  // 2^63
+      double intpart;
+      if (std::isfinite(num) && num >= static_cast<double>(std::numeric_limits<int64_t>::min()) &&
+          num < kInt64UpperExclusive && std::modf(num, &intpart) == 0.0) {
+        return builder.AddInteger(static_cast<int64_t>(num));
+      }
+      return builder.AddNumber(num);
+    }
+    case napi_string:
+      return builder.AddString(value.As<Napi::String>().Utf8Value());
+    case napi_object: {
+      if (value.IsArray()) {
+        const auto arr = value.As<Napi::Array>();
+        const uint32_t node = builder.AddArray(arr.Length());
+        for (uint32_t i = 0; i < arr.Length(); ++i) {
+          builder.SetElement(node, i, BuildSharedDataNode(builder, arr.Get(i), depth + 1));
+        }
+        return node;
+      }
+      const auto obj = value.As<Napi::Object>();
+      const Napi::Array keys = obj.GetPropertyNames();
+      const uint32_t node = builder.AddObject(keys.Length());
+      for (uint32_t i = 0; i < keys.Length(); ++i) {
+        const Napi::Value key = keys.Get(i);
+        builder.SetEntry(node, i, key.ToString().Utf8Value(),
+                         BuildSharedDataNode(builder, obj.Get(key), depth + 1));
+      }
+      return node;
+    }
+    default:
+      break;
+  }
+  throw std::runtime_error(
+    "shared data can only hold plain data (null, booleans, numbers, strings, "
+    "arrays and objects)");
+}
+
+// The root must be a container: it is bound as a global view, and a view of a
+// scalar would index as an empty table rather than read as the value.
+static std::shared_ptr<const lua_core::SharedData> BuildSharedData(const Napi::Value& value) {
+  if (!value.IsObject() || value.IsFunction()) {
+    throw std::runtime_error("shared data must be an object or an array");
+  }
+  lua_core::SharedDataBuilder builder;
+  const uint32_t root = BuildSharedDataNode(builder, value, 0);
+  return builder.Finish(root);
+}
+
+Napi::Function SharedDataStore::DefineSharedData(const Napi::Env env) {
+  return DefineClass(env, "SharedData", {
+    InstanceMethod("update", &SharedDataStore::Update),
+    InstanceMethod("version", &SharedDataStore::Version),
+    InstanceMethod("byteSize", &SharedDataStore::ByteSize)
+  });
+}
+
+SharedDataStore::SharedDataStore(const Napi::CallbackInfo& info) : ObjectWrap(info) {
+  const Napi::Env env_ = info.Env();
+  try {
+    slot_ = std::make_shared<lua_core::SharedDataSlot>(
+      BuildSharedData(info.Length() > 0 ? info[0] : env_.Undefined()));
+  } catch (const std::exception& e) {
+    Napi::TypeError::New(env_, std::string("createSharedData(value): ") + e.what())
+      .ThrowAsJavaScriptException();
+  }
+}
+
+// update(value): build the replacement first, then swap it in — a value that
+// fails to convert leaves the current version in place.
+Napi::Value SharedDataStore::Update(const Napi::CallbackInfo& info) {
+  const Napi::Env env_ = info.Env();
+  try {
+    slot_->Store(BuildSharedData(info.Length() > 0 ? info[0] : env_.Undefined()));
+  } catch (const std::exception& e) {
+    Napi::TypeError::New(env_, std::string("update(value): ") + e.what())
+      .ThrowAsJavaScriptException();
+  }
+  return env_.Undefined();
+}
+
+Napi::Value SharedDataStore::Version(const Napi::CallbackInfo& info) {
+  return Napi::Number::New(info.Env(), static_cast<double>(slot_->version()));
+}
+
+Napi::Value SharedDataStore::ByteSize(const Napi::CallbackInfo& info) {
+  const auto data = slot_->Load();
+  return Napi::Number::New(info.Env(), static_cast<double>(data ? data->ByteSize() : 0));
+}
+
+// Resolves a `shared` option entry to its SharedDataStore, or nullptr; see
+// AsSharedTable for why the InstanceOf check comes first.
+static SharedDataStore* AsSharedData(const Napi::Env env, const Napi::Value& value) {
+  if (!value.IsObject() || value.IsFunction()) return nullptr;
+  const auto* data = env.GetInstanceData<AddonData>();
+  if (!data || data->sharedDataConstructor.IsEmpty()) return nullptr;
+  const auto obj = value.As<Napi::Object>();
+  if (!obj.InstanceOf(data->sharedDataConstructor.Value())) return nullptr;
+  return SharedDataStore::Unwrap(obj);
+}
+
 Napi::Object LuaContext::Init(const Napi::Env env, const Napi::Object exports) {
   const Napi::Function func = DefineClass(env, "LuaContext", {
     InstanceMethod("execute_script", &LuaContext::ExecuteScript),
     InstanceMethod("execute_file", &LuaContext::ExecuteFile),
     InstanceMethod("set_global", &LuaContext::SetGlobal),
     InstanceMethod("get_global", &LuaContext::GetGlobal),
+    InstanceMethod("set_global_json", &LuaContext::SetGlobalJson),
+    InstanceMethod("execute_script_json", &LuaContext::ExecuteScriptJson),
+    InstanceMethod("register_fast_function", &LuaContext::RegisterFastFunction),
     InstanceMethod("call", &LuaContext::Call),
     InstanceMethod("set_userdata", &LuaContext::SetUserdata),
     InstanceMethod("set_metatable", &LuaContext::SetMetatable),
     InstanceMethod("create_coroutine", &LuaContext::CreateCoroutine),
     InstanceMethod("resume", &LuaContext::ResumeCoroutine),
+    InstanceMethod("iterate_async", &LuaContext::IterateAsync),
     InstanceMethod("execute_script_async", &LuaContext::ExecuteScriptAsync),
     InstanceMethod("execute_file_async", &LuaContext::ExecuteFileAsync),
     InstanceMethod("execute_async", &LuaContext::ExecuteAsync),
@@ -791,16 +1494,21 @@ Napi::Object LuaContext::Init(const Napi::Env env, const Napi::Object exports) {
     InstanceMethod("register_module", &LuaContext::RegisterModule),
     InstanceMethod("compile", &LuaContext::Compile),
     InstanceMethod("compile_file", &LuaContext::CompileFile),
+    InstanceMethod("prepare", &LuaContext::Prepare),
     InstanceMethod("load_bytecode", &LuaContext::LoadBytecode),
     InstanceMethod("create_table", &LuaContext::CreateTableMethod),
     InstanceMethod("get_global_ref", &LuaContext::GetGlobalRef),
     InstanceMethod("create_environment", &LuaContext::CreateEnvironment),
+    InstanceMethod("create_environment_template", &LuaContext::CreateEnvironmentTemplate),
     InstanceMethod("execute_script_in", &LuaContext::ExecuteScriptIn),
+    InstanceMethod("set_environment_limits", &LuaContext::SetEnvironmentLimits),
+    InstanceMethod("get_environment_usage", &LuaContext::GetEnvironmentUsage),
     InstanceMethod("get_memory_usage", &LuaContext::GetMemoryUsage),
     InstanceMethod("info", &LuaContext::Info),
     InstanceMethod("register_type_converter", &LuaContext::RegisterTypeConverter),
     InstanceMethod("register_from_lua_converter", &LuaContext::RegisterFromLuaConverter),
     InstanceMethod("register_class", &LuaContext::RegisterClass),
+    InstanceMethod("flush_fields", &LuaContext::FlushFields),
     InstanceMethod("pcall", &LuaContext::Pcall),
     InstanceMethod("set_print_handler", &LuaContext::SetPrintHandler),
     InstanceMethod("set_hook", &LuaContext::SetHook),
@@ -883,6 +1591,34 @@ LuaContext::LuaContext(const Napi::CallbackInfo& info)
       }
     }
 
+    // Check for coroutinePoolSize option (finished coroutine threads kept for
+    // reuse by create_coroutine / execute_async; 0 disables reuse)
+    size_t coroutine_pool_size = 0;
+    bool has_coroutine_pool = false;
+    if (options.Has("coroutinePoolSize")) {
+      auto poolVal = options.Get("coroutinePoolSize");
+      if (poolVal.IsNumber()) {
+        double poolNum = poolVal.As<Napi::Number>().DoubleValue();
+        if (poolNum < 0) {
+          Napi::RangeError::New(env, "coroutinePoolSize must be a non-negative number").ThrowAsJavaScriptException();
+          return;
+        }
+        coroutine_pool_size = static_cast<size_t>(poolNum);
+        has_coroutine_pool = true;
+      } else if (!poolVal.IsUndefined() && !poolVal.IsNull()) {
+        Napi::TypeError::New(env, "coroutinePoolSize must be a number").ThrowAsJavaScriptException();
+        return;
+      }
+    }
+
+    // Check for environmentAccounting option (tag allocations by environment
+    // so set_environment_limits can cap each one's memory)
+    bool environment_accounting = false;
+    if (options.Has("environmentAccounting")) {
+      const Napi::Value v = options.Get("environmentAccounting");
+      if (!v.IsUndefined() && !v.IsNull()) environment_accounting = v.ToBoolean().Value();
+    }
+
     // Parse libraries
     std::vector<std::string> libraries;
     bool has_libraries = false;
@@ -918,12 +1654,15 @@ LuaContext::LuaContext(const Napi::CallbackInfo& info)
 
     // Create runtime with appropriate constructor
     try {
-      if (has_max_memory || has_max_instructions || has_timeout) {
+      if (has_max_memory || has_max_instructions || has_timeout || has_coroutine_pool ||
+          environment_accounting) {
         lua_core::RuntimeConfig config;
         config.libraries = std::move(libraries);
         config.max_memory = max_memory;
         config.max_instructions = max_instructions;
         config.timeout_ms = timeout_ms;
+        config.coroutine_pool_size = coroutine_pool_size;
+        config.environment_accounting = environment_accounting;
         runtime = std::make_shared<lua_core::LuaRuntime>(config);
       } else if (has_libraries) {
         runtime = std::make_shared<lua_core::LuaRuntime>(libraries);
@@ -957,6 +1696,18 @@ LuaContext::LuaContext(const Napi::CallbackInfo& info)
   if (info.Length() > 1 && info[1].IsObject()) {
     auto options = info[1].As<Napi::Object>();
     try {
+      // typedArrays: 'copy' (default) converts every TypedArray to a byte
+      // string; 'view' passes the numeric ones to Lua as a zero-copy view.
+      if (options.Has("typedArrays")) {
+        const auto modeVal = options.Get("typedArrays");
+        const std::string mode = modeVal.IsString() ? modeVal.As<Napi::String>().Utf8Value() : "";
+        if (mode == "view") {
+          typed_array_views_ = true;
+        } else if (mode != "copy" && !modeVal.IsUndefined() && !modeVal.IsNull()) {
+          Napi::TypeError::New(env, "typedArrays must be 'copy' or 'view'").ThrowAsJavaScriptException();
+          return;
+        }
+      }
       if (options.Has("allowBytecode") && options.Get("allowBytecode").IsBoolean() &&
           !options.Get("allowBytecode").As<Napi::Boolean>().Value()) {
         allow_bytecode_ = false;
@@ -972,7 +1723,7 @@ LuaContext::LuaContext(const Napi::CallbackInfo& info)
   }
 
   // Shared state: subscribe to each SharedTable and publish its current value
-  // as a global. Done last, because subscribing pushes the value through this
+  // as a global (a SharedData store is bound as a view instead). Done last, because subscribing pushes the value through this
   // context's own set_global — which needs the runtime, the handlers, and the
   // type converters all in place. A failure here throws from `new`, so it must
   // be reported the way every other constructor failure is (a pending JS
@@ -990,7 +1741,7 @@ LuaContext::LuaContext(const Napi::CallbackInfo& info)
         }
         // A shared table handed over directly has no own enumerable keys, so it
         // would otherwise subscribe nothing at all — silently. Name the mistake.
-        if (AsSharedTable(env, sharedVal)) {
+        if (AsSharedTable(env, sharedVal) || AsSharedData(env, sharedVal)) {
           Napi::TypeError::New(env,
             "shared must be an object mapping global names to shared tables "
             "(e.g. { settings: sharedTable }), not a shared table itself")
@@ -1002,14 +1753,51 @@ LuaContext::LuaContext(const Napi::CallbackInfo& info)
         for (uint32_t i = 0; i < names.Length(); ++i) {
           const std::string name = names.Get(i).As<Napi::String>().Utf8Value();
           const Napi::Value entry = sharedObj.Get(name);
+          // A SharedData store is bound, not subscribed: the view reads the
+          // store's slot, so there is nothing to push now or on update().
+          if (SharedDataStore* store = AsSharedData(env, entry)) {
+            std::vector<std::string> path;
+            if (!SplitGlobalPath(name, path)) {
+              Napi::TypeError::New(env, "Invalid global path '" + name +
+                "': path segments must be non-empty (no leading, trailing, or doubled dots)")
+                .ThrowAsJavaScriptException();
+              return;
+            }
+            try {
+              runtime->SetGlobalSharedData(path, store->slot());
+            } catch (const std::exception& e) {
+              Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+              return;
+            }
+            shared_data_.emplace_back(store->slot(), std::move(path));
+            continue;
+          }
           SharedTable* table = AsSharedTable(env, entry);
           if (!table) {
             Napi::TypeError::New(env,
               "shared." + name +
-              " must be a shared table created with createSharedTable()")
+              " must be a shared table created with createSharedTable() or createSharedData()")
               .ThrowAsJavaScriptException();
             return;
           }
+          if (table->lazy()) {
+            std::vector<std::string> path;
+            if (!SplitGlobalPath(name, path)) {
+              Napi::TypeError::New(env, "Invalid global path '" + name +
+                "': path segments must be non-empty (no leading, trailing, or doubled dots)")
+                .ThrowAsJavaScriptException();
+              return;
+            }
+            try {
+              BindLazySharedTable(path, table);
+            } catch (const std::exception& e) {
+              Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+              return;
+            }
+            shared_tables_.emplace_back(
+              Napi::Persistent(entry.As<Napi::Object>()), name);
+            continue;
+          }
           try {
             table->Subscribe(info.This().As<Napi::Object>(), name);
           } catch (const Napi::Error& e) {
@@ -1028,10 +1816,90 @@ LuaContext::LuaContext(const Napi::CallbackInfo& info)
   }
 }
 
+void LuaContext::BindLazySharedTable(const std::vector<std::string>& path,
+                                     SharedTable* table) {
+  // `table` outlives the binding: shared_tables_ holds its JS object for as
+  // long as this context (and so the runtime the source lives in) exists.
+  auto source = std::make_shared<lua_core::LazyTableSource>();
+  source->version = table->version();
+  // A throwing getter, proxy trap or type converter surfaces either as a thrown
+  // Napi::Error or as an exception left pending with a placeholder result.
+  // Either way the read fails as a Lua error, and the JS exception doesn't
+  // outlive it.
+  const auto pull = [this](const std::function<lua_core::LuaValue()>& read) {
+    Napi::HandleScope scope(env);
+    std::string error;
+    try {
+      lua_core::LuaValue value = read();
+      if (!env.IsExceptionPending()) return std::make_shared<lua_core::LuaValue>(std::move(value));
+      error = env.GetAndClearPendingException().Message();
+    } catch (const Napi::Error& e) {
+      error = e.Message();
+    }
+    throw std::runtime_error(error);
+  };
+  source->fetch = [this, table, pull](const std::string& key) {
+    return pull([&]() {
+      const Napi::Object value = table->shared_value();
+      Napi::Value field = env.Undefined();
+      if (value.IsArray()) {
+        // Lua reads a shared array 1-based, as the eager push lays it out. Only
+        // the canonical spelling of an index names an element: strtoull would
+        // also take " 1", "+1", "01", or wrap "-1" around, so t["01"] would
+        // alias t[1]. Digits only, no leading zero, and short enough not to
+        // overflow.
+        const bool canonical = !key.empty() && key.size() <= 10 && key[0] != '0' &&
+          key.find_first_not_of("0123456789") == std::string::npos;
+        if (canonical) {
+          const unsigned long long i = std::stoull(key);
+          if (i <= value.As<Napi::Array>().Length()) {
+            field = value.Get(static_cast<uint32_t>(i - 1));
+          }
+        }
+      } else if (value.HasOwnProperty(key)) {
+        // Own properties only, so `toString` and friends don't leak through.
+        field = value.Get(key);
+      }
+      if (env.IsExceptionPending()) return lua_core::LuaValue::nil();
+      return NapiToCoreInstance(field);
+    });
+  };
+  source->fetch_all = [this, table, pull]() {
+    return pull([&]() { return NapiToCoreInstance(table->shared_value()); });
+  };
+  runtime->SetGlobalLazyTable(path, std::move(source));
+}
+
 void LuaContext::InstallRuntimeHandlers() {
   // Set up userdata GC callback
   runtime->SetUserdataGCCallback([this](int ref_id) {
-    js_userdata_.erase(ref_id);
+    // Lua's last reference is gone: hand the final field values to the object.
+    if (runtime->ClassFieldsDirty(ref_id)) {
+      Napi::HandleScope scope(env);
+      FlushClassFields(ref_id);
+    }
+    js_userdata_.Erase(ref_id);
+  });
+
+  // Numeric array views re-read their TypedArray before Lua touches its
+  // memory: a transfer or postMessage may have detached the buffer since the
+  // view was made, and the view then reads as gone rather than as a dangling
+  // pointer. Runs on a view's first use after each entry into Lua and after
+  // each host callback returns (see CallScope), from inside a Lua C function,
+  // so it opens its own HandleScope.
+  runtime->SetNumericViewResolver([this](int ref_id, lua_core::NumericArrayView& view) {
+    Napi::HandleScope scope(env);
+    const UserdataEntry* entry = js_userdata_.Find(ref_id);
+    if (!entry) return false;
+    const Napi::Value value = entry->object.Value();
+    if (!value.IsTypedArray()) return false;
+    const auto ta = value.As<Napi::TypedArray>();
+    Napi::ArrayBuffer buffer = ta.ArrayBuffer();
+    if (buffer.IsDetached()) return false;
+    const size_t length = ta.ElementLength();
+    view.data = length ? static_cast<char*>(buffer.Data()) + ta.ByteOffset() : nullptr;
+    view.length = length;
+    return true;
   });
 
   // Drop the paired JS reference when an anonymous nested callback's Lua closure
@@ -1047,25 +1915,27 @@ void LuaContext::InstallRuntimeHandlers() {
     // Getter (__index)
     [this](int ref_id, const std::string& key) -> lua_core::LuaPtr {
       Napi::HandleScope scope(env);
-      auto it = js_userdata_.find(ref_id);
-      if (it == js_userdata_.end()) {
+      const UserdataEntry* entry = js_userdata_.Find(ref_id);
+      if (!entry) {
         return std::make_shared<lua_core::LuaValue>(lua_core::LuaValue::nil());
       }
-      if (!it->second.readable) {
+      if (!entry->readable) {
         throw std::runtime_error("userdata is not readable");
       }
-      Napi::Value val = it->second.object.Value().Get(key);
+      Napi::Value val = entry->object.Value().Get(key);
       return std::make_shared<lua_core::LuaValue>(NapiToCoreInstance(val));
     },
     // Setter (__newindex)
     [this](int ref_id, const std::string& key, const lua_core::LuaPtr& value) {
       Napi::HandleScope scope(env);
-      auto it = js_userdata_.find(ref_id);
-      if (it == js_userdata_.end()) return;
-      if (!it->second.writable) {
+      const UserdataEntry* entry = js_userdata_.Find(ref_id);
+      if (!entry) return;
+      if (!entry->writable) {
         throw std::runtime_error("userdata is not writable");
       }
-      it->second.object.Value().Set(key, CoreToNapi(*value));
+      // Object first: converting the value can reach JS, and the slab may move.
+      const Napi::Object object = entry->object.Value();
+      object.Set(key, CoreToNapi(*value));
     }
   );
 }
@@ -1167,11 +2037,124 @@ Napi::Value LuaContext::SetGlobal(const Napi::CallbackInfo& info) {
     } else {
       runtime->SetGlobal(name, std::make_shared<lua_core::LuaValue>(NapiToCoreInstance(value)));
     }
-  } catch (const std::exception& e) {
-    Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+  } catch (const std::exception& e) {
+    Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  return env.Undefined();
+}
+
+// set_global_json(name, json): the JSON fast path. A string is taken as JSON
+// text; any other value is first serialized by V8's own JSON.stringify (one
+// call, however large the value). Either way the text is decoded natively into
+// Lua tables, skipping the property-by-property walk NapiToCore does.
+Napi::Value LuaContext::SetGlobalJson(const Napi::CallbackInfo& info) {
+  if (RejectIfBusy()) return env.Undefined();
+  if (info.Length() < 2 || !info[0].IsString()) {
+    Napi::TypeError::New(env, "Expected string name as first argument").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  const std::string name = info[0].As<Napi::String>().Utf8Value();
+  std::vector<std::string> path;
+  if (name.find('.') == std::string::npos) {
+    path.push_back(name);
+  } else if (!SplitGlobalPath(name, path)) {
+    Napi::TypeError::New(env, "Invalid global path '" + name +
+      "': path segments must be non-empty (no leading, trailing, or doubled dots)")
+      .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  Napi::Value text = info[1];
+  if (!text.IsString()) {
+    const auto json = env.Global().Get("JSON").As<Napi::Object>();
+    text = json.Get("stringify").As<Napi::Function>().Call(json, {info[1]});
+    if (env.IsExceptionPending()) return env.Undefined();  // e.g. a cycle
+    if (!text.IsString()) {
+      Napi::TypeError::New(env, "set_global_json: value has no JSON representation")
+        .ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+  }
+
+  try {
+    runtime->SetGlobalJson(path, text.As<Napi::String>().Utf8Value());
+  } catch (const std::exception& e) {
+    Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+  }
+  return env.Undefined();
+}
+
+// Parses one register_fast_function type name. 'void' is accepted only for the
+// result.
+static bool ParseFastScalarType(const Napi::Value& value, bool allow_void,
+                                lua_core::FastScalarType& out) {
+  if (!value.IsString()) return false;
+  const std::string name = value.As<Napi::String>().Utf8Value();
+  if (name == "number") out = lua_core::FastScalarType::Number;
+  else if (name == "integer") out = lua_core::FastScalarType::Integer;
+  else if (name == "boolean") out = lua_core::FastScalarType::Boolean;
+  else if (name == "void" && allow_void) out = lua_core::FastScalarType::Void;
+  else return false;
+  return true;
+}
+
+Napi::Value LuaContext::RegisterFastFunction(const Napi::CallbackInfo& info) {
+  if (RejectIfBusy()) return env.Undefined();
+  if (info.Length() < 3 || !info[0].IsString() || !info[1].IsFunction() ||
+      !info[2].IsObject()) {
+    Napi::TypeError::New(env,
+      "register_fast_function(name, fn, { args, returns }) requires a name, a function, and a signature")
+      .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  const std::string name = info[0].As<Napi::String>().Utf8Value();
+  const auto sigObj = info[2].As<Napi::Object>();
+
+  lua_core::FastSignature sig;
+  const Napi::Value argsVal = sigObj.Get("args");
+  if (!argsVal.IsUndefined()) {
+    if (!argsVal.IsArray()) {
+      Napi::TypeError::New(env, "signature.args must be an array of type names")
+        .ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    const auto argsArr = argsVal.As<Napi::Array>();
+    if (argsArr.Length() > lua_core::LuaRuntime::kMaxFastArgs) {
+      Napi::RangeError::New(env, "signature.args may declare at most " +
+        std::to_string(lua_core::LuaRuntime::kMaxFastArgs) + " parameters")
+        .ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    for (uint32_t i = 0; i < argsArr.Length(); ++i) {
+      lua_core::FastScalarType type;
+      if (!ParseFastScalarType(argsArr.Get(i), /*allow_void=*/false, type)) {
+        Napi::TypeError::New(env,
+          "signature.args entries must be 'number', 'integer', or 'boolean'")
+          .ThrowAsJavaScriptException();
+        return env.Undefined();
+      }
+      sig.args.push_back(type);
+    }
+  }
+  const Napi::Value returnsVal = sigObj.Get("returns");
+  if (!returnsVal.IsUndefined() &&
+      !ParseFastScalarType(returnsVal, /*allow_void=*/true, sig.returns)) {
+    Napi::TypeError::New(env,
+      "signature.returns must be 'number', 'integer', 'boolean', or 'void'")
+      .ThrowAsJavaScriptException();
     return env.Undefined();
   }
 
+  try {
+    // Runtime registration first, as in set_global (N5).
+    runtime->RegisterFastFunction(name, sig, CreateFastCallbackWrapper(name, sig));
+    js_callbacks_[name] = Napi::Persistent(info[1].As<Napi::Function>());
+  } catch (const std::exception& e) {
+    Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+  }
   return env.Undefined();
 }
 
@@ -1323,13 +2306,17 @@ Napi::Value LuaContext::SetUserdata(const Napi::CallbackInfo& info) {
     }
   }
 
-  int ref_id = next_userdata_id_++;
-
   UserdataEntry entry;
   entry.object = Napi::Persistent(info[1].As<Napi::Object>());
   entry.readable = readable;
   entry.writable = writable;
-  js_userdata_[ref_id] = std::move(entry);
+  int ref_id = 0;
+  try {
+    ref_id = js_userdata_.Insert(std::move(entry));
+  } catch (const std::exception& e) {
+    Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
 
   // The core calls below build inside RunProtected, which throws on OOM under
   // maxMemory or a raising __newindex on a _G metatable at the global write.
@@ -1337,19 +2324,13 @@ Napi::Value LuaContext::SetUserdata(const Napi::CallbackInfo& info) {
   // N-API boundary terminates the process (the H1 class — the same defect F11
   // fixed for register_class, here at its unswept sibling site, CR-6 F1). On
   // failure, roll back the js_userdata_/js_callbacks_/host_functions_ entries
-  // registered above so a rejected call strands nothing.
+  // and the method table registered above so a rejected call strands nothing.
   std::vector<std::string> registered_method_fns;
-  bool global_installed = false;
+  const bool needs_proxy = readable || writable || has_methods;
   try {
-    bool needs_proxy = readable || writable || has_methods;
-    if (needs_proxy) {
-      runtime->CreateProxyUserdataGlobal(name, ref_id);
-    } else {
-      runtime->CreateUserdataGlobal(name, ref_id);
-    }
-    global_installed = true;
-
-    // Register methods if present
+    // Register methods if present. They (and the access flags) must exist
+    // before the proxy block does: the block copies both into its user values
+    // when it is created.
     if (has_methods) {
       std::unordered_map<std::string, std::string> method_map;
 
@@ -1369,21 +2350,22 @@ Napi::Value LuaContext::SetUserdata(const Napi::CallbackInfo& info) {
 
       runtime->SetUserdataMethodTable(ref_id, method_map);
     }
+
+    if (needs_proxy) {
+      runtime->SetUserdataAccess(ref_id, readable, writable);
+      runtime->CreateProxyUserdataGlobal(name, ref_id);
+    } else {
+      runtime->CreateUserdataGlobal(name, ref_id);
+    }
   } catch (const std::exception& e) {
-    js_userdata_.erase(ref_id);
+    js_userdata_.Erase(ref_id);
+    runtime->ClearUserdataMethodTable(ref_id);
     for (const auto& func_name : registered_method_fns) {
       js_callbacks_.erase(func_name);
       runtime->RemoveHostFunction(func_name);
     }
-    // If the global write succeeded before a later step failed, remove the
-    // installed global too — otherwise the name stays bound to an inert proxy
-    // whose js_userdata_ entry was just erased (CR-7 F3). Raw (no __newindex
-    // can re-raise) and best-effort: the removal can itself fail under the same
-    // OOM, and the inert global is the accepted floor then. Only when this call
-    // installed it — a pre-existing same-named global must not be deleted.
-    if (global_installed) {
-      try { runtime->RemoveGlobalRaw(name); } catch (...) {}
-    }
+    // The global write is the last step, so a failure never leaves the name
+    // bound to an inert proxy (CR-7 F3): there is no installed global to undo.
     Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
     return env.Undefined();
   }
@@ -1488,6 +2470,38 @@ Napi::Value LuaContext::RegisterClass(const Napi::CallbackInfo& info) {
     }
   }
 
+  // Native fields, snapshotted like the metamethods (N3).
+  std::vector<lua_core::ClassField> fields;
+  if (const Napi::Value fieldsVal = def.Get("fields"); !fieldsVal.IsUndefined() &&
+      !fieldsVal.IsNull()) {
+    if (!fieldsVal.IsObject() || fieldsVal.IsArray() || fieldsVal.IsFunction()) {
+      Napi::TypeError::New(env,
+        "register_class(): 'fields' must be an object of field name -> type")
+        .ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    auto fieldsObj = fieldsVal.As<Napi::Object>();
+    Napi::Array fieldKeys = fieldsObj.GetPropertyNames();
+    for (uint32_t i = 0; i < fieldKeys.Length(); ++i) {
+      std::string key = fieldKeys.Get(i).As<Napi::String>().Utf8Value();
+      const Napi::Value typeVal = fieldsObj.Get(key);
+      const std::string type = typeVal.IsString() ? typeVal.As<Napi::String>().Utf8Value() : "";
+      lua_core::ClassField field{std::move(key), lua_core::ClassFieldType::Number};
+      if (type == "number") field.type = lua_core::ClassFieldType::Number;
+      else if (type == "integer") field.type = lua_core::ClassFieldType::Integer;
+      else if (type == "boolean") field.type = lua_core::ClassFieldType::Boolean;
+      else if (type == "string") field.type = lua_core::ClassFieldType::String;
+      else {
+        Napi::TypeError::New(env,
+          "register_class(): field '" + field.name +
+          "' must be 'number', 'integer', 'boolean' or 'string'")
+          .ThrowAsJavaScriptException();
+        return env.Undefined();
+      }
+      fields.push_back(std::move(field));
+    }
+  }
+
   const Napi::Value readableVal = def.Get("readable");
   const Napi::Value writableVal = def.Get("writable");
   const bool readable = readableVal.IsBoolean() && readableVal.As<Napi::Boolean>().Value();
@@ -1517,6 +2531,14 @@ Napi::Value LuaContext::RegisterClass(const Napi::CallbackInfo& info) {
       std::string name = keys.Get(i).As<Napi::String>().Utf8Value();
       Napi::Value val = methods.Get(name);
       if (val.IsFunction()) {
+        // A field would shadow the method in __index; refuse the ambiguity.
+        if (std::any_of(fields.begin(), fields.end(),
+                        [&](const lua_core::ClassField& f) { return f.name == name; })) {
+          Napi::TypeError::New(env,
+            "register_class(): '" + name + "' is declared as both a field and a method")
+            .ThrowAsJavaScriptException();
+          return env.Undefined();
+        }
         std::string func_name = "__class_method_" + std::to_string(class_id) + "_" + name;
         deferred_fns.emplace_back(func_name, val.As<Napi::Function>());
         method_map[name] = func_name;
@@ -1543,7 +2565,8 @@ Napi::Value LuaContext::RegisterClass(const Napi::CallbackInfo& info) {
   // write. Surface that as a JS error: letting a std::runtime_error unwind
   // across the N-API boundary terminates the process (the H1 class).
   try {
-    runtime->RegisterClass(class_name, ctor_name, method_map, metamethods, parent_class);
+    runtime->RegisterClass(class_name, ctor_name, method_map, metamethods, parent_class,
+                           fields);
   } catch (const std::exception& e) {
     Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
     // The reservation guard releases the name; nothing was registered, so
@@ -1553,7 +2576,12 @@ Napi::Value LuaContext::RegisterClass(const Napi::CallbackInfo& info) {
 
   js_callbacks_[ctor_name] = Napi::Persistent(constructFn);
   runtime->StoreHostFunction(ctor_name,
-    CreateConstructorWrapper(ctor_name, class_name, readable, writable));
+    CreateConstructorWrapper(ctor_name, class_name, readable, writable, [&fields]() {
+      std::vector<std::string> names;
+      names.reserve(fields.size());
+      for (const auto& f : fields) names.push_back(f.name);
+      return names;
+    }()));
   for (auto& [func_name, fn] : deferred_fns) {
     js_callbacks_[func_name] = Napi::Persistent(fn);
     runtime->StoreHostFunction(func_name, CreateJsCallbackWrapper(func_name));
@@ -1563,6 +2591,57 @@ Napi::Value LuaContext::RegisterClass(const Napi::CallbackInfo& info) {
   return env.Undefined();
 }
 
+void LuaContext::FlushClassFields(int ref_id) {
+  if (!runtime->ClassFieldsDirty(ref_id)) return;
+  const UserdataEntry* entry = js_userdata_.Find(ref_id);
+  const auto* layout = runtime->ClassFieldLayout(ref_id);
+  if (!entry || !layout) return;
+  // Clean first: a setter on the object may re-enter Lua and write again.
+  runtime->MarkClassFieldsClean(ref_id);
+  const std::vector<lua_core::LuaValue> values = runtime->ClassFieldValues(ref_id);
+  // Straight into the accessors' store, so Lua's own values don't read as a
+  // JS write.
+  const Napi::Object object =
+    entry->field_tracker ? entry->field_store.Value() : entry->object.Value();
+  for (size_t i = 0; i < values.size() && i < layout->size(); ++i) {
+    (void)object.Set((*layout)[i].name, CoreToNapi(values[i]));
+  }
+}
+
+void LuaContext::ReloadClassFields(int ref_id) {
+  const auto* layout = runtime->ClassFieldLayout(ref_id);
+  if (!layout) return;
+  const UserdataEntry* entry = js_userdata_.Find(ref_id);
+  if (!entry) return;
+  // Nothing assigned from JS since the last reload: the record is current.
+  if (entry->field_tracker && !entry->field_tracker->js_dirty) return;
+  FlushClassFields(ref_id);  // Lua-side writes win over unflushed JS-side ones
+  entry = js_userdata_.Find(ref_id);  // the flush runs JS; re-find the slot
+  if (!entry) return;
+  if (entry->field_tracker) entry->field_tracker->js_dirty = false;
+  const Napi::Object object =
+    entry->field_tracker ? entry->field_store.Value() : entry->object.Value();
+  // Copy the names out: a getter below can run JS that re-enters Lua.
+  std::vector<std::string> names;
+  names.reserve(layout->size());
+  for (const auto& field : *layout) names.push_back(field.name);
+  std::vector<lua_core::LuaPtr> values;
+  values.reserve(names.size());
+  for (const auto& name : names) {
+    values.push_back(std::make_shared<lua_core::LuaValue>(NapiToCoreInstance(object.Get(name))));
+  }
+  runtime->SetClassFields(ref_id, "", values);  // the record's own layout
+}
+
+Napi::Value LuaContext::FlushFields(const Napi::CallbackInfo& /*info*/) {
+  if (RejectIfBusy()) return env.Undefined();
+  for (const int ref_id : runtime->DirtyClassInstances()) {
+    Napi::HandleScope scope(env);
+    FlushClassFields(ref_id);
+  }
+  return env.Undefined();
+}
+
 // Defined further down, next to the table-reference API it belongs to.
 static LuaTableRefData* TableRefDataFrom(const Napi::Value& value);
 
@@ -1823,6 +2902,52 @@ Napi::Value LuaContext::CompileFile(const Napi::CallbackInfo& info) {
   return {env, Napi::Buffer<uint8_t>::Copy(env, bytecode.data(), bytecode.size())};
 }
 
+// Compiles a script once for running in many environments: the returned
+// object is opaque, and `env.run(chunk, ...args)` executes it with that table
+// handle as its _ENV and `args` as its `...` — no parse per run (see
+// LuaRuntime::PrepareChunk).
+//
+//   const rule = lua.prepare('return score(...) > threshold')
+//   for (const env of tenants) results.push(env.run(rule, input))
+Napi::Value LuaContext::Prepare(const Napi::CallbackInfo& info) {
+  if (RejectIfBusy()) return env.Undefined();
+  if (info.Length() < 1 || !info[0].IsString()) {
+    Napi::TypeError::New(env, "Expected string argument").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  const std::string script = info[0].As<Napi::String>().Utf8Value();
+  std::string chunk_name;
+  if (info.Length() >= 2 && info[1].IsObject()) {
+    auto options = info[1].As<Napi::Object>();
+    if (options.Has("chunkName") && options.Get("chunkName").IsString()) {
+      chunk_name = options.Get("chunkName").As<Napi::String>().Utf8Value();
+    }
+  }
+
+  CallScope _cs(this);
+  auto result = runtime->PrepareChunk(script, chunk_name);
+  if (std::holds_alternative<std::string>(result)) {
+    ThrowLuaError(std::get<std::string>(result));
+    return env.Undefined();
+  }
+
+  auto* dataPtr = new LuaPreparedChunkData(
+    runtime, std::move(std::get<lua_core::LuaFunctionRef>(result)));
+  const Napi::Object chunk = Napi::Object::New(env);
+  const auto external = Napi::External<LuaPreparedChunkData>::New(env, dataPtr,
+    [](Napi::Env, const LuaPreparedChunkData* d) { delete d; });
+  DefineHiddenProp(env, chunk, "_preparedChunk", external, /*writable=*/false);
+  const Napi::Function release = Napi::Function::New(env,
+    [](const Napi::CallbackInfo& ci) -> Napi::Value {
+      static_cast<LuaPreparedChunkData*>(ci.Data())->chunk.release();
+      return ci.Env().Undefined();
+    }, "release", dataPtr);
+  DefineHiddenProp(env, release, "_chunkOwner", external, /*writable=*/false);
+  (void)chunk.Set("release", release);
+  return chunk;
+}
+
 Napi::Value LuaContext::LoadBytecode(const Napi::CallbackInfo& info) {
   if (RejectIfBusy()) return env.Undefined();
   if (info.Length() < 1 || !info[0].IsBuffer()) {
@@ -1849,8 +2974,11 @@ Napi::Value LuaContext::LoadBytecode(const Napi::CallbackInfo& info) {
 }
 
 Napi::Object LuaContext::CreateTableHandle(const Napi::Env env_, const int registry_ref) {
-  auto* dataPtr = new LuaTableRefData(
-    runtime, lua_core::LuaTableRef(registry_ref, runtime->RawState()), this, alive_);
+  return CreateTableHandle(env_, lua_core::LuaTableRef(registry_ref, runtime->RawState()));
+}
+
+Napi::Object LuaContext::CreateTableHandle(const Napi::Env env_, lua_core::LuaTableRef ref) {
+  auto* dataPtr = new LuaTableRefData(runtime, std::move(ref), this, alive_);
 
   const Napi::Object handle = Napi::Object::New(env_);
 
@@ -1873,10 +3001,15 @@ Napi::Object LuaContext::CreateTableHandle(const Napi::Env env_, const int regis
   addMethod("get", TableHandleGet);
   addMethod("get_ref", TableHandleGetRef);
   addMethod("set", TableHandleSet);
+  addMethod("get_many", TableHandleGetMany);
+  addMethod("set_many", TableHandleSetMany);
+  addMethod("pick", TableHandlePick);
   addMethod("has", TableHandleHas);
   addMethod("length", TableHandleLength);
   addMethod("pairs", TableHandlePairs);
   addMethod("ipairs", TableHandleIPairs);
+  addMethod("entries", TableHandleEntries);
+  addMethod("run", TableHandleRun);
   addMethod("release", TableHandleRelease);
 
   return handle;
@@ -1977,48 +3110,59 @@ static LuaTableRefData* TableRefDataFrom(const Napi::Value& value) {
 //   create_environment()                                  -> empty environment
 //   create_environment({ whitelist: ['math', 'print'] })   -> only those names
 //   create_environment({ whitelist: [...], inherit: true }) -> + _G fallback
-Napi::Value LuaContext::CreateEnvironment(const Napi::CallbackInfo& info) {
-  if (RejectIfBusy()) return env.Undefined();
-
-  std::vector<std::string> whitelist;
-  bool inherit = false;
-
-  if (info.Length() > 0 && !info[0].IsUndefined() && !info[0].IsNull()) {
-    if (!info[0].IsObject() || info[0].IsArray() || info[0].IsFunction()) {
-      Napi::TypeError::New(env, "create_environment() options must be an object")
-        .ThrowAsJavaScriptException();
-      return env.Undefined();
-    }
-    const auto options = info[0].As<Napi::Object>();
+// Parses the `{ whitelist, inherit }` options shared by create_environment and
+// create_environment_template into `whitelist` / `inherit`. Returns the options
+// object (undefined when none was passed), or an empty value after throwing a
+// TypeError naming `method`.
+static Napi::Value ParseEnvironmentOptions(const Napi::CallbackInfo& info, const char* method,
+                                           std::vector<std::string>& whitelist, bool& inherit) {
+  Napi::Env env = info.Env();
+  if (info.Length() == 0 || info[0].IsUndefined() || info[0].IsNull()) return env.Undefined();
+  if (!info[0].IsObject() || info[0].IsArray() || info[0].IsFunction()) {
+    Napi::TypeError::New(env, std::string(method) + " options must be an object")
+      .ThrowAsJavaScriptException();
+    return Napi::Value();
+  }
+  const auto options = info[0].As<Napi::Object>();
 
-    if (options.Has("whitelist")) {
-      const Napi::Value list = options.Get("whitelist");
-      if (!list.IsUndefined() && !list.IsNull()) {
-        if (!list.IsArray()) {
+  if (options.Has("whitelist")) {
+    const Napi::Value list = options.Get("whitelist");
+    if (!list.IsUndefined() && !list.IsNull()) {
+      if (!list.IsArray()) {
+        Napi::TypeError::New(env,
+          std::string(method) + ": whitelist must be an array of strings")
+          .ThrowAsJavaScriptException();
+        return Napi::Value();
+      }
+      const auto arr = list.As<Napi::Array>();
+      whitelist.reserve(arr.Length());
+      for (uint32_t i = 0; i < arr.Length(); ++i) {
+        const Napi::Value entry = arr.Get(i);
+        if (!entry.IsString()) {
           Napi::TypeError::New(env,
-            "create_environment(): whitelist must be an array of strings")
+            std::string(method) + ": whitelist entries must be strings")
             .ThrowAsJavaScriptException();
-          return env.Undefined();
-        }
-        const auto arr = list.As<Napi::Array>();
-        whitelist.reserve(arr.Length());
-        for (uint32_t i = 0; i < arr.Length(); ++i) {
-          const Napi::Value entry = arr.Get(i);
-          if (!entry.IsString()) {
-            Napi::TypeError::New(env,
-              "create_environment(): whitelist entries must be strings")
-              .ThrowAsJavaScriptException();
-            return env.Undefined();
-          }
-          whitelist.push_back(entry.As<Napi::String>().Utf8Value());
+          return Napi::Value();
         }
+        whitelist.push_back(entry.As<Napi::String>().Utf8Value());
       }
     }
+  }
 
-    if (options.Has("inherit")) {
-      const Napi::Value v = options.Get("inherit");
-      if (!v.IsUndefined() && !v.IsNull()) inherit = v.ToBoolean().Value();
-    }
+  if (options.Has("inherit")) {
+    const Napi::Value v = options.Get("inherit");
+    if (!v.IsUndefined() && !v.IsNull()) inherit = v.ToBoolean().Value();
+  }
+  return options;
+}
+
+Napi::Value LuaContext::CreateEnvironment(const Napi::CallbackInfo& info) {
+  if (RejectIfBusy()) return env.Undefined();
+
+  std::vector<std::string> whitelist;
+  bool inherit = false;
+  if (ParseEnvironmentOptions(info, "create_environment()", whitelist, inherit).IsEmpty()) {
+    return env.Undefined();
   }
 
   int ref;
@@ -2035,40 +3179,189 @@ Napi::Value LuaContext::CreateEnvironment(const Napi::CallbackInfo& info) {
   return CreateTableHandle(env, ref);
 }
 
-// Runs a script with `env` as its _ENV. `env` is any table reference minted by
-// this context — an environment from create_environment, or any table handle /
-// metatabled-table Proxy, since an environment is nothing more than the table a
-// chunk resolves its globals against.
-Napi::Value LuaContext::ExecuteScriptIn(const Napi::CallbackInfo& info) {
-  if (RejectIfBusy()) return env.Undefined();
-  if (info.Length() < 2 || !info[1].IsString()) {
+// Environment templates: create_environment_template() resolves the whitelist
+// once into a base table, and each acquire() is then an empty table whose
+// shared metatable reads through to it. recycle() clears an environment and
+// keeps it for the next acquire(), so a request-per-environment loop stops
+// allocating (and collecting) one table per request.
+//
+//   const tpl = lua.create_environment_template({ whitelist: ['math'], maxPooled: 32 })
+//   const env = tpl.acquire()
+//   lua.execute_script_in(env, script)
+//   tpl.recycle(env)   // env's handle is released; the table goes to the pool
+
+static LuaEnvTemplateData* LiveEnvTemplate(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  auto* data = static_cast<LuaEnvTemplateData*>(info.Data());
+  if (RejectIfWorkerBusy(env, data)) return nullptr;
+  if (data->tableRef.ref == LUA_NOREF) {
+    Napi::Error::New(env, "environment template has been released")
+      .ThrowAsJavaScriptException();
+    return nullptr;
+  }
+  return data;
+}
+
+static Napi::Value EnvTemplateAcquire(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  auto* data = LiveEnvTemplate(info);
+  if (!data) return env.Undefined();
+  if (!data->pool.empty()) {
+    lua_core::LuaTableRef ref = std::move(data->pool.back());
+    data->pool.pop_back();
+    return data->context->CreateTableHandle(env, std::move(ref));
+  }
+  int ref;
+  try {
+    ref = data->runtime->InstantiateEnvironment(data->tableRef.ref);
+  } catch (const std::exception& e) {
+    Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  return data->context->CreateTableHandle(env, ref);
+}
+
+static Napi::Value EnvTemplateRecycle(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  auto* data = LiveEnvTemplate(info);
+  if (!data) return env.Undefined();
+  auto* target = info.Length() > 0 ? TableRefDataFrom(info[0]) : nullptr;
+  if (!target || target->runtime.get() != data->runtime.get()) {
     Napi::TypeError::New(env,
-      "execute_script_in(env, script) requires an environment and a script string")
+      "recycle() requires an environment acquired from this template")
       .ThrowAsJavaScriptException();
     return env.Undefined();
   }
+  if (target->tableRef.ref == LUA_NOREF) {
+    Napi::Error::New(env, "table handle has been released").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
 
-  auto* data = TableRefDataFrom(info[0]);
-  if (!data) {
+  bool cleared;
+  try {
+    cleared = data->runtime->ClearEnvironment(target->tableRef.ref, data->tableRef.ref);
+  } catch (const std::exception& e) {
+    Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (!cleared) {
     Napi::TypeError::New(env,
-      "execute_script_in(): the first argument must be an environment or table reference")
+      "recycle() requires an environment acquired from this template")
       .ThrowAsJavaScriptException();
     return env.Undefined();
   }
+  // The pool takes a share of the slot before the handle drops its own, so
+  // the table survives the handle; past the cap it is simply collected.
+  if (data->pool.size() < data->max_pooled) data->pool.push_back(target->tableRef);
+  target->tableRef.release();
+  return env.Undefined();
+}
+
+static Napi::Value EnvTemplateRelease(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  auto* data = static_cast<LuaEnvTemplateData*>(info.Data());
+  if (RejectIfWorkerBusy(env, data)) return env.Undefined();
+  data->pool.clear();
+  data->tableRef.release();
+  return env.Undefined();
+}
+
+Napi::Value LuaContext::CreateEnvironmentTemplate(const Napi::CallbackInfo& info) {
+  if (RejectIfBusy()) return env.Undefined();
+
+  std::vector<std::string> whitelist;
+  bool inherit = false;
+  const Napi::Value options = ParseEnvironmentOptions(
+    info, "create_environment_template()", whitelist, inherit);
+  if (options.IsEmpty()) return env.Undefined();
+
+  size_t max_pooled = 64;
+  if (options.IsObject() && options.As<Napi::Object>().Has("maxPooled")) {
+    const Napi::Value v = options.As<Napi::Object>().Get("maxPooled");
+    if (!v.IsUndefined()) {
+      const double n = v.IsNumber() ? v.As<Napi::Number>().DoubleValue() : -1;
+      if (!(n >= 0) || std::trunc(n) != n) {
+        Napi::TypeError::New(env,
+          "create_environment_template(): maxPooled must be a non-negative integer")
+          .ThrowAsJavaScriptException();
+        return env.Undefined();
+      }
+      max_pooled = static_cast<size_t>(std::min(n, 1e9));
+    }
+  }
+
+  int ref;
+  try {
+    // The one whitelist lookup; see CreateEnvironment for the CallScope.
+    CallScope _cs(this);
+    ref = runtime->CreateEnvironmentTemplate(whitelist, inherit);
+  } catch (const std::exception& e) {
+    Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  auto* dataPtr = new LuaEnvTemplateData(
+    runtime, lua_core::LuaTableRef(ref, runtime->RawState()), this, alive_, max_pooled);
+  const Napi::Object tpl = Napi::Object::New(env);
+  // Ownership as in CreateTableHandle: the External's finalizer frees the data,
+  // and every method roots the External.
+  const auto external = Napi::External<LuaEnvTemplateData>::New(env, dataPtr,
+    [](Napi::Env, const LuaEnvTemplateData* d) { delete d; });
+  DefineHiddenProp(env, tpl, "_envTemplate", external, /*writable=*/false);
+  auto addMethod = [&](const char* name,
+                       Napi::Value (*cb)(const Napi::CallbackInfo&)) {
+    const Napi::Function fn = Napi::Function::New(env, cb, name, dataPtr);
+    DefineHiddenProp(env, fn, "_templateOwner", external, /*writable=*/false);
+    (void)tpl.Set(name, fn);
+  };
+  addMethod("acquire", EnvTemplateAcquire);
+  addMethod("recycle", EnvTemplateRecycle);
+  addMethod("release", EnvTemplateRelease);
+  return tpl;
+}
+
+// The live environment `value` names, or nullptr with a JS exception pending.
+// Any table reference minted by this context qualifies.
+LuaTableRefData* LuaContext::EnvironmentArg(const Napi::Value& value, const char* method) {
+  auto* data = TableRefDataFrom(value);
+  if (!data) {
+    Napi::TypeError::New(env,
+      std::string(method) + ": the first argument must be an environment or table reference")
+      .ThrowAsJavaScriptException();
+    return nullptr;
+  }
   // Same policy as release() and the round-trip markers: a ref index minted by
   // another context (or by this one before a reset()) addresses an unrelated
   // slot in the current registry.
   if (data->runtime.get() != runtime.get()) {
     Napi::Error::New(env, "environment belongs to a different Lua context")
       .ThrowAsJavaScriptException();
-    return env.Undefined();
+    return nullptr;
   }
   if (data->tableRef.ref == LUA_NOREF) {
     Napi::Error::New(env, "table handle has been released")
       .ThrowAsJavaScriptException();
+    return nullptr;
+  }
+  return data;
+}
+
+// Runs a script with `env` as its _ENV. `env` is any table reference minted by
+// this context — an environment from create_environment, or any table handle /
+// metatabled-table Proxy, since an environment is nothing more than the table a
+// chunk resolves its globals against.
+Napi::Value LuaContext::ExecuteScriptIn(const Napi::CallbackInfo& info) {
+  if (RejectIfBusy()) return env.Undefined();
+  if (info.Length() < 2 || !info[1].IsString()) {
+    Napi::TypeError::New(env,
+      "execute_script_in(env, script) requires an environment and a script string")
+      .ThrowAsJavaScriptException();
     return env.Undefined();
   }
 
+  auto* data = EnvironmentArg(info[0], "execute_script_in()");
+  if (!data) return env.Undefined();
+
   const std::string script = info[1].As<Napi::String>().Utf8Value();
 
   CallScope _cs(this);
@@ -2080,6 +3373,73 @@ Napi::Value LuaContext::ExecuteScriptIn(const Napi::CallbackInfo& info) {
   return ResultsToJs(std::get<std::vector<lua_core::LuaPtr>>(res));
 }
 
+// Per-environment budgets for a state shared by many tenants: while
+// execute_script_in or env.run() runs against `env`, its instructions (and,
+// with the environmentAccounting option, its allocations) are charged to it.
+//
+//   lua.set_environment_limits(env, { maxMemory: 4 << 20, maxInstructions: 1e6 })
+//   lua.get_environment_usage(env)  // { memoryBytes, instructions, runs, ... }
+Napi::Value LuaContext::SetEnvironmentLimits(const Napi::CallbackInfo& info) {
+  if (RejectIfBusy()) return env.Undefined();
+  auto* data = EnvironmentArg(info[0], "set_environment_limits()");
+  if (!data) return env.Undefined();
+
+  lua_core::EnvironmentLimits limits;
+  if (info.Length() > 1 && !info[1].IsUndefined() && !info[1].IsNull()) {
+    if (!info[1].IsObject()) {
+      Napi::TypeError::New(env, "set_environment_limits(): limits must be an object")
+        .ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    const auto options = info[1].As<Napi::Object>();
+    for (const auto& [name, field] : {std::pair{"maxMemory", &limits.max_memory},
+                                      std::pair{"maxInstructions", &limits.max_instructions}}) {
+      const Napi::Value v = options.Get(name);
+      if (v.IsUndefined() || v.IsNull()) continue;
+      const double n = v.IsNumber() ? v.As<Napi::Number>().DoubleValue() : -1;
+      if (!(n >= 0)) {
+        Napi::RangeError::New(env, std::string("set_environment_limits(): ") + name +
+          " must be a non-negative number").ThrowAsJavaScriptException();
+        return env.Undefined();
+      }
+      *field = static_cast<size_t>(std::min(n, 9e15));
+    }
+  }
+
+  if (limits.max_memory > 0 && !runtime->HasEnvironmentAccounting()) {
+    Napi::Error::New(env,
+      "set_environment_limits(): maxMemory requires the environmentAccounting option")
+      .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  try {
+    runtime->SetEnvironmentLimits(data->tableRef.ref, limits);
+  } catch (const std::exception& e) {
+    Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+  }
+  return env.Undefined();
+}
+
+Napi::Value LuaContext::GetEnvironmentUsage(const Napi::CallbackInfo& info) {
+  // The counters move while a worker thread runs; see get_memory_usage.
+  if (RejectIfBusy()) return env.Undefined();
+  auto* data = EnvironmentArg(info[0], "get_environment_usage()");
+  if (!data) return env.Undefined();
+
+  const auto usage = runtime->GetEnvironmentUsage(data->tableRef.ref);
+  if (!usage) return env.Null();
+  Napi::Object result = Napi::Object::New(env);
+  (void)result.Set("memoryBytes", Napi::Number::New(env, static_cast<double>(usage->memory)));
+  (void)result.Set("maxMemory", Napi::Number::New(env, static_cast<double>(usage->max_memory)));
+  (void)result.Set("instructions",
+    Napi::Number::New(env, static_cast<double>(usage->instructions)));
+  (void)result.Set("maxInstructions",
+    Napi::Number::New(env, static_cast<double>(usage->max_instructions)));
+  (void)result.Set("runs", Napi::Number::New(env, static_cast<double>(usage->runs)));
+  return result;
+}
+
 Napi::Value LuaContext::GetMemoryUsage(const Napi::CallbackInfo& /*info*/) {
   // A worker thread mutates the allocator counter during async execution;
   // reading it concurrently would be a data race.
@@ -2126,6 +3486,17 @@ Napi::Value LuaContext::Info(const Napi::CallbackInfo& /*info*/) {
   }
   (void)result.Set("libraries", libs);
 
+  // Coroutine thread reuse (see the coroutinePoolSize option): the configured
+  // cap, how many finished threads are parked, and how many coroutines were
+  // built on a fresh thread versus a recycled one.
+  const auto pool = runtime->GetCoroutinePoolStats();
+  Napi::Object poolInfo = Napi::Object::New(env);
+  (void)poolInfo.Set("capacity", Napi::Number::New(env, static_cast<double>(pool.capacity)));
+  (void)poolInfo.Set("idle", Napi::Number::New(env, static_cast<double>(pool.idle)));
+  (void)poolInfo.Set("created", Napi::Number::New(env, static_cast<double>(pool.created)));
+  (void)poolInfo.Set("reused", Napi::Number::New(env, static_cast<double>(pool.reused)));
+  (void)result.Set("coroutinePool", poolInfo);
+
   return result;
 }
 
@@ -2332,11 +3703,27 @@ lua_core::LuaRuntime::Function LuaContext::CreateJsCallbackWrapper(const std::st
     }
     std::vector<napi_value> jsArgs;
     jsArgs.reserve(args.size());
-    for (const auto& a : args) {
-      jsArgs.push_back(CoreToNapi(*a));
+    const size_t handoff_mark = field_handoffs_.size();
+    {
+      struct HandoffDepth {
+        int* depth;
+        ~HandoffDepth() { --*depth; }
+      } handoff_depth{&++field_handoff_depth_};
+      for (const auto& a : args) {
+        jsArgs.push_back(CoreToNapi(*a));
+      }
     }
+    // Pick up what the callback did to the fields of instances it was given.
+    struct HandoffReload {
+      LuaContext* ctx;
+      size_t mark;
+      ~HandoffReload() { ctx->field_handoffs_.resize(mark); }
+    } handoff_reload{this, handoff_mark};
     try {
       const Napi::Value result = cbIt->second.Call(jsArgs);
+      for (size_t i = handoff_mark; i < field_handoffs_.size(); ++i) {
+        ReloadClassFields(field_handoffs_[i]);
+      }
       if (result.IsPromise()) {
         if (!runtime->IsAwaitDriverMode()) {
           throw std::runtime_error(
@@ -2347,17 +3734,161 @@ lua_core::LuaRuntime::Function LuaContext::CreateJsCallbackWrapper(const std::st
         runtime->RequestAwaitYield();
         return std::make_shared<lua_core::LuaValue>(lua_core::LuaValue::nil());
       }
-      return std::make_shared<lua_core::LuaValue>(NapiToCoreInstance(result));
+      return std::make_shared<lua_core::LuaValue>(NapiToCoreInstance(result));
+    } catch (const Napi::Error& e) {
+      throw std::runtime_error(StageJsError(e.Value(), e.Message()));
+    }
+  };
+}
+
+// The JS side of a fast function: scalars go straight to napi values in a
+// per-function argument buffer (reused across calls; napi_call_function copies
+// the arguments, so a reentrant call may safely overwrite it), and the result
+// is checked against the declared type instead of going through
+// NapiToCoreInstance. The HandleScope stays — it is what keeps a hot loop from
+// accumulating handles (see CreateJsCallbackWrapper).
+lua_core::LuaRuntime::FastFunction LuaContext::CreateFastCallbackWrapper(
+    const std::string& name, const lua_core::FastSignature& sig) {
+  return [this, name, types = sig.args, returns = sig.returns,
+          jsArgs = std::vector<napi_value>(sig.args.size())](
+      const lua_core::FastScalar* args, size_t argc) mutable -> lua_core::FastScalar {
+    Napi::HandleScope scope(env);
+    auto cbIt = js_callbacks_.find(name);
+    if (cbIt == js_callbacks_.end()) {
+      throw std::runtime_error("JS callback '" + name + "' is no longer registered");
+    }
+    for (size_t i = 0; i < argc; ++i) {
+      switch (types[i]) {
+        case lua_core::FastScalarType::Number:
+          jsArgs[i] = Napi::Number::New(env, args[i].number);
+          break;
+        case lua_core::FastScalarType::Integer: {
+          // Same Number/BigInt split as CoreToNapi.
+          constexpr int64_t kMaxSafeInteger = 9007199254740991LL;  // 2^53 - 1
+          const int64_t v = args[i].integer;
+          jsArgs[i] = (v > kMaxSafeInteger || v < -kMaxSafeInteger)
+            ? static_cast<napi_value>(Napi::BigInt::New(env, v))
+            : static_cast<napi_value>(Napi::Number::New(env, static_cast<double>(v)));
+          break;
+        }
+        default:
+          jsArgs[i] = Napi::Boolean::New(env, args[i].boolean);
+          break;
+      }
+    }
+
+    Napi::Value result;
+    try {
+      result = cbIt->second.Call(env.Undefined(), argc, jsArgs.data());
     } catch (const Napi::Error& e) {
       throw std::runtime_error(StageJsError(e.Value(), e.Message()));
     }
+
+    lua_core::FastScalar out{};
+    switch (returns) {
+      case lua_core::FastScalarType::Void:
+        break;
+      case lua_core::FastScalarType::Number:
+        if (!result.IsNumber()) {
+          throw std::runtime_error("fast function '" + name + "' must return a number");
+        }
+        out.number = result.As<Napi::Number>().DoubleValue();
+        break;
+      case lua_core::FastScalarType::Integer: {
+        bool ok = false;
+        if (result.IsNumber()) {
+          const double d = result.As<Napi::Number>().DoubleValue();
+          ok = std::isfinite(d) && d == std::trunc(d) &&
+               d >= -9223372036854775808.0 && d < 9223372036854775808.0;
+          if (ok) out.integer = static_cast<int64_t>(d);
+        } else if (result.Type() == napi_bigint) {
+          out.integer = result.As<Napi::BigInt>().Int64Value(&ok);
+        }
+        if (!ok) {
+          throw std::runtime_error("fast function '" + name + "' must return an integer");
+        }
+        break;
+      }
+      case lua_core::FastScalarType::Boolean:
+        if (!result.IsBoolean()) {
+          throw std::runtime_error("fast function '" + name + "' must return a boolean");
+        }
+        out.boolean = result.As<Napi::Boolean>().Value();
+        break;
+    }
+    return out;
   };
 }
 
+// --- Native class field accessors ---
+//
+// Each declared field of a class instance becomes an accessor on the JS object,
+// its value kept in a hidden __luaFieldStore object. The setter also flags the
+// instance's ClassFieldTracker, so the reload after a callback (or when the
+// object passes back into Lua) re-reads only instances JS actually wrote to.
+// They reach everything through `this`, and their data is an interned field
+// name that lives as long as the process, so an accessor called after its
+// context is gone still works on the object alone.
+
+static const std::string* InternFieldName(const std::string& name) {
+  static std::mutex mutex;
+  static std::set<std::string> names;  // node-based: pointers stay valid
+  const std::lock_guard<std::mutex> lock(mutex);
+  return &*names.insert(name).first;
+}
+
+static Napi::Value ClassFieldGet(const Napi::CallbackInfo& info) {
+  const auto* name = static_cast<const std::string*>(info.Data());
+  const Napi::Value store = info.This().As<Napi::Object>().Get("__luaFieldStore");
+  if (!store.IsObject()) return info.Env().Undefined();
+  return store.As<Napi::Object>().Get(*name);
+}
+
+static void ClassFieldSet(const Napi::CallbackInfo& info) {
+  const auto* name = static_cast<const std::string*>(info.Data());
+  const Napi::Object self = info.This().As<Napi::Object>();
+  const Napi::Value store = self.Get("__luaFieldStore");
+  if (!store.IsObject()) return;
+  (void)store.As<Napi::Object>().Set(*name, info[0]);
+  const Napi::Value tracker = self.Get("__luaFieldTracker");
+  if (tracker.IsExternal()) {
+    (*tracker.As<Napi::External<std::shared_ptr<ClassFieldTracker>>>().Data())->js_dirty = true;
+  }
+}
+
+// Moves `fields` of `object` behind accessors. Returns false, leaving the
+// fields as plain properties, if the object refuses the definitions (frozen,
+// or a field that is not configurable); accessors already defined then still
+// read and write the store, so the object stays consistent either way.
+static bool InstallClassFieldAccessors(const Napi::Env env, Napi::Object object,
+                                       const std::vector<std::string>& fields,
+                                       Napi::Object& store,
+                                       std::shared_ptr<ClassFieldTracker>& tracker) {
+  try {
+    store = Napi::Object::New(env);
+    for (const auto& field : fields) (void)store.Set(field, object.Get(field));
+    tracker = std::make_shared<ClassFieldTracker>();
+    DefineHiddenProp(env, object, "__luaFieldStore", store);
+    DefineHiddenProp(env, object, "__luaFieldTracker",
+      Napi::External<std::shared_ptr<ClassFieldTracker>>::New(env,
+        new std::shared_ptr<ClassFieldTracker>(tracker),
+        [](Napi::Env, std::shared_ptr<ClassFieldTracker>* t) { delete t; }));
+    for (const auto& field : fields) {
+      object.DefineProperty(Napi::PropertyDescriptor::Accessor<ClassFieldGet, ClassFieldSet>(
+        field.c_str(), static_cast<napi_property_attributes>(napi_enumerable | napi_configurable),
+        const_cast<std::string*>(InternFieldName(field))));
+    }
+    return true;
+  } catch (const Napi::Error&) {
+    tracker.reset();
+    return false;
+  }
+}
+
 lua_core::LuaRuntime::Function LuaContext::CreateConstructorWrapper(
     const std::string& name, const std::string& class_name,
-    bool readable, bool writable) {
-  return [this, name, class_name, readable, writable](
+    bool readable, bool writable, std::vector<std::string> field_names) {
+  return [this, name, class_name, readable, writable, field_names = std::move(field_names)](
       const std::vector<lua_core::LuaPtr>& args) -> lua_core::LuaPtr {
     // Bound the N-API handles created below (arg conversions, the constructed
     // instance, the hidden-prop temporaries) to this call. Without a scope,
@@ -2388,9 +3919,32 @@ lua_core::LuaRuntime::Function LuaContext::CreateConstructorWrapper(
         "Class '" + class_name + "' constructor must return an object");
     }
 
-    // Register the new instance as JS-backed userdata.
-    const int ref_id = next_userdata_id_++;
     const auto instObj = instance.As<Napi::Object>();
+
+    // Read the native fields' initial values before anything is registered.
+    std::vector<lua_core::LuaPtr> field_values;
+    field_values.reserve(field_names.size());
+    for (const auto& field : field_names) {
+      field_values.push_back(std::make_shared<lua_core::LuaValue>(
+        NapiToCoreInstance(instObj.Get(field))));
+    }
+
+    // Register the new instance as JS-backed userdata.
+    UserdataEntry entry;
+    entry.object = Napi::Persistent(instObj);
+    entry.readable = readable;
+    entry.writable = writable;
+    const int ref_id = js_userdata_.Insert(std::move(entry));
+
+    // A value of the wrong type fails the construction and strands nothing.
+    if (!field_names.empty()) {
+      try {
+        runtime->SetClassFields(ref_id, class_name, field_values);
+      } catch (...) {
+        js_userdata_.Erase(ref_id);
+        throw;
+      }
+    }
     // Tag the instance so that passing the JS object back into Lua re-materializes
     // it as the same class userdata instead of deep-copying it to a table. The
     // owner marker carries this context's runtime pointer so a ref_id from a
@@ -2403,11 +3957,17 @@ lua_core::LuaRuntime::Function LuaContext::CreateConstructorWrapper(
     DefineHiddenProp(env, instObj, "__luaClassOwner",
       Napi::External<lua_core::LuaRuntime>::New(env, runtime.get()));
 
-    UserdataEntry entry;
-    entry.object = Napi::Persistent(instObj);
-    entry.readable = readable;
-    entry.writable = writable;
-    js_userdata_[ref_id] = std::move(entry);
+    // Only once the instance is registered: a failed construction above must
+    // leave the caller's object as it was.
+    if (!field_names.empty()) {
+      Napi::Object store;
+      std::shared_ptr<ClassFieldTracker> tracker;
+      if (InstallClassFieldAccessors(env, instObj, field_names, store, tracker)) {
+        UserdataEntry* registered = js_userdata_.Find(ref_id);
+        registered->field_store = Napi::Persistent(store);
+        registered->field_tracker = std::move(tracker);
+      }
+    }
 
     // Return a class-bound userdata reference; PushLuaValue materializes it
     // with the per-class metatable.
@@ -2436,6 +3996,64 @@ Napi::Value LuaContext::ExecuteScript(const Napi::CallbackInfo& info) {
   return ResultsToJs(std::get<std::vector<lua_core::LuaPtr>>(res));
 }
 
+// execute_script_json(script, options?): the bulk-result fast path. The core
+// serializes the results to JSON text in one pass over the Lua stack; JS gets
+// that string, or (the default) the value of a single JSON.parse over it — far
+// fewer N-API calls than building the result one Object::New/Set at a time.
+Napi::Value LuaContext::ExecuteScriptJson(const Napi::CallbackInfo& info) {
+  if (RejectIfBusy()) return env.Undefined();
+  if (info.Length() < 1 || !info[0].IsString()) {
+    Napi::TypeError::New(env, "Expected string argument").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  lua_core::JsonEncodeOptions options;
+  bool as_string = false;
+  if (info.Length() > 1 && !info[1].IsUndefined()) {
+    if (!info[1].IsObject()) {
+      Napi::TypeError::New(env, "execute_script_json options must be an object").ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    const auto opts = info[1].As<Napi::Object>();
+    if (const Napi::Value output = opts.Get("output"); !output.IsUndefined()) {
+      const std::string mode = output.IsString() ? output.As<Napi::String>().Utf8Value() : "";
+      if (mode != "string" && mode != "value") {
+        Napi::TypeError::New(env, "output must be 'string' or 'value'").ThrowAsJavaScriptException();
+        return env.Undefined();
+      }
+      as_string = mode == "string";
+    }
+    if (const Napi::Value empty = opts.Get("emptyTable"); !empty.IsUndefined()) {
+      const std::string mode = empty.IsString() ? empty.As<Napi::String>().Utf8Value() : "";
+      if (mode != "array" && mode != "object") {
+        Napi::TypeError::New(env, "emptyTable must be 'array' or 'object'").ThrowAsJavaScriptException();
+        return env.Undefined();
+      }
+      options.empty_table_as_object = mode == "object";
+    }
+    if (const Napi::Value sparse = opts.Get("sparseArrays"); !sparse.IsUndefined()) {
+      if (!sparse.IsBoolean()) {
+        Napi::TypeError::New(env, "sparseArrays must be a boolean").ThrowAsJavaScriptException();
+        return env.Undefined();
+      }
+      options.sparse_arrays = sparse.As<Napi::Boolean>().Value();
+    }
+  }
+
+  const std::string script = info[0].As<Napi::String>().Utf8Value();
+
+  CallScope _cs(this);
+  const auto res = runtime->ExecuteScriptJson(script, options);
+  if (std::holds_alternative<std::string>(res)) {
+    ThrowLuaError(std::get<std::string>(res));
+    return env.Undefined();
+  }
+  const Napi::String text = Napi::String::New(env, std::get<lua_core::JsonText>(res).text);
+  if (as_string) return text;
+  const auto json = env.Global().Get("JSON").As<Napi::Object>();
+  return json.Get("parse").As<Napi::Function>().Call(json, {text});
+}
+
 Napi::Value LuaContext::ExecuteFile(const Napi::CallbackInfo& info) {
   if (RejectIfBusy()) return env.Undefined();
   if (info.Length() < 1 || !info[0].IsString()) {
@@ -2458,6 +4076,9 @@ void LuaContext::ClearBusy() {
   // Worker teardown (OnOK/OnError). Clear any cancel signalled during the run so
   // a cancelled worker doesn't leave the flag set to abort the next run (L8).
   runtime->ClearCancel();
+  // Userdata Lua dropped during the run: write back their native fields and
+  // release their entries now that N-API is usable again.
+  runtime->DrainAsyncUserdataReleases();
   is_busy_ = false;
 }
 
@@ -3011,10 +4632,15 @@ Napi::Value LuaContext::Reset(const Napi::CallbackInfo& /*info*/) {
   runtime = std::move(fresh);
 
   // Drop the bookkeeping that described the old state's contents. The id
-  // counters are deliberately left alone: they must stay monotonic so a name or
-  // ref_id minted before the reset can never collide with one minted after.
+  // counters are deliberately left alone: they must stay monotonic so a name
+  // minted before the reset can never collide with one minted after. Clearing
+  // js_userdata_ bumps the generation of every slot it frees, which gives
+  // ref_ids the same guarantee.
   js_callbacks_.clear();
-  js_userdata_.clear();
+  js_callback_names_.Reset();
+  typed_array_ids_.Reset();
+  wrapper_cache_.clear();
+  js_userdata_.Clear();
   js_error_registry_.clear();
   registered_classes_.clear();
 
@@ -3066,6 +4692,12 @@ Napi::Value LuaContext::Reset(const Napi::CallbackInfo& /*info*/) {
     SharedTable* table = AsSharedTable(env, table_ref.Value());
     if (!table) continue;  // defensive; the entry was validated at subscribe time
     try {
+      if (table->lazy()) {
+        std::vector<std::string> path;
+        (void)SplitGlobalPath(name, path);  // validated when first bound
+        BindLazySharedTable(path, table);
+        continue;
+      }
       table->PushTo(Value(), name);
     } catch (const Napi::Error& e) {
       e.ThrowAsJavaScriptException();
@@ -3075,6 +4707,15 @@ Napi::Value LuaContext::Reset(const Napi::CallbackInfo& /*info*/) {
       return env.Undefined();
     }
   }
+  // SharedData views just re-bind: the store's slot still holds the data.
+  for (const auto& [slot, path] : shared_data_) {
+    try {
+      runtime->SetGlobalSharedData(path, slot);
+    } catch (const std::exception& e) {
+      Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+  }
 
   return env.Undefined();
 }
@@ -3322,21 +4963,42 @@ static Napi::Value CreateSharedTable(const Napi::CallbackInfo& info) {
     return env.Undefined();
   }
   const Napi::Function ctor = data->sharedTableConstructor.Value();
+  if (info.Length() > 1) return ctor.New({info[0], info[1]});
   if (info.Length() > 0) return ctor.New({info[0]});
   return ctor.New({});
 }
 
+// createSharedData(value) — the only way to mint a SharedData store, for the
+// same reason as createSharedTable.
+static Napi::Value CreateSharedData(const Napi::CallbackInfo& info) {
+  const Napi::Env env = info.Env();
+  const auto* data = env.GetInstanceData<AddonData>();
+  if (!data || data->sharedDataConstructor.IsEmpty()) {
+    Napi::Error::New(env, "SharedData class is not initialized")
+      .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  return data->sharedDataConstructor.Value().New({info.Length() > 0 ? info[0] : env.Undefined()});
+}
+
 Napi::Object InitModule(const Napi::Env env, const Napi::Object exports) {
   const auto result = LuaContext::Init(env, exports);
   const Napi::Function sharedCtor = SharedTable::DefineSharedTable(env);
-  // Both constructors are kept alive here for the life of the addon instance;
-  // the SharedTable one is also what AsSharedTable checks against.
+  const Napi::Function sharedDataCtor = SharedDataStore::DefineSharedData(env);
+  // The constructors are kept alive here for the life of the addon instance;
+  // the SharedTable and SharedData ones are also what AsSharedTable and
+  // AsSharedData check against.
   env.SetInstanceData(new AddonData{
     Napi::Persistent(exports.Get("init").As<Napi::Function>()),
-    Napi::Persistent(sharedCtor)
+    Napi::Persistent(sharedCtor),
+    Napi::Persistent(sharedDataCtor),
+    Napi::Persistent(env.Global().Get("Proxy").As<Napi::Function>()),
+    Napi::Persistent(CreateTableProxyHandler(env))
   });
   (void)result.Set("createSharedTable",
     Napi::Function::New(env, CreateSharedTable, "createSharedTable"));
+  (void)result.Set("createSharedData",
+    Napi::Function::New(env, CreateSharedData, "createSharedData"));
   return result;
 }
 
@@ -3358,6 +5020,93 @@ lua_core::LuaValue LuaContext::NapiToCoreInstance(const Napi::Value& value, int
   return result;
 }
 
+// Returns the name `fn` is registered under if that registration can be
+// reused: it still maps to this very function, and a Lua closure made from it
+// is alive. The live closure is what makes reuse safe — the entry cannot be
+// swept as unpushed, and PushLuaValue returns that closure, leaving the
+// sentinel count exactly as it was. The name is pinned for as long as the
+// returned value lives, so a GC step between here and the push cannot reclaim
+// it out from under us. Without a live closure (never pushed yet, or already
+// reclaimed) a fresh name is minted as before. Also creates the WeakMap on
+// first use, so the registration path can always record into it.
+std::optional<lua_core::HostFunctionName> LuaContext::ReusableJsCallbackName(const Napi::Function& fn) {
+  if (js_callback_names_.IsEmpty()) {
+    js_callback_names_ = Napi::Persistent(
+      env.Global().Get("WeakMap").As<Napi::Function>().New({}));
+  }
+  const auto names = js_callback_names_.Value();
+  const Napi::Value known = names.Get("get").As<Napi::Function>().Call(names, {fn});
+  if (!known.IsString()) return std::nullopt;
+  std::string name = known.As<Napi::String>().Utf8Value();
+  const auto it = js_callbacks_.find(name);
+  if (it == js_callbacks_.end() || !it->second.Value().StrictEquals(fn)) return std::nullopt;
+  if (!runtime->PinReclaimableHostFunction(name)) return std::nullopt;
+  // The owner holds the runtime it pinned, so a reset() before the value dies
+  // releases the pin on the old runtime rather than the new one.
+  std::shared_ptr<void> pin(nullptr, [rt = runtime, name](void*) {
+    rt->UnpinReclaimableHostFunction(name);
+  });
+  return lua_core::HostFunctionName{std::move(name), std::move(pin)};
+}
+
+// Hands a numeric TypedArray to Lua as a view over its own memory. The array
+// is registered as JS-created userdata, so the strong js_userdata_ reference
+// keeps its ArrayBuffer alive while any Lua block holds the ref_id, and a view
+// coming back out of Lua converts to this very TypedArray. The same array
+// converted again while still registered reuses its ref_id (a WeakMap, like
+// js_callback_names_), so Lua sees one identity per array, not one per call.
+// The returned value carries a pin on the ref count: until it is pushed (or
+// dropped), a GC of the last Lua block cannot unregister the array.
+lua_core::LuaValue LuaContext::TypedArrayView(const Napi::TypedArray& ta,
+                                              const lua_core::NumericArrayType type) {
+  // A resizable (or growable shared) buffer can shrink under the view between
+  // two element accesses in ways the per-access refresh cannot see coming,
+  // and a length-tracking array has no fixed length to hand Lua.
+  const Napi::Value buffer = ta.Get("buffer");
+  if (buffer.IsObject()) {
+    const auto buf = buffer.As<Napi::Object>();
+    if (buf.Get("resizable").ToBoolean().Value() || buf.Get("growable").ToBoolean().Value()) {
+      throw std::runtime_error(
+        "typed arrays over resizable or growable buffers cannot be passed to Lua");
+    }
+  }
+
+  if (typed_array_ids_.IsEmpty()) {
+    typed_array_ids_ = Napi::Persistent(
+      env.Global().Get("WeakMap").As<Napi::Function>().New({}));
+  }
+  const auto ids = typed_array_ids_.Value();
+  int ref_id = 0;
+  const Napi::Value known = ids.Get("get").As<Napi::Function>().Call(ids, {ta});
+  if (known.IsNumber()) {
+    const int id = known.As<Napi::Number>().Int32Value();
+    const UserdataEntry* entry = js_userdata_.Find(id);
+    if (entry && entry->object.Value().StrictEquals(ta)) ref_id = id;
+  }
+  if (ref_id == 0) {
+    UserdataEntry entry;
+    entry.object = Napi::Persistent(ta.As<Napi::Object>());
+    ref_id = js_userdata_.Insert(std::move(entry));
+    ids.Get("set").As<Napi::Function>().Call(ids, {ta, Napi::Number::New(env, ref_id)});
+  }
+
+  lua_core::NumericArrayView view;
+  const size_t length = ta.ElementLength();
+  view.data = length
+    ? static_cast<char*>(ta.ArrayBuffer().Data()) + ta.ByteOffset()
+    : nullptr;
+  view.length = length;
+  view.type = type;
+
+  runtime->IncrementUserdataRefCount(ref_id);
+  lua_core::LuaUserdataRef ref(ref_id, runtime->RawState());
+  ref.numeric = view;
+  ref.pin = std::shared_ptr<void>(nullptr, [rt = runtime, ref_id](void*) {
+    rt->ReleaseUserdataPin(ref_id);
+  });
+  return lua_core::LuaValue::from(std::move(ref));
+}
+
 void LuaContext::SweepUnpushedJsCallbacks(const std::vector<std::string>& names) {
   for (const auto& name : names) {
     if (runtime && runtime->EraseReclaimableIfUnpushed(name)) {
@@ -3373,16 +5122,24 @@ lua_core::LuaValue LuaContext::NapiToCoreImpl(const Napi::Value& value, int dept
   }
 
   if (value.IsFunction()) {
+    const auto fn = value.As<Napi::Function>();
+    // The same function passed again while its earlier closure is still alive
+    // maps back to that registration (and closure) rather than a new one.
+    if (auto known = ReusableJsCallbackName(fn)) {
+      return lua_core::LuaValue::from(std::move(*known));
+    }
     // Register the callback (without creating a global) and return a
     // HostFunctionName so PushLuaValue materializes it as a real Lua closure —
     // even when the function is nested inside a table or array.
     const std::string name = "__js_callback_" + std::to_string(next_js_callback_id_++);
-    js_callbacks_[name] = Napi::Persistent(value.As<Napi::Function>());
+    js_callbacks_[name] = Napi::Persistent(fn);
     // Reclaimable: the entry (and the js_callbacks_ reference above) is dropped
     // when the materialized Lua closure is garbage-collected, so anonymous
     // callbacks don't accumulate for the life of the context (M2).
     runtime->RegisterReclaimableHostFunction(name, CreateJsCallbackWrapper(name));
     if (js_callback_collector_) js_callback_collector_->push_back(name);
+    const auto names = js_callback_names_.Value();
+    names.Get("set").As<Napi::Function>().Call(names, {fn, Napi::String::New(env, name)});
     return lua_core::LuaValue::from(lua_core::HostFunctionName{name});
   }
 
@@ -3467,7 +5224,9 @@ lua_core::LuaValue LuaContext::NapiToCoreImpl(const Napi::Value& value, int dept
           owner.As<Napi::External<lua_core::LuaRuntime>>().Data() == runtime.get();
         if (owned && r.IsNumber() && cn.IsString()) {
           const int ref_id = r.As<Napi::Number>().Int32Value();
-          if (js_userdata_.find(ref_id) != js_userdata_.end()) {
+          if (js_userdata_.Find(ref_id)) {
+            // Back into Lua: take any JS-side edits to its native fields.
+            ReloadClassFields(ref_id);
             return lua_core::LuaValue::from(lua_core::LuaUserdataRef(
               ref_id, runtime->RawState(), /*is_opaque=*/false, LUA_NOREF,
               /*is_proxy=*/false, cn.As<Napi::String>().Utf8Value()));
@@ -3490,6 +5249,14 @@ lua_core::LuaValue LuaContext::NapiToCoreImpl(const Napi::Value& value, int dept
       }
     }
 
+    // Numeric TypedArrays in view mode: shared memory instead of a byte copy.
+    if (typed_array_views_ && value.IsTypedArray() && !value.IsBuffer()) {
+      const auto ta = value.As<Napi::TypedArray>();
+      if (const auto type = NumericViewTypeOf(ta)) {
+        return TypedArrayView(ta, *type);
+      }
+    }
+
     // B1: common built-in JS types (binary data, Date, Map, Set, RegExp)
     if (auto builtin = ConvertBuiltinType(value, depth,
           [this](const Napi::Value& v, const int d) { return NapiToCoreInstance(v, d); })) {
@@ -3591,6 +5358,13 @@ Napi::Value LuaContext::CoreToNapiBuiltin(const lua_core::LuaValue& value) {
           }
           return obj;
         } else if constexpr (std::is_same_v<T, lua_core::LuaFunctionRef>) {
+          // The same Lua function crossing again gets the wrapper it got last
+          // time, while that is alive and unreleased; the ref `v` carries is
+          // then simply dropped, so the function keeps holding one slot.
+          if (const Napi::Object cached = CachedWrapper(v.identity, /*is_table=*/false);
+              !cached.IsEmpty()) {
+            return cached;
+          }
           // The data is owned by a finalizer tied to the JS function, so it (and
           // its registry ref) is freed when the function is garbage-collected.
           auto* dataPtr = new LuaFunctionData(runtime, v, this, alive_);
@@ -3601,8 +5375,12 @@ Napi::Value LuaContext::CoreToNapiBuiltin(const lua_core::LuaValue& value) {
           // deletable or reassignable from JS (L6).
           DefineHiddenProp(env, fn, "__luaFnOwner",
             Napi::External<LuaFunctionData>::New(env, dataPtr,
-              [](Napi::Env, LuaFunctionData* d) { delete d; }),
+              [](Napi::Env, LuaFunctionData* d) {
+                if (d->ContextLive()) d->context->ForgetWrapper(d->funcRef.identity, d);
+                delete d;
+              }),
             /*writable=*/false);
+          CacheWrapper(v.identity, fn, dataPtr, /*is_table=*/false);
           return fn;
         } else if constexpr (std::is_same_v<T, lua_core::LuaThreadRef>) {
           // Return a coroutine object with the thread reference (data owned by the
@@ -3614,9 +5392,15 @@ Napi::Value LuaContext::CoreToNapiBuiltin(const lua_core::LuaValue& value) {
         } else if constexpr (std::is_same_v<T, lua_core::LuaUserdataRef>) {
           if (!v.opaque) {
             // JS-created userdata - return the original JS object
-            auto it = js_userdata_.find(v.ref_id);
-            if (it != js_userdata_.end()) {
-              return it->second.object.Value();
+            if (const UserdataEntry* entry = js_userdata_.Find(v.ref_id)) {
+              // Object first: the flush below runs JS, and the slab may move.
+              const Napi::Object object = entry->object.Value();
+              if (!v.class_name.empty() && runtime->ClassFieldLayout(v.ref_id)) {
+                // JS is about to see the object: bring its fields up to date.
+                FlushClassFields(v.ref_id);
+                if (field_handoff_depth_ > 0) field_handoffs_.push_back(v.ref_id);
+              }
+              return object;
             }
             return env.Null();
           } else {
@@ -3629,44 +5413,38 @@ Napi::Value LuaContext::CoreToNapiBuiltin(const lua_core::LuaValue& value) {
             return handle;
           }
         } else if constexpr (std::is_same_v<T, lua_core::LuaTableRef>) {
-          // Create a JS Proxy that preserves Lua metamethods. The trap data is
-          // owned by the External's finalizer, tied to the proxy target's life.
+          // Same identity cache as for functions: one Proxy per live table.
+          if (const Napi::Object cached = CachedWrapper(v.identity, /*is_table=*/true);
+              !cached.IsEmpty()) {
+            return cached;
+          }
+          // Create a JS Proxy that preserves Lua metamethods. The traps are the
+          // addon instance's shared handler; all per-table state is the data
+          // behind the target's _tableRef External, owned by its finalizer and
+          // so tied to the proxy target's life.
+          const auto* addon = env.GetInstanceData<AddonData>();
+          if (!addon || addon->tableProxyHandler.IsEmpty()) {
+            throw Napi::Error::New(env, "table Proxy handler is not initialized");
+          }
           Napi::Object target = Napi::Object::New(env);
 
           auto* dataPtr = new LuaTableRefData(runtime, v, this, alive_);
 
-          // Store _tableRef as non-enumerable on target for round-trip detection
           auto external = Napi::External<LuaTableRefData>::New(env, dataPtr,
-            [](Napi::Env, LuaTableRefData* d) { delete d; });
-          const auto Object = env.Global().Get("Object").As<Napi::Object>();
-          const auto defineProperty = Object.Get("defineProperty").As<Napi::Function>();
-          Napi::Object descriptor = Napi::Object::New(env);
-          descriptor.Set("value", external);
-          descriptor.Set("enumerable", Napi::Boolean::New(env, false));
-          descriptor.Set("configurable", Napi::Boolean::New(env, true));
-          defineProperty.Call({target, Napi::String::New(env, "_tableRef"), descriptor});
-
-          // Create handler with traps. Root the owner External on each trap so
-          // `delete proxy._tableRef` (which forwards to the target, removing only
-          // that reference) can't free dataPtr while the traps still point at it
-          // (H3). The target's _tableRef stays configurable so the Proxy ownKeys
+            [](Napi::Env, LuaTableRefData* d) {
+              if (d->ContextLive()) d->context->ForgetWrapper(d->tableRef.identity, d);
+              delete d;
+            });
+          // Non-enumerable marker for round-trip detection and for the traps
+          // (see TrapTableRefData). It stays configurable so the Proxy ownKeys
           // invariant — ownKeys omits _tableRef — is not violated.
-          Napi::Object handler = Napi::Object::New(env);
-          auto addTrap = [&](const char* name,
-                             Napi::Value (*cb)(const Napi::CallbackInfo&)) {
-            Napi::Function fn = Napi::Function::New(env, cb, name, dataPtr);
-            DefineHiddenProp(env, fn, "_tableOwner", external, /*writable=*/false);
-            (void)handler.Set(name, fn);
-          };
-          addTrap("get", TableRefGetTrap);
-          addTrap("set", TableRefSetTrap);
-          addTrap("has", TableRefHasTrap);
-          addTrap("ownKeys", TableRefOwnKeysTrap);
-          addTrap("getOwnPropertyDescriptor", TableRefGetOwnPropertyDescriptorTrap);
-
-          // Create Proxy
-          auto ProxyCtor = env.Global().Get("Proxy").As<Napi::Function>();
-          return ProxyCtor.New({target, handler});
+          target.DefineProperty(
+            Napi::PropertyDescriptor::Value("_tableRef", external, napi_configurable));
+
+          const Napi::Object proxy = addon->proxyConstructor.Value().New(
+            {target, addon->tableProxyHandler.Value()});
+          CacheWrapper(v.identity, proxy, dataPtr, /*is_table=*/true);
+          return proxy;
         } else if constexpr (std::is_same_v<T, lua_core::HostFunctionName>) {
           // A JS function that crossed into Lua and came back: return the
           // original JS function if it's still registered.
@@ -3679,6 +5457,37 @@ Napi::Value LuaContext::CoreToNapiBuiltin(const lua_core::LuaValue& value) {
       value.value);
 }
 
+// --- Wrapper identity cache ---
+
+// Returns the live, unreleased wrapper previously minted for `identity`, or an
+// empty object. A collected wrapper (its weak reference reads back empty) or a
+// released one is a miss; the caller mints a new wrapper and CacheWrapper
+// overwrites the entry. Both hold only while the entry's kind matches, since an
+// identity pointer is only unique among live objects.
+Napi::Object LuaContext::CachedWrapper(const void* identity, bool is_table) {
+  if (!identity) return Napi::Object();
+  const auto it = wrapper_cache_.find(identity);
+  if (it == wrapper_cache_.end() || it->second.is_table != is_table) return Napi::Object();
+  Napi::Object cached = it->second.wrapper.Value();
+  if (cached.IsEmpty()) return Napi::Object();
+  // The wrapper is alive, so its finalizer has not run and `data` is valid.
+  const bool released = is_table
+    ? static_cast<const LuaTableRefData*>(it->second.data)->tableRef.ref == LUA_NOREF
+    : static_cast<const LuaFunctionData*>(it->second.data)->funcRef.ref == LUA_NOREF;
+  return released ? Napi::Object() : cached;
+}
+
+void LuaContext::CacheWrapper(const void* identity, const Napi::Object& wrapper,
+                              const void* data, bool is_table) {
+  if (!identity) return;
+  wrapper_cache_[identity] = WrapperCacheEntry{Napi::Weak(wrapper), data, is_table};
+}
+
+void LuaContext::ForgetWrapper(const void* identity, const void* data) {
+  const auto it = wrapper_cache_.find(identity);
+  if (it != wrapper_cache_.end() && it->second.data == data) wrapper_cache_.erase(it);
+}
+
 // --- A4: coroutines as JS iterators ---
 
 // The realm's well-known Symbol.iterator.
@@ -3833,6 +5642,52 @@ static Napi::Value CoroSymbolIterator(const Napi::CallbackInfo& info) {
   return iterator;
 }
 
+// The coroutine object's `take(n, ...args)`. `info.Data()` is the context
+// binding shared with `[Symbol.iterator]`; `info.This()` is the coroutine. A
+// non-finite `n` (Infinity) drains the coroutine.
+static Napi::Value CoroTake(const Napi::CallbackInfo& info) {
+  const Napi::Env env = info.Env();
+  const auto* binding = static_cast<LuaContextBinding*>(info.Data());
+  if (!binding || !binding->ContextLive()) {
+    Napi::Error::New(env, "Lua coroutine's context has been destroyed")
+      .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (!info.This().IsObject()) {
+    Napi::TypeError::New(env, "take() must be called on a coroutine object")
+      .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  if (info.Length() < 1 || !info[0].IsNumber()) {
+    Napi::TypeError::New(env, "take(n) requires a numeric count")
+      .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  const double n = info[0].As<Napi::Number>().DoubleValue();
+  if (!(n >= 1)) {  // also rejects NaN
+    Napi::RangeError::New(env, "take(n) count must be at least 1")
+      .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  const size_t count = std::isfinite(n) && n < 9007199254740992.0
+    ? static_cast<size_t>(n) : std::numeric_limits<size_t>::max();
+
+  if (binding->context->IsBusy()) {
+    Napi::Error::New(env, "Lua context is busy with an async operation")
+      .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  std::vector<Napi::Value> args;
+  args.reserve(info.Length() - 1);
+  for (size_t i = 1; i < info.Length(); ++i) args.push_back(info[i]);
+
+  // Same outermost-entry bookkeeping resume() does (L7).
+  LuaContext::CallScope scope(binding->context);
+  return binding->context->TakeCoroutineObject(info.This().As<Napi::Object>(),
+                                                count, args);
+}
+
 Napi::Object LuaContext::CreateCoroutineObject(LuaThreadData* dataPtr,
                                                const std::string& status) {
   const Napi::Object coro = Napi::Object::New(env);
@@ -3842,14 +5697,18 @@ Napi::Object LuaContext::CreateCoroutineObject(LuaThreadData* dataPtr,
     [](Napi::Env, const LuaThreadData* d) { delete d; }));
   (void)coro.Set("status", Napi::String::New(env, status));
 
+  // One binding serves both methods; its owner External is rooted on each, so
+  // either one detached from the coroutine keeps it alive (H3 / L6).
   auto* binding = new LuaContextBinding{this, alive_};
+  const auto bindingOwner = Napi::External<LuaContextBinding>::New(env, binding,
+    [](Napi::Env, const LuaContextBinding* b) { delete b; });
   const Napi::Function iterFn =
     Napi::Function::New(env, CoroSymbolIterator, "[Symbol.iterator]", binding);
-  DefineHiddenProp(env, iterFn, "__coroBindingOwner",
-    Napi::External<LuaContextBinding>::New(env, binding,
-      [](Napi::Env, const LuaContextBinding* b) { delete b; }),
-    /*writable=*/false);
+  DefineHiddenProp(env, iterFn, "__coroBindingOwner", bindingOwner, /*writable=*/false);
   (void)coro.Set(SymbolIteratorKey(env), iterFn);
+  const Napi::Function takeFn = Napi::Function::New(env, CoroTake, "take", binding);
+  DefineHiddenProp(env, takeFn, "__coroBindingOwner", bindingOwner, /*writable=*/false);
+  (void)coro.Set("take", takeFn);
   return coro;
 }
 
@@ -3952,23 +5811,22 @@ Napi::Value LuaContext::ResumeCoroutine(const Napi::CallbackInfo& info) {
   return ResumeCoroutineObject(info[0].As<Napi::Object>(), args);
 }
 
-Napi::Value LuaContext::ResumeCoroutineObject(const Napi::Object& coroObj,
-                                              const std::vector<Napi::Value>& args_js) {
+const LuaThreadData* LuaContext::CoroutineDataFrom(const Napi::Object& coroObj) {
   if (!coroObj.Has("_coroutine")) {
     Napi::TypeError::New(env, "Invalid coroutine object").ThrowAsJavaScriptException();
-    return env.Undefined();
+    return nullptr;
   }
 
   Napi::Value externalVal = coroObj.Get("_coroutine");
   if (!externalVal.IsExternal()) {
     Napi::TypeError::New(env, "Invalid coroutine object").ThrowAsJavaScriptException();
-    return env.Undefined();
+    return nullptr;
   }
 
   const auto* threadData = externalVal.As<Napi::External<LuaThreadData>>().Data();
   if (!threadData || !threadData->runtime) {
     Napi::Error::New(env, "Invalid coroutine reference").ThrowAsJavaScriptException();
-    return env.Undefined();
+    return nullptr;
   }
   // Resuming a coroutine created by another context would run lua_resume with
   // this context's main state driving that context's thread — two unrelated Lua
@@ -3977,15 +5835,22 @@ Napi::Value LuaContext::ResumeCoroutineObject(const Napi::Object& coroObj,
   if (threadData->runtime.get() != runtime.get()) {
     Napi::Error::New(env, "coroutine belongs to a different Lua context")
       .ThrowAsJavaScriptException();
-    return env.Undefined();
+    return nullptr;
   }
 
   // A released ref carries LUA_NOREF and a null thread pointer — resuming it
   // would drive lua_resume on nullptr. Surface a clear error instead.
   if (threadData->threadRef.ref == LUA_NOREF) {
     Napi::Error::New(env, "coroutine has been released").ThrowAsJavaScriptException();
-    return env.Undefined();
+    return nullptr;
   }
+  return threadData;
+}
+
+Napi::Value LuaContext::ResumeCoroutineObject(const Napi::Object& coroObj,
+                                              const std::vector<Napi::Value>& args_js) {
+  const LuaThreadData* threadData = CoroutineDataFrom(coroObj);
+  if (!threadData) return env.Undefined();
 
   // Convert the resume arguments. One collector spans every argument so a later
   // argument's conversion failure sweeps the callbacks minted by the earlier
@@ -4045,3 +5910,293 @@ Napi::Value LuaContext::ResumeCoroutineObject(const Napi::Object& coroObj,
 
   return resultObj;
 }
+
+Napi::Value LuaContext::TakeCoroutineObject(const Napi::Object& coroObj,
+                                            const size_t count,
+                                            const std::vector<Napi::Value>& args_js) {
+  const LuaThreadData* threadData = CoroutineDataFrom(coroObj);
+  if (!threadData) return env.Undefined();
+
+  // Same single-collector conversion as resume() (CR-8 F1).
+  JsCallbackCollectorScope collector(this);
+  std::vector<lua_core::LuaPtr> args;
+  args.reserve(args_js.size());
+  try {
+    for (const auto& arg : args_js) {
+      args.push_back(std::make_shared<lua_core::LuaValue>(NapiToCoreInstance(arg)));
+    }
+  } catch (const std::exception& e) {
+    Napi::Error::New(env, e.what()).ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  // The whole batch runs in the core; JS sees one crossing and one array.
+  const auto batch = runtime->ResumeCoroutineBatch(threadData->threadRef, count, args);
+  (void)coroObj.Set("status", Napi::String::New(env,
+    batch.status == lua_core::CoroutineStatus::Suspended ? "suspended" : "dead"));
+
+  // A raise ends the coroutine; surface it the way iteration does, as a throw
+  // (with the original JS error reconstructed when one crossed into Lua). The
+  // runtime's last error value is claimed before the yields are converted, as
+  // conversion goes back through the runtime.
+  const Napi::Value error = batch.error ? LuaErrorToJsValue(*batch.error) : Napi::Value();
+
+  // The final return value is discarded, matching for..of (A4).
+  Napi::Array out = Napi::Array::New(env, batch.yields.size());
+  for (size_t i = 0; i < batch.yields.size(); ++i) {
+    (void)out.Set(static_cast<uint32_t>(i), ResultsToJs(batch.yields[i]));
+  }
+  if (batch.error) {
+    // The values yielded before the raise were produced and consumed from the
+    // coroutine; hand them over on the error rather than dropping them, as
+    // iterate_async delivers them ahead of its rejection. They go on an Error
+    // of our own, the raised value as its `cause`: the script's error (or a
+    // callback's, reconstructed) may be frozen, shared, or not an object at
+    // all, and is never written to.
+    Napi::Error thrown = Napi::Error::New(env, *batch.error);
+    (void)thrown.Value().Set("cause", error);
+    (void)thrown.Value().Set("values", out);
+    thrown.ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  return out;
+}
+
+// --- iterate_async: a coroutine consumed as an async iterator ---
+
+// One iterate_async stream. Owned by the iterator object's External finalizer,
+// and pinned by any in-flight batch worker (via its iterator reference). Only
+// the main thread touches it: a worker works on its own copies of the thread
+// ref and batch size, and hands its results over on completion, so the buffer
+// needs no lock.
+struct LuaCoroStreamState {
+  LuaContext* context = nullptr;
+  std::shared_ptr<std::atomic<bool>> contextAlive;
+  // The runtime the thread lives in, so a stream that outlives a reset() is
+  // refused rather than driving an old thread with the new state.
+  std::shared_ptr<lua_core::LuaRuntime> runtime;
+  // The stream's own share of the thread: release(co) mid-stream can't pull it.
+  // Dropped once the stream can produce nothing more.
+  std::optional<lua_core::LuaThreadRef> thread;
+  Napi::ObjectReference coro;  // its `status` is kept in sync
+  Napi::ObjectReference self;  // weak: the iterator object
+  size_t batchSize = 64;
+
+  // Produced, not yet consumed: converted batches, each with a read cursor.
+  // Holds at most one batch — the worker only runs once it has been drained.
+  struct Batch {
+    Napi::Reference<Napi::Array> values;
+    uint32_t next;
+    uint32_t size;
+  };
+  std::deque<Batch> buffered;
+  std::deque<Napi::Promise::Deferred> waiting;  // next() calls not yet settled
+  // The rejection, delivered after the values before it: the raised value as
+  // a sync resume would throw it (LuaErrorToJsValue), or a plain Error.
+  Napi::ObjectReference error;
+  bool exhausted = false;  // finished or raised: nothing more to produce
+  bool closed = false;     // return() was called
+  bool producing = false;  // a batch worker is in flight
+
+  [[nodiscard]] bool ContextLive() const {
+    return context && contextAlive && contextAlive->load();
+  }
+};
+
+// Settles as many waiting next() calls as the buffer allows, then starts a
+// batch only if one is still waiting. Production never runs ahead of demand:
+// a batch holds the context busy, and a speculative prefetch would hold it
+// through the consumer's own loop body, which is free to call back into the
+// context (execute_script, get_global, ...) between values.
+static void PumpCoroStream(const Napi::Env env, LuaCoroStreamState* s) {
+  while (!s->waiting.empty()) {
+    if (!s->buffered.empty()) {
+      auto& batch = s->buffered.front();
+      const Napi::Value value = batch.values.Value().Get(batch.next++);
+      if (batch.next == batch.size) s->buffered.pop_front();
+      s->waiting.front().Resolve(CoroIterResult(env, value, false));
+    } else if (!s->error.IsEmpty()) {
+      s->waiting.front().Reject(s->error.Value());
+      s->error.Reset();
+    } else if (s->exhausted || s->closed) {
+      s->waiting.front().Resolve(CoroIterResult(env, env.Undefined(), true));
+    } else {
+      break;  // needs the next batch
+    }
+    s->waiting.pop_front();
+  }
+
+  if (s->waiting.empty() || !s->buffered.empty() || s->exhausted || s->closed ||
+      s->producing || !s->ContextLive()) {
+    return;
+  }
+  const Napi::Object iterator = s->self.Value();
+  if (iterator.IsEmpty()) return;
+  if (const auto err = s->context->StartCoroutineBatch(s, iterator)) {
+    while (!s->waiting.empty()) {
+      s->waiting.front().Reject(Napi::Error::New(env, *err).Value());
+      s->waiting.pop_front();
+    }
+  }
+}
+
+static Napi::Value CoroStreamNext(const Napi::CallbackInfo& info) {
+  const Napi::Env env = info.Env();
+  auto* state = static_cast<LuaCoroStreamState*>(info.Data());
+  auto deferred = Napi::Promise::Deferred::New(env);
+  if (!state || !state->ContextLive()) {
+    deferred.Reject(
+      Napi::Error::New(env, "Lua coroutine's context has been destroyed").Value());
+    return deferred.Promise();
+  }
+  state->waiting.push_back(deferred);
+  PumpCoroStream(env, state);
+  return deferred.Promise();
+}
+
+// Ends the stream (a `for await` loop exiting early). Values already produced
+// are dropped; the coroutine stays suspended after the last batch produced.
+static Napi::Value CoroStreamReturn(const Napi::CallbackInfo& info) {
+  const Napi::Env env = info.Env();
+  if (auto* state = static_cast<LuaCoroStreamState*>(info.Data())) {
+    state->closed = true;
+    state->buffered.clear();
+    state->error.Reset();
+    state->thread.reset();
+    PumpCoroStream(env, state);  // settles any still-waiting next() as done
+  }
+  auto deferred = Napi::Promise::Deferred::New(env);
+  deferred.Resolve(
+    CoroIterResult(env, info.Length() > 0 ? info[0] : env.Undefined(), true));
+  return deferred.Promise();
+}
+
+// iterate_async(coroutine, options?) — consume a coroutine as an async
+// iterator whose values are produced on a worker thread, `batchSize` resumes
+// at a time. Production is on demand: a batch starts only when a next() finds
+// the buffer empty, so the context is idle while the consumer drains one.
+Napi::Value LuaContext::IterateAsync(const Napi::CallbackInfo& info) {
+  if (info.Length() < 1 || !info[0].IsObject()) {
+    Napi::TypeError::New(env, "iterate_async() expects a coroutine object")
+      .ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  const Napi::Object coro = info[0].As<Napi::Object>();
+  const LuaThreadData* threadData = CoroutineDataFrom(coro);
+  if (!threadData) return env.Undefined();
+
+  size_t batchSize = 64;
+  if (info.Length() > 1 && !info[1].IsUndefined()) {
+    if (!info[1].IsObject()) {
+      Napi::TypeError::New(env, "iterate_async() options must be an object")
+        .ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+    const auto options = info[1].As<Napi::Object>();
+    if (options.Has("batchSize")) {
+      const auto batchVal = options.Get("batchSize");
+      if (!batchVal.IsNumber()) {
+        Napi::TypeError::New(env, "batchSize must be a number").ThrowAsJavaScriptException();
+        return env.Undefined();
+      }
+      const double n = batchVal.As<Napi::Number>().DoubleValue();
+      if (!(n >= 1) || !std::isfinite(n)) {
+        Napi::RangeError::New(env, "batchSize must be a positive integer")
+          .ThrowAsJavaScriptException();
+        return env.Undefined();
+      }
+      batchSize = static_cast<size_t>(n);
+    }
+  }
+
+  auto* state = new LuaCoroStreamState();
+  state->context = this;
+  state->contextAlive = alive_;
+  state->runtime = threadData->runtime;
+  state->thread.emplace(threadData->threadRef);
+  state->coro = Napi::Persistent(coro);
+  state->batchSize = batchSize;
+
+  const Napi::Object iterator = Napi::Object::New(env);
+  // Same ownership discipline as the sync iterator (H3 / L6): the External's
+  // finalizer solely owns `state`, rooted on the iterator and each method.
+  const auto owner = Napi::External<LuaCoroStreamState>::New(env, state,
+    [](Napi::Env, const LuaCoroStreamState* s) { delete s; });
+  DefineHiddenProp(env, iterator, "__coroStreamOwner", owner, /*writable=*/false);
+  auto addMethod = [&](const char* name,
+                       Napi::Value (*cb)(const Napi::CallbackInfo&)) {
+    const Napi::Function fn = Napi::Function::New(env, cb, name, state);
+    DefineHiddenProp(env, fn, "__coroStreamOwner", owner, /*writable=*/false);
+    (void)iterator.Set(name, fn);
+  };
+  addMethod("next", CoroStreamNext);
+  addMethod("return", CoroStreamReturn);
+  (void)iterator.Set(
+    env.Global().Get("Symbol").As<Napi::Object>().Get("asyncIterator"),
+    Napi::Function::New(env, CoroIteratorSelf, "[Symbol.asyncIterator]"));
+  state->self = Napi::Weak(iterator);
+  return iterator;
+}
+
+std::optional<std::string> LuaContext::StartCoroutineBatch(LuaCoroStreamState* state,
+                                                           const Napi::Object& iterator) {
+  if (is_busy_) return std::string("Lua context is busy with an async operation");
+  // reset() swapped in a fresh state; the stream's thread belongs to the old one.
+  if (state->runtime.get() != runtime.get() || !state->thread) {
+    return std::string("coroutine belongs to a different Lua context");
+  }
+  is_busy_ = true;
+  state->producing = true;
+  auto* worker = new LuaCoroutineBatchWorker(
+    env, runtime, *state->thread, state->batchSize, this,
+    Napi::Persistent(Value()), state, Napi::Persistent(iterator));
+  worker->Queue();
+  return std::nullopt;
+}
+
+void LuaCoroutineBatchWorker::OnOK() {
+  Napi::Env env = Env();
+  context_->ClearBusy();
+  LuaCoroStreamState* s = state_;
+  s->producing = false;
+
+  const bool dead = batch_.status != lua_core::CoroutineStatus::Suspended;
+  if (dead) s->exhausted = true;
+  (void)s->coro.Value().Set("status", Napi::String::New(env, dead ? "dead" : "suspended"));
+
+  if (!s->closed) {
+    // Marshalling can throw (CR-8 F4); end the stream with the failure instead
+    // of unwinding out of OnOK.
+    try {
+      // Claimed before the yields are converted, as conversion goes back
+      // through the runtime (see TakeCoroutineObject).
+      if (batch_.error) {
+        s->error = Napi::Persistent(
+          context_->LuaErrorToJsValue(*batch_.error).As<Napi::Object>());
+      }
+      if (!batch_.yields.empty()) {
+        const auto size = static_cast<uint32_t>(batch_.yields.size());
+        Napi::Array values = Napi::Array::New(env, size);
+        for (uint32_t i = 0; i < size; ++i) {
+          (void)values.Set(i, context_->ResultsToJs(batch_.yields[i]));
+        }
+        s->buffered.push_back({Napi::Persistent(values), 0, size});
+      }
+    } catch (const std::exception& e) {
+      s->exhausted = true;
+      s->error = Napi::Persistent(Napi::Error::New(env,
+        std::string("failed to convert async result: ") + e.what()).Value());
+    }
+  }
+  if (s->exhausted) s->thread.reset();
+  PumpCoroStream(env, s);
+}
+
+void LuaCoroutineBatchWorker::OnError(const Napi::Error& error) {
+  context_->ClearBusy();
+  state_->producing = false;
+  state_->exhausted = true;
+  state_->thread.reset();
+  if (!state_->closed) state_->error = Napi::Persistent(error.Value());
+  PumpCoroStream(Env(), state_);
+}
@@ -13,6 +13,7 @@
 #include "core/lua-runtime.h"
 
 class LuaContext;
+struct LuaCoroStreamState;
 
 // A returned Lua-function/table handle keeps its LuaRuntime alive (via the
 // shared_ptr) but the LuaContext wrapper is an independent GC root that can be
@@ -99,10 +100,53 @@ struct LuaTableRefData {
   [[nodiscard]] bool ContextLive() const { return contextAlive && contextAlive->load(); }
 };
 
+// Backing data of a prepared chunk (lua.prepare): the compiled
+// `function(_ENV, ...)` the script became. Run by a table handle's run().
+struct LuaPreparedChunkData {
+  std::shared_ptr<lua_core::LuaRuntime> runtime;
+  lua_core::LuaFunctionRef chunk;
+
+  LuaPreparedChunkData(std::shared_ptr<lua_core::LuaRuntime> rt, lua_core::LuaFunctionRef fn)
+    : runtime(std::move(rt)), chunk(std::move(fn)) {}
+
+  ~LuaPreparedChunkData() {
+    chunk.release();
+  }
+};
+
+// Backing data of an environment template (create_environment_template).
+// `tableRef` is the template's shared metatable; `pool` holds environments
+// handed back through recycle(), already cleared, for the next acquire().
+struct LuaEnvTemplateData : LuaTableRefData {
+  std::vector<lua_core::LuaTableRef> pool;
+  size_t max_pooled;
+
+  LuaEnvTemplateData(std::shared_ptr<lua_core::LuaRuntime> rt,
+                     lua_core::LuaTableRef ref,
+                     LuaContext* ctx,
+                     std::shared_ptr<std::atomic<bool>> alive,
+                     size_t max)
+    : LuaTableRefData(std::move(rt), std::move(ref), ctx, std::move(alive)),
+      max_pooled(max) {}
+};
+
+// Set by the accessor a native class field becomes on its JS object, when JS
+// assigns to it (see LuaContext::CreateConstructorWrapper). Shared between the
+// object (through an External) and its UserdataEntry, so either may go first.
+struct ClassFieldTracker {
+  bool js_dirty = false;
+};
+
 struct UserdataEntry {
   Napi::ObjectReference object;
-  bool readable;
-  bool writable;
+  bool readable = false;
+  bool writable = false;
+  // Native class fields only: the hidden object the field accessors read and
+  // write, and their write flag. Both empty when the accessors could not be
+  // installed (a frozen object), in which case the fields are plain properties
+  // and every reload re-reads them.
+  Napi::ObjectReference field_store;
+  std::shared_ptr<ClassFieldTracker> field_tracker;
 };
 
 // A JS-side value that several LuaContexts mirror as a global — the backing
@@ -111,10 +155,10 @@ struct UserdataEntry {
 // Lua states cannot share memory, so "shared" here means *synchronized copies*:
 // one JS object is held here and pushed into each subscribed context's global
 // namespace with that context's own `set_global`. Propagation is one-way
-// (JS -> Lua) and eager — `set()` updates the object and immediately re-pushes
-// it everywhere; `sync()` re-pushes after the object was mutated directly.
-// Lua-side edits stay local to their context; read them back with that
-// context's `get_global`.
+// (JS -> Lua) and eager — `set()` updates the object and immediately assigns
+// the one field everywhere; `sync()` sends the keys that changed since the last
+// publish, after the object was mutated directly. Lua-side edits stay local to
+// their context; read them back with that context's `get_global`.
 class SharedTable final : public Napi::ObjectWrap<SharedTable> {
 public:
     // Builds the class. The constructor is not exported — `createSharedTable`
@@ -128,6 +172,14 @@ public:
     Napi::Value Set(const Napi::CallbackInfo& info);
     Napi::Value Sync(const Napi::CallbackInfo& info);
 
+    // Lazy mode (`createSharedTable(initial, { lazy: true })`): nothing is
+    // pushed. Each context binds a proxy global that pulls fields from this
+    // object on first read (LuaContext::BindLazySharedTable), and an update
+    // just bumps `version()` — the contexts notice on their next read.
+    [[nodiscard]] bool lazy() const { return lazy_; }
+    [[nodiscard]] const std::shared_ptr<std::atomic<uint64_t>>& version() const { return version_; }
+    [[nodiscard]] Napi::Object shared_value() const { return value_.Value(); }
+
     // Pushes the current value into `context` under `name`, then records the
     // context as a subscriber. Pushing first means a context whose initial push
     // failed is never recorded. Throws Napi::Error if the push fails.
@@ -135,38 +187,94 @@ public:
 
     // Pushes the current value into one already-subscribed context without
     // recording it again. Used by LuaContext::Reset to re-establish the shared
-    // globals the retired state took with it.
-    void PushTo(const Napi::Object& context, const std::string& name) const;
+    // globals the retired state took with it. A full push, so it also clears
+    // the context's stale flag.
+    void PushTo(const Napi::Object& context, const std::string& name);
 
 private:
     // The shared object itself, held (not copied) so a caller that mutates the
     // object it passed to createSharedTable can publish the change with sync().
     Napi::ObjectReference value_;
 
+    bool lazy_ = false;
+    std::shared_ptr<std::atomic<uint64_t>> version_ =
+      std::make_shared<std::atomic<uint64_t>>(1);
+
+    // What the subscribers were last sent, per top-level key: plain objects and
+    // arrays deep-copied, every other value held by reference. sync() diffs the
+    // live value against it to find the keys that actually changed.
+    Napi::ObjectReference snapshot_;
+
     struct Subscriber {
       // Weak: a SharedTable must not keep a context alive. A collected context
       // reads back empty and is pruned on the next propagation.
       Napi::ObjectReference context;
       std::string name;
+      // Set when a push to this context failed, so it missed some delta; its
+      // next propagation is a full push instead. Shared so the flag can be
+      // updated through a Target snapshot even if subscribers_ changes meanwhile.
+      std::shared_ptr<bool> stale = std::make_shared<bool>(false);
     };
     std::vector<Subscriber> subscribers_;
 
-    // Re-pushes the value into every live subscriber and prunes collected ones.
-    // Contexts that reject the push (e.g. one busy with an async operation) are
-    // collected and reported together, after every other context has been
-    // updated — one unavailable context must not silently skip the rest.
-    void Propagate(Napi::Env env);
+    // Publishes `keys` into every live subscriber — one field assignment per
+    // key, nil for a key the value no longer has — or, with `full`, re-pushes
+    // the whole value. A stale subscriber always gets the whole value, and so
+    // does every subscriber when the value is an array (its Lua copy is keyed
+    // by position, not by the names a delta would assign). Collected contexts
+    // are pruned. Contexts that reject the push (e.g. one busy with an async
+    // operation) are collected and reported together, after every other context
+    // has been updated — one unavailable context must not silently skip the rest.
+    void Propagate(Napi::Env env, const std::vector<std::string>& keys, bool full);
+
+    // Records `key`'s current value (or its absence) in snapshot_.
+    void Remember(Napi::Env env, const std::string& key);
+
+    static void PushField(const Napi::Object& context, const std::string& name,
+                          const std::string& key, const Napi::Value& value);
 
     static void PushValue(const Napi::Object& context, const std::string& name,
                           const Napi::Value& value);
 };
 
+// An immutable, natively stored data tree readable from many contexts without
+// a per-context copy — the backing object for `lua_native.createSharedData()`.
+// The value is converted once into a lua_core::SharedData held by a
+// SharedDataSlot; each context given it in the `shared` init option binds a
+// read-only view global onto the slot (LuaRuntime::SetGlobalSharedData).
+// `update()` builds a replacement and swaps it into the slot, so every context
+// reads the new version on its next access — including one running on an
+// async worker, which is why the swap goes through the slot's lock rather than
+// a context's busy guard.
+class SharedDataStore final : public Napi::ObjectWrap<SharedDataStore> {
+public:
+    // Like SharedTable: the constructor is not exported, so `createSharedData`
+    // is the only way to mint one and InstanceOf identifies it.
+    static Napi::Function DefineSharedData(Napi::Env env);
+
+    explicit SharedDataStore(const Napi::CallbackInfo& info);
+
+    Napi::Value Update(const Napi::CallbackInfo& info);
+    Napi::Value Version(const Napi::CallbackInfo& info);
+    Napi::Value ByteSize(const Napi::CallbackInfo& info);
+
+    [[nodiscard]] const std::shared_ptr<lua_core::SharedDataSlot>& slot() const { return slot_; }
+
+private:
+    std::shared_ptr<lua_core::SharedDataSlot> slot_;
+};
+
 // Per-addon-instance data. Keeps the exported class constructors alive for the
 // life of the addon instance, and gives the `shared` option a way to recognize
 // a genuine SharedTable (whose constructor is deliberately not exported).
+// Also holds what every metatabled-table Proxy is built from: the realm's
+// Proxy constructor and the one trap handler all such Proxies share.
 struct AddonData {
   Napi::FunctionReference contextConstructor;
   Napi::FunctionReference sharedTableConstructor;
+  Napi::FunctionReference sharedDataConstructor;
+  Napi::FunctionReference proxyConstructor;
+  Napi::ObjectReference tableProxyHandler;
 };
 
 class LuaContext final : public Napi::ObjectWrap<LuaContext> {
@@ -184,25 +292,34 @@ public:
     Napi::Value IsBusyMethod(const Napi::CallbackInfo& info);
     Napi::Value SetGlobal(const Napi::CallbackInfo& info);
     Napi::Value GetGlobal(const Napi::CallbackInfo& info);
+    Napi::Value SetGlobalJson(const Napi::CallbackInfo& info);
+    Napi::Value ExecuteScriptJson(const Napi::CallbackInfo& info);
+    Napi::Value RegisterFastFunction(const Napi::CallbackInfo& info);
     Napi::Value Call(const Napi::CallbackInfo& info);
     Napi::Value SetUserdata(const Napi::CallbackInfo& info);
     Napi::Value SetMetatable(const Napi::CallbackInfo& info);
     Napi::Value CreateCoroutine(const Napi::CallbackInfo& info);
     Napi::Value ResumeCoroutine(const Napi::CallbackInfo& info);
+    Napi::Value IterateAsync(const Napi::CallbackInfo& info);
     Napi::Value AddSearchPath(const Napi::CallbackInfo& info);
     Napi::Value RegisterModule(const Napi::CallbackInfo& info);
     Napi::Value Compile(const Napi::CallbackInfo& info);
     Napi::Value CompileFile(const Napi::CallbackInfo& info);
+    Napi::Value Prepare(const Napi::CallbackInfo& info);
     Napi::Value LoadBytecode(const Napi::CallbackInfo& info);
     Napi::Value CreateTableMethod(const Napi::CallbackInfo& info);
     Napi::Value GetGlobalRef(const Napi::CallbackInfo& info);
     Napi::Value CreateEnvironment(const Napi::CallbackInfo& info);
+    Napi::Value CreateEnvironmentTemplate(const Napi::CallbackInfo& info);
     Napi::Value ExecuteScriptIn(const Napi::CallbackInfo& info);
+    Napi::Value SetEnvironmentLimits(const Napi::CallbackInfo& info);
+    Napi::Value GetEnvironmentUsage(const Napi::CallbackInfo& info);
     Napi::Value GetMemoryUsage(const Napi::CallbackInfo& info);
     Napi::Value Info(const Napi::CallbackInfo& info);
     Napi::Value RegisterTypeConverter(const Napi::CallbackInfo& info);
     Napi::Value RegisterFromLuaConverter(const Napi::CallbackInfo& info);
     Napi::Value RegisterClass(const Napi::CallbackInfo& info);
+    Napi::Value FlushFields(const Napi::CallbackInfo& info);
     Napi::Value Pcall(const Napi::CallbackInfo& info);
     Napi::Value SetPrintHandler(const Napi::CallbackInfo& info);
     Napi::Value AddSearcher(const Napi::CallbackInfo& info);
@@ -238,10 +355,26 @@ public:
     Napi::Value ResumeCoroutineObject(const Napi::Object& coro,
                                       const std::vector<Napi::Value>& args);
 
+    // The body of a coroutine object's `take(n, ...args)`: resumes up to
+    // `count` times in one native call and returns the yields as an array, each
+    // element shaped like an iteration step's value. Same caller contract as
+    // ResumeCoroutineObject.
+    Napi::Value TakeCoroutineObject(const Napi::Object& coro, size_t count,
+                                    const std::vector<Napi::Value>& args);
+
+    // Queues the worker that produces the next batch of an iterate_async
+    // stream, marking the context busy for the run. Returns an error message
+    // instead when the context is busy or was reset since the stream began.
+    // Public so the stream's free-function `next` can reach it.
+    std::optional<std::string> StartCoroutineBatch(LuaCoroStreamState* state,
+                                                   const Napi::Object& iterator);
+
     // Wraps a registry table reference as a `LuaTableHandle` JS object. Public
     // so the handle's own `get_ref` free function can mint the nested handle it
     // returns.
     Napi::Object CreateTableHandle(Napi::Env env_, int registry_ref);
+    // Same, over a share of an existing ref (a pooled environment).
+    Napi::Object CreateTableHandle(Napi::Env env_, lua_core::LuaTableRef ref);
 
     // Wraps `dataPtr` (whose ownership passes to the returned object's
     // finalizer) as the JS coroutine object: the `_coroutine` marker, a `status`
@@ -257,10 +390,13 @@ public:
     void ThrowLuaError(const std::string& fallback);
 
     // RAII: clears the JS-error registry when the outermost Lua call begins.
+    // Every entry, nested ones included, follows JS that may have detached a
+    // typed array's buffer, so numeric array views are re-resolved on next use.
     struct CallScope {
       LuaContext* ctx;
       explicit CallScope(LuaContext* c) : ctx(c) {
         if (ctx->call_depth_++ == 0) ctx->js_error_registry_.clear();
+        ctx->runtime->InvalidateNumericViews();
       }
       ~CallScope() { --ctx->call_depth_; }
     };
@@ -310,7 +446,20 @@ public:
     // static Lua-function trampoline can reach it.
     void SweepUnpushedJsCallbacks(const std::vector<std::string>& names);
 
+    // Drops the wrapper_cache_ entry for `identity` if it still belongs to
+    // `data`. Called from the wrapper finalizers, hence public.
+    void ForgetWrapper(const void* identity, const void* data);
+
 private:
+    // Validates a JS coroutine object for resume/take: its marker, its owning
+    // context, and that it has not been released. Throws a JS exception and
+    // returns nullptr on failure.
+    const LuaThreadData* CoroutineDataFrom(const Napi::Object& coro);
+    // Validates the environment argument of execute_script_in and the
+    // environment-accounting methods the same way: a live table reference of
+    // this context. Throws a JS exception and returns nullptr on failure.
+    LuaTableRefData* EnvironmentArg(const Napi::Value& value, const char* method);
+
     // The addon env, captured at construction. Safe to reuse from later instance
     // methods because they all run on the same JS thread while this ObjectWrap is
     // alive. It must NOT be used from a worker thread (see the async workers,
@@ -323,6 +472,18 @@ private:
     // N-API finalizer tied to the JS object it backs, so it (and its registry
     // ref) is freed when that object is garbage-collected. Each *Data keeps its
     // own shared_ptr<LuaRuntime>, so the Lua state outlives every wrapper.
+    //
+    // Function and metatabled-table wrappers are additionally indexed here by
+    // their Lua object's identity (LuaFunctionRef/LuaTableRef::identity), weakly,
+    // so a repeated crossing returns the same JS object instead of minting a new
+    // one. `data` is the wrapper's *Data, compared on eviction so a stale
+    // finalizer can't drop a newer entry; `is_table` says which kind it is.
+    struct WrapperCacheEntry {
+      Napi::ObjectReference wrapper;
+      const void* data;
+      bool is_table;
+    };
+    std::unordered_map<const void*, WrapperCacheEntry> wrapper_cache_;
 
     // Set on the main thread around any in-flight async op (worker-thread
     // execute_*_async and coroutine-driven execute_async). Atomic for defensive
@@ -376,17 +537,32 @@ private:
     // converter pass, and it is what every recursive call goes through, so a
     // converter reaches values nested inside tables and arrays too.
     Napi::Value CoreToNapiBuiltin(const lua_core::LuaValue& value);
-
-    // Userdata reference tracking. next_userdata_id_ keys the int-based userdata
-    // maps and the in-userdata-block storage, so it stays int; the remaining
-    // counters only feed unique-name strings and are widened to avoid overflow.
-    std::unordered_map<int, UserdataEntry> js_userdata_;
-    int next_userdata_id_ = 1;
+    Napi::Object CachedWrapper(const void* identity, bool is_table);
+    void CacheWrapper(const void* identity, const Napi::Object& wrapper,
+                      const void* data, bool is_table);
+
+    // Userdata reference tracking. js_userdata_ mints the ref_ids (slot plus
+    // generation, see lua_core::UserdataSlab) that the core indexes its own
+    // per-userdata records by; the counters below only feed unique-name strings
+    // and are widened to avoid overflow.
+    lua_core::UserdataSlab<UserdataEntry> js_userdata_;
     uint64_t next_metatable_id_ = 1;
     uint64_t next_module_id_ = 1;
     uint64_t next_class_id_ = 1;
     uint64_t next_searcher_id_ = 1;
     uint64_t next_js_callback_id_ = 1;  // monotonic id for anonymous nested callbacks
+    // JS function -> the __js_callback_N name it was last registered under, as
+    // a JS WeakMap (created on first use), so converting the same function
+    // again reuses that name — and its Lua closure — instead of minting a new
+    // one while the old is still live. Never keeps a function alive.
+    Napi::ObjectReference js_callback_names_;
+    std::optional<lua_core::HostFunctionName> ReusableJsCallbackName(const Napi::Function& fn);
+    // typedArrays: 'view' — numeric TypedArrays cross as zero-copy views, each
+    // registered in js_userdata_ under the ref_id recorded in typed_array_ids_
+    // (a JS WeakMap, created on first use).
+    bool typed_array_views_ = false;
+    Napi::ObjectReference typed_array_ids_;
+    lua_core::LuaValue TypedArrayView(const Napi::TypedArray& ta, lua_core::NumericArrayType type);
 
     // Output redirection (E1): JS handler for print()/io.write().
     Napi::FunctionReference print_handler_;
@@ -448,6 +624,16 @@ private:
     // object); the SharedTable's own reference back to this context is weak, so
     // there is no cycle. reset() replays these onto the fresh state.
     std::vector<std::pair<Napi::ObjectReference, std::string>> shared_tables_;
+    // SharedData stores bound via the same option, with the global path of
+    // each view. Only the slot is kept — it is all a view needs, and all
+    // reset() needs to bind a fresh one.
+    std::vector<std::pair<std::shared_ptr<lua_core::SharedDataSlot>,
+                          std::vector<std::string>>> shared_data_;
+
+    // Binds a lazy SharedTable at `path`: a LazyTableSource whose fetches read
+    // the table's JS object and convert with this context's NapiToCoreInstance
+    // (type converters included). Used by the constructor and reset().
+    void BindLazySharedTable(const std::vector<std::string>& path, SharedTable* table);
 
     // Installs the runtime-side handlers that bridge back into this context
     // (userdata GC, host-function GC, proxy property access). Shared by the
@@ -460,7 +646,22 @@ private:
 
     void RegisterCallbacks(const Napi::Object& callbacks);
     lua_core::LuaRuntime::Function CreateJsCallbackWrapper(const std::string& name);
+    lua_core::LuaRuntime::FastFunction CreateFastCallbackWrapper(
+        const std::string& name, const lua_core::FastSignature& sig);
     lua_core::LuaRuntime::Function CreateConstructorWrapper(
         const std::string& name, const std::string& class_name,
-        bool readable, bool writable);
+        bool readable, bool writable, std::vector<std::string> field_names);
+
+    // Native class fields (register_class `fields`). The core's record is the
+    // live copy while Lua holds an instance; these move it to and from the JS
+    // object. FlushClassFields writes a dirty record back; ReloadClassFields
+    // flushes, then re-reads the JS object (a JS-side edit) — but only when its
+    // field accessors saw a JS write since the last reload. Instances handed to
+    // a JS callback as arguments are listed in field_handoffs_ (only while
+    // field_handoff_depth_ > 0) and reloaded when it returns, so a method that
+    // assigns `self.x` is seen by Lua, and one that doesn't costs nothing.
+    void FlushClassFields(int ref_id);
+    void ReloadClassFields(int ref_id);
+    std::vector<int> field_handoffs_;
+    int field_handoff_depth_ = 0;
 };
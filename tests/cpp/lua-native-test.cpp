@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <cmath>
@@ -3679,6 +3680,196 @@ TEST(LuaRuntimeEnvironment, EnvironmentTableIsAnOrdinaryTableRef) {
   rt.ReleaseTableRef(ref);
 }
 
+TEST(LuaRuntimeEnvironment, TemplateEnvironmentsReadThroughTheBase) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  const int tpl = rt.CreateEnvironmentTemplate({"math", "tostring", "getmetatable"});
+  const int ref = rt.InstantiateEnvironment(tpl);
+
+  EXPECT_EQ(RunInEnvString(rt, ref, "return tostring(math.floor(3.7))"), "3");
+  // Nothing was copied into the environment itself, and the base is hidden.
+  EXPECT_FALSE(rt.HasTableField(ref, "math"));
+  EXPECT_EQ(RunInEnvString(rt, ref, "return tostring(getmetatable(_ENV))"), "false");
+
+  (void)rt.ExecuteScriptInEnvironment(ref, "mine = 1");
+  const int other = rt.InstantiateEnvironment(tpl);
+  EXPECT_EQ(RunInEnvString(rt, other, "return tostring(mine)"), "nil");
+
+  rt.ReleaseTableRef(other);
+  rt.ReleaseTableRef(ref);
+  rt.ReleaseTableRef(tpl);
+}
+
+TEST(LuaRuntimeEnvironment, ClearEnvironmentEmptiesOnlyItsTemplatesTables) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  const int tpl = rt.CreateEnvironmentTemplate({"tostring"});
+  const int ref = rt.InstantiateEnvironment(tpl);
+  (void)rt.ExecuteScriptInEnvironment(ref, "a = 1; b = { 1, 2 }; seq = 3");
+
+  EXPECT_TRUE(rt.ClearEnvironment(ref, tpl));
+  EXPECT_TRUE(rt.TablePairs(ref).empty());
+  EXPECT_EQ(RunInEnvString(rt, ref, "return tostring(a)"), "nil");
+
+  const int plain = rt.CreateEnvironment({"tostring"});
+  const int other = rt.CreateEnvironmentTemplate({});
+  EXPECT_FALSE(rt.ClearEnvironment(plain, tpl));
+  EXPECT_FALSE(rt.ClearEnvironment(ref, other));
+  EXPECT_TRUE(rt.HasTableField(plain, "tostring"));
+
+  rt.ReleaseTableRef(plain);
+  rt.ReleaseTableRef(other);
+  rt.ReleaseTableRef(ref);
+  rt.ReleaseTableRef(tpl);
+}
+
+TEST(LuaRuntimeEnvironment, PreparedChunkRunsAgainstEachEnvironment) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  auto prepared = rt.PrepareChunk("local n = ... return name .. ':' .. tostring(n * factor)");
+  ASSERT_TRUE(std::holds_alternative<LuaFunctionRef>(prepared));
+  const auto& chunk = std::get<LuaFunctionRef>(prepared);
+
+  const int a = rt.CreateEnvironment({"tostring"});
+  const int b = rt.CreateEnvironment({"tostring"});
+  rt.SetTableField(a, "name", std::make_shared<LuaValue>(LuaValue::from(std::string("a"))));
+  rt.SetTableField(a, "factor", std::make_shared<LuaValue>(LuaValue::from(int64_t{2})));
+  rt.SetTableField(b, "name", std::make_shared<LuaValue>(LuaValue::from(std::string("b"))));
+  rt.SetTableField(b, "factor", std::make_shared<LuaValue>(LuaValue::from(int64_t{3})));
+
+  const std::vector<LuaPtr> args{std::make_shared<LuaValue>(LuaValue::from(int64_t{5}))};
+  for (const auto& [env, expected] : {std::pair{a, "a:10"}, std::pair{b, "b:15"}}) {
+    const auto res = rt.RunPreparedChunk(chunk, env, args);
+    ASSERT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(res));
+    EXPECT_EQ(std::get<std::string>(std::get<std::vector<LuaPtr>>(res)[0]->value), expected);
+  }
+
+  rt.ReleaseTableRef(a);
+  rt.ReleaseTableRef(b);
+}
+
+TEST(LuaRuntimeEnvironment, PreparedChunkClosuresKeepTheirRunsEnvironment) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  auto prepared = rt.PrepareChunk("tag = ... getter = function() return tag end");
+  ASSERT_TRUE(std::holds_alternative<LuaFunctionRef>(prepared));
+  const auto& chunk = std::get<LuaFunctionRef>(prepared);
+
+  const int a = rt.CreateEnvironment({});
+  const int b = rt.CreateEnvironment({});
+  (void)rt.RunPreparedChunk(chunk, a, {std::make_shared<LuaValue>(LuaValue::from(std::string("first")))});
+  (void)rt.RunPreparedChunk(chunk, b, {std::make_shared<LuaValue>(LuaValue::from(std::string("second")))});
+
+  // A rebound upvalue would have switched a's getter over to b.
+  const auto getter = std::get<LuaFunctionRef>(rt.GetTableField(a, "getter")->value);
+  const auto res = rt.CallFunction(getter, {});
+  ASSERT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(res));
+  EXPECT_EQ(std::get<std::string>(std::get<std::vector<LuaPtr>>(res)[0]->value), "first");
+
+  rt.ReleaseTableRef(a);
+  rt.ReleaseTableRef(b);
+}
+
+TEST(LuaRuntimeEnvironment, PreparedChunkReportsErrorsOnTheScriptsLines) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  const auto bad = rt.PrepareChunk("x = 1\nx = = 2", "rule");
+  ASSERT_TRUE(std::holds_alternative<std::string>(bad));
+  EXPECT_NE(std::get<std::string>(bad).find("rule\"]:2:"), std::string::npos);
+
+  // Closing the wrapper early leaves the loader with no globals to reach.
+  const auto escape = rt.PrepareChunk("end, print('escaped'), function()");
+  ASSERT_TRUE(std::holds_alternative<std::string>(escape));
+  EXPECT_NE(std::get<std::string>(escape).find("upvalue '_ENV'"), std::string::npos);
+
+  // Code that reaches no globals runs, but its extra results are refused, as is
+  // a function standing in for the wrapper.
+  for (const char* script : {"end, 1, function()", "end and function()"}) {
+    const auto extra = rt.PrepareChunk(script);
+    ASSERT_TRUE(std::holds_alternative<std::string>(extra)) << script;
+    EXPECT_EQ(std::get<std::string>(extra), "script closes the prepared chunk's function early");
+  }
+  EXPECT_EQ(lua_gettop(rt.RawState()), 0);
+}
+
+TEST(LuaRuntimeEnvironment, InstructionLimitStopsOnlyThatEnvironment) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  const int greedy = rt.CreateEnvironment({});
+  const int other = rt.CreateEnvironment({});
+  rt.SetEnvironmentLimits(greedy, {0, 50000});
+
+  const auto res = rt.ExecuteScriptInEnvironment(greedy, "while true do end");
+  ASSERT_TRUE(std::holds_alternative<std::string>(res));
+  EXPECT_NE(std::get<std::string>(res).find("environment instruction limit exceeded"),
+            std::string::npos);
+  // The budget is per environment: the other one (and plain scripts) run freely.
+  EXPECT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(
+    rt.ExecuteScriptInEnvironment(other, "for i = 1, 200000 do end")));
+
+  // A chunk that never gets to run is not counted.
+  EXPECT_TRUE(std::holds_alternative<std::string>(
+    rt.ExecuteScriptInEnvironment(greedy, "x = = 1")));
+
+  const auto usage = rt.GetEnvironmentUsage(greedy);
+  ASSERT_TRUE(usage.has_value());
+  EXPECT_EQ(usage->runs, 1u);
+  EXPECT_GE(usage->instructions, 50000u);
+  EXPECT_FALSE(rt.GetEnvironmentUsage(other).has_value());
+
+  rt.ReleaseTableRef(greedy);
+  rt.ReleaseTableRef(other);
+}
+
+TEST(LuaRuntimeEnvironment, MemoryIsChargedToTheAllocatingEnvironment) {
+  RuntimeConfig config;
+  config.libraries = LuaRuntime::AllLibraries();
+  config.environment_accounting = true;
+  LuaRuntime rt(config);
+  const int a = rt.CreateEnvironment({"string"});
+  const int b = rt.CreateEnvironment({"string"});
+  rt.SetEnvironmentLimits(a, {});
+  rt.SetEnvironmentLimits(b, {256 * 1024, 0});
+
+  (void)rt.ExecuteScriptInEnvironment(a, "big = string.rep('x', 1024 * 1024)");
+  EXPECT_GE(rt.GetEnvironmentUsage(a)->memory, 1024u * 1024u);
+  EXPECT_LT(rt.GetEnvironmentUsage(b)->memory, 1024u * 1024u);
+
+  // b's budget is its own: a's megabyte does not count against it.
+  const auto oom = rt.ExecuteScriptInEnvironment(b, "big = string.rep('x', 1024 * 1024)");
+  ASSERT_TRUE(std::holds_alternative<std::string>(oom));
+  EXPECT_NE(std::get<std::string>(oom).find("not enough memory"), std::string::npos);
+  EXPECT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(
+    rt.ExecuteScriptInEnvironment(b, "small = string.rep('x', 1024)")));
+
+  // Freed outside any run, the string is still credited back to a.
+  (void)rt.ExecuteScriptInEnvironment(a, "big = nil");
+  (void)rt.ExecuteScript("collectgarbage()");
+  EXPECT_LT(rt.GetEnvironmentUsage(a)->memory, 1024u * 1024u);
+
+  rt.ReleaseTableRef(a);
+  rt.ReleaseTableRef(b);
+}
+
+TEST(LuaRuntimeEnvironment, MemoryLimitsRequireEnvironmentAccounting) {
+  LuaRuntime rt;
+  const int ref = rt.CreateEnvironment({});
+  EXPECT_THROW(rt.SetEnvironmentLimits(ref, {1024 * 1024, 0}), std::runtime_error);
+  EXPECT_NO_THROW(rt.SetEnvironmentLimits(ref, {0, 1000}));
+  rt.ReleaseTableRef(ref);
+}
+
+TEST(LuaRuntimeEnvironment, ClearEnvironmentDropsTheAccount) {
+  RuntimeConfig config;
+  config.environment_accounting = true;
+  LuaRuntime rt(config);
+  const int tpl = rt.CreateEnvironmentTemplate({});
+  const int ref = rt.InstantiateEnvironment(tpl);
+  rt.SetEnvironmentLimits(ref, {1024 * 1024, 1000});
+  (void)rt.ExecuteScriptInEnvironment(ref, "t = {}");
+  ASSERT_TRUE(rt.GetEnvironmentUsage(ref).has_value());
+
+  EXPECT_TRUE(rt.ClearEnvironment(ref, tpl));
+  EXPECT_FALSE(rt.GetEnvironmentUsage(ref).has_value());
+
+  rt.ReleaseTableRef(ref);
+  rt.ReleaseTableRef(tpl);
+}
+
 // --- Memory Limits Tests ---
 
 TEST(LuaRuntimeMemory, MemoryUsageTracking) {
@@ -4346,6 +4537,1390 @@ TEST(LuaRuntimeWorkerUnref, ImmediateUnrefWhenNoWorkerActive) {
   luaL_unref(L, LUA_REGISTRYINDEX, reused);
 }
 
+// Coroutine thread pool: finished threads are recycled when their handle is
+// released, and nothing that Lua might still see is ever handed out again.
+namespace {
+LuaRuntime MakePooledRuntime(size_t pool_size) {
+  RuntimeConfig config;
+  config.libraries = LuaRuntime::AllLibraries();
+  config.coroutine_pool_size = pool_size;
+  return LuaRuntime(config);
+}
+
+LuaFunctionRef ScriptFunction(LuaRuntime& rt, const std::string& script) {
+  auto res = rt.ExecuteScript(script);
+  EXPECT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(res));
+  return std::get<LuaFunctionRef>(std::get<std::vector<LuaPtr>>(res)[0]->value);
+}
+}  // namespace
+
+TEST(LuaRuntimeCoroutinePool, FinishedThreadIsReused) {
+  LuaRuntime rt = MakePooledRuntime(4);
+  const auto fn = ScriptFunction(rt, "return function(x) return x * 2 end");
+
+  auto first = std::get<LuaThreadRef>(rt.CreateCoroutine(fn));
+  lua_State* thread = first.thread;
+  auto result = rt.ResumeCoroutine(first, {std::make_shared<LuaValue>(LuaValue::from(int64_t{21}))});
+  ASSERT_EQ(result.status, CoroutineStatus::Dead);
+  EXPECT_EQ(std::get<int64_t>(result.values[0]->value), 42);
+  first.release();
+  EXPECT_EQ(rt.GetCoroutinePoolStats().idle, 1u);
+
+  // The next coroutine lands on the parked thread and runs from a clean slate.
+  auto second = std::get<LuaThreadRef>(rt.CreateCoroutine(fn));
+  EXPECT_EQ(second.thread, thread);
+  result = rt.ResumeCoroutine(second, {std::make_shared<LuaValue>(LuaValue::from(int64_t{5}))});
+  ASSERT_EQ(result.status, CoroutineStatus::Dead);
+  EXPECT_EQ(std::get<int64_t>(result.values[0]->value), 10);
+
+  const auto stats = rt.GetCoroutinePoolStats();
+  EXPECT_EQ(stats.created, 1u);
+  EXPECT_EQ(stats.reused, 1u);
+  EXPECT_EQ(stats.idle, 0u);
+}
+
+TEST(LuaRuntimeCoroutinePool, SuspendedOrErroredThreadIsNotReused) {
+  LuaRuntime rt = MakePooledRuntime(4);
+  const auto yields = ScriptFunction(rt, "return function() coroutine.yield(1) end");
+  const auto fails = ScriptFunction(rt, "return function() error('boom') end");
+
+  auto suspended = std::get<LuaThreadRef>(rt.CreateCoroutine(yields));
+  ASSERT_EQ(rt.ResumeCoroutine(suspended, {}).status, CoroutineStatus::Suspended);
+  suspended.release();
+
+  auto errored = std::get<LuaThreadRef>(rt.CreateCoroutine(fails));
+  ASSERT_TRUE(rt.ResumeCoroutine(errored, {}).error.has_value());
+  errored.release();
+
+  EXPECT_EQ(rt.GetCoroutinePoolStats().idle, 0u);
+}
+
+TEST(LuaRuntimeCoroutinePool, ThreadPassedIntoLuaIsNotReused) {
+  LuaRuntime rt = MakePooledRuntime(4);
+  const auto fn = ScriptFunction(rt, "return function() end");
+  const auto keep = ScriptFunction(rt, "return function(co) kept = co end");
+
+  auto co = std::get<LuaThreadRef>(rt.CreateCoroutine(fn));
+  ASSERT_EQ(rt.ResumeCoroutine(co, {}).status, CoroutineStatus::Dead);
+  // Lua now holds the thread in a global, so it must not be recycled.
+  (void)rt.CallFunction(keep, {std::make_shared<LuaValue>(LuaValue::from(LuaThreadRef(co)))});
+  co.release();
+
+  EXPECT_EQ(rt.GetCoroutinePoolStats().idle, 0u);
+}
+
+TEST(LuaRuntimeCoroutinePool, DisabledByDefaultAndTrimmedOnShrink) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  const auto fn = ScriptFunction(rt, "return function() end");
+
+  auto co = std::get<LuaThreadRef>(rt.CreateCoroutine(fn));
+  (void)rt.ResumeCoroutine(co, {});
+  co.release();
+  EXPECT_EQ(rt.GetCoroutinePoolStats().capacity, 0u);
+  EXPECT_EQ(rt.GetCoroutinePoolStats().idle, 0u);
+
+  rt.SetCoroutinePoolSize(3);
+  std::vector<LuaThreadRef> live;
+  for (int i = 0; i < 3; ++i) live.push_back(std::get<LuaThreadRef>(rt.CreateCoroutine(fn)));
+  live.clear();  // never started: all three are eligible
+  EXPECT_EQ(rt.GetCoroutinePoolStats().idle, 3u);
+
+  rt.SetCoroutinePoolSize(1);
+  EXPECT_EQ(rt.GetCoroutinePoolStats().idle, 1u);
+  EXPECT_EQ(rt.GetConfig().coroutine_pool_size, 1u);
+}
+
+TEST(LuaRuntimeCoroutineBatch, BatchedResumeCollectsYieldsUntilDeath) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  const auto fn = ScriptFunction(rt,
+    "return function(n) for i = 1, n do coroutine.yield(i, i * i) end return 'end' end");
+  auto co = std::get<LuaThreadRef>(rt.CreateCoroutine(fn));
+
+  auto batch = rt.ResumeCoroutineBatch(
+    co, 3, {std::make_shared<LuaValue>(LuaValue::from(int64_t{5}))});
+  EXPECT_EQ(batch.status, CoroutineStatus::Suspended);
+  ASSERT_EQ(batch.yields.size(), 3u);
+  EXPECT_EQ(std::get<int64_t>(batch.yields[2][1]->value), 9);
+
+  // Two yields left: the batch stops early with the return values.
+  batch = rt.ResumeCoroutineBatch(co, 10, {});
+  EXPECT_EQ(batch.status, CoroutineStatus::Dead);
+  EXPECT_EQ(batch.yields.size(), 2u);
+  ASSERT_EQ(batch.returned.size(), 1u);
+  EXPECT_EQ(std::get<std::string>(batch.returned[0]->value), "end");
+  EXPECT_FALSE(batch.error.has_value());
+
+  // Dead: nothing, and no error.
+  batch = rt.ResumeCoroutineBatch(co, 10, {});
+  EXPECT_TRUE(batch.yields.empty());
+  EXPECT_FALSE(batch.error.has_value());
+}
+
+TEST(LuaRuntimeCoroutineBatch, BatchedResumeKeepsYieldsBeforeAnError) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  const auto fn = ScriptFunction(rt,
+    "return function() coroutine.yield(1) coroutine.yield(2) error('boom') end");
+  auto co = std::get<LuaThreadRef>(rt.CreateCoroutine(fn));
+
+  const auto batch = rt.ResumeCoroutineBatch(co, 10, {});
+  EXPECT_EQ(batch.status, CoroutineStatus::Dead);
+  EXPECT_EQ(batch.yields.size(), 2u);
+  ASSERT_TRUE(batch.error.has_value());
+  EXPECT_NE(batch.error->find("boom"), std::string::npos);
+}
+
+// ========== Host Function Slot Tests ==========
+
+TEST(LuaRuntimeHostFunctionSlot, ReregisteringRetargetsCapturedClosure) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  rt.RegisterFunction("f", [](const std::vector<LuaPtr>&) -> LuaPtr {
+    return std::make_shared<LuaValue>(LuaValue::from(static_cast<int64_t>(1)));
+  });
+  (void)rt.ExecuteScript("local g = f; held = function() return g() end");
+  rt.RegisterFunction("f", [](const std::vector<LuaPtr>&) -> LuaPtr {
+    return std::make_shared<LuaValue>(LuaValue::from(static_cast<int64_t>(2)));
+  });
+  const auto res = rt.ExecuteScript("return held()");
+  const auto& vals = std::get<std::vector<LuaPtr>>(res);
+  ASSERT_EQ(vals.size(), 1u);
+  EXPECT_EQ(std::get<int64_t>(vals[0]->value), 2);
+}
+
+TEST(LuaRuntimeHostFunctionSlot, RemovedFunctionRaisesAndRebindsOnReregistration) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  rt.StoreHostFunction("__slot_fn", [](const std::vector<LuaPtr>&) -> LuaPtr {
+    return std::make_shared<LuaValue>(LuaValue::from(std::string("first")));
+  });
+  (void)rt.ExecuteScript("t = {}");
+  MetatableEntry e;
+  e.key = "__call";
+  e.is_function = true;
+  e.func_name = "__slot_fn";
+  rt.SetGlobalMetatable("t", {e});
+
+  rt.RemoveHostFunction("__slot_fn");
+  const auto err = rt.ExecuteScript("return t()");
+  ASSERT_TRUE(std::holds_alternative<std::string>(err));
+  EXPECT_NE(std::get<std::string>(err).find("not found"), std::string::npos);
+
+  rt.StoreHostFunction("__slot_fn", [](const std::vector<LuaPtr>&) -> LuaPtr {
+    return std::make_shared<LuaValue>(LuaValue::from(std::string("second")));
+  });
+  const auto res = rt.ExecuteScript("return t(), t()");
+  const auto& vals = std::get<std::vector<LuaPtr>>(res);
+  ASSERT_EQ(vals.size(), 2u);
+  EXPECT_EQ(std::get<std::string>(vals[0]->value), "second");
+  EXPECT_EQ(std::get<std::string>(vals[1]->value), "second");
+}
+
+// ========== Fast Function Tests ==========
+
+TEST(LuaRuntimeFastFunction, ScalarArgumentsAndResultCrossDirectly) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  FastSignature sig;
+  sig.args = {FastScalarType::Number, FastScalarType::Integer, FastScalarType::Boolean};
+  sig.returns = FastScalarType::Number;
+  rt.RegisterFastFunction("fma", sig, [](const FastScalar* args, size_t argc) {
+    EXPECT_EQ(argc, 3u);
+    FastScalar out{};
+    out.number = args[2].boolean ? args[0].number * static_cast<double>(args[1].integer) : 0.0;
+    return out;
+  });
+  const auto res = rt.ExecuteScript(
+    "local s = 0 for i = 1, 100 do s = s + fma(0.5, i, true) end return s, fma(1.5, 2, false)");
+  const auto& vals = std::get<std::vector<LuaPtr>>(res);
+  ASSERT_EQ(vals.size(), 2u);
+  EXPECT_DOUBLE_EQ(std::get<double>(vals[0]->value), 2525.0);
+  EXPECT_DOUBLE_EQ(std::get<double>(vals[1]->value), 0.0);
+}
+
+TEST(LuaRuntimeFastFunction, MismatchedArgumentsRaiseAndThrowsPropagate) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  FastSignature sig;
+  sig.args = {FastScalarType::Integer};
+  sig.returns = FastScalarType::Void;
+  rt.RegisterFastFunction("need_int", sig, [](const FastScalar* args, size_t) -> FastScalar {
+    if (args[0].integer < 0) throw std::runtime_error("negative");
+    return FastScalar{};
+  });
+
+  auto err = rt.ExecuteScript("need_int('1')");
+  ASSERT_TRUE(std::holds_alternative<std::string>(err));
+  EXPECT_NE(std::get<std::string>(err).find("integer expected"), std::string::npos);
+  err = rt.ExecuteScript("need_int(1.5)");
+  ASSERT_TRUE(std::holds_alternative<std::string>(err));
+  EXPECT_NE(std::get<std::string>(err).find("no integer representation"), std::string::npos);
+  err = rt.ExecuteScript("need_int()");
+  ASSERT_TRUE(std::holds_alternative<std::string>(err));
+  EXPECT_NE(std::get<std::string>(err).find("expects 1 argument"), std::string::npos);
+  err = rt.ExecuteScript("need_int(-1)");
+  ASSERT_TRUE(std::holds_alternative<std::string>(err));
+  EXPECT_NE(std::get<std::string>(err).find("negative"), std::string::npos);
+
+  const auto ok = rt.ExecuteScript("return select('#', need_int(3))");
+  EXPECT_EQ(std::get<int64_t>(std::get<std::vector<LuaPtr>>(ok)[0]->value), 0);
+
+  sig.args.assign(LuaRuntime::kMaxFastArgs + 1, FastScalarType::Number);
+  EXPECT_THROW(rt.RegisterFastFunction("too_many", sig,
+                 [](const FastScalar*, size_t) { return FastScalar{}; }),
+               std::invalid_argument);
+}
+
+TEST(LuaRuntimeFastFunction, ReRegisteringAsTheOtherKindReplacesTheName) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  FastSignature sig;
+  sig.returns = FastScalarType::Integer;
+  rt.RegisterFastFunction("f", sig, [](const FastScalar*, size_t) {
+    FastScalar out{};
+    out.integer = 1;
+    return out;
+  });
+  (void)rt.ExecuteScript("old_fast = f");
+  rt.RegisterFunction("f", [](const std::vector<LuaPtr>&) -> LuaPtr {
+    return std::make_shared<LuaValue>(LuaValue::from(int64_t(2)));
+  });
+  auto res = rt.ExecuteScript("return f()");
+  EXPECT_EQ(std::get<int64_t>(std::get<std::vector<LuaPtr>>(res)[0]->value), 2);
+  // A closure kept from the fast registration no longer reaches its callable.
+  auto err = rt.ExecuteScript("old_fast()");
+  ASSERT_TRUE(std::holds_alternative<std::string>(err));
+  EXPECT_NE(std::get<std::string>(err).find("not found"), std::string::npos);
+
+  (void)rt.ExecuteScript("old_plain = f");
+  rt.RegisterFastFunction("f", sig, [](const FastScalar*, size_t) {
+    FastScalar out{};
+    out.integer = 3;
+    return out;
+  });
+  res = rt.ExecuteScript("return f()");
+  EXPECT_EQ(std::get<int64_t>(std::get<std::vector<LuaPtr>>(res)[0]->value), 3);
+  err = rt.ExecuteScript("old_plain()");
+  ASSERT_TRUE(std::holds_alternative<std::string>(err));
+  EXPECT_NE(std::get<std::string>(err).find("not found"), std::string::npos);
+}
+
+// ========== Reference Identity Tests ==========
+
+TEST(LuaRuntimeRefIdentity, RefsToTheSameObjectShareAnIdentity) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  (void)rt.ExecuteScript("f = function() end g = function() end t = setmetatable({}, {})");
+  const auto f1 = std::get<LuaFunctionRef>(rt.GetGlobal("f")->value);
+  const auto f2 = std::get<LuaFunctionRef>(rt.GetGlobal("f")->value);
+  const auto g = std::get<LuaFunctionRef>(rt.GetGlobal("g")->value);
+  EXPECT_NE(f1.identity, nullptr);
+  EXPECT_EQ(f1.identity, f2.identity);
+  EXPECT_NE(f1.ref, f2.ref);  // still independent slots
+  EXPECT_NE(f1.identity, g.identity);
+
+  const auto t1 = std::get<LuaTableRef>(rt.GetGlobal("t")->value);
+  const auto t2 = std::get<LuaTableRef>(rt.GetGlobal("t")->value);
+  EXPECT_NE(t1.identity, nullptr);
+  EXPECT_EQ(t1.identity, t2.identity);
+}
+
+// ========== Host Function Closure Cache Tests ==========
+
+TEST(LuaRuntimeHostFnClosureCache, ReclaimableNamePushedTwiceYieldsOneClosure) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  rt.RegisterReclaimableHostFunction("cb", [](const std::vector<LuaPtr>&) {
+    return std::make_shared<LuaValue>(LuaValue::from(int64_t{7}));
+  });
+  // Nothing pushed yet: there is no live closure to pin.
+  EXPECT_FALSE(rt.PinReclaimableHostFunction("cb"));
+
+  rt.SetGlobal("a", std::make_shared<LuaValue>(LuaValue::from(HostFunctionName{"cb"})));
+  ASSERT_TRUE(rt.PinReclaimableHostFunction("cb"));
+  rt.SetGlobal("b", std::make_shared<LuaValue>(LuaValue::from(HostFunctionName{"cb"})));
+  const auto res = rt.ExecuteScript("return a == b, b()");
+  ASSERT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(res));
+  const auto& vals = std::get<std::vector<LuaPtr>>(res);
+  EXPECT_TRUE(std::get<bool>(vals[0]->value));
+  EXPECT_EQ(std::get<int64_t>(vals[1]->value), 7);
+
+  // The pin alone keeps the entry alive once the closure is gone...
+  (void)rt.ExecuteScript("a = nil b = nil collectgarbage() collectgarbage()");
+  EXPECT_FALSE(rt.EraseReclaimableIfUnpushed("cb"));
+  // ...and releasing it reclaims the entry.
+  rt.UnpinReclaimableHostFunction("cb");
+  EXPECT_FALSE(rt.PinReclaimableHostFunction("cb"));
+}
+
+// ========== Bulk Table Field Tests ==========
+
+TEST(LuaRuntimeBulkTableFields, GetManyReturnsValuesInKeyOrderThroughIndex) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  (void)rt.ExecuteScript(
+    "t = setmetatable({ a = 1, [2] = 'two' }, { __index = function(_, k) return 'missing:' .. tostring(k) end })");
+  const int ref = std::get<int>(rt.GetGlobalRef("t"));
+  const auto vals = rt.GetTableFieldsKeyed(ref,
+    {TableKey{std::string("a")}, TableKey{int64_t{2}}, TableKey{std::string("zz")}});
+  ASSERT_EQ(vals.size(), 3u);
+  EXPECT_EQ(std::get<int64_t>(vals[0]->value), 1);
+  EXPECT_EQ(std::get<std::string>(vals[1]->value), "two");
+  EXPECT_EQ(std::get<std::string>(vals[2]->value), "missing:zz");
+  rt.ReleaseTableRef(ref);
+}
+
+TEST(LuaRuntimeBulkTableFields, SetManyAppliesInOrderUntilARaise) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  (void)rt.ExecuteScript(
+    "t = setmetatable({}, { __newindex = function(t, k, v) if k == 'bad' then error('no') end rawset(t, k, v) end })");
+  const int ref = std::get<int>(rt.GetGlobalRef("t"));
+  const auto num = [](int64_t n) { return std::make_shared<LuaValue>(LuaValue::from(n)); };
+  EXPECT_THROW(rt.SetTableFieldsKeyed(ref, {
+    {TableKey{std::string("x")}, num(1)},
+    {TableKey{std::string("bad")}, num(2)},
+    {TableKey{std::string("y")}, num(3)}}), std::runtime_error);
+  const auto res = rt.ExecuteScript("return t.x, t.y");
+  const auto& vals = std::get<std::vector<LuaPtr>>(res);
+  EXPECT_EQ(std::get<int64_t>(vals[0]->value), 1);
+  EXPECT_TRUE(std::holds_alternative<std::monostate>(vals[1]->value));
+  rt.ReleaseTableRef(ref);
+}
+
+// ========== Table Cursor Tests ==========
+
+TEST(LuaRuntimeTableCursor, WalksEveryEntryInBoundedBatches) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  (void)rt.ExecuteScript(
+    "t = {} for i = 1, 1000 do t['k' .. i] = i end t[true] = 'skipped'");
+  LuaTableCursor cursor(LuaTableRef(std::get<int>(rt.GetGlobalRef("t")), rt.RawState()));
+  int64_t sum = 0;
+  size_t seen = 0;
+  while (!cursor.done) {
+    const auto batch = rt.NextTableEntries(cursor, 64);
+    EXPECT_LE(batch.size(), 64u);
+    for (const auto& [k, v] : batch) {
+      EXPECT_TRUE(std::holds_alternative<std::string>(k->value));
+      sum += std::get<int64_t>(v->value);
+      ++seen;
+    }
+  }
+  EXPECT_EQ(seen, 1000u);
+  EXPECT_EQ(sum, 1000 * 1001 / 2);
+  EXPECT_TRUE(rt.NextTableEntries(cursor, 64).empty());
+}
+
+TEST(LuaRuntimeTableCursor, RebuiltTableInvalidatesTheCursor) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  (void)rt.ExecuteScript("t = {} for i = 1, 8 do t['k' .. i] = i end");
+  LuaTableCursor cursor(LuaTableRef(std::get<int>(rt.GetGlobalRef("t")), rt.RawState()));
+  (void)rt.NextTableEntries(cursor, 2);
+  // Clear the saved key's entry and grow the table enough to force a rehash:
+  // the dead key no longer exists in the rebuilt node part.
+  (void)rt.ExecuteScript("for k in pairs(t) do t[k] = nil end for i = 1, 1000 do t['n' .. i] = i end");
+  EXPECT_THROW({
+    try {
+      (void)rt.NextTableEntries(cursor, 2);
+    } catch (const std::runtime_error& e) {
+      EXPECT_STREQ(e.what(), "table was modified during iteration");
+      throw;
+    }
+  }, std::runtime_error);
+  EXPECT_TRUE(cursor.done);
+}
+
+TEST(LuaRuntimeTableCursor, AssigningAndClearingFieldsMidWalkIsAllowed) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  (void)rt.ExecuteScript("t = {} for i = 1, 8 do t['k' .. i] = i end");
+  LuaTableCursor cursor(LuaTableRef(std::get<int>(rt.GetGlobalRef("t")), rt.RawState()));
+  size_t seen = rt.NextTableEntries(cursor, 2).size();
+  (void)rt.ExecuteScript("for k, v in pairs(t) do t[k] = v * 10 end");
+  seen += rt.NextTableEntries(cursor, 2).size();
+  // Clear the fifth entry in walk order — the key that followed the boundary
+  // when the last batch ended — so the next batch resumes past it.
+  (void)rt.ExecuteScript("local n = 0 for k in pairs(t) do n = n + 1 if n == 5 then t[k] = nil end end");
+  while (!cursor.done) seen += rt.NextTableEntries(cursor, 2).size();
+  EXPECT_EQ(seen, 7u);
+}
+
+TEST(LuaRuntimeTableCursor, TableGrownAroundALiveKeyInvalidatesTheCursor) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  (void)rt.ExecuteScript("t = {} for i = 1, 8 do t['k' .. i] = i end");
+  LuaTableCursor cursor(LuaTableRef(std::get<int>(rt.GetGlobalRef("t")), rt.RawState()));
+  (void)rt.NextTableEntries(cursor, 2);
+  // The saved key survives the rehash, so lua_next would accept it and resume
+  // from wherever it landed in the rebuilt node part.
+  (void)rt.ExecuteScript("for i = 1, 4000 do t['n' .. i] = i end");
+  EXPECT_THROW({
+    try {
+      (void)rt.NextTableEntries(cursor, 2);
+    } catch (const std::runtime_error& e) {
+      EXPECT_STREQ(e.what(), "table was modified during iteration");
+      throw;
+    }
+  }, std::runtime_error);
+  EXPECT_TRUE(cursor.done);
+}
+
+// ========== Numeric Array View Tests ==========
+
+namespace {
+LuaPtr NumericView(LuaRuntime& rt, const int ref_id, void* data, const size_t length,
+                   const NumericArrayType type) {
+  LuaUserdataRef ref(ref_id, rt.RawState());
+  ref.numeric = NumericArrayView{data, length, type};
+  return std::make_shared<LuaValue>(LuaValue::from(std::move(ref)));
+}
+}  // namespace
+
+TEST(LuaRuntimeNumericArrayView, ReadsAndWritesTheSharedMemory) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  std::vector<double> samples{1.5, 2.5, 3.5};
+  rt.SetGlobal("a", NumericView(rt, 1, samples.data(), samples.size(), NumericArrayType::Float64));
+  const auto res = rt.ExecuteScript(
+    "local s = 0 for i = 1, #a do a[i] = a[i] * 2 s = s + a[i] end return s, #a, a[0], a[4]");
+  ASSERT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(res));
+  const auto& vals = std::get<std::vector<LuaPtr>>(res);
+  ASSERT_EQ(vals.size(), 4u);
+  EXPECT_DOUBLE_EQ(std::get<double>(vals[0]->value), 15.0);
+  EXPECT_EQ(std::get<int64_t>(vals[1]->value), 3);
+  EXPECT_TRUE(std::holds_alternative<std::monostate>(vals[2]->value));
+  EXPECT_TRUE(std::holds_alternative<std::monostate>(vals[3]->value));
+  EXPECT_EQ(samples, (std::vector<double>{3.0, 5.0, 7.0}));
+}
+
+TEST(LuaRuntimeNumericArrayView, IntegerElementsRejectOutOfRangeValues) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  std::vector<int16_t> cells{0, 0};
+  rt.SetGlobal("a", NumericView(rt, 1, cells.data(), cells.size(), NumericArrayType::Int16));
+  (void)rt.ExecuteScript("a[1] = -32768 a[2] = 7.0");
+  EXPECT_EQ(cells, (std::vector<int16_t>{-32768, 7}));
+  EXPECT_EQ(std::get<int64_t>(std::get<std::vector<LuaPtr>>(rt.ExecuteScript("return a[1]"))[0]->value),
+            -32768);
+
+  auto res = rt.ExecuteScript("a[1] = 40000");
+  ASSERT_TRUE(std::holds_alternative<std::string>(res));
+  EXPECT_NE(std::get<std::string>(res).find("out of range for Int16Array"), std::string::npos);
+  res = rt.ExecuteScript("a[2] = 1.5");
+  ASSERT_TRUE(std::holds_alternative<std::string>(res));
+  res = rt.ExecuteScript("a[3] = 1");
+  ASSERT_TRUE(std::holds_alternative<std::string>(res));
+  EXPECT_NE(std::get<std::string>(res).find("index out of range"), std::string::npos);
+  EXPECT_EQ(cells, (std::vector<int16_t>{-32768, 7}));
+}
+
+TEST(LuaRuntimeNumericArrayView, ResolverRefreshesAndDetachesTheView) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  std::vector<double> first{1.0, 2.0};
+  std::vector<double> moved{5.0, 6.0, 7.0};
+  bool attached = true;
+  int resolves = 0;
+  rt.SetNumericViewResolver([&](int, NumericArrayView& view) {
+    ++resolves;
+    if (!attached) return false;
+    view.data = moved.data();
+    view.length = moved.size();
+    return true;
+  });
+  rt.SetGlobal("a", NumericView(rt, 1, first.data(), first.size(), NumericArrayType::Float64));
+
+  // The first access sees the memory the resolver reports now, not the
+  // original, and later ones reuse it without asking again.
+  const auto res = rt.ExecuteScript("return #a * 100 + a[3] + a[1] * 0");
+  ASSERT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(res));
+  EXPECT_DOUBLE_EQ(std::get<double>(std::get<std::vector<LuaPtr>>(res)[0]->value), 307.0);
+  EXPECT_EQ(resolves, 1);
+
+  // A host function's return re-resolves the view: it may have run JS.
+  rt.RegisterFunction("js", [&](const std::vector<LuaPtr>&) -> LuaPtr {
+    attached = false;
+    return std::make_shared<LuaValue>(LuaValue::nil());
+  });
+  const auto during = rt.ExecuteScript("local x = a[1]; js(); return a[1]");
+  ASSERT_TRUE(std::holds_alternative<std::string>(during));
+  EXPECT_NE(std::get<std::string>(during).find("typed array has been detached"),
+            std::string::npos);
+
+  // So does each entry, through the embedder.
+  for (const char* script : {"return a[1]", "a[1] = 0", "return #a"}) {
+    rt.InvalidateNumericViews();
+    const auto gone = rt.ExecuteScript(script);
+    ASSERT_TRUE(std::holds_alternative<std::string>(gone)) << script;
+    EXPECT_NE(std::get<std::string>(gone).find("typed array has been detached"),
+              std::string::npos);
+  }
+  EXPECT_EQ(first, (std::vector<double>{1.0, 2.0}));
+}
+
+TEST(LuaRuntimeNumericArrayView, AsyncModeUsesTheLastResolvedView) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  std::vector<double> cells{1.0, 2.0};
+  int resolves = 0;
+  rt.SetNumericViewResolver([&](int, NumericArrayView&) {
+    ++resolves;
+    return true;
+  });
+  rt.SetGlobal("a", NumericView(rt, 1, cells.data(), cells.size(), NumericArrayType::Float64));
+  rt.SetAsyncMode(true);
+  rt.InvalidateNumericViews();
+  const auto res = rt.ExecuteScript("a[2] = a[1] + a[2]; return #a");
+  rt.SetAsyncMode(false);
+  ASSERT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(res));
+  EXPECT_EQ(resolves, 0);
+  EXPECT_EQ(cells, (std::vector<double>{1.0, 3.0}));
+}
+
+TEST(LuaRuntimeNumericArrayView, RoundTripsWithItsRefIdAndView) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  std::vector<float> cells{1.0f};
+  rt.SetGlobal("a", NumericView(rt, 9, cells.data(), cells.size(), NumericArrayType::Float32));
+  const auto back = rt.GetGlobal("a");
+  ASSERT_TRUE(std::holds_alternative<LuaUserdataRef>(back->value));
+  const auto& ref = std::get<LuaUserdataRef>(back->value);
+  EXPECT_EQ(ref.ref_id, 9);
+  EXPECT_FALSE(ref.opaque);
+  ASSERT_TRUE(ref.numeric.has_value());
+  EXPECT_EQ(ref.numeric->data, cells.data());
+  EXPECT_EQ(ref.numeric->type, NumericArrayType::Float32);
+}
+
+TEST(LuaRuntimeNumericArrayView, PinOutlivesTheLastLuaReference) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  int released = -1;
+  rt.SetUserdataGCCallback([&](const int ref_id) { released = ref_id; });
+  std::vector<int32_t> cells{1};
+  rt.IncrementUserdataRefCount(4);  // the binding's pin
+  rt.SetGlobal("a", NumericView(rt, 4, cells.data(), cells.size(), NumericArrayType::Int32));
+  (void)rt.ExecuteScript("a = nil");
+  lua_gc(rt.RawState(), LUA_GCCOLLECT, 0);
+  EXPECT_EQ(released, -1);
+  rt.ReleaseUserdataPin(4);
+  EXPECT_EQ(released, 4);
+}
+
+// ========== Vector Library Tests ==========
+
+namespace {
+std::vector<std::string> VectorLibraries() {
+  auto libs = LuaRuntime::AllLibraries();
+  libs.emplace_back("vector");
+  return libs;
+}
+}  // namespace
+
+TEST(LuaRuntimeVectorLibrary, IsOptInAndOutsideThePresets) {
+  const LuaRuntime plain(LuaRuntime::AllLibraries());
+  EXPECT_TRUE(std::get<bool>(std::get<std::vector<LuaPtr>>(
+    plain.ExecuteScript("return vector == nil"))[0]->value));
+  const LuaRuntime rt(VectorLibraries());
+  EXPECT_TRUE(std::get<bool>(std::get<std::vector<LuaPtr>>(
+    rt.ExecuteScript("return package.loaded.vector == vector"))[0]->value));
+}
+
+TEST(LuaRuntimeVectorLibrary, ReductionsOverAViewAndALuaArray) {
+  LuaRuntime rt(VectorLibraries());
+  std::vector<double> xs(1003);
+  for (size_t i = 0; i < xs.size(); ++i) xs[i] = static_cast<double>(i + 1);
+  rt.SetGlobal("xs", NumericView(rt, 1, xs.data(), xs.size(), NumericArrayType::Float64));
+  const auto res = rt.ExecuteScript(R"(
+    local ys = vector.from({}, 'float64')
+    local ones = vector.new(#xs)
+    for i = 1, #ones do ones[i] = 1 end
+    local lo, lo_i = vector.min(xs)
+    local hi, hi_i = vector.max(xs)
+    return vector.sum(xs), vector.dot(xs, ones), lo, lo_i, hi, hi_i, #ys, vector.min(ys)
+  )");
+  ASSERT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(res));
+  const auto& vals = std::get<std::vector<LuaPtr>>(res);
+  ASSERT_EQ(vals.size(), 8u);
+  EXPECT_DOUBLE_EQ(std::get<double>(vals[0]->value), 1003.0 * 1004 / 2);
+  EXPECT_DOUBLE_EQ(std::get<double>(vals[1]->value), 1003.0 * 1004 / 2);
+  EXPECT_DOUBLE_EQ(std::get<double>(vals[2]->value), 1.0);
+  EXPECT_EQ(std::get<int64_t>(vals[3]->value), 1);
+  EXPECT_DOUBLE_EQ(std::get<double>(vals[4]->value), 1003.0);
+  EXPECT_EQ(std::get<int64_t>(vals[5]->value), 1003);
+  EXPECT_EQ(std::get<int64_t>(vals[6]->value), 0);
+  EXPECT_TRUE(std::holds_alternative<std::monostate>(vals[7]->value));
+}
+
+TEST(LuaRuntimeVectorLibrary, InPlaceKernelsWriteThroughTheView) {
+  LuaRuntime rt(VectorLibraries());
+  std::vector<float> y{1.0f, 2.0f, 3.0f};
+  std::vector<int32_t> v{5, -1, 3, 2};
+  rt.SetGlobal("y", NumericView(rt, 1, y.data(), y.size(), NumericArrayType::Float32));
+  rt.SetGlobal("v", NumericView(rt, 2, v.data(), v.size(), NumericArrayType::Int32));
+  const auto res = rt.ExecuteScript(R"(
+    vector.axpy(2, vector.from({1, 1, 1}, 'float32'), y)
+    vector.sort(v)
+    local mask = vector.compare(v, '>', 1)
+    return vector.sum(mask), vector.type(mask), vector.sum(vector.cumsum(vector.from({1, 2, 3}, 'int32')))
+  )");
+  ASSERT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(res));
+  const auto& vals = std::get<std::vector<LuaPtr>>(res);
+  EXPECT_EQ(y, (std::vector<float>{3.0f, 4.0f, 5.0f}));
+  EXPECT_EQ(v, (std::vector<int32_t>{-1, 2, 3, 5}));
+  EXPECT_EQ(std::get<int64_t>(vals[0]->value), 3);
+  EXPECT_EQ(std::get<std::string>(vals[1]->value), "int8");
+  EXPECT_EQ(std::get<int64_t>(vals[2]->value), 1 + 3 + 6);
+}
+
+TEST(LuaRuntimeVectorLibrary, RejectsMismatchedShapesAndOverflow) {
+  const LuaRuntime rt(VectorLibraries());
+  auto res = rt.ExecuteScript("return vector.dot(vector.new(2), vector.new(3))");
+  ASSERT_TRUE(std::holds_alternative<std::string>(res));
+  EXPECT_NE(std::get<std::string>(res).find("lengths differ"), std::string::npos);
+  res = rt.ExecuteScript("return vector.dot(vector.new(2), vector.new(2, 'int32'))");
+  ASSERT_TRUE(std::holds_alternative<std::string>(res));
+  EXPECT_NE(std::get<std::string>(res).find("element types differ"), std::string::npos);
+  res = rt.ExecuteScript("return vector.cumsum(vector.from({100, 100}, 'int8'))");
+  ASSERT_TRUE(std::holds_alternative<std::string>(res));
+  EXPECT_NE(std::get<std::string>(res).find("out of range for Int8Array"), std::string::npos);
+  res = rt.ExecuteScript("return vector.new(1, 'int64')");
+  ASSERT_TRUE(std::holds_alternative<std::string>(res));
+}
+
+TEST(LuaRuntimeVectorLibrary, LuaMadeArraysLeaveAsPlainArrays) {
+  const LuaRuntime rt(VectorLibraries());
+  const auto res = rt.ExecuteScript("return vector.from({1, 2, 3}, 'int16')");
+  ASSERT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(res));
+  const auto& arr = std::get<LuaArray>(std::get<std::vector<LuaPtr>>(res)[0]->value);
+  ASSERT_EQ(arr.size(), 3u);
+  EXPECT_EQ(std::get<int64_t>(arr[2]->value), 3);
+}
+
+// ========== JSON Decode Tests ==========
+
+TEST(LuaRuntimeJsonDecode, MapsLikeTheEquivalentJsValue) {
+  const LuaRuntime rt(LuaRuntime::AllLibraries());
+  rt.SetGlobalJson({"doc"}, R"( {"name": "caf\u00e9 \ud83d\ude00", "n": 3, "f": 2.5, "e": 1e2,
+    "big": 9007199254740993, "neg": -9223372036854775808, "ok": true, "none": null,
+    "list": [1, null, 3], "empty": {}, "esc": "a\"b\\c\n"} )");
+  const auto res = rt.ExecuteScript(R"(
+    return doc.name, math.type(doc.n), doc.f, math.type(doc.e), doc.big, doc.neg == math.mininteger,
+           doc.ok, doc.none == nil, doc.list[1], doc.list[2] == nil, doc.list[3],
+           next(doc.empty) == nil, doc.esc
+  )");
+  ASSERT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(res));
+  const auto& v = std::get<std::vector<LuaPtr>>(res);
+  ASSERT_EQ(v.size(), 13u);
+  EXPECT_EQ(std::get<std::string>(v[0]->value), "caf\xC3\xA9 \xF0\x9F\x98\x80");
+  EXPECT_EQ(std::get<std::string>(v[1]->value), "integer");
+  EXPECT_DOUBLE_EQ(std::get<double>(v[2]->value), 2.5);
+  EXPECT_EQ(std::get<std::string>(v[3]->value), "integer");
+  EXPECT_EQ(std::get<int64_t>(v[4]->value), 9007199254740993LL);
+  EXPECT_TRUE(std::get<bool>(v[5]->value));
+  EXPECT_TRUE(std::get<bool>(v[6]->value));
+  EXPECT_TRUE(std::get<bool>(v[7]->value));
+  EXPECT_EQ(std::get<int64_t>(v[8]->value), 1);
+  EXPECT_TRUE(std::get<bool>(v[9]->value));
+  EXPECT_EQ(std::get<int64_t>(v[10]->value), 3);
+  EXPECT_TRUE(std::get<bool>(v[11]->value));
+  EXPECT_EQ(std::get<std::string>(v[12]->value), "a\"b\\c\n");
+}
+
+TEST(LuaRuntimeJsonDecode, DottedPathAndLongStrings) {
+  const LuaRuntime rt(LuaRuntime::AllLibraries());
+  const std::string body(1000, 'x');
+  rt.SetGlobalJson({"cfg", "blob"}, "\"" + body + "\"");
+  EXPECT_EQ(std::get<std::string>(rt.GetGlobalPath({"cfg", "blob"})->value), body);
+}
+
+TEST(LuaRuntimeJsonDecode, MalformedInputThrowsAndLeavesTargetUnset) {
+  const LuaRuntime rt(LuaRuntime::AllLibraries());
+  for (const char* bad : {"{\"a\": 1,}", "[1, 2", "tru", "01", "\"tab\there\"", "{} x", "\"\\q\"", ""}) {
+    EXPECT_THROW(rt.SetGlobalJson({"doc"}, bad), std::runtime_error) << bad;
+  }
+  EXPECT_TRUE(std::holds_alternative<std::monostate>(rt.GetGlobal("doc")->value));
+  try {
+    rt.SetGlobalJson({"doc"}, "[1, ?]");
+    FAIL() << "expected a parse error";
+  } catch (const std::runtime_error& e) {
+    EXPECT_NE(std::string(e.what()).find("offset 4"), std::string::npos) << e.what();
+  }
+}
+
+TEST(LuaRuntimeJsonDecode, NestingIsBoundedByMaxDepth) {
+  const LuaRuntime rt(LuaRuntime::AllLibraries());
+  const int depth = LuaRuntime::kMaxDepth + 5;
+  const std::string deep = std::string(depth, '[') + std::string(depth, ']');
+  EXPECT_THROW(rt.SetGlobalJson({"doc"}, deep), std::runtime_error);
+}
+
+// ========== JSON Encode Tests ==========
+
+namespace {
+std::string JsonOf(const LuaRuntime& rt, const std::string& script, const JsonEncodeOptions& options = {}) {
+  const auto res = rt.ExecuteScriptJson(script, options);
+  if (std::holds_alternative<std::string>(res)) return "error: " + std::get<std::string>(res);
+  return std::get<JsonText>(res).text;
+}
+}  // namespace
+
+TEST(LuaRuntimeJsonEncode, MatchesTheValueConversionShapes) {
+  const LuaRuntime rt(LuaRuntime::AllLibraries());
+  EXPECT_EQ(JsonOf(rt, "return {1, 2.5, 'x', true}"), R"([1,2.5,"x",true])");
+  EXPECT_EQ(JsonOf(rt, "return {a = {b = {}}}"), R"({"a":{"b":[]}})");
+  const std::string holes = JsonOf(rt, "return {[1] = 'a', [3] = 'c'}");  // pairs() order
+  EXPECT_TRUE(holes == R"({"1":"a","3":"c"})" || holes == R"({"3":"c","1":"a"})") << holes;
+  EXPECT_EQ(JsonOf(rt, "return {[2.5] = 1}"), R"({"2.5":1})");
+  EXPECT_EQ(JsonOf(rt, R"(return 'q"\\\n\1')"), R"("q\"\\\n\u0001")");
+  EXPECT_EQ(JsonOf(rt, "return 0/0, 1/0, 0.1, math.maxinteger"), R"([null,null,0.1,9223372036854775807])");
+  EXPECT_EQ(JsonOf(rt, "return"), "null");
+  EXPECT_EQ(JsonOf(rt, "return setmetatable({1}, {__index = function() return 9 end})"), "[1]");
+}
+
+TEST(LuaRuntimeJsonEncode, EmptyTableAndSparseArrayOptions) {
+  const LuaRuntime rt(LuaRuntime::AllLibraries());
+  JsonEncodeOptions options;
+  options.empty_table_as_object = true;
+  options.sparse_arrays = true;
+  EXPECT_EQ(JsonOf(rt, "return {}", options), "{}");
+  EXPECT_EQ(JsonOf(rt, "return {[1] = 'a', [3] = 'c'}", options), R"(["a",null,"c"])");
+  // Too sparse to be worth an array: stays an object.
+  EXPECT_EQ(JsonOf(rt, "return {[1000] = 1}", options), R"({"1000":1})");
+  // The bound is exactly half full: 2 of 4 slots is an array, 2 of 5 is not.
+  EXPECT_EQ(JsonOf(rt, "return {[1] = 1, [4] = 4}", options), "[1,null,null,4]");
+  EXPECT_EQ(JsonOf(rt, "return {[1] = 1, [5] = 5}", options).front(), '{');
+}
+
+TEST(LuaRuntimeJsonEncode, RejectsWhatJsonCannotHold) {
+  const LuaRuntime rt(LuaRuntime::AllLibraries());
+  EXPECT_EQ(JsonOf(rt, "return {f = print}"), "error: cannot encode a function as JSON");
+  EXPECT_EQ(JsonOf(rt, "local t = {} t.self = t return t"), "error: cannot encode a cyclic table as JSON");
+  // A table reached twice without a cycle is fine.
+  EXPECT_EQ(JsonOf(rt, "local t = {1} return {t, t}"), "[[1],[1]]");
+  // The stack is left clean either way.
+  EXPECT_EQ(lua_gettop(rt.RawState()), 0);
+}
+
+TEST(LuaRuntimeJsonEncode, NumericViewsEncodeAsArrays) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  std::vector<int16_t> cells{-1, 2};
+  rt.SetGlobal("a", NumericView(rt, 1, cells.data(), cells.size(), NumericArrayType::Int16));
+  EXPECT_EQ(JsonOf(rt, "return {data = a}"), R"({"data":[-1,2]})");
+}
+
+// ========== JSON Library Tests ==========
+
+namespace {
+std::vector<std::string> JsonLibraries() {
+  auto libs = LuaRuntime::AllLibraries();
+  libs.emplace_back("json");
+  return libs;
+}
+}  // namespace
+
+TEST(LuaRuntimeJsonLibrary, RoundTripsThroughEncodeAndDecode) {
+  const LuaRuntime rt(JsonLibraries());
+  const auto res = rt.ExecuteScript(R"(
+    local text = json.encode({ name = "x", list = { 1, 2.5, true }, empty = {} })
+    local back = json.decode(text)
+    return back.name, #back.list, back.list[2], next(back.empty) == nil
+  )");
+  ASSERT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(res));
+  const auto& v = std::get<std::vector<LuaPtr>>(res);
+  EXPECT_EQ(std::get<std::string>(v[0]->value), "x");
+  EXPECT_EQ(std::get<int64_t>(v[1]->value), 3);
+  EXPECT_DOUBLE_EQ(std::get<double>(v[2]->value), 2.5);
+  EXPECT_TRUE(std::get<bool>(v[3]->value));
+}
+
+TEST(LuaRuntimeJsonLibrary, NullSentinelAndEncodeOptions) {
+  const LuaRuntime rt(JsonLibraries());
+  const auto res = rt.ExecuteScript(R"(
+    local arr = json.decode("[1, null, 3]", { null = json.null })
+    return #arr, arr[2] == json.null, json.encode(arr), json.encode({}, { empty_table = "object" }),
+           json.encode({ [1] = 1, [3] = 3 }, { sparse_arrays = true }), json.decode("null") == nil,
+           json.decode("null", {}, "not the null") == nil
+  )");
+  ASSERT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(res));
+  const auto& v = std::get<std::vector<LuaPtr>>(res);
+  EXPECT_EQ(std::get<int64_t>(v[0]->value), 3);
+  EXPECT_TRUE(std::get<bool>(v[1]->value));
+  EXPECT_EQ(std::get<std::string>(v[2]->value), "[1,null,3]");
+  EXPECT_EQ(std::get<std::string>(v[3]->value), "{}");
+  EXPECT_EQ(std::get<std::string>(v[4]->value), "[1,null,3]");
+  EXPECT_TRUE(std::get<bool>(v[5]->value));
+  EXPECT_TRUE(std::get<bool>(v[6]->value));  // a third argument is ignored
+}
+
+TEST(LuaRuntimeJsonLibrary, ErrorsAreCatchableLuaErrors) {
+  const LuaRuntime rt(JsonLibraries());
+  const auto res = rt.ExecuteScript(R"(
+    local ok1, e1 = pcall(json.decode, "[1,")
+    local ok2, e2 = pcall(json.encode, { f = print })
+    return ok1, e1, ok2, e2
+  )");
+  ASSERT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(res));
+  const auto& v = std::get<std::vector<LuaPtr>>(res);
+  EXPECT_FALSE(std::get<bool>(v[0]->value));
+  EXPECT_NE(std::get<std::string>(v[1]->value).find("JSON parse error"), std::string::npos);
+  EXPECT_FALSE(std::get<bool>(v[2]->value));
+  EXPECT_EQ(std::get<std::string>(v[3]->value), "json.encode: cannot encode a function as JSON");
+}
+
+// ========== Shared Data Tests ==========
+
+namespace {
+std::shared_ptr<SharedDataSlot> CatalogSlot(const std::string& name, int64_t price) {
+  LuaTable item;
+  item.emplace("name", std::make_shared<LuaValue>(LuaValue::from(name)));
+  item.emplace("price", std::make_shared<LuaValue>(LuaValue::from(price)));
+  LuaArray items;
+  items.push_back(std::make_shared<LuaValue>(LuaValue::from(std::move(item))));
+  items.push_back(std::make_shared<LuaValue>(LuaValue::from(std::string("loose"))));
+  LuaTable root;
+  root.emplace("items", std::make_shared<LuaValue>(LuaValue::from(std::move(items))));
+  root.emplace("ratio", std::make_shared<LuaValue>(LuaValue::from(0.5)));
+  root.emplace("7", std::make_shared<LuaValue>(LuaValue::from(true)));
+  return std::make_shared<SharedDataSlot>(SharedData::FromValue(LuaValue::from(std::move(root))));
+}
+}  // namespace
+
+TEST(LuaRuntimeSharedData, BuilderSortsKeysAndRejectsNonPlainData) {
+  SharedDataBuilder b;
+  const uint32_t obj = b.AddObject(3);
+  b.SetEntry(obj, 0, "zeta", b.AddInteger(1));
+  b.SetEntry(obj, 1, "alpha", b.AddString("a"));
+  b.SetEntry(obj, 2, "mid", b.AddNil());
+  const auto data = b.Finish(obj);
+  const auto& root = data->node(data->root());
+  ASSERT_EQ(root.kind, SharedData::Kind::Object);
+  EXPECT_EQ(data->EntryKey(root, 0), "alpha");
+  EXPECT_EQ(data->EntryKey(root, 2), "zeta");
+  ASSERT_TRUE(data->FindEntry(root, "mid").has_value());
+  EXPECT_FALSE(data->FindEntry(root, "nope").has_value());
+  EXPECT_GT(data->ByteSize(), 0u);
+
+  SharedDataBuilder dup;
+  const uint32_t d = dup.AddObject(2);
+  dup.SetEntry(d, 0, "k", dup.AddNil());
+  dup.SetEntry(d, 1, "k", dup.AddNil());
+  EXPECT_THROW(dup.Finish(d), std::runtime_error);
+
+  LuaTable fn;
+  fn.emplace("f", std::make_shared<LuaValue>(LuaValue::from(HostFunctionName{"f"})));
+  EXPECT_THROW(SharedData::FromValue(LuaValue::from(std::move(fn))), std::runtime_error);
+}
+
+TEST(LuaRuntimeSharedData, LuaReadsTheNodesInPlace) {
+  const LuaRuntime rt(LuaRuntime::AllLibraries());
+  rt.SetGlobalSharedData({"catalog"}, CatalogSlot("pen", 3));
+  const auto res = rt.ExecuteScript(R"(
+    local keys = {}
+    for k in pairs(catalog) do keys[#keys + 1] = k end
+    local n = 0
+    for i, v in ipairs(catalog.items) do n = n + i end
+    return catalog.items[1].name, catalog.items[1].price, #catalog.items, catalog.ratio,
+           catalog[7], table.concat(keys, ","), n, catalog.items == catalog.items,
+           catalog.missing == nil, pcall(function() catalog.ratio = 1 end)
+  )");
+  ASSERT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(res));
+  const auto& v = std::get<std::vector<LuaPtr>>(res);
+  ASSERT_EQ(v.size(), 11u);
+  EXPECT_EQ(std::get<std::string>(v[0]->value), "pen");
+  EXPECT_EQ(std::get<int64_t>(v[1]->value), 3);
+  EXPECT_EQ(std::get<int64_t>(v[2]->value), 2);
+  EXPECT_DOUBLE_EQ(std::get<double>(v[3]->value), 0.5);
+  EXPECT_TRUE(std::get<bool>(v[4]->value));
+  EXPECT_EQ(std::get<std::string>(v[5]->value), "7,items,ratio");
+  EXPECT_EQ(std::get<int64_t>(v[6]->value), 3);
+  EXPECT_TRUE(std::get<bool>(v[7]->value));
+  EXPECT_TRUE(std::get<bool>(v[8]->value));
+  EXPECT_FALSE(std::get<bool>(v[9]->value));
+  EXPECT_NE(std::get<std::string>(v[10]->value).find("shared data is read-only"), std::string::npos);
+}
+
+TEST(LuaRuntimeSharedData, StoreSwapsTheVersionEveryStateReads) {
+  const LuaRuntime a(LuaRuntime::AllLibraries());
+  const LuaRuntime b(LuaRuntime::AllLibraries());
+  const auto slot = CatalogSlot("pen", 3);
+  a.SetGlobalSharedData({"catalog"}, slot);
+  b.SetGlobalSharedData({"cfg", "catalog"}, slot);
+  ASSERT_FALSE(std::holds_alternative<std::string>(a.ExecuteScript("old = catalog.items[1]")));
+
+  slot->Store(CatalogSlot("ink", 9)->Load());
+  EXPECT_EQ(slot->version(), 2u);
+  const auto res = a.ExecuteScript("return catalog.items[1].name, old.name");
+  ASSERT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(res));
+  const auto& v = std::get<std::vector<LuaPtr>>(res);
+  EXPECT_EQ(std::get<std::string>(v[0]->value), "ink");
+  // A nested view stays on the version it was read from.
+  EXPECT_EQ(std::get<std::string>(v[1]->value), "pen");
+  const auto other = b.ExecuteScript("return cfg.catalog.items[1].name");
+  ASSERT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(other));
+  EXPECT_EQ(std::get<std::string>(std::get<std::vector<LuaPtr>>(other)[0]->value), "ink");
+}
+
+TEST(LuaRuntimeSharedData, ViewsLeaveLuaAsPlainData) {
+  const LuaRuntime rt(LuaRuntime::AllLibraries());
+  rt.SetGlobalSharedData({"catalog"}, CatalogSlot("pen", 3));
+  const auto items = rt.GetGlobalPath({"catalog", "items"});
+  const auto& arr = std::get<LuaArray>(items->value);
+  ASSERT_EQ(arr.size(), 2u);
+  EXPECT_EQ(std::get<std::string>(arr[1]->value), "loose");
+  EXPECT_EQ(JsonOf(rt, "return catalog.items"), R"([{"name":"pen","price":3},"loose"])");
+}
+
+// ========== Lazy Table Tests ==========
+
+namespace {
+// A host table for SetGlobalLazyTable that counts how often it is pulled.
+struct CountingSource {
+  std::shared_ptr<std::atomic<uint64_t>> version = std::make_shared<std::atomic<uint64_t>>(1);
+  LuaTable fields;
+  int fetches = 0;
+  int full_fetches = 0;
+
+  std::shared_ptr<const LazyTableSource> Source() {
+    auto source = std::make_shared<LazyTableSource>();
+    source->version = version;
+    source->fetch = [this](const std::string& key) {
+      ++fetches;
+      const auto it = fields.find(key);
+      return it == fields.end() ? std::make_shared<LuaValue>(LuaValue::nil()) : it->second;
+    };
+    source->fetch_all = [this]() {
+      ++full_fetches;
+      return std::make_shared<LuaValue>(LuaValue::from(fields));
+    };
+    return source;
+  }
+};
+}  // namespace
+
+TEST(LuaRuntimeLazyTable, PullsEachFieldOncePerVersion) {
+  const LuaRuntime rt(LuaRuntime::AllLibraries());
+  CountingSource host;
+  host.fields.emplace("mode", std::make_shared<LuaValue>(LuaValue::from(std::string("dev"))));
+  rt.SetGlobalLazyTable({"settings"}, host.Source());
+  EXPECT_EQ(host.fetches, 0);
+
+  auto res = rt.ExecuteScript("return settings.mode, settings.mode, settings.missing, settings.missing");
+  ASSERT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(res));
+  EXPECT_EQ(std::get<std::string>(std::get<std::vector<LuaPtr>>(res)[1]->value), "dev");
+  EXPECT_EQ(host.fetches, 2);  // one per key, the absent one included
+
+  // A change costs nothing until the next read, which pulls again.
+  host.fields["mode"] = std::make_shared<LuaValue>(LuaValue::from(std::string("prod")));
+  host.version->fetch_add(1);
+  EXPECT_EQ(host.fetches, 2);
+  res = rt.ExecuteScript("return settings.mode");
+  EXPECT_EQ(std::get<std::string>(std::get<std::vector<LuaPtr>>(res)[0]->value), "prod");
+  EXPECT_EQ(host.fetches, 3);
+}
+
+TEST(LuaRuntimeLazyTable, PairsAndLengthMaterializeOnce) {
+  const LuaRuntime rt(LuaRuntime::AllLibraries());
+  CountingSource host;
+  host.fields.emplace("1", std::make_shared<LuaValue>(LuaValue::from(int64_t{10})));
+  host.fields.emplace("b", std::make_shared<LuaValue>(LuaValue::from(true)));
+  rt.SetGlobalLazyTable({"t"}, host.Source());
+  const auto res = rt.ExecuteScript(R"(
+    t.local_edit = 5
+    local n = 0
+    for k, v in pairs(t) do n = n + 1 end
+    return n, t.local_edit, t.b, t.nope
+  )");
+  ASSERT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(res));
+  const auto& v = std::get<std::vector<LuaPtr>>(res);
+  EXPECT_EQ(std::get<int64_t>(v[0]->value), 3);
+  EXPECT_EQ(std::get<int64_t>(v[1]->value), 5);
+  EXPECT_TRUE(std::get<bool>(v[2]->value));
+  EXPECT_TRUE(std::holds_alternative<std::monostate>(v[3]->value));
+  EXPECT_EQ(host.full_fetches, 1);
+  EXPECT_EQ(host.fetches, 0);  // everything after pairs() came from the cache
+}
+
+TEST(LuaRuntimeLazyTable, StaleReadsRaiseInAsyncModeAndHostErrorsPropagate) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  CountingSource host;
+  rt.SetGlobalLazyTable({"t"}, host.Source());
+  rt.SetAsyncMode(true);
+  auto res = rt.ExecuteScript("return t.x");
+  rt.SetAsyncMode(false);
+  ASSERT_TRUE(std::holds_alternative<std::string>(res));
+  EXPECT_NE(std::get<std::string>(res).find("async mode"), std::string::npos);
+
+  auto source = std::make_shared<LazyTableSource>();
+  source->version = host.version;
+  source->fetch = [](const std::string&) -> LuaPtr { throw std::runtime_error("boom"); };
+  rt.SetGlobalLazyTable({"bad"}, source);
+  res = rt.ExecuteScript("return bad.x");
+  ASSERT_TRUE(std::holds_alternative<std::string>(res));
+  EXPECT_NE(std::get<std::string>(res).find("shared table read failed: boom"), std::string::npos);
+}
+
+TEST(LuaRuntimeLazyTable, ConvertsAndEncodesAsItsContents) {
+  const LuaRuntime rt(JsonLibraries());
+  CountingSource host;
+  host.fields.emplace("n", std::make_shared<LuaValue>(LuaValue::from(int64_t{4})));
+  rt.SetGlobalLazyTable({"t"}, host.Source());
+
+  const auto value = rt.GetGlobal("t");
+  ASSERT_TRUE(std::holds_alternative<LuaTable>(value->value));
+  EXPECT_EQ(std::get<int64_t>(std::get<LuaTable>(value->value).at("n")->value), 4);
+
+  const auto res = rt.ExecuteScript("t.m = true; return json.encode(t)");
+  ASSERT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(res));
+  const auto& text = std::get<std::string>(std::get<std::vector<LuaPtr>>(res)[0]->value);
+  EXPECT_NE(text.find(R"("n":4)"), std::string::npos) << text;
+  EXPECT_NE(text.find(R"("m":true)"), std::string::npos) << text;
+
+  // A failed pull is an error, not an empty table.
+  auto source = std::make_shared<LazyTableSource>();
+  source->version = host.version;
+  source->fetch_all = []() -> LuaPtr { throw std::runtime_error("boom"); };
+  rt.SetGlobalLazyTable({"bad"}, source);
+  EXPECT_THROW((void)rt.GetGlobal("bad"), std::runtime_error);
+  const auto bad = rt.ExecuteScript("return json.encode(bad)");
+  ASSERT_TRUE(std::holds_alternative<std::string>(bad));
+  EXPECT_NE(std::get<std::string>(bad).find("shared table read failed: boom"), std::string::npos);
+}
+
+// ========== Userdata Method Table Tests ==========
+
+TEST(LuaRuntimeUserdataMethods, MethodsTravelWithEveryBlock) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  int getter_calls = 0;
+  rt.SetPropertyHandlers(
+    [&](int, const std::string&) -> LuaPtr {
+      ++getter_calls;
+      return std::make_shared<LuaValue>(LuaValue::nil());
+    },
+    nullptr);
+  rt.StoreHostFunction("__m_double", [](const std::vector<LuaPtr>& args) -> LuaPtr {
+    return std::make_shared<LuaValue>(LuaValue::from(std::get<int64_t>(args[1]->value) * 2));
+  });
+  rt.RegisterFunction("passthrough", [](const std::vector<LuaPtr>& args) -> LuaPtr {
+    return args[0];
+  });
+  rt.SetUserdataMethodTable(4, {{"double", "__m_double"}});
+  rt.CreateProxyUserdataGlobal("obj", 4);
+
+  // A re-pushed block (a new userdata with the same ref_id) carries the table too.
+  const auto res = rt.ExecuteScript(R"(
+    local copy = passthrough(obj)
+    return obj:double(21), copy:double(5), obj.double == obj.double, rawequal(obj, copy)
+  )");
+  ASSERT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(res));
+  const auto& vals = std::get<std::vector<LuaPtr>>(res);
+  ASSERT_EQ(vals.size(), 4u);
+  EXPECT_EQ(std::get<int64_t>(vals[0]->value), 42);
+  EXPECT_EQ(std::get<int64_t>(vals[1]->value), 10);
+  EXPECT_TRUE(std::get<bool>(vals[2]->value));
+  EXPECT_FALSE(std::get<bool>(vals[3]->value));
+  EXPECT_EQ(getter_calls, 0);  // method hits never reach the property getter
+}
+
+TEST(LuaRuntimeUserdataMethods, AccessFlagsAreEnforcedWithoutTheHandlers) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  int handler_calls = 0;
+  rt.SetPropertyHandlers(
+    [&](int, const std::string&) -> LuaPtr {
+      ++handler_calls;
+      return std::make_shared<LuaValue>(LuaValue::from(int64_t{1}));
+    },
+    [&](int, const std::string&, const LuaPtr&) { ++handler_calls; });
+  rt.StoreHostFunction("__m_id", [](const std::vector<LuaPtr>&) -> LuaPtr {
+    return std::make_shared<LuaValue>(LuaValue::from(int64_t{7}));
+  });
+  rt.SetUserdataMethodTable(1, {{"id", "__m_id"}});
+  rt.SetUserdataAccess(1, false, false);
+  rt.CreateProxyUserdataGlobal("locked", 1);
+  rt.SetUserdataAccess(2, true, false);
+  rt.CreateProxyUserdataGlobal("readonly", 2);
+
+  // Not readable but has methods: a non-method key reads as nil.
+  const auto res = rt.ExecuteScript("return locked:id(), locked.other, readonly.x");
+  ASSERT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(res));
+  const auto& vals = std::get<std::vector<LuaPtr>>(res);
+  ASSERT_EQ(vals.size(), 3u);
+  EXPECT_EQ(std::get<int64_t>(vals[0]->value), 7);
+  EXPECT_TRUE(std::holds_alternative<std::monostate>(vals[1]->value));
+  EXPECT_EQ(std::get<int64_t>(vals[2]->value), 1);
+  EXPECT_EQ(handler_calls, 1);
+
+  const auto err = rt.ExecuteScript("readonly.x = 2");
+  ASSERT_TRUE(std::holds_alternative<std::string>(err));
+  EXPECT_NE(std::get<std::string>(err).find("userdata is not writable"), std::string::npos);
+  EXPECT_EQ(handler_calls, 1);
+}
+
+TEST(LuaRuntimeUserdataMethods, ClearedWhenTheLastBlockIsCollected) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  rt.SetPropertyHandlers(
+    [](int, const std::string&) -> LuaPtr {
+      return std::make_shared<LuaValue>(LuaValue::nil());
+    },
+    nullptr);
+  rt.StoreHostFunction("__m_f", [](const std::vector<LuaPtr>&) -> LuaPtr {
+    return std::make_shared<LuaValue>(LuaValue::from(true));
+  });
+  rt.SetUserdataMethodTable(9, {{"f", "__m_f"}});
+  rt.CreateProxyUserdataGlobal("obj", 9);
+  ASSERT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(
+    rt.ExecuteScript("obj = nil; collectgarbage(); collectgarbage()")));
+
+  // A block created for ref_id 9 now has no methods left to find.
+  rt.CreateProxyUserdataGlobal("again", 9);
+  const auto res = rt.ExecuteScript("return again.f");
+  ASSERT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(res));
+  EXPECT_TRUE(std::holds_alternative<std::monostate>(
+    std::get<std::vector<LuaPtr>>(res)[0]->value));
+}
+
+// ========== Class Method Table Tests ==========
+
+namespace {
+LuaRuntime::Function ReturnString(const std::string& text) {
+  return [text](const std::vector<LuaPtr>&) -> LuaPtr {
+    return std::make_shared<LuaValue>(LuaValue::from(text));
+  };
+}
+}  // namespace
+
+TEST(LuaRuntimeClassMethods, InheritedMethodsResolveThroughTheFlattenedTable) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  int getter_calls = 0;
+  rt.SetPropertyHandlers(
+    [&](int, const std::string&) -> LuaPtr {
+      ++getter_calls;
+      return std::make_shared<LuaValue>(LuaValue::nil());
+    },
+    nullptr);
+  rt.StoreHostFunction("leaf_new", [&rt](const std::vector<LuaPtr>&) -> LuaPtr {
+    return std::make_shared<LuaValue>(LuaValue::from(
+      LuaUserdataRef(1, rt.RawState(), false, LUA_NOREF, false, "Leaf")));
+  });
+  rt.StoreHostFunction("base_new", ReturnString("unused"));
+  rt.StoreHostFunction("mid_new", ReturnString("unused"));
+  rt.StoreHostFunction("b_greet", ReturnString("base greet"));
+  rt.StoreHostFunction("b_name", ReturnString("base"));
+  rt.StoreHostFunction("m_name", ReturnString("mid"));
+  rt.StoreHostFunction("l_own", ReturnString("leaf"));
+
+  rt.RegisterClass("Base", "base_new", {{"greet", "b_greet"}, {"name", "b_name"}}, {});
+  rt.RegisterClass("Mid", "mid_new", {{"name", "m_name"}}, {}, "Base");
+  rt.RegisterClass("Leaf", "leaf_new", {{"own", "l_own"}}, {}, "Mid");
+
+  const auto res = rt.ExecuteScript(R"(
+    local o = Leaf.new()
+    return o:greet(), o:name(), o:own(), o.greet == o.greet, o.missing
+  )");
+  ASSERT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(res));
+  const auto& vals = std::get<std::vector<LuaPtr>>(res);
+  ASSERT_EQ(vals.size(), 5u);
+  EXPECT_EQ(std::get<std::string>(vals[0]->value), "base greet");
+  EXPECT_EQ(std::get<std::string>(vals[1]->value), "mid");  // nearest override wins
+  EXPECT_EQ(std::get<std::string>(vals[2]->value), "leaf");
+  EXPECT_TRUE(std::get<bool>(vals[3]->value));
+  EXPECT_TRUE(std::holds_alternative<std::monostate>(vals[4]->value));
+  EXPECT_EQ(getter_calls, 1);  // only the miss reached property handling
+}
+
+TEST(LuaRuntimeClassMethods, ReregisteringABaseRebuildsDescendants) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  rt.StoreHostFunction("child_new", [&rt](const std::vector<LuaPtr>&) -> LuaPtr {
+    return std::make_shared<LuaValue>(LuaValue::from(
+      LuaUserdataRef(1, rt.RawState(), false, LUA_NOREF, false, "Child")));
+  });
+  rt.StoreHostFunction("base_new", ReturnString("unused"));
+  rt.StoreHostFunction("v1", ReturnString("v1"));
+  rt.StoreHostFunction("v2", ReturnString("v2"));
+
+  rt.RegisterClass("Base", "base_new", {{"version", "v1"}}, {});
+  rt.RegisterClass("Child", "child_new", {}, {}, "Base");
+  ASSERT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(
+    rt.ExecuteScript("child = Child.new(); first = child:version()")));
+
+  rt.RegisterClass("Base", "base_new", {{"version", "v2"}}, {});
+  const auto res = rt.ExecuteScript("return first, child:version()");
+  ASSERT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(res));
+  const auto& vals = std::get<std::vector<LuaPtr>>(res);
+  ASSERT_EQ(vals.size(), 2u);
+  EXPECT_EQ(std::get<std::string>(vals[0]->value), "v1");
+  EXPECT_EQ(std::get<std::string>(vals[1]->value), "v2");
+}
+
+// ========== Class Field Tests ==========
+
+namespace {
+// Registers "Body" with native fields; Body.new() yields instance `ref_id`.
+void RegisterBodyClass(LuaRuntime& rt, int ref_id) {
+  rt.StoreHostFunction("body_new", [&rt, ref_id](const std::vector<LuaPtr>&) -> LuaPtr {
+    return std::make_shared<LuaValue>(LuaValue::from(
+      LuaUserdataRef(ref_id, rt.RawState(), false, LUA_NOREF, false, "Body")));
+  });
+  rt.RegisterClass("Body", "body_new", {}, {}, "", {
+    {"x", ClassFieldType::Number},
+    {"hits", ClassFieldType::Integer},
+    {"alive", ClassFieldType::Boolean},
+    {"name", ClassFieldType::String},
+  });
+}
+}  // namespace
+
+TEST(LuaRuntimeClassFields, ReadAndWrittenWithoutTheHost) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  int handler_calls = 0;
+  rt.SetPropertyHandlers(
+    [&](int, const std::string&) -> LuaPtr {
+      ++handler_calls;
+      return std::make_shared<LuaValue>(LuaValue::nil());
+    },
+    [&](int, const std::string&, const LuaPtr&) { ++handler_calls; });
+  RegisterBodyClass(rt, 1);
+  rt.SetClassFields(1, "Body", {
+    std::make_shared<LuaValue>(LuaValue::from(1.5)),
+    std::make_shared<LuaValue>(LuaValue::from(int64_t{2})),
+    std::make_shared<LuaValue>(LuaValue::from(true)),
+    std::make_shared<LuaValue>(LuaValue::nil()),
+  });
+
+  const auto res = rt.ExecuteScript(R"(
+    b = Body.new()
+    for i = 1, 10 do b.x = b.x + 1; b.hits = b.hits + 1 end
+    b.name = 'probe'
+    b.hits = 20.0  -- an integral float is accepted
+    return b.x, b.hits, b.alive, b.name, math.type(b.hits)
+  )");
+  ASSERT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(res));
+  const auto& vals = std::get<std::vector<LuaPtr>>(res);
+  ASSERT_EQ(vals.size(), 5u);
+  EXPECT_DOUBLE_EQ(std::get<double>(vals[0]->value), 11.5);
+  EXPECT_EQ(std::get<int64_t>(vals[1]->value), 20);
+  EXPECT_TRUE(std::get<bool>(vals[2]->value));
+  EXPECT_EQ(std::get<std::string>(vals[3]->value), "probe");
+  EXPECT_EQ(std::get<std::string>(vals[4]->value), "integer");
+  EXPECT_EQ(handler_calls, 0);
+
+  EXPECT_TRUE(rt.ClassFieldsDirty(1));
+  EXPECT_EQ(rt.DirtyClassInstances(), std::vector<int>{1});
+  const auto values = rt.ClassFieldValues(1);
+  ASSERT_EQ(values.size(), 4u);
+  EXPECT_EQ(std::get<std::string>(values[3].value), "probe");
+  rt.MarkClassFieldsClean(1);
+  EXPECT_TRUE(rt.DirtyClassInstances().empty());
+}
+
+TEST(LuaRuntimeClassFields, WrongTypesAreRejected) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  RegisterBodyClass(rt, 2);
+  ASSERT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(rt.ExecuteScript("b = Body.new()")));
+
+  for (const char* script : {"b.x = 'fast'", "b.hits = 1.5", "b.alive = 1", "b.name = 7"}) {
+    const auto err = rt.ExecuteScript(script);
+    ASSERT_TRUE(std::holds_alternative<std::string>(err)) << script;
+    EXPECT_NE(std::get<std::string>(err).find("must be"), std::string::npos) << script;
+  }
+  EXPECT_FALSE(rt.ClassFieldsDirty(2));
+
+  EXPECT_THROW(rt.SetClassFields(2, "Body", {
+    std::make_shared<LuaValue>(LuaValue::from(std::string("no")))}), std::runtime_error);
+}
+
+TEST(LuaRuntimeClassFields, SharedByEveryBlockAndReadableInAsyncMode) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  RegisterBodyClass(rt, 3);
+  rt.RegisterFunction("passthrough", [](const std::vector<LuaPtr>& args) -> LuaPtr {
+    return args[0];
+  });
+  ASSERT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(rt.ExecuteScript(R"(
+    b = Body.new()
+    copy = passthrough(b)
+    copy.hits = 5
+  )")));
+
+  rt.SetAsyncMode(true);
+  const auto res = rt.ExecuteScript("b.hits = b.hits + 1; return b.hits");
+  rt.SetAsyncMode(false);
+  ASSERT_TRUE(std::holds_alternative<std::vector<LuaPtr>>(res));
+  EXPECT_EQ(std::get<int64_t>(std::get<std::vector<LuaPtr>>(res)[0]->value), 6);
+}
+
+TEST(LuaRuntimeClassFields, ReleaseDuringAsyncModeKeepsDirtyFieldsForTheDrain) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  RegisterBodyClass(rt, 4);
+  std::vector<double> flushed;
+  rt.SetUserdataGCCallback([&](int ref_id) {
+    if (rt.ClassFieldsDirty(ref_id)) {
+      flushed.push_back(std::get<double>(rt.ClassFieldValues(ref_id)[0].value));
+    }
+  });
+
+  rt.SetAsyncMode(true);
+  (void)rt.ExecuteScript("local b = Body.new() b.x = 9.5 b = nil collectgarbage()");
+  // No callback off-thread, but the written field is not lost either.
+  EXPECT_TRUE(flushed.empty());
+  rt.SetAsyncMode(false);
+
+  rt.DrainAsyncUserdataReleases();
+  EXPECT_EQ(flushed, std::vector<double>{9.5});
+  EXPECT_FALSE(rt.ClassFieldsDirty(4));
+  rt.DrainAsyncUserdataReleases();  // already finished
+  EXPECT_EQ(flushed.size(), 1u);
+}
+
+// ========== Userdata Slab Tests ==========
+
+TEST(UserdataSlab, InsertFindErase) {
+  UserdataSlab<std::string> slab;
+  const int a = slab.Insert("a");
+  const int b = slab.Insert("b");
+  EXPECT_GT(a, 0);
+  EXPECT_GT(b, 0);
+  EXPECT_NE(a, b);
+  ASSERT_NE(slab.Find(a), nullptr);
+  EXPECT_EQ(*slab.Find(a), "a");
+  EXPECT_EQ(*slab.Find(b), "b");
+  EXPECT_EQ(slab.size(), 2u);
+
+  EXPECT_TRUE(slab.Erase(a));
+  EXPECT_FALSE(slab.Erase(a));
+  EXPECT_EQ(slab.Find(a), nullptr);
+  EXPECT_EQ(slab.Find(0), nullptr);
+  EXPECT_EQ(slab.Find(-1), nullptr);
+  EXPECT_EQ(slab.size(), 1u);
+}
+
+TEST(UserdataSlab, ReusedSlotRejectsStaleId) {
+  UserdataSlab<int> slab;
+  const int first = slab.Insert(1);
+  slab.Erase(first);
+  const int second = slab.Insert(2);
+  // Same slot, next generation.
+  EXPECT_EQ(UserdataSlotOf(first), UserdataSlotOf(second));
+  EXPECT_NE(first, second);
+  EXPECT_EQ(slab.Find(first), nullptr);
+  ASSERT_NE(slab.Find(second), nullptr);
+  EXPECT_EQ(*slab.Find(second), 2);
+}
+
+TEST(UserdataSlab, ClearInvalidatesEveryId) {
+  UserdataSlab<int> slab;
+  std::vector<int> ids;
+  for (int i = 0; i < 8; ++i) ids.push_back(slab.Insert(i));
+  slab.Clear();
+  EXPECT_EQ(slab.size(), 0u);
+  for (int i = 0; i < 8; ++i) {
+    const int fresh = slab.Insert(i);
+    EXPECT_EQ(slab.Find(ids[i]), nullptr);
+    EXPECT_EQ(std::count(ids.begin(), ids.end(), fresh), 0);
+  }
+}
+
+TEST(UserdataSlab, RuntimeIgnoresStaleIdInReusedSlot) {
+  LuaRuntime rt(LuaRuntime::AllLibraries());
+  std::vector<int> collected;
+  rt.SetUserdataGCCallback([&](int ref_id) { collected.push_back(ref_id); });
+
+  UserdataSlab<int> slab;
+  const int first = slab.Insert(1);
+  rt.IncrementUserdataRefCount(first);
+  rt.DecrementUserdataRefCount(first);
+  slab.Erase(first);
+  const int second = slab.Insert(2);
+  rt.IncrementUserdataRefCount(second);
+
+  // The old id no longer owns the slot's record.
+  rt.DecrementUserdataRefCount(first);
+  EXPECT_EQ(collected, std::vector<int>{first});
+  rt.DecrementUserdataRefCount(second);
+  EXPECT_EQ(collected, (std::vector<int>{first, second}));
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -4170,6 +4170,183 @@ describe('lua-native Node adapter', () => {
         expect(typeof lua.get_global('print')).toBe('function');
       });
     });
+
+    describe('create_environment_template()', () => {
+      it('reads whitelisted globals through the template', () => {
+        const lua = new lua_native.init({}, ALL_LIBS);
+        const tpl = lua.create_environment_template({ whitelist: ['math'] });
+        const env = tpl.acquire();
+        expect(lua.execute_script_in(env, 'return math.sqrt(16)')).toBe(4);
+        expect(lua.execute_script_in(env, 'return string == nil')).toBe(true);
+        // The shared base is out of the script's reach.
+        expect(lua.execute_script_in(env, 'x = 1; return x')).toBe(1);
+        expect(() => lua.execute_script_in(env, 'setmetatable(_ENV, nil)')).toThrow();
+      });
+
+      it('keeps writes in the environment, not the template', () => {
+        const lua = new lua_native.init({}, ALL_LIBS);
+        const tpl = lua.create_environment_template({ whitelist: ['math'] });
+        const a = tpl.acquire();
+        const b = tpl.acquire();
+        lua.execute_script_in(a, 'math = nil; mine = 1');
+        expect(lua.execute_script_in(b, 'return math ~= nil')).toBe(true);
+        expect(lua.execute_script_in(b, 'return mine == nil')).toBe(true);
+        expect(lua.execute_script_in(a, 'return math ~= nil')).toBe(true);
+      });
+
+      it('inherits _G when asked', () => {
+        const lua = new lua_native.init({}, ALL_LIBS);
+        const tpl = lua.create_environment_template({ inherit: true });
+        const env = tpl.acquire();
+        expect(lua.execute_script_in(env, 'return type(print)')).toBe('function');
+        lua.execute_script_in(env, 'leaked = true');
+        expect(lua.execute_script('return leaked')).toBeNull();
+      });
+
+      it('recycles a cleared environment and releases its handle', () => {
+        const lua = new lua_native.init({}, ALL_LIBS);
+        const tpl = lua.create_environment_template({ whitelist: ['math'] });
+        const first = tpl.acquire();
+        lua.execute_script_in(first, 'tenant = "a"; t = { 1, 2, 3 }');
+        tpl.recycle(first);
+        expect(() => first.get('tenant')).toThrow('released');
+
+        const second = tpl.acquire();
+        expect(lua.execute_script_in(second, 'return tenant == nil and t == nil')).toBe(true);
+        expect(lua.execute_script_in(second, 'return math.abs(-2)')).toBe(2);
+      });
+
+      it('rejects environments from elsewhere', () => {
+        const lua = new lua_native.init({}, ALL_LIBS);
+        const tpl = lua.create_environment_template();
+        const other = lua.create_environment_template();
+        expect(() => tpl.recycle(lua.create_environment())).toThrow('acquired from this template');
+        expect(() => tpl.recycle(other.acquire())).toThrow('acquired from this template');
+        expect(() => tpl.recycle({} as any)).toThrow('acquired from this template');
+      });
+
+      it('validates its options', () => {
+        const lua = new lua_native.init({}, ALL_LIBS);
+        expect(() => lua.create_environment_template('math' as any)).toThrow('must be an object');
+        expect(() => lua.create_environment_template({ whitelist: [1] as any }))
+          .toThrow('whitelist entries must be strings');
+        expect(() => lua.create_environment_template({ maxPooled: -1 }))
+          .toThrow('maxPooled must be a non-negative integer');
+      });
+
+      it('stops working once released', () => {
+        const lua = new lua_native.init({}, ALL_LIBS);
+        const tpl = lua.create_environment_template({ maxPooled: 0 });
+        tpl.recycle(tpl.acquire());
+        tpl.release();
+        expect(() => tpl.acquire()).toThrow('environment template has been released');
+      });
+    });
+
+    describe('prepare() / env.run()', () => {
+      it('runs one compiled chunk against many environments', () => {
+        const lua = new lua_native.init({}, ALL_LIBS);
+        const rule = lua.prepare('local input = ... return input * factor');
+        const envs = [2, 3, 4].map((factor) => {
+          const env = lua.create_environment();
+          env.set('factor', factor);
+          return env;
+        });
+        expect(envs.map((env) => env.run(rule, 10))).toEqual([20, 30, 40]);
+      });
+
+      it('works with template environments and keeps writes per environment', () => {
+        const lua = new lua_native.init({}, ALL_LIBS);
+        const tpl = lua.create_environment_template({ whitelist: ['math'] });
+        const rule = lua.prepare('hits = (hits or 0) + 1 return math.max(hits, ...)');
+        const a = tpl.acquire();
+        const b = tpl.acquire();
+        expect(a.run(rule, 0)).toBe(1);
+        expect(a.run(rule, 0)).toBe(2);
+        expect(b.run(rule, 5)).toBe(5);
+        expect(b.get('hits')).toBe(1);
+      });
+
+      it('keeps each run\'s environment for the closures it creates', () => {
+        const lua = new lua_native.init({}, ALL_LIBS);
+        const chunk = lua.prepare('tag = ... return function() return tag end');
+        const a = lua.create_environment();
+        const b = lua.create_environment();
+        const getA = a.run(chunk, 'a');
+        b.run(chunk, 'b');
+        expect(getA()).toBe('a');
+      });
+
+      it('reports compile and runtime errors', () => {
+        const lua = new lua_native.init({}, ALL_LIBS);
+        expect(() => lua.prepare('x = = 1')).toThrow();
+        const chunk = lua.prepare('error("boom")');
+        expect(() => lua.create_environment({ whitelist: ['error'] }).run(chunk)).toThrow('boom');
+      });
+
+      it('rejects a non-chunk, a released chunk, and a foreign chunk', () => {
+        const lua = new lua_native.init({}, ALL_LIBS);
+        const other = new lua_native.init({}, ALL_LIBS);
+        const env = lua.create_environment();
+        expect(() => env.run({} as any)).toThrow('requires a chunk from prepare()');
+        expect(() => env.run(other.prepare('return 1'))).toThrow('different Lua context');
+        const chunk = lua.prepare('return 1');
+        expect(env.run(chunk)).toBe(1);
+        chunk.release();
+        expect(() => env.run(chunk)).toThrow('prepared chunk has been released');
+      });
+    });
+
+    describe('set_environment_limits() / get_environment_usage()', () => {
+      it('stops only the environment over its instruction budget', () => {
+        const lua = new lua_native.init({}, ALL_LIBS);
+        const greedy = lua.create_environment();
+        const other = lua.create_environment();
+        lua.set_environment_limits(greedy, { maxInstructions: 50000 });
+        expect(() => lua.execute_script_in(greedy, 'while true do end'))
+          .toThrow('environment instruction limit exceeded');
+        expect(() => lua.execute_script_in(other, 'for i = 1, 200000 do end')).not.toThrow();
+
+        const usage = lua.get_environment_usage(greedy)!;
+        expect(usage.runs).toBe(1);
+        expect(usage.instructions).toBeGreaterThanOrEqual(50000);
+        expect(usage.maxInstructions).toBe(50000);
+        expect(lua.get_environment_usage(other)).toBeNull();
+      });
+
+      it('charges memory to the environment that allocated it', () => {
+        const lua = new lua_native.init({}, { ...ALL_LIBS, environmentAccounting: true });
+        const a = lua.create_environment({ whitelist: ['string'] });
+        const b = lua.create_environment({ whitelist: ['string'] });
+        lua.set_environment_limits(a, {});
+        lua.set_environment_limits(b, { maxMemory: 256 * 1024 });
+
+        lua.execute_script_in(a, 'big = string.rep("x", 1024 * 1024)');
+        expect(lua.get_environment_usage(a)!.memoryBytes).toBeGreaterThanOrEqual(1024 * 1024);
+        expect(() => lua.execute_script_in(b, 'big = string.rep("x", 1024 * 1024)'))
+          .toThrow('not enough memory');
+        expect(lua.execute_script_in(b, 'return #string.rep("x", 1024)')).toBe(1024);
+      });
+
+      it('requires environmentAccounting for maxMemory', () => {
+        const lua = new lua_native.init({}, ALL_LIBS);
+        const env = lua.create_environment();
+        expect(() => lua.set_environment_limits(env, { maxMemory: 1 << 20 }))
+          .toThrow('requires the environmentAccounting option');
+        expect(() => lua.set_environment_limits(env, { maxInstructions: -1 }))
+          .toThrow('must be a non-negative number');
+      });
+
+      it('gives a recycled template environment a fresh account', () => {
+        const lua = new lua_native.init({}, { ...ALL_LIBS, environmentAccounting: true });
+        const tpl = lua.create_environment_template();
+        const env = tpl.acquire();
+        lua.set_environment_limits(env, { maxMemory: 1 << 20 });
+        lua.execute_script_in(env, 't = {}');
+        tpl.recycle(env);
+        expect(lua.get_environment_usage(tpl.acquire())).toBeNull();
+      });
+    });
   });
 
   // ============================================
@@ -6344,14 +6521,15 @@ describe('lua-native Node adapter', () => {
         expect(() => lua.execute_script('return released_fn()')).toThrow(/released/);
       });
 
-      it('other references to the same Lua function are unaffected', () => {
+      it('the next crossing after a release mints a fresh wrapper', () => {
         const lua = new lua_native.init({}, ALL_LIBS);
         lua.execute_script('shared = function() return 7 end');
         const a: any = lua.execute_script('return shared');
-        const b: any = lua.execute_script('return shared');
         lua.release(a);
         expect(() => a()).toThrow('released');
-        expect(b()).toBe(7); // independent registry slot
+        const b: any = lua.execute_script('return shared');
+        expect(b).not.toBe(a); // the released wrapper is not handed out again
+        expect(b()).toBe(7);
       });
 
       it('releasing a plain JS function throws a TypeError', () => {
@@ -7211,6 +7389,62 @@ describe('lua-native Node adapter', () => {
         const shared = lua_native.createSharedTable({ n: 1 });
         expect(() => shared.sync()).not.toThrow();
       });
+
+      it('sends only the keys that changed', () => {
+        const state = { a: 1, b: { deep: [1, 2] }, c: 'x' };
+        const shared = lua_native.createSharedTable(state);
+        const lua = new lua_native.init({}, { ...ALL_LIBS, shared: { s: shared } });
+
+        // Lua-side marks on untouched keys survive a delta sync; a full push
+        // would replace the table and lose them.
+        lua.execute_script('s.local_mark = true; s.c = "lua-edit"');
+        state.a = 2;
+        state.b.deep.push(3);
+        shared.sync();
+
+        expect(lua.execute_script('return s.a')).toBe(2);
+        expect(lua.execute_script('return #s.b.deep')).toBe(3);
+        expect(lua.execute_script('return s.c')).toBe('lua-edit');
+        expect(lua.execute_script('return s.local_mark')).toBe(true);
+      });
+
+      it('assigns nil for a removed key', () => {
+        const state: Record<string, unknown> = { keep: 1, drop: 2 };
+        const shared = lua_native.createSharedTable(state);
+        const lua = new lua_native.init({}, { ...ALL_LIBS, shared: { s: shared } });
+
+        delete state.drop;
+        shared.sync();
+        expect(lua.execute_script('return s.drop')).toBeNull();
+        expect(lua.execute_script('return s.keep')).toBe(1);
+      });
+
+      it('does not re-send an unchanged NaN', () => {
+        const shared = lua_native.createSharedTable({ v: NaN });
+        const lua = new lua_native.init({}, { ...ALL_LIBS, shared: { s: shared } });
+
+        lua.execute_script('s.v = 0');
+        shared.sync();
+        expect(lua.execute_script('return s.v')).toBe(0);
+      });
+
+      it('re-pushes the whole value with { full: true }', () => {
+        const shared = lua_native.createSharedTable({ n: 1 });
+        const lua = new lua_native.init({}, { ...ALL_LIBS, shared: { s: shared } });
+
+        lua.execute_script('s = { replaced = true }');
+        shared.sync();  // nothing changed on the JS side
+        expect(lua.execute_script('return s.n')).toBeNull();
+
+        shared.sync({ full: true });
+        expect(lua.execute_script('return s.n')).toBe(1);
+        expect(lua.execute_script('return s.replaced')).toBeNull();
+      });
+
+      it('rejects a non-object options argument', () => {
+        const shared = lua_native.createSharedTable({ n: 1 });
+        expect(() => shared.sync(5 as any)).toThrow('sync(options) requires an options object');
+      });
     });
 
     describe('isolation', () => {
@@ -7326,7 +7560,8 @@ describe('lua-native Node adapter', () => {
 
         await pending;
 
-        // sync() brings the straggler back in line.
+        // sync() brings the straggler back in line — with the whole value, since
+        // it missed a delta the snapshot already records as published.
         shared.sync();
         expect(busy.execute_script('return settings.n')).toBe(7);
       });
@@ -7338,10 +7573,10 @@ describe('lua-native Node adapter', () => {
         const ref = lua.get_global_ref('settings');
         expect(ref.get('n')).toBe(1);
 
-        // Each publish replaces the global with a fresh table, so a handle taken
-        // beforehand keeps pointing at the previous one.
+        // set() assigns the one field of the existing table, so a handle taken
+        // beforehand sees the update.
         shared.set('n', 2);
-        expect(ref.get('n')).toBe(1);
+        expect(ref.get('n')).toBe(2);
         expect(lua.execute_script('return settings.n')).toBe(2);
         ref.release();
       });
@@ -8090,4 +8325,952 @@ describe('lua-native Node adapter', () => {
       expect(lua.execute_script(`return Dog.new('rex'):name_of()`)).toBe('re:rex');
     });
   });
+
+  describe('register_class() native fields', () => {
+    const bodies = () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      const made: any[] = [];
+      lua.register_class('Body', {
+        construct: (x: any) => {
+          const body = { x, hits: 0, alive: true, label: 'b' };
+          made.push(body);
+          return body;
+        },
+        fields: { x: 'number', hits: 'integer', alive: 'boolean', label: 'string' },
+        methods: {
+          bump: (self: any) => { self.hits += 100; },
+          peek: (self: any) => self.x,
+        },
+      });
+      return { lua, made };
+    };
+
+    it('reads and writes declared fields from Lua', () => {
+      const { lua } = bodies();
+      expect(lua.execute_script(`
+        local b = Body.new(1.5)
+        for i = 1, 1000 do b.x = b.x + 1; b.hits = b.hits + 1 end
+        b.label = 'probe'
+        return b.x, b.hits, b.alive, b.label
+      `)).toEqual([1001.5, 1000, true, 'probe']);
+    });
+
+    it('writes back lazily when the object crosses to JS, or on flush_fields()', () => {
+      const { lua, made } = bodies();
+      lua.execute_script('b = Body.new(0); b.x = 42');
+      expect(made[0].x).toBe(0);  // not yet written back
+      lua.flush_fields();
+      expect(made[0].x).toBe(42);
+
+      lua.execute_script('b.x = 7');
+      expect(lua.execute_script('return b:peek()')).toBe(7);  // flushed for the method
+      expect(made[0].x).toBe(7);
+    });
+
+    it('sees a method\'s writes to self', () => {
+      const { lua } = bodies();
+      expect(lua.execute_script('local b = Body.new(0); b:bump(); return b.hits')).toBe(100);
+    });
+
+    it('picks up JS writes made since the last reload, and only those', () => {
+      const { lua, made } = bodies();
+      lua.execute_script('b = Body.new(0)');
+      made[0].x = 9;
+      expect(Object.keys(made[0])).toEqual(['x', 'hits', 'alive', 'label']);
+      expect(lua.execute_script('b.hits = 5; b:peek(); return b.x, b.hits')).toEqual([9, 5]);
+      expect(lua.execute_script('b.x = 3; b:peek(); return b.x')).toBe(3);
+    });
+
+    it('rejects a value of the wrong type', () => {
+      const { lua } = bodies();
+      expect(() => lua.execute_script("Body.new(0).hits = 'many'"))
+        .toThrow("field 'hits' must be an integer, got string");
+      expect(() => lua.execute_script("Body.new('far')"))
+        .toThrow("field 'x' must be a number");
+    });
+
+    it('validates the definition', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      expect(() => lua.register_class('A', { construct: () => ({}), fields: { x: 'float' as any } }))
+        .toThrow("field 'x' must be 'number', 'integer', 'boolean' or 'string'");
+      expect(() => lua.register_class('B', {
+        construct: () => ({}),
+        fields: { x: 'number' },
+        methods: { x: () => 0 },
+      })).toThrow("'x' is declared as both a field and a method");
+    });
+  });
+
+  // ============================================
+  // COROUTINE THREAD POOL
+  // ============================================
+  describe('coroutine thread pool', () => {
+    const pooled = (size = 8) =>
+      new lua_native.init({}, { ...ALL_LIBS, coroutinePoolSize: size });
+
+    it('is off by default', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      const fn = lua.execute_script('return function() end') as any;
+      const co = lua.create_coroutine(fn);
+      lua.resume(co);
+      lua.release(co);
+      expect(lua.info().coroutinePool).toEqual({ capacity: 0, idle: 0, created: 1, reused: 0 });
+    });
+
+    it('reuses the thread of a finished, released coroutine', () => {
+      const lua = pooled();
+      const fn = lua.execute_script(
+        'return function(n) coroutine.yield(n) return n * 2 end') as any;
+      for (let i = 1; i <= 5; i++) {
+        const co = lua.create_coroutine(fn);
+        expect(lua.resume(co, i).values).toEqual([i]);
+        expect(lua.resume(co).values).toEqual([i * 2]);
+        lua.release(co);
+      }
+      expect(lua.info().coroutinePool).toEqual({ capacity: 8, idle: 1, created: 1, reused: 4 });
+    });
+
+    it('never recycles a suspended coroutine', () => {
+      const lua = pooled();
+      const fn = lua.execute_script('return function() coroutine.yield(1) end') as any;
+      const co = lua.create_coroutine(fn);
+      lua.resume(co);
+      lua.release(co);
+      expect(lua.info().coroutinePool.idle).toBe(0);
+    });
+
+    it('never recycles a coroutine whose thread Lua handed out', () => {
+      const lua = pooled();
+      const fn = lua.execute_script('return function() return coroutine.running() end') as any;
+      const co = lua.create_coroutine(fn);
+      const [self] = lua.resume(co).values as any[];
+      lua.release(co);
+      // `self` still refers to the finished thread, so it must not be reused.
+      expect(lua.info().coroutinePool.idle).toBe(0);
+      expect(lua.resume(self).status).toBe('dead');
+    });
+
+    it('recycles the execute_async driver thread', async () => {
+      const lua = pooled(2);
+      expect(await lua.execute_async('return 1')).toBe(1);
+      expect(await lua.execute_async('return 2')).toBe(2);
+      const { created, reused } = lua.info().coroutinePool;
+      expect(created + reused).toBe(2);
+      expect(reused).toBe(1);
+    });
+
+    it('survives reset() with the same capacity', () => {
+      const lua = pooled(3);
+      lua.reset();
+      expect(lua.info().coroutinePool).toEqual({ capacity: 3, idle: 0, created: 0, reused: 0 });
+    });
+
+    it('validates the option', () => {
+      expect(() => new lua_native.init({}, { coroutinePoolSize: -1 }))
+        .toThrow(RangeError);
+      expect(() => new lua_native.init({}, { coroutinePoolSize: 'x' as any }))
+        .toThrow(/coroutinePoolSize must be a number/);
+    });
+  });
+
+  // ============================================
+  // BATCHED COROUTINE RESUME - take(n)
+  // ============================================
+  describe('coroutine take(n)', () => {
+    const counter = (lua: any) => lua.create_coroutine(`
+      return function(n)
+        for i = 1, n do coroutine.yield(i) end
+        return 'done'
+      end
+    `);
+
+    it('returns up to n yields per call and passes args to the first resume', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      const co = counter(lua);
+      expect(co.take(3, 7)).toEqual([1, 2, 3]);
+      expect(co.status).toBe('suspended');
+      expect(co.take(3)).toEqual([4, 5, 6]);
+      // The last batch is short and the return value is discarded.
+      expect(co.take(3)).toEqual([7]);
+      expect(co.status).toBe('dead');
+      expect(co.take(3)).toEqual([]);
+    });
+
+    it('drains with Infinity and shapes multi-value yields like iteration', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      const co = lua.create_coroutine(`
+        return function()
+          coroutine.yield()
+          coroutine.yield('a')
+          coroutine.yield('b', 'c')
+        end
+      `);
+      expect(co.take(Infinity)).toEqual([undefined, 'a', ['b', 'c']]);
+    });
+
+    it('interleaves with resume() and iteration on the same thread', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      const co = counter(lua);
+      expect(lua.resume(co, 6).values).toEqual([1]);
+      expect(co.take(2)).toEqual([2, 3]);
+      expect([...co]).toEqual([4, 5, 6]);
+    });
+
+    it('throws a Lua error raised mid-batch, carrying the earlier yields', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      const co = lua.create_coroutine(
+        'return function() coroutine.yield(1) coroutine.yield(2) error("bad row") end');
+      let caught: any;
+      try { co.take(10); } catch (e) { caught = e; }
+      expect(caught?.message).toMatch(/bad row/);
+      expect(caught.values).toEqual([1, 2]);
+      expect(co.status).toBe('dead');
+      expect(co.take(10)).toEqual([]);
+    });
+
+    it('leaves a thrown JS error untouched and wraps it as the cause', () => {
+      const original = Object.freeze(new TypeError('frozen'));
+      const lua = new lua_native.init({ fail: () => { throw original; } }, ALL_LIBS);
+      const co = lua.create_coroutine('return function() coroutine.yield(1) fail() end');
+      let caught: any;
+      try { co.take(10); } catch (e) { caught = e; }
+      expect(caught).toBeInstanceOf(Error);
+      expect(caught.values).toEqual([1]);
+      expect(caught.cause).toBe(original);
+      expect('values' in original).toBe(false);
+    });
+
+    it('validates the count', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      const co = counter(lua);
+      expect(() => co.take('2' as any)).toThrow(TypeError);
+      expect(() => co.take(0)).toThrow(RangeError);
+      expect(() => co.take(NaN)).toThrow(RangeError);
+    });
+
+    it('rejects a released coroutine', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      const co = counter(lua);
+      lua.release(co);
+      expect(() => co.take(1)).toThrow(/coroutine has been released/);
+    });
+  });
+
+  // ============================================
+  // ASYNC ITERATION FROM A WORKER - iterate_async()
+  // ============================================
+  describe('iterate_async()', () => {
+    const rows = (lua: any, n: number) => lua.create_coroutine(`
+      return function()
+        for i = 1, ${n} do coroutine.yield(i) end
+        return 'ignored'
+      end
+    `);
+
+    it('streams every yield through for await, across batches', async () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      const seen: unknown[] = [];
+      for await (const v of lua.iterate_async(rows(lua, 10), { batchSize: 3 })) {
+        seen.push(v);
+      }
+      expect(seen).toEqual([1, 2, 3, 4, 5, 6, 7, 8, 9, 10]);
+      expect(lua.is_busy()).toBe(false);
+    });
+
+    it('produces on demand and leaves the context free between batches', async () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      lua.execute_script('produced = 0');
+      const co = lua.create_coroutine(`
+        return function()
+          while true do produced = produced + 1 coroutine.yield(produced) end
+        end
+      `);
+      const it = lua.iterate_async(co, { batchSize: 4 });
+      expect(lua.get_global('produced')).toBe(0);
+
+      expect(lua.is_busy()).toBe(false);
+      const first = it.next();
+      expect(lua.is_busy()).toBe(true);  // the first batch is on the worker
+      expect(await first).toEqual({ value: 1, done: false });
+      // Three values are buffered; nothing more is produced until they drain.
+      expect(lua.is_busy()).toBe(false);
+      expect(lua.get_global('produced')).toBe(4);
+
+      await it.next(); await it.next(); await it.next();
+      // The buffer just ran dry, but nothing is waiting: no batch is started,
+      // so the consumer can still use the context synchronously.
+      expect(lua.is_busy()).toBe(false);
+      expect(lua.execute_script('return produced')).toBe(4);
+      const fifth = it.next();
+      expect(lua.is_busy()).toBe(true);
+      expect(await fifth).toEqual({ value: 5, done: false });
+      await it.return!();
+    });
+
+    it('delivers values before a Lua error, then rejects', async () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      const co = lua.create_coroutine(`
+        return function() coroutine.yield('a') coroutine.yield('b') error('bad row') end
+      `);
+      const seen: unknown[] = [];
+      await expect((async () => {
+        for await (const v of lua.iterate_async(co)) seen.push(v);
+      })()).rejects.toThrow(/bad row/);
+      expect(seen).toEqual(['a', 'b']);
+      expect(co.status).toBe('dead');
+    });
+
+    it('rejects with the error a sync iteration throws', async () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      const body = 'return function() coroutine.yield(1) error("bad row") end';
+      let thrown: any;
+      try {
+        for (const _ of lua.create_coroutine(body)) { /* drain */ }
+      } catch (e) { thrown = e; }
+      let rejected: any;
+      try {
+        for await (const _ of lua.iterate_async(lua.create_coroutine(body))) { /* drain */ }
+      } catch (e) { rejected = e; }
+      expect(rejected).toBeInstanceOf(Error);
+      expect(rejected.constructor).toBe(thrown.constructor);
+      expect(rejected.message).toBe(thrown.message);
+    });
+
+    it('rejects a coroutine body that calls a JS callback', async () => {
+      const lua = new lua_native.init({ cb: () => 1 }, ALL_LIBS);
+      const co = lua.create_coroutine('return function() coroutine.yield(cb()) end');
+      await expect(lua.iterate_async(co).next()).rejects.toThrow(/async mode/);
+    });
+
+    it('ends early on return() and leaves the coroutine suspended', async () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      const co = rows(lua, 100);
+      for await (const v of lua.iterate_async(co, { batchSize: 5 })) {
+        if (v === 2) break;
+      }
+      expect(co.status).toBe('suspended');
+      // The dropped remainder of the batch is gone; the coroutine continues after it.
+      expect(lua.resume(co).values).toEqual([6]);
+    });
+
+    it('is finished immediately for a dead coroutine', async () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      const co = rows(lua, 1);
+      lua.resume(co); lua.resume(co);
+      expect(await lua.iterate_async(co).next()).toEqual({ value: undefined, done: true });
+    });
+
+    it('validates its arguments', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      const co = rows(lua, 1);
+      expect(() => lua.iterate_async({} as any)).toThrow(/Invalid coroutine object/);
+      expect(() => lua.iterate_async(co, { batchSize: 0 })).toThrow(RangeError);
+      expect(() => lua.iterate_async(co, { batchSize: 'x' as any })).toThrow(TypeError);
+    });
+  });
+
+  // ============================================
+  // REGISTER_FAST_FUNCTION
+  // ============================================
+  describe('register_fast_function()', () => {
+    it('calls a typed scalar function in a hot loop', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      lua.register_fast_function('lerp', (a: any, b: any, t: any) => a + (b - a) * t, {
+        args: ['number', 'number', 'number'],
+        returns: 'number',
+      });
+      lua.register_fast_function('odd', (n: any) => n % 2 === 1, {
+        args: ['integer'],
+        returns: 'boolean',
+      });
+      const result = lua.execute_script(`
+        local s, c = 0, 0
+        for i = 1, 1000 do
+          s = s + lerp(0, 2, 0.5)
+          if odd(i) then c = c + 1 end
+        end
+        return s, c
+      `);
+      expect(result).toEqual([1000, 500]);
+    });
+
+    it('rejects mismatched arguments from Lua', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      lua.register_fast_function('sq', (n: any) => n * n, { args: ['integer'], returns: 'integer' });
+      expect(lua.execute_script('return sq(12)')).toBe(144);
+      expect(() => lua.execute_script("return sq('3')")).toThrow(/integer expected/);
+      expect(() => lua.execute_script('return sq(1.5)')).toThrow(/no integer representation/);
+      expect(() => lua.execute_script('return sq(1, 2)')).toThrow(/expects 1 argument/);
+    });
+
+    it('checks the result type and preserves thrown JS errors', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      lua.register_fast_function('bad', () => 'nope' as any, { returns: 'number' });
+      expect(() => lua.execute_script('return bad()')).toThrow(/must return a number/);
+
+      const boom = new Error('boom');
+      lua.register_fast_function('boom', () => { throw boom; }, {});
+      try {
+        lua.execute_script('boom()');
+        throw new Error('should have thrown');
+      } catch (e) {
+        expect(e).toBe(boom);
+      }
+    });
+
+    it('validates the signature', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      const fn = () => 0;
+      expect(() => lua.register_fast_function('f', fn, { args: ['string' as any] })).toThrow(TypeError);
+      expect(() => lua.register_fast_function('f', fn, { returns: 'table' as any })).toThrow(TypeError);
+      expect(() => lua.register_fast_function('f', fn, { args: Array(9).fill('number') }))
+        .toThrow(RangeError);
+    });
+  });
+
+  // ============================================
+  // WRAPPER IDENTITY
+  // ============================================
+  describe('wrapper identity', () => {
+    it('returns the same wrapper for a Lua function crossing repeatedly', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      lua.execute_script('function handler() return 1 end');
+      const a = lua.get_global('handler');
+      const b = lua.execute_script('return handler');
+      expect(a).toBe(b);
+      const [c, d] = lua.execute_script<any[]>('return handler, handler');
+      expect(c).toBe(a);
+      expect(d).toBe(a);
+      expect(lua.execute_script('return function() end'))
+        .not.toBe(lua.execute_script('return function() end'));
+    });
+
+    it('returns the same Proxy for a metatabled table', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      lua.execute_script('obj = setmetatable({ n = 1 }, {})');
+      const a: any = lua.get_global('obj');
+      const b: any = lua.get_global('obj');
+      expect(a).toBe(b);
+      lua.execute_script('obj.n = 2');
+      expect(b.n).toBe(2);
+      // Memoizing on a returned handle now works.
+      const seen = new Map([[a, 'first']]);
+      expect(seen.get(lua.get_global('obj'))).toBe('first');
+    });
+
+    it('is per context and does not survive reset()', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      lua.execute_script('function f() return 1 end');
+      const before = lua.get_global('f');
+      lua.reset();
+      lua.execute_script('function f() return 2 end');
+      const after: any = lua.get_global('f');
+      expect(after).not.toBe(before);
+      expect(after()).toBe(2);
+    });
+  });
+
+  // ============================================
+  // JS CALLBACK DEDUPE
+  // ============================================
+  describe('JS callback dedupe', () => {
+    it('maps the same function to one Lua closure while it is alive', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      const fn = (n: number) => n + 1;
+      lua.set_global('a', { f: fn });
+      lua.set_global('b', { f: fn, g: fn });
+      expect(lua.execute_script('return a.f == b.f, b.f == b.g, b.g(1)')).toEqual([true, true, 2]);
+      lua.set_global('c', { f: (n: number) => n + 1 });
+      expect(lua.execute_script('return a.f == c.f')).toBe(false);
+    });
+
+    it('registers afresh once the earlier closure is collected', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      const fn = () => 'ok';
+      lua.set_global('a', { f: fn });
+      lua.execute_script('a = nil; collectgarbage(); collectgarbage()');
+      lua.set_global('b', { f: fn });
+      expect(lua.execute_script('return b.f()')).toBe('ok');
+    });
+  });
+
+  // ============================================
+  // SHARED TABLE PROXY HANDLER
+  // ============================================
+  describe('shared table Proxy handler', () => {
+    it('routes each Proxy to its own table, across contexts', () => {
+      const a = new lua_native.init({}, ALL_LIBS);
+      const b = new lua_native.init({}, ALL_LIBS);
+      const make = 'local out = {} for i = 1, 200 do out[i] = setmetatable({ n = i }, {}) end return out';
+      const pa: any[] = a.execute_script(make);
+      const pb: any[] = b.execute_script(make);
+      pa.forEach((p, i) => {
+        expect(p.n).toBe(i + 1);
+        p.n = -p.n;
+      });
+      expect(pa[199].n).toBe(-200);
+      expect(pb[199].n).toBe(200);
+      expect(Object.keys(pb[0])).toEqual(['n']);
+      expect('n' in pa[3]).toBe(true);
+    });
+
+    it('treats a Proxy whose marker was deleted as released', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      const p: any = lua.execute_script('return setmetatable({ x = 1 }, {})');
+      expect(p.x).toBe(1);
+      delete p._tableRef;
+      global.gc?.();
+      expect(() => p.x).toThrow('table handle has been released');
+      expect(() => lua.set_global('again', p)).toThrow('table handle has been released');
+    });
+  });
+
+  // ============================================
+  // BULK TABLE HANDLE ACCESS
+  // ============================================
+  describe('table handle get_many / pick / set_many', () => {
+    it('reads many keys in order, honoring key types and __index', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      lua.execute_script(`
+        cfg = setmetatable({ host = 'localhost', port = 5432, [1] = 'first', ['1'] = 'str' },
+          { __index = function(_, k) return 'default:' .. k end })
+      `);
+      const cfg = lua.get_global_ref('cfg');
+      expect(cfg.get_many(['host', 'port', 1, '1', 'user']))
+        .toEqual(['localhost', 5432, 'first', 'str', 'default:user']);
+      expect(cfg.get_many([])).toEqual([]);
+      expect(cfg.pick('host', 'port')).toEqual({ host: 'localhost', port: 5432 });
+      cfg.release();
+    });
+
+    it('writes every property in one call, through __newindex', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      lua.execute_script(`
+        log = {}
+        t = setmetatable({}, { __newindex = function(t, k, v) log[#log + 1] = k; rawset(t, k, v) end })
+      `);
+      const t = lua.get_global_ref('t');
+      t.set_many({ a: 1, b: 'two', c: { nested: true }, f: (n: number) => n * 2 });
+      expect(lua.execute_script('return t.a, t.b, t.c.nested, t.f(21), #log')).toEqual([1, 'two', true, 42, 4]);
+      t.release();
+    });
+
+    it('rejects bad arguments and released handles', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      const t = lua.create_table();
+      expect(() => t.get_many('a' as any)).toThrow(TypeError);
+      expect(() => t.get_many([{} as any])).toThrow('get_many() keys must be strings or numbers');
+      expect(() => t.pick(true as any)).toThrow(TypeError);
+      expect(() => t.set_many([1, 2] as any)).toThrow(TypeError);
+      t.release();
+      expect(() => t.get_many(['a'])).toThrow('table handle has been released');
+      expect(() => t.set_many({ a: 1 })).toThrow('table handle has been released');
+    });
+  });
+
+  // ============================================
+  // STREAMING TABLE ITERATION
+  // ============================================
+  describe('table handle entries()', () => {
+    it('walks every pair in batches', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      lua.execute_script("index = {} for i = 1, 5000 do index['k' .. i] = i end index[1] = 'one'");
+      const index = lua.get_global_ref('index');
+      let sum = 0;
+      let count = 0;
+      for (const [key, value] of index.entries({ batchSize: 100 })) {
+        if (key === 1) {
+          expect(value).toBe('one');
+        } else {
+          sum += value as number;
+        }
+        count++;
+      }
+      expect(count).toBe(5001);
+      expect(sum).toBe((5000 * 5001) / 2);
+      expect(new Map(index.entries())).toEqual(new Map(index.pairs()));
+      index.release();
+    });
+
+    it('outlives the handle and stops cleanly on break', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      const t = lua.create_table({ a: 1, b: 2, c: 3 });
+      const it = t.entries({ batchSize: 1 });
+      t.release();
+      const first = it.next();
+      expect(first.done).toBe(false);
+      for (const _ of it) break;
+      expect(it.next().done).toBe(true);
+    });
+
+    it('reports a table rebuilt mid-walk', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      lua.execute_script("t = {} for i = 1, 8 do t['k' .. i] = i end");
+      const it = lua.get_global_ref('t').entries({ batchSize: 2 });
+      it.next();
+      lua.execute_script("for k in pairs(t) do t[k] = nil end for i = 1, 1000 do t['n' .. i] = i end");
+      expect(() => { it.next(); it.next(); }).toThrow('table was modified during iteration');
+      expect(it.next().done).toBe(true);
+    });
+
+    it('validates batchSize', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      const t = lua.create_table();
+      expect(() => t.entries({ batchSize: 0 })).toThrow(RangeError);
+      expect(() => t.entries({ batchSize: 'x' as any })).toThrow(TypeError);
+      expect(() => t.entries(5 as any)).toThrow(TypeError);
+    });
+  });
+  // ============================================
+  // TYPEDARRAY VIEWS
+  // ============================================
+  describe('typedArrays view mode', () => {
+    it('shares the array memory with Lua in both directions', () => {
+      const lua = new lua_native.init({}, { ...ALL_LIBS, typedArrays: 'view' });
+      const samples = new Float64Array([1.5, 2.5, 3.5]);
+      lua.set_global('samples', samples);
+      expect(lua.execute_script('for i = 1, #samples do samples[i] = samples[i] * 2 end return #samples')).toBe(3);
+      expect(Array.from(samples)).toEqual([3, 5, 7]);
+      samples[0] = 42;
+      expect(lua.execute_script('return samples[1], samples[4] == nil')).toEqual([42, true]);
+    });
+
+    it('returns the original TypedArray and honors byteOffset', () => {
+      const lua = new lua_native.init({}, { typedArrays: 'view' });
+      const backing = new Int32Array([1, 2, 3, 4]);
+      const tail = backing.subarray(2);
+      lua.set_global('t', tail);
+      expect(lua.execute_script('return t')).toBe(tail);
+      lua.execute_script('t[1] = -7');
+      expect(Array.from(backing)).toEqual([1, 2, -7, 4]);
+      const echo = lua.execute_script<(x: unknown) => unknown>('return function(x) return x end');
+      expect(echo(tail)).toBe(tail);
+    });
+
+    it('rejects values the element type cannot hold', () => {
+      const lua = new lua_native.init({}, { typedArrays: 'view' });
+      lua.set_global('u', new Uint16Array(2));
+      expect(() => lua.execute_script('u[1] = 70000')).toThrow('out of range for Uint16Array');
+      expect(() => lua.execute_script('u[1] = 0.5')).toThrow();
+      expect(() => lua.execute_script('u[3] = 1')).toThrow('index out of range');
+    });
+
+    it('keeps byte arrays and the default mode as strings', () => {
+      const view = new lua_native.init({}, { typedArrays: 'view' });
+      view.set_global('b', new Uint8Array([104, 105]));
+      expect(view.execute_script('return b')).toBe('hi');
+      const copy = new lua_native.init();
+      copy.set_global('f', new Float32Array([1]));
+      expect(copy.execute_script('return type(f), #f')).toEqual(['string', 4]);
+      expect(() => new lua_native.init({}, { typedArrays: 'share' as any })).toThrow(TypeError);
+    });
+
+    it('raises instead of touching a transferred buffer', () => {
+      const lua = new lua_native.init({}, { libraries: ['base', 'vector'], typedArrays: 'view' });
+      const samples = new Float64Array([1, 2, 3]);
+      lua.set_global('samples', samples);
+      expect(lua.execute_script('return samples[2]')).toBe(2);
+      structuredClone(samples.buffer, { transfer: [samples.buffer] });
+      expect(() => lua.execute_script('return samples[1]')).toThrow('typed array has been detached');
+      expect(() => lua.execute_script('samples[1] = 0')).toThrow('typed array has been detached');
+      expect(() => lua.execute_script('return vector.sum(samples)')).toThrow('typed array has been detached');
+    });
+
+    it('checks the buffer again after a callback that transferred it', () => {
+      const lua = new lua_native.init({
+        detach: () => { structuredClone(samples.buffer, { transfer: [samples.buffer] }); },
+      }, { typedArrays: 'view' });
+      const samples = new Float64Array([1, 2, 3]);
+      lua.set_global('samples', samples);
+      expect(() => lua.execute_script('local x = samples[1]; detach(); return samples[1]'))
+        .toThrow('typed array has been detached');
+    });
+
+    it('rejects arrays over resizable buffers', () => {
+      const lua = new lua_native.init({}, { typedArrays: 'view' });
+      const buffer = new (ArrayBuffer as any)(16, { maxByteLength: 64 });
+      expect(() => lua.set_global('r', new Float64Array(buffer))).toThrow('resizable');
+    });
+  });
+  // ============================================
+  // VECTOR LIBRARY
+  // ============================================
+  describe('vector library', () => {
+    it('is loaded only when named', () => {
+      expect(new lua_native.init({}, ALL_LIBS).execute_script('return vector')).toBeNull();
+      const lua = new lua_native.init({}, { libraries: ['base', 'vector'] });
+      expect(lua.execute_script('return type(vector.sum)')).toBe('function');
+      expect(lua.info().libraries).toEqual(['base', 'vector']);
+    });
+
+    it('runs kernels over TypedArray views in place', () => {
+      const lua = new lua_native.init({}, { libraries: ['base', 'vector'], typedArrays: 'view' });
+      const xs = new Float64Array(10_000).map((_, i) => i + 1);
+      const ys = new Float64Array(10_000);
+      lua.set_global('xs', xs);
+      lua.set_global('ys', ys);
+      expect(lua.execute_script('return vector.sum(xs)')).toBe((10_000 * 10_001) / 2);
+      lua.execute_script('vector.axpy(0.5, xs, ys)');
+      expect(ys[9_999]).toBe(5_000);
+      const scores = new Int32Array([4, 9, 1, 7]);
+      lua.set_global('scores', scores);
+      expect(lua.execute_script('return vector.sum(vector.compare(scores, ">=", 5))')).toBe(2);
+      lua.execute_script('vector.sort(scores)');
+      expect(Array.from(scores)).toEqual([1, 4, 7, 9]);
+    });
+
+    it('copies Lua-made arrays out as plain arrays', () => {
+      const lua = new lua_native.init({}, { libraries: ['base', 'vector'] });
+      expect(lua.execute_script("return vector.cumsum(vector.from({1, 2, 3}, 'int32'))")).toEqual([1, 3, 6]);
+      expect(() => lua.execute_script('return vector.dot(vector.new(1), vector.new(2))')).toThrow('lengths differ');
+    });
+  });
+  // ============================================
+  // JSON FAST PATH
+  // ============================================
+  describe('set_global_json', () => {
+    it('maps JSON text like the equivalent set_global value', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      const payload = { items: [{ id: 1, tags: ['a', 'b'] }, { id: 2, tags: [] }], total: 2.5, ok: true };
+      lua.set_global_json('viaJson', JSON.stringify(payload));
+      lua.set_global('viaObject', payload);
+      expect(lua.get_global('viaJson')).toEqual(lua.get_global('viaObject'));
+      expect(lua.execute_script('return #viaJson.items, math.type(viaJson.items[2].id)')).toEqual([2, 'integer']);
+    });
+
+    it('stringifies non-string values in V8 and honors dotted paths', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      lua.set_global_json('cfg.db', { host: 'localhost', port: 5432, toString: () => 'ignored' });
+      expect(lua.execute_script('return cfg.db.host, cfg.db.port')).toEqual(['localhost', 5432]);
+      lua.set_global_json('when', { toJSON: () => 'serialized' });
+      expect(lua.get_global('when')).toBe('serialized');
+    });
+
+    it('rejects malformed JSON with its offset', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      expect(() => lua.set_global_json('doc', '{"a": [1, 2}')).toThrow('JSON parse error at offset 11');
+      expect(lua.get_global('doc')).toBeNull();
+      expect(() => lua.set_global_json('doc', () => 1)).toThrow(TypeError);
+      const cyclic: Record<string, unknown> = {};
+      cyclic.self = cyclic;
+      expect(() => lua.set_global_json('doc', cyclic as any)).toThrow();
+    });
+  });
+  // ============================================
+  // JSON RESULTS
+  // ============================================
+  describe('execute_script_json', () => {
+    it('returns the same shapes as execute_script', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      const script = "return { rows = { { id = 1, name = 'a' }, { id = 2, name = 'b' } }, total = 2.5, tags = {} }";
+      expect(lua.execute_script_json(script)).toEqual(lua.execute_script(script));
+      expect(lua.execute_script_json('return 1, "two"')).toEqual([1, 'two']);
+      expect(lua.execute_script_json('return')).toBeNull();
+    });
+
+    it('returns the JSON text and honors the table options', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      expect(lua.execute_script_json('return { list = { 1, 2 } }', { output: 'string' })).toBe('{"list":[1,2]}');
+      expect(lua.execute_script_json('return {}', { emptyTable: 'object' })).toEqual({});
+      expect(lua.execute_script_json("return { [1] = 'a', [3] = 'c' }", { sparseArrays: true })).toEqual(['a', null, 'c']);
+      expect(() => lua.execute_script_json('return 1', { output: 'xml' as any })).toThrow(TypeError);
+    });
+
+    it('rejects values JSON cannot represent', () => {
+      const lua = new lua_native.init({}, ALL_LIBS);
+      expect(() => lua.execute_script_json('return { f = print }')).toThrow('cannot encode a function as JSON');
+      expect(() => lua.execute_script_json('local t = {} t[1] = t return t')).toThrow('cyclic');
+    });
+  });
+  // ============================================
+  // JSON LIBRARY
+  // ============================================
+  describe('json library', () => {
+    it('is loaded only when named', () => {
+      expect(new lua_native.init({}, ALL_LIBS).execute_script('return json')).toBeNull();
+      const lua = new lua_native.init({}, { libraries: ['base', 'json'] });
+      expect(lua.execute_script('return type(json.encode), type(json.decode)')).toEqual(['function', 'function']);
+    });
+
+    it('agrees with V8 on the JSON it reads and writes', () => {
+      const lua = new lua_native.init({}, { libraries: ['base', 'json'] });
+      const doc = { id: 7, name: 'caf\u00e9 \u{1F600}', nested: { list: [1, 2.5, 'x', false] }, quote: 'a"b\\c\n' };
+      lua.set_global('text', JSON.stringify(doc));
+      expect(JSON.parse(lua.execute_script<string>('return json.encode(json.decode(text))'))).toEqual(doc);
+      expect(lua.execute_script("return json.decode('[1, null, 3]', { null = json.null })[2] == json.null")).toBe(true);
+    });
+
+    it('raises catchable errors', () => {
+      const lua = new lua_native.init({}, { libraries: ['base', 'json'] });
+      expect(() => lua.execute_script('return json.decode("{")')).toThrow('JSON parse error');
+      expect(lua.execute_script('return (pcall(json.encode, { f = print }))')).toBe(false);
+    });
+  });
+  // ============================================
+  // LAZY SHARED TABLES
+  // ============================================
+  describe('createSharedTable(value, { lazy: true })', () => {
+    it('pulls fields on first read and re-pulls after a change', () => {
+      const shared = lua_native.createSharedTable({ mode: 'dev', nested: { n: 1 } }, { lazy: true });
+      const lua1 = new lua_native.init({}, { ...ALL_LIBS, shared: { settings: shared } });
+      const lua2 = new lua_native.init({}, { ...ALL_LIBS, shared: { settings: shared } });
+
+      expect(lua1.execute_script('return settings.mode, settings.nested.n, settings.missing'))
+        .toEqual(['dev', 1, undefined]);
+      shared.set('mode', 'prod');
+      expect(lua1.execute_script('return settings.mode')).toBe('prod');
+      expect(lua2.execute_script('return settings.mode')).toBe('prod');
+
+      // Direct mutation is picked up once sync() invalidates.
+      (shared.get('nested') as { n: number }).n = 2;
+      shared.sync();
+      expect(lua1.execute_script('return settings.nested.n')).toBe(2);
+    });
+
+    it('iterates and measures the whole table', () => {
+      const shared = lua_native.createSharedTable({ a: 1, b: 2 }, { lazy: true });
+      const list = lua_native.createSharedTable([10, 20, 30], { lazy: true });
+      const lua = new lua_native.init({}, { ...ALL_LIBS, shared: { settings: shared, list } });
+
+      expect(lua.execute_script(`
+        local keys = {}
+        for k, v in pairs(settings) do keys[#keys + 1] = k .. '=' .. v end
+        table.sort(keys)
+        return table.concat(keys, ',')
+      `)).toBe('a=1,b=2');
+      expect(lua.execute_script('return #list, list[2], list[4]')).toEqual([3, 20, undefined]);
+      // Only the canonical spelling of an index names an element.
+      expect(lua.execute_script("return list['01'], list['+1'], list[' 1'], list['-1']"))
+        .toEqual([undefined, undefined, undefined, undefined]);
+    });
+
+    it('keeps a Lua-side edit until the next change', () => {
+      const shared = lua_native.createSharedTable({ n: 1, m: 1 }, { lazy: true });
+      const lua = new lua_native.init({}, { ...ALL_LIBS, shared: { settings: shared } });
+
+      lua.execute_script('settings.n = 999');
+      expect(lua.execute_script('return settings.n')).toBe(999);
+      expect(shared.get('n')).toBe(1);
+      shared.set('m', 2);
+      expect(lua.execute_script('return settings.n')).toBe(1);
+    });
+
+    it('does not fail set() for a busy context', async () => {
+      const shared = lua_native.createSharedTable({ n: 1 }, { lazy: true });
+      const busy = new lua_native.init({}, { ...ALL_LIBS, shared: { settings: shared } });
+      expect(busy.execute_script('return settings.n')).toBe(1);
+
+      const pending = busy.execute_script_async(
+        'local s = 0 for i = 1, 3000000 do s = s + i end return s');
+      expect(() => shared.set('n', 7)).not.toThrow();
+      await pending;
+      expect(busy.execute_script('return settings.n')).toBe(7);
+    });
+
+    it('raises for a changed field read in async mode', async () => {
+      const shared = lua_native.createSharedTable({ n: 1 }, { lazy: true });
+      const lua = new lua_native.init({}, { ...ALL_LIBS, shared: { settings: shared } });
+
+      expect(await lua.execute_script_async('return settings.n')).toBe(1);
+      shared.set('n', 2);
+      await expect(lua.execute_script_async('return settings.n'))
+        .rejects.toThrow("shared table field 'n' changed and cannot be read in async mode");
+    });
+
+    it('converts to its contents wherever it leaves Lua', () => {
+      const shared = lua_native.createSharedTable({ n: 1, list: [1, 2] }, { lazy: true });
+      const lua = new lua_native.init({
+        echo: (t: any) => t,
+      }, { ...ALL_LIBS, shared: { settings: shared } });
+
+      expect(lua.get_global('settings')).toEqual({ n: 1, list: [1, 2] });
+      expect(lua.execute_script('return settings')).toEqual({ n: 1, list: [1, 2] });
+      expect(lua.execute_script('return echo(settings).n')).toBe(1);
+      expect(lua.execute_script_json('return settings')).toEqual({ n: 1, list: [1, 2] });
+    });
+
+    it('is re-bound after reset()', () => {
+      const shared = lua_native.createSharedTable({ n: 1 }, { lazy: true });
+      const lua = new lua_native.init({}, { ...ALL_LIBS, shared: { settings: shared } });
+      lua.reset();
+      shared.set('n', 3);
+      expect(lua.execute_script('return settings.n')).toBe(3);
+    });
+
+    it('rejects non-object options', () => {
+      expect(() => lua_native.createSharedTable({}, true as any))
+        .toThrow('createSharedTable(initial, options) requires an options object');
+    });
+  });
+  // ============================================
+  // SHARED DATA
+  // ============================================
+  describe('createSharedData()', () => {
+    const catalogValue = () => ({
+      items: [{ sku: 'a1', price: 3 }, { sku: 'b2', price: 5.5 }],
+      currency: 'EUR',
+      flags: { 7: true },
+    });
+
+    it('is read in place by every bound context', () => {
+      const catalog = lua_native.createSharedData(catalogValue());
+      const lua1 = new lua_native.init({}, { ...ALL_LIBS, shared: { catalog } });
+      const lua2 = new lua_native.init({}, { ...ALL_LIBS, shared: { cfg: catalog } });
+
+      expect(lua1.execute_script(`
+        local total = 0
+        for _, item in ipairs(catalog.items) do total = total + item.price end
+        return total, #catalog.items, catalog.flags[7], type(catalog)
+      `)).toEqual([8.5, 2, true, 'userdata']);
+      expect(lua2.execute_script('return cfg.items[2].sku')).toBe('b2');
+      expect(lua1.execute_script(`
+        local keys = {}
+        for k in pairs(catalog) do keys[#keys + 1] = k end
+        return table.concat(keys, ','), catalog.items == catalog.items
+      `)).toEqual(['currency,flags,items', true]);
+      expect(catalog.byteSize()).toBeGreaterThan(0);
+    });
+
+    it('is read-only from Lua', () => {
+      const catalog = lua_native.createSharedData(catalogValue());
+      const lua = new lua_native.init({}, { ...ALL_LIBS, shared: { catalog } });
+      expect(() => lua.execute_script('catalog.currency = "USD"')).toThrow('shared data is read-only');
+      expect(() => lua.execute_script('catalog.items[1].price = 0')).toThrow('shared data is read-only');
+    });
+
+    it('swaps versions with update()', () => {
+      const catalog = lua_native.createSharedData(catalogValue());
+      const lua = new lua_native.init({}, { ...ALL_LIBS, shared: { catalog } });
+      lua.execute_script('held = catalog.items');
+
+      catalog.update({ items: [], currency: 'USD' });
+      expect(catalog.version()).toBe(2);
+      expect(lua.execute_script('return catalog.currency, #catalog.items')).toEqual(['USD', 0]);
+      // A view taken before the update stays on its version.
+      expect(lua.execute_script('return #held')).toBe(2);
+
+      expect(() => catalog.update({ f: () => 1 } as any)).toThrow(TypeError);
+      expect(catalog.version()).toBe(2);
+    });
+
+    it('copies a view out as plain data when it reaches JS', () => {
+      const catalog = lua_native.createSharedData(catalogValue());
+      const lua = new lua_native.init({}, { ...ALL_LIBS, shared: { catalog } });
+      expect(lua.execute_script('return catalog.items[1]')).toEqual({ sku: 'a1', price: 3 });
+      expect(lua.execute_script_json('return catalog.items', { output: 'string' }))
+        .toBe('[{"price":3,"sku":"a1"},{"price":5.5,"sku":"b2"}]');
+    });
+
+    it('survives reset() and rejects what is not plain data', () => {
+      const catalog = lua_native.createSharedData(catalogValue());
+      const lua = new lua_native.init({}, { ...ALL_LIBS, shared: { catalog } });
+      lua.reset();
+      expect(lua.execute_script('return catalog.currency')).toBe('EUR');
+
+      expect(() => lua_native.createSharedData(5 as any)).toThrow('must be an object or an array');
+      expect(() => lua_native.createSharedData({ s: Symbol('x') } as any)).toThrow(TypeError);
+      expect(() => new lua_native.init({}, { ...ALL_LIBS, shared: catalog as any }))
+        .toThrow('not a shared table itself');
+    });
+  });
 });
@@ -55,7 +55,11 @@ export interface LuaTable {
 }
 
 /**
- * Represents a function that can be called from Lua or returned from Lua
+ * Represents a function that can be called from Lua or returned from Lua.
+ *
+ * The same Lua function returned to JS again yields the same wrapper
+ * (`===`) while the earlier one is alive and unreleased. Metatabled-table
+ * Proxies behave the same way.
  */
 export interface LuaFunction {
   (...args: LuaInput[]): LuaValue | LuaValue[] | void;
@@ -96,6 +100,24 @@ export interface LuaCoroutine extends Iterable<LuaValue> {
    * the resume values, so a generator-style coroutine can be fed from JS.
    */
   [Symbol.iterator](): Iterator<LuaValue, LuaValue | undefined, LuaInput>;
+  /**
+   * Resumes up to `n` times in a single native call and returns the yielded
+   * values, one element per `yield` (shaped like an iteration step's value).
+   * `args` are passed to the first resume only. Returns fewer than `n` values
+   * when the coroutine finishes — its final `return` value is discarded, as with
+   * `for..of` — and `[]` once it is dead. Pass `Infinity` to drain it.
+   *
+   * Use it to stream a long-running generator out of Lua without paying a
+   * JS↔Lua crossing per value. A Lua error ends the coroutine and is thrown
+   * as an `Error` whose `cause` is the raised value (a JS error thrown by a
+   * callback arrives as itself); values yielded earlier in the same batch are
+   * attached to it as `error.values`.
+   *
+   * @example
+   * let rows;
+   * while ((rows = co.take(1000)).length > 0) sink.write(rows);
+   */
+  take(n: number, ...args: LuaInput[]): LuaValue[];
 }
 
 /**
@@ -129,6 +151,18 @@ export interface LuaCallback {
   (...args: LuaValue[]): LuaValue | void;
 }
 
+/** A scalar type in a fast-function signature. */
+export type FastScalarType = 'number' | 'integer' | 'boolean';
+
+/**
+ * Declared signature for `register_fast_function`. `args` defaults to `[]` and
+ * `returns` to `'void'`.
+ */
+export interface FastFunctionSignature {
+  args?: FastScalarType[];
+  returns?: FastScalarType | 'void';
+}
+
 /**
  * Object containing callbacks and values that will be available in the Lua environment
  */
@@ -254,6 +288,28 @@ export interface ClassDefinition {
 
   /** Allow Lua to write instance properties via `instance.prop = v` (default: false) */
   writable?: boolean;
+
+  /**
+   * Typed fields stored natively per instance. Lua reads and writes them with
+   * no call into JavaScript (also during async execution), and assigning a
+   * value of the wrong type raises. Declared fields are always readable and
+   * writable from Lua, whatever `readable` / `writable` say, and are not
+   * inherited through `extends`.
+   *
+   * Values are seeded from the constructed object. Lua-side writes reach the
+   * JS object when the instance is next handed to JavaScript (a method or
+   * callback argument, a return value), on `flush_fields()`, or when Lua drops
+   * its last reference. JS-side writes are picked up when the instance passes
+   * back into Lua, including after a method that was given it returns.
+   *
+   * @example
+   * lua.register_class('Particle', {
+   *   construct: (x) => ({ x, vx: 1 }),
+   *   fields: { x: 'number', vx: 'number' },
+   * });
+   * // Lua: p.x = p.x + p.vx  -- no JS involved
+   */
+  fields?: Record<string, 'number' | 'integer' | 'boolean' | 'string'>;
 }
 
 /**
@@ -310,6 +366,32 @@ export interface LuaTableHandle {
   /** Set a field by key. Triggers __newindex if the table has a metatable. See {@link get} for how the key's JS type maps to the Lua key type. */
   set(key: string | number, value: LuaInput): void;
 
+  /**
+   * Read several keys in one call. All reads run in a single protected frame
+   * (one crossing into Lua rather than one per key); each still triggers
+   * `__index`. See {@link get} for how each key's JS type maps to the Lua key type.
+   *
+   * @returns The values, in `keys` order
+   * @example
+   * const [host, port] = cfg.get_many(['host', 'port']);
+   */
+  get_many(keys: Array<string | number>): LuaValue[];
+
+  /**
+   * {@link get_many} shaped as a plain object keyed by the requested keys.
+   *
+   * @example
+   * const { host, port } = cfg.pick('host', 'port');
+   */
+  pick<K extends string | number>(...keys: K[]): Record<K, LuaValue>;
+
+  /**
+   * Write every own enumerable property of `values` in one call. Each name is a
+   * string key, as with `set(name, value)`. Writes trigger `__newindex` and
+   * apply in property order; if one raises, the earlier ones stay applied.
+   */
+  set_many(values: Record<string, LuaInput>): void;
+
   /** Check if a key exists in the table. See {@link get} for how the key's JS type maps to the Lua key type. */
   has(key: string | number): boolean;
 
@@ -329,6 +411,36 @@ export interface LuaTableHandle {
    */
   ipairs(): Array<[number, LuaValue]>;
 
+  /**
+   * Iterate key-value pairs (like {@link pairs}) without materializing the
+   * table: the walk fetches `batchSize` entries at a time (default 256), so
+   * memory stays bounded however large the table is. The iterator keeps its
+   * own reference to the table, so releasing the handle does not end it.
+   *
+   * Assigning to or clearing existing fields during the walk is fine; adding
+   * new keys is not (Lua's `next()` rule). Each batch checks the point where
+   * the last one stopped and throws `"table was modified during iteration"`
+   * if additions rebuilt or reordered the table there; an addition that leaves
+   * that point intact is not detected.
+   *
+   * @example
+   * for (const [key, value] of index.entries({ batchSize: 1000 })) { ... }
+   */
+  entries(options?: { batchSize?: number }): IterableIterator<[string | number, LuaValue]>;
+
+  /**
+   * Run a chunk from {@link LuaContext.prepare} with this table as its
+   * environment (`_ENV`) and `args` as its `...`. The chunk is not recompiled.
+   *
+   * @returns The chunk's results, as from `execute_script`
+   * @throws If `chunk` is not a live prepared chunk from this context, or the
+   *   script errors
+   * @example
+   * const rule = lua.prepare('return (...) > limit');
+   * tenantEnv.run(rule, 42);
+   */
+  run<T extends LuaValue | LuaValue[] = LuaValue>(chunk: LuaPreparedChunk, ...args: LuaValue[]): T;
+
   /**
    * Release the registry reference. After calling release(),
    * all other methods throw. Safe to call multiple times.
@@ -336,6 +448,15 @@ export interface LuaTableHandle {
   release(): void;
 }
 
+/**
+ * A script compiled once by {@link LuaContext.prepare}, run against an
+ * environment with {@link LuaTableHandle.run}. Opaque apart from `release()`.
+ */
+export interface LuaPreparedChunk {
+  /** Drop the compiled chunk. Running it afterwards throws. */
+  release(): void;
+}
+
 /**
  * The kind of event a {@link LuaHookCallback} was fired for.
  *
@@ -422,6 +543,26 @@ export interface LuaStateInfo {
    * the names it expanded to (`'all'` → all ten), and a bare state as `[]`.
    */
   libraries: LuaLibrary[];
+
+  /** Coroutine thread reuse counters (see the `coroutinePoolSize` option). */
+  coroutinePool: CoroutinePoolStats;
+}
+
+/**
+ * Counters for the coroutine thread pool, reported by {@link LuaContext.info}.
+ */
+export interface CoroutinePoolStats {
+  /** The `coroutinePoolSize` in force. `0` means threads are never reused. */
+  capacity: number;
+
+  /** Finished threads currently parked for reuse. */
+  idle: number;
+
+  /** Coroutines that were built on a freshly allocated thread. */
+  created: number;
+
+  /** Coroutines that were built on a recycled thread. */
+  reused: number;
 }
 
 /**
@@ -454,6 +595,99 @@ export interface EnvironmentOptions {
   inherit?: boolean;
 }
 
+/**
+ * Options for {@link LuaContext.create_environment_template}.
+ */
+export interface EnvironmentTemplateOptions extends EnvironmentOptions {
+  /**
+   * How many recycled environments the template keeps for reuse. Past this,
+   * `recycle()` lets the environment be collected. Default: 64.
+   */
+  maxPooled?: number;
+}
+
+/**
+ * Per-environment budgets for {@link LuaContext.set_environment_limits}.
+ * Omitted or `0` means unlimited.
+ */
+export interface EnvironmentLimits {
+  /**
+   * Bytes of live Lua memory the environment may hold. An allocation past it
+   * fails with "not enough memory" in that environment's run. Requires the
+   * `environmentAccounting` option.
+   */
+  maxMemory?: number;
+  /**
+   * VM instructions one run against the environment may execute before it
+   * fails with "environment instruction limit exceeded".
+   */
+  maxInstructions?: number;
+}
+
+/**
+ * An environment's account, from {@link LuaContext.get_environment_usage}.
+ */
+export interface EnvironmentUsage {
+  /**
+   * Live bytes charged to the environment: what its runs allocated and has
+   * not been freed yet. Always `0` without `environmentAccounting`.
+   */
+  memoryBytes: number;
+  maxMemory: number;
+  /** Instructions run across all its runs, at count-hook granularity (1000 or the smallest limit). */
+  instructions: number;
+  maxInstructions: number;
+  /** Runs against it since its limits were first set. */
+  runs: number;
+}
+
+/**
+ * A whitelist resolved once, for handing out many environments cheaply. Made
+ * by {@link LuaContext.create_environment_template}.
+ */
+export interface LuaEnvironmentTemplate {
+  /**
+   * A fresh environment (or a recycled, emptied one). Its globals read through
+   * to the template's shared base; its writes stay in the environment.
+   */
+  acquire(): LuaEnvironment;
+
+  /**
+   * Empty `env` and keep it for a later `acquire()`. The `env` handle is
+   * released by this call.
+   *
+   * Recycle only once nothing from the run can still reach the environment.
+   * A Lua function the script handed to JS or stored in a shared table keeps
+   * using this table as its globals, and would then see the next user's.
+   *
+   * @throws If `env` was not acquired from this template
+   */
+  recycle(env: LuaEnvironment): void;
+
+  /** Drop the template and its pool. Environments already acquired keep working. */
+  release(): void;
+}
+
+/**
+ * Options for `execute_script_json`.
+ */
+export interface JsonResultOptions {
+  /** `'value'` (default): the parsed result. `'string'`: the JSON text itself. */
+  output?: 'value' | 'string';
+  /**
+   * How an empty Lua table encodes. Default `'array'` (`[]`), matching what
+   * `execute_script` returns for `{}`.
+   */
+  emptyTable?: 'array' | 'object';
+  /**
+   * Encode a table whose keys are all positive integers but which has holes as
+   * an array with `null` in the holes (when at least half its slots are
+   * filled), instead of an object keyed by the decimal strings. Default `false`,
+   * matching `execute_script`.
+   */
+  sparseArrays?: boolean;
+}
+
 /**
  * Represents a Lua execution context
  */
@@ -469,6 +703,24 @@ export interface LuaContext {
    */
   execute_script<T extends LuaValue | LuaValue[] = LuaValue>(script: string): T;
 
+  /**
+   * Executes a Lua script and returns its results serialized as JSON natively
+   * in C++ — one pass over the Lua tables, then a single `JSON.parse` (or the
+   * raw JSON text with `output: 'string'`). Much faster than `execute_script`
+   * for large plain-data results, which it converts one property at a time.
+   *
+   * Results are shaped as in `execute_script`: none is `null`, one is itself,
+   * several are an array. Tables are read raw (metatables are ignored) and
+   * TypedArray views encode as arrays. Functions, userdata, threads and cyclic
+   * tables throw. NaN and infinities become `null`, as in `JSON.stringify`.
+   *
+   * @example
+   * const report = lua.execute_script_json('return build_report()');
+   * const text = lua.execute_script_json('return rows', { output: 'string' });
+   */
+  execute_script_json<T = unknown>(script: string, options?: JsonResultOptions & { output?: 'value' }): T;
+  execute_script_json(script: string, options: JsonResultOptions & { output: 'string' }): string;
+
   /**
    * Executes a Lua file and returns the result.
    * Use the generic parameter to specify the expected return type.
@@ -495,6 +747,27 @@ export interface LuaContext {
    */
   set_global(name: string, value: LuaInput | LuaCallback): void;
 
+  /**
+   * Sets a global (or dotted-path field, as in `set_global`) from JSON,
+   * decoded natively straight into Lua tables. Much faster than `set_global`
+   * for large plain-data payloads, which it converts one property at a time.
+   *
+   * A string is parsed as JSON text. Any other value is first serialized with
+   * `JSON.stringify`, so JSON semantics apply to it: `toJSON()` is honored,
+   * functions and `undefined` properties are dropped, and `Date`/`Map`/`BigInt`
+   * do not get `set_global`'s type conversions.
+   *
+   * The result maps as `set_global` would map the parsed value: objects become
+   * tables, arrays 1-based sequences, `null` nil, and integral numbers
+   * integers (exact for any integer literal in 64-bit range). Throws on
+   * malformed JSON, leaving the target unset.
+   *
+   * @example
+   * lua.set_global_json('payload', await response.text());
+   * lua.execute_script('return #payload.items');
+   */
+  set_global_json(name: string, json: string | LuaInput): void;
+
   /**
    * Gets a global variable from the Lua environment.
    *
@@ -510,6 +783,29 @@ export interface LuaContext {
    */
   get_global(name: string): LuaValue;
 
+  /**
+   * Installs `fn` as the global `name` with a declared scalar signature. Calls
+   * read their arguments straight off the Lua stack and push the result back
+   * directly, skipping the generic value conversion. This is meant for hot
+   * numeric helpers.
+   *
+   * Checking is strict. Lua must pass exactly `args.length` arguments, of
+   * exactly the declared types: a numeric string is not a number, and an
+   * `'integer'` must have an exact integer value. A mismatch raises a Lua
+   * argument error. A result of the wrong type (or a Promise) raises an error.
+   * At most 8 parameters.
+   *
+   * @param name Global name (not split on dots)
+   * @param fn The JavaScript implementation
+   * @param signature Parameter and result types
+   * @throws TypeError for an unknown type name; RangeError for more than 8 parameters
+   */
+  register_fast_function(
+    name: string,
+    fn: (...args: (number | bigint | boolean)[]) => number | bigint | boolean | void,
+    signature: FastFunctionSignature
+  ): void;
+
   /**
    * Calls a Lua function by global name, returning its result (an array when
    * the function returned several values, `undefined` when it returned none).
@@ -660,6 +956,33 @@ export interface LuaContext {
    */
   resume(coroutine: LuaCoroutine, ...args: LuaInput[]): CoroutineResult;
 
+  /**
+   * Consumes a coroutine as an async iterator whose values are produced on a
+   * worker thread, `batchSize` resumes at a time, so a long-running generator
+   * doesn't block the event loop. Production is on demand: a batch starts only
+   * when `next()` finds the buffer empty, so a slow consumer pauses the
+   * generator and the loop body may use the context between batches.
+   *
+   * Worker-thread rules apply, as for `execute_script_async`: the coroutine
+   * body cannot call JS callbacks, and the context is busy while a batch is
+   * being produced. The final `return` value is discarded (as with `for..of`),
+   * and a Lua error rejects the `next()` that reaches it. Ending the loop early
+   * drops values already produced; the coroutine stays suspended where its
+   * last batch stopped.
+   *
+   * @param coroutine A coroutine from this context
+   * @param options `batchSize`: resumes per worker run (default 64)
+   * @example
+   * for await (const row of lua.iterate_async(co, { batchSize: 500 })) {
+   *   await db.insert(row);
+   * }
+   * // As a Node stream: Readable.from(lua.iterate_async(co))
+   */
+  iterate_async(
+    coroutine: LuaCoroutine,
+    options?: { batchSize?: number },
+  ): AsyncIterableIterator<LuaValue>;
+
   /**
    * Executes a Lua script string asynchronously on a worker thread.
    * Returns a Promise that resolves with the result.
@@ -772,6 +1095,24 @@ export interface LuaContext {
    */
   compile(script: string, options?: CompileOptions): Buffer;
 
+  /**
+   * Compile a script once, for running against many environments.
+   *
+   * `execute_script_in` parses its script on every call. A prepared chunk is
+   * parsed here only, and `env.run(chunk, ...args)` runs it with `env` as its
+   * globals and `args` as its `...`. Each run has its own environment, so a
+   * function the script creates keeps the environment of the run that made it.
+   *
+   * @param script The Lua source to compile
+   * @param options `chunkName` names the chunk in error messages
+   * @returns An opaque prepared chunk
+   * @throws If the script has a syntax error
+   * @example
+   * const rule = lua.prepare('local order = ... return order.total > limit');
+   * for (const tenant of tenants) tenant.env.run(rule, order);
+   */
+  prepare(script: string, options?: { chunkName?: string }): LuaPreparedChunk;
+
   /**
    * Compiles a Lua file to bytecode without executing it.
    * The chunk name defaults to "@filepath" matching Lua convention.
@@ -864,6 +1205,35 @@ export interface LuaContext {
    */
   create_environment(options?: EnvironmentOptions): LuaEnvironment;
 
+  /**
+   * Resolve an environment whitelist once, for code that creates an
+   * environment per request.
+   *
+   * {@link create_environment} copies every whitelisted global into each new
+   * table. A template copies them once, into a shared base. Each `acquire()`
+   * is then just an empty table whose metatable reads through to the base,
+   * and `recycle()` empties an environment for reuse instead of leaving it to
+   * the garbage collector.
+   *
+   * Scripts see the same globals as with `create_environment`, with two
+   * differences. The whitelisted names are not keys of the environment, so
+   * `pairs(_ENV)` shows only what the script defined. And the metatable is
+   * locked: `getmetatable(_ENV)` returns `false` and `setmetatable(_ENV, ...)`
+   * raises.
+   *
+   * @param options Which globals to seed, whether to fall back to `_G`, and how
+   *   many recycled environments to keep
+   * @example
+   * const tpl = lua.create_environment_template({ whitelist: ['math', 'string'] });
+   * for (const req of requests) {
+   *   const env = tpl.acquire();
+   *   env.set('input', req.body);
+   *   respond(lua.execute_script_in(env, handler));
+   *   tpl.recycle(env);
+   * }
+   */
+  create_environment_template(options?: EnvironmentTemplateOptions): LuaEnvironmentTemplate;
+
   /**
    * Execute a script with `env` installed as its `_ENV`, so the script's
    * global reads and writes resolve against that table instead of `_G`.
@@ -893,6 +1263,31 @@ export interface LuaContext {
     script: string
   ): T;
 
+  /**
+   * Gives an environment its own budget, for a state shared by many tenants.
+   * While `execute_script_in` or `env.run()` runs against `env`, the
+   * instructions it executes — and, with the `environmentAccounting` option,
+   * the memory it allocates — are charged to `env` rather than only to the
+   * context's `maxInstructions` / `maxMemory`, which still apply on top.
+   *
+   * Calling it again replaces the limits and keeps the counters. The account
+   * lasts as long as the environment's table; a template's `recycle()` drops it.
+   *
+   * @throws If `maxMemory` is set without `environmentAccounting`, or `env` is
+   *   not a live table reference from this context
+   * @example
+   * const lua = new lua_native.init({}, { libraries: 'safe', environmentAccounting: true });
+   * const env = lua.create_environment({ whitelist: ['string'] });
+   * lua.set_environment_limits(env, { maxMemory: 4 << 20, maxInstructions: 1e6 });
+   */
+  set_environment_limits(env: LuaEnvironment | LuaTableHandle, limits?: EnvironmentLimits): void;
+
+  /**
+   * The counters and limits of `env`'s account, or `null` if
+   * {@link set_environment_limits} was never called for it.
+   */
+  get_environment_usage(env: LuaEnvironment | LuaTableHandle): EnvironmentUsage | null;
+
   /**
    * Registers a custom JS→Lua converter for values crossing into Lua.
    *
@@ -1010,6 +1405,15 @@ export interface LuaContext {
    */
   register_class(name: string, definition: ClassDefinition): void;
 
+  /**
+   * Write the native fields (see `ClassDefinition.fields`) that Lua changed
+   * back to their JS objects now, instead of when each object next crosses
+   * to JavaScript.
+   *
+   * @throws If the context is busy with an async operation
+   */
+  flush_fields(): void;
+
   /**
    * Calls a function in protected mode, returning a result object instead of
    * throwing. Mirrors Lua's `pcall`: on success `{ ok: true, value }`; on
@@ -1135,7 +1539,9 @@ export interface LuaContext {
    * After release, using the wrapper throws a clear error ("Lua function has
    * been released" / "coroutine has been released" / "table handle has been
    * released"). Releasing the same value again is a safe no-op. Equivalent to
-   * `handle.release()` for table handles.
+   * `handle.release()` for table handles. A function or metatabled-table
+   * wrapper is shared by every crossing of the same Lua object, so releasing
+   * it affects all holders. The next crossing then mints a fresh wrapper.
    *
    * @param value The Lua function, coroutine, or table reference to release
    * @example
@@ -1159,7 +1565,8 @@ export interface LuaContext {
    *
    * **Not replayed** — these bind to Lua-side objects that die with the old
    * state and must be re-applied after a reset: `set_global`, `set_userdata`,
-   * `set_metatable`, `register_module`, `register_class`, and `add_searcher`.
+   * `set_metatable`, `register_module`, `register_class`,
+   * `register_fast_function`, and `add_searcher`.
    *
    * Values that previously crossed into JavaScript (Lua functions, coroutines,
    * table references, opaque userdata) belong to the old state and are
@@ -1290,7 +1697,11 @@ export type LuaLibrary =
   | 'os'
   | 'string'
   | 'table'
-  | 'utf8';
+  | 'utf8'
+  /** Non-standard whole-array kernels over numeric arrays; never in a preset. */
+  | 'vector'
+  /** Non-standard native `json.encode` / `json.decode`; never in a preset. */
+  | 'json';
 
 /**
  * Preset names for loading groups of standard libraries
@@ -1399,6 +1810,34 @@ export interface LuaInitOptions {
    */
   timeout?: number;
 
+  /**
+   * Keep up to this many finished coroutine threads for reuse. When a
+   * coroutine from `create_coroutine` (or the one `execute_async` runs on) is
+   * released — via `release()` or garbage collection — after running to
+   * completion, its thread is reset and parked instead of being left for the
+   * collector, and the next coroutine is built on it. Useful for workloads
+   * that create many short-lived coroutines. Default: `0` (no reuse).
+   *
+   * A suspended or errored coroutine is never recycled, nor is one whose
+   * thread has surfaced as a value (e.g. a returned `coroutine.running()`).
+   * A coroutine body that stores `coroutine.running()` inside Lua where it
+   * outlives the coroutine would see the thread's next occupant, so leave
+   * pooling off for code that does.
+   *
+   * @example
+   * { libraries: 'all', coroutinePoolSize: 64 }
+   */
+  coroutinePoolSize?: number;
+
+  /**
+   * Tags every Lua allocation with the environment it is charged to, so
+   * {@link LuaContext.set_environment_limits} can cap each environment's
+   * memory. A block stays charged to the environment that allocated it until
+   * it is freed, even when the collector frees it during another one's run.
+   * Costs 8 bytes per allocation, which is why it is opt-in. Default: `false`.
+   */
+  environmentAccounting?: boolean;
+
   /**
    * Redirects Lua `print()` and `io.write()` to this handler (see
    * `set_print_handler`). The handler receives the formatted output text.
@@ -1415,6 +1854,25 @@ export interface LuaInitOptions {
    */
   allowBytecode?: boolean;
 
+  /**
+   * How numeric TypedArrays cross into Lua. `'copy'` (the default) converts
+   * every TypedArray to a binary string of its bytes. `'view'` passes
+   * `Int8Array`, `Int16Array`, `Uint16Array`, `Int32Array`, `Uint32Array`,
+   * `Float32Array` and `Float64Array` as a zero-copy view: Lua indexes it
+   * 1-based (`a[i]`, `a[i] = v`, `#a`) and reads and writes the array's own
+   * memory, so writes on either side are visible to the other. Integer
+   * element types only accept in-range integers. A view returned to JS is the
+   * original TypedArray. Byte arrays (`Uint8Array`, `Buffer`) and BigInt
+   * arrays still convert as strings.
+   *
+   * Lua checks that the array still owns its memory on first use after each
+   * call into Lua and after each JS callback returns. A view whose
+   * `ArrayBuffer` was transferred raises "typed array has been detached".
+   * Async execution uses the memory checked last; don't transfer the buffer
+   * while it runs. Arrays over resizable or growable buffers are rejected.
+   */
+  typedArrays?: 'copy' | 'view';
+
   /**
    * Shared tables to publish as globals in this context, keyed by the global
    * name each should take. Every subscribing context receives the shared
@@ -1426,9 +1884,12 @@ export interface LuaInitOptions {
    * const lua2 = new lua_native.init({}, { shared: { settings: shared } });
    * shared.set('debug', false);  // both contexts see settings.debug === false
    *
+   * A {@link SharedData} store may appear here too: it is bound as a
+   * read-only view of the store's native data rather than copied in.
+   *
    * @see {@link SharedTable} for the propagation model and its limits
    */
-  shared?: Record<string, SharedTable>;
+  shared?: Record<string, SharedTable | SharedData>;
 }
 
 /**
@@ -1456,6 +1917,11 @@ export interface LuaInitOptions {
  * Subscriptions do not keep a context alive: once a context is garbage
  * collected it is dropped from the subscriber list.
  *
+ * A lazy table (`createSharedTable(value, { lazy: true })`) pushes nothing:
+ * `set()`/`sync()` bump a version, and each context pulls a field on its first
+ * read after a change. A Lua-side edit lasts until the next change. In an async
+ * run only fields already pulled for the current version can be read.
+ *
  * @example
  * const shared = lua_native.createSharedTable({ mode: 'dev' });
  * const lua1 = new lua_native.init({}, { shared: { settings: shared } });
@@ -1474,7 +1940,7 @@ export interface SharedTable {
   get(key: string): LuaValue;
 
   /**
-   * Set a top-level field and immediately publish the whole value to every
+   * Set a top-level field and immediately assign that field (only) in every
    * subscribed context.
    *
    * @throws If a subscriber rejects the update. The JS-side value is still
@@ -1483,13 +1949,43 @@ export interface SharedTable {
   set(key: string, value: LuaInput): void;
 
   /**
-   * Re-publish the current value to every subscribed context. Use it after
+   * Publish the top-level keys whose values changed since the last update to
+   * every subscribed context; removed keys become `nil`. Plain objects and
+   * arrays are compared by content, other objects by identity. Use it after
    * mutating the shared object directly (including through a nested object
-   * returned by `get()`), or to retry a `set()` that a busy context rejected.
+   * returned by `get()`), or to retry a `set()` that a busy context rejected —
+   * a context that missed an update receives the whole value.
    *
+   * @param options.full Re-push the whole value instead of the changed keys,
+   *   e.g. after a Lua script replaced its copy of the shared global.
    * @throws If a subscriber rejects the update.
    */
-  sync(): void;
+  sync(options?: { full?: boolean }): void;
+}
+
+/**
+ * An immutable data tree stored once, natively, and read in place by every
+ * context it is bound to (via the `shared` init option) — no per-context copy.
+ * Lua sees a read-only view: indexing, `#`, `pairs` and `ipairs` work as on a
+ * table; assignment raises. Nested tables read out of it are views too.
+ *
+ * Contexts read the current version on each access, including contexts busy
+ * on an async worker; a nested view keeps the version it was read from.
+ */
+export interface SharedData {
+  /**
+   * Replace the data. The new value is converted first, so a value that can't
+   * be stored leaves the current version in place.
+   *
+   * @throws TypeError if the value is not plain data (see createSharedData)
+   */
+  update(value: Record<string, LuaInput> | LuaInput[]): void;
+
+  /** The version number, starting at 1 and incremented by every update(). */
+  version(): number;
+
+  /** Bytes of native memory the current version occupies. */
+  byteSize(): number;
 }
 
 /**
@@ -1512,10 +2008,29 @@ export interface LuaNative {
    * objects.
    *
    * @param initial The object to share. Defaults to an empty object.
+   * @param options.lazy Pull fields into each context on first read instead of
+   *   pushing every update to every context.
    * @example
    * const shared = lua_native.createSharedTable({ config: { debug: true } });
    * const lua = new lua_native.init({}, { shared: { settings: shared } });
    * lua.execute_script('return settings.config.debug');  // true
    */
-  createSharedTable(initial?: Record<string, LuaInput> | LuaInput[]): SharedTable;
+  createSharedTable(
+    initial?: Record<string, LuaInput> | LuaInput[],
+    options?: { lazy?: boolean },
+  ): SharedTable;
+
+  /**
+   * Creates an immutable shared data store: `value` is converted once into a
+   * compact native tree that every context bound to it reads in place.
+   *
+   * @param value An object or array of plain data: null, booleans, numbers,
+   *   strings, arrays and objects. Functions, symbols and BigInts are rejected.
+   * @throws TypeError if the value is not an object or array of plain data
+   * @example
+   * const catalog = lua_native.createSharedData({ items: [{ sku: 'a1', price: 3 }] });
+   * const lua = new lua_native.init({}, { shared: { catalog } });
+   * lua.execute_script('return catalog.items[1].price');  // 3
+   */
+  createSharedData(value: Record<string, LuaInput> | LuaInput[]): SharedData;
 }